@@ -0,0 +1,248 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__x86_64__)
+#  include <immintrin.h>
+#elif defined(__aarch64__)
+#  include <arm_neon.h>
+#endif
+
+#include "ascii-span.h"
+#include "string-util.h"
+
+/* The validators for strings and object paths received on the bus spend most of their time on long runs of
+ * plain ASCII. These helpers find the end of such runs 16 or 32 bytes at a time, leaving only whatever
+ * follows to the byte-wise checks. On x86-64 SSE2 is always available, AVX2 is used if the CPU supports it.
+ * On aarch64 NEON is always available. Everything else gets the scalar loops. */
+
+/* Strings shorter than this are handled by the scalar loops, the vector setup isn't worth it for them */
+#define ASCII_SPAN_VECTOR_MIN 16U
+
+static bool is_object_path_char(char c) {
+        return ascii_isalpha(c) || ascii_isdigit(c) || IN_SET(c, '_', '/');
+}
+
+size_t ascii_span_scalar(const char *s, size_t n) {
+        size_t i;
+
+        assert(s || n == 0);
+
+        for (i = 0; i < n; i++)
+                if (s[i] == 0 || (uint8_t) s[i] >= 0x80)
+                        break;
+
+        return i;
+}
+
+static size_t ascii_span_object_path_scalar_from(const char *s, size_t i, size_t n) {
+        for (; i < n; i++)
+                if (!is_object_path_char(s[i]) ||
+                    (s[i] == '/' && i > 0 && s[i-1] == '/'))
+                        break;
+
+        return i;
+}
+
+size_t ascii_span_object_path_scalar(const char *s, size_t n) {
+        assert(s || n == 0);
+
+        return ascii_span_object_path_scalar_from(s, 0, n);
+}
+
+#if defined(__x86_64__)
+
+static size_t ascii_span_sse2(const char *s, size_t n) {
+        const __m128i zero = _mm_setzero_si128();
+        size_t i = 0;
+
+        for (; i + 16 <= n; i += 16) {
+                __m128i v = _mm_loadu_si128((const __m128i*) (s + i));
+                unsigned mask;
+
+                /* Bytes outside of 7-bit ASCII have the sign bit set already, NUL bytes get it from the
+                 * comparison. */
+                mask = (unsigned) _mm_movemask_epi8(_mm_or_si128(v, _mm_cmpeq_epi8(v, zero)));
+                if (mask != 0)
+                        return i + __builtin_ctz(mask);
+        }
+
+        return i + ascii_span_scalar(s + i, n - i);
+}
+
+static __m128i in_range_sse2(__m128i v, char lo, char hi) {
+        /* Signed comparisons, hence bytes outside of 7-bit ASCII are never in range */
+        return _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(lo - 1)),
+                             _mm_cmplt_epi8(v, _mm_set1_epi8(hi + 1)));
+}
+
+static size_t ascii_span_object_path_sse2(const char *s, size_t i, size_t n) {
+        /* Whether the byte preceding the current block is a slash */
+        unsigned carry = i > 0 && s[i-1] == '/';
+
+        for (; i + 16 <= n; i += 16) {
+                __m128i v = _mm_loadu_si128((const __m128i*) (s + i)), good;
+                unsigned slashes, mask;
+
+                slashes = (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('/')));
+
+                /* Setting 0x20 maps upper case letters onto lower case ones, and nothing else onto them */
+                good = _mm_or_si128(in_range_sse2(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z'),
+                                    _mm_or_si128(in_range_sse2(v, '0', '9'),
+                                                 _mm_cmpeq_epi8(v, _mm_set1_epi8('_'))));
+
+                /* Bad are all other characters, and slashes following a slash */
+                mask = (~((unsigned) _mm_movemask_epi8(good) | slashes) | (slashes & (slashes << 1 | carry))) & 0xFFFFU;
+                if (mask != 0)
+                        return i + __builtin_ctz(mask);
+
+                carry = slashes >> 15;
+        }
+
+        return ascii_span_object_path_scalar_from(s, i, n);
+}
+
+#define _target_avx2_ __attribute__((__target__("avx2")))
+
+_target_avx2_ static size_t ascii_span_avx2(const char *s, size_t n) {
+        const __m256i zero = _mm256_setzero_si256();
+        size_t i = 0;
+
+        for (; i + 32 <= n; i += 32) {
+                __m256i v = _mm256_loadu_si256((const __m256i*) (s + i));
+                uint32_t mask;
+
+                mask = (uint32_t) _mm256_movemask_epi8(_mm256_or_si256(v, _mm256_cmpeq_epi8(v, zero)));
+                if (mask != 0) {
+                        _mm256_zeroupper();
+                        return i + __builtin_ctz(mask);
+                }
+        }
+
+        /* Mixing AVX and SSE code is expensive if the upper halves of the registers are in use, and not all
+         * compilers at all optimization levels clear them for us when returning. */
+        _mm256_zeroupper();
+        return i + ascii_span_sse2(s + i, n - i);
+}
+
+_target_avx2_ static __m256i in_range_avx2(__m256i v, char lo, char hi) {
+        return _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8(lo - 1)),
+                                _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), v));
+}
+
+_target_avx2_ static size_t ascii_span_object_path_avx2(const char *s, size_t n) {
+        uint32_t carry = 0;
+        size_t i = 0;
+
+        for (; i + 32 <= n; i += 32) {
+                __m256i v = _mm256_loadu_si256((const __m256i*) (s + i)), good;
+                uint32_t slashes, mask;
+
+                slashes = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('/')));
+                good = _mm256_or_si256(in_range_avx2(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z'),
+                                       _mm256_or_si256(in_range_avx2(v, '0', '9'),
+                                                       _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'))));
+
+                mask = ~((uint32_t) _mm256_movemask_epi8(good) | slashes) | (slashes & (slashes << 1 | carry));
+                if (mask != 0) {
+                        _mm256_zeroupper();
+                        return i + __builtin_ctz(mask);
+                }
+
+                carry = slashes >> 31;
+        }
+
+        _mm256_zeroupper();
+        return ascii_span_object_path_sse2(s, i, n);
+}
+
+static bool have_avx2(void) {
+        static int cached = -1;
+
+        if (cached < 0) {
+                __builtin_cpu_init();
+                cached = __builtin_cpu_supports("avx2");
+        }
+
+        return cached;
+}
+
+#elif defined(__aarch64__)
+
+static size_t ascii_span_neon(const char *s, size_t n) {
+        size_t i = 0;
+
+        for (; i + 16 <= n; i += 16) {
+                uint8x16_t v = vld1q_u8((const uint8_t*) s + i);
+
+                /* Find out whether there's a bad byte in this block at all, and leave the search for its
+                 * position to the scalar loop. */
+                if (vmaxvq_u8(vorrq_u8(vceqzq_u8(v), vcgeq_u8(v, vdupq_n_u8(0x80)))) != 0)
+                        break;
+        }
+
+        return i + ascii_span_scalar(s + i, n - i);
+}
+
+static size_t ascii_span_object_path_neon(const char *s, size_t n) {
+        uint8x16_t previous = vdupq_n_u8(0);
+        size_t i = 0;
+
+        for (; i + 16 <= n; i += 16) {
+                uint8x16_t v = vld1q_u8((const uint8_t*) s + i), slashes, good;
+
+                /* Unsigned range checks, via wrap-around of the subtraction */
+                slashes = vceqq_u8(v, vdupq_n_u8('/'));
+                good = vorrq_u8(
+                                vorrq_u8(vcleq_u8(vsubq_u8(vorrq_u8(v, vdupq_n_u8(0x20)), vdupq_n_u8('a')), vdupq_n_u8('z' - 'a')),
+                                         vcleq_u8(vsubq_u8(v, vdupq_n_u8('0')), vdupq_n_u8('9' - '0'))),
+                                vorrq_u8(vceqq_u8(v, vdupq_n_u8('_')),
+                                         vbicq_u8(slashes, vextq_u8(previous, slashes, 15))));
+
+                if (vminvq_u8(good) == 0)
+                        break;
+
+                previous = slashes;
+        }
+
+        return ascii_span_object_path_scalar_from(s, i, n);
+}
+
+#endif
+
+size_t ascii_span(const char *s, size_t n) {
+        assert(s || n == 0);
+
+        if (n < ASCII_SPAN_VECTOR_MIN)
+                return ascii_span_scalar(s, n);
+
+#if defined(__x86_64__)
+        if (n >= 32 && have_avx2())
+                return ascii_span_avx2(s, n);
+
+        return ascii_span_sse2(s, n);
+#elif defined(__aarch64__)
+        return ascii_span_neon(s, n);
+#else
+        return ascii_span_scalar(s, n);
+#endif
+}
+
+size_t ascii_span_object_path(const char *s, size_t n) {
+        assert(s || n == 0);
+
+        if (n < ASCII_SPAN_VECTOR_MIN)
+                return ascii_span_object_path_scalar_from(s, 0, n);
+
+#if defined(__x86_64__)
+        if (n >= 32 && have_avx2())
+                return ascii_span_object_path_avx2(s, n);
+
+        return ascii_span_object_path_sse2(s, 0, n);
+#elif defined(__aarch64__)
+        return ascii_span_object_path_neon(s, n);
+#else
+        return ascii_span_object_path_scalar_from(s, 0, n);
+#endif
+}
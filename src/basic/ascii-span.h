@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <stddef.h>
+
+#include "macro.h"
+
+/* Return the length of the longest prefix of the n bytes at s that consists of 7-bit ASCII characters
+ * other than NUL. Such a prefix is always valid UTF-8, and ends on a character boundary. */
+size_t ascii_span(const char *s, size_t n) _pure_;
+
+/* Return the length of the longest prefix of the n bytes at s that consists of characters that may appear
+ * in D-Bus object paths, i.e. [A-Za-z0-9_/], and doesn't contain two consecutive slashes. */
+size_t ascii_span_object_path(const char *s, size_t n) _pure_;
+
+/* The plain versions of the above, as reference for the vectorized ones. Exported for the tests. */
+size_t ascii_span_scalar(const char *s, size_t n) _pure_;
+size_t ascii_span_object_path_scalar(const char *s, size_t n) _pure_;
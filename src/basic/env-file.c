@@ -8,7 +8,7 @@
 #include "fileio.h"
 //#include "fs-util.h"
 #include "string-util.h"
-//#include "strv.h"
+#include "strv.h"
 // #include "tmpfile-util.h"
 #include "utf8.h"
 
@@ -457,6 +457,7 @@ int load_env_file(FILE *f, const char *fname, char ***ret) {
         *ret = TAKE_PTR(m);
         return 0;
 }
+#endif // 0
 
 static int load_env_file_push_pairs(
                 const char *filename, unsigned line,
@@ -506,6 +507,7 @@ int load_env_file_pairs(FILE *f, const char *fname, char ***ret) {
         return 0;
 }
 
+#if 0 /// UNNEEDED by elogind
 int load_env_file_pairs_fd(int fd, const char *fname, char ***ret) {
         _cleanup_fclose_ FILE *f = NULL;
         int r;
@@ -17,13 +17,16 @@
 #include "fd-util.h"
 #include "fileio.h"
 #include "fs-util.h"
+#include "hashmap.h"
 #include "hexdecoct.h"
 #include "log.h"
 #include "macro.h"
+#include "missing_threads.h"
 #include "mkdir.h"
 #include "nulstr-util.h"
 //#include "parse-util.h"
 #include "path-util.h"
+#include "process-util.h"
 #include "socket-util.h"
 //#include "stdio-util.h"
 #include "string-util.h"
@@ -568,6 +571,133 @@ int read_virtual_file_at(
         return read_virtual_file_fd(fd, max_size, ret_contents, ret_size);
 }
 
+/* Attributes in sysfs and procfs which are looked at over and over again are kept open, and are reread
+ * with pread() at offset 0, which both support. This saves the open(), fstat() and close() (and the
+ * second read() of read_one_line_file()) per read, i.e. one syscall instead of four or five. Maps the
+ * path to the fd. */
+static thread_local Hashmap *virtual_attribute_fds = NULL;
+static thread_local pid_t virtual_attribute_fds_pid = 0;
+
+static void virtual_attribute_cache_check_owner(void) {
+        if (!virtual_attribute_fds || virtual_attribute_fds_pid == getpid_cached())
+                return;
+
+        /* Inherited from our parent. The fds might have been closed since, and their numbers reused, hence
+         * forget about them without closing them. */
+        virtual_attribute_fds = hashmap_free(virtual_attribute_fds);
+}
+
+static void virtual_attribute_cache_drop(const char *path) {
+        _cleanup_free_ char *key = NULL;
+        void *fd;
+
+        fd = hashmap_remove2(virtual_attribute_fds, path, (void**) &key);
+        if (fd)
+                safe_close(PTR_TO_FD(fd));
+}
+
+static int pread_virtual_attribute(int fd, char **ret) {
+        size_t size;
+
+        assert(fd >= 0);
+        assert(ret);
+
+        /* sysfs attributes are at most a page, and so are most procfs files we are interested in */
+        size = MIN(page_size(), (size_t) READ_VIRTUAL_BYTES_MAX);
+
+        for (;;) {
+                _cleanup_free_ char *buf = NULL;
+                ssize_t n;
+
+                buf = malloc(size + 1);
+                if (!buf)
+                        return -ENOMEM;
+
+                /* Read one more byte to be able to tell if the buffer was large enough. As in
+                 * read_virtual_file_fd(), the contents must be read in one go, a short read is EOF. */
+                n = pread(fd, buf, size + 1, 0);
+                if (n < 0)
+                        return -errno;
+
+                if ((size_t) n <= size) {
+                        if (memchr(buf, 0, n))
+                                return -EBADMSG;
+
+                        buf[n] = 0;
+                        delete_trailing_chars(buf, NEWLINE);
+
+                        *ret = TAKE_PTR(buf);
+                        return 0;
+                }
+
+                if (size >= READ_VIRTUAL_BYTES_MAX)
+                        return -EFBIG;
+
+                size = MIN(size * 4, (size_t) READ_VIRTUAL_BYTES_MAX);
+        }
+}
+
+int read_virtual_attribute(const char *path, char **ret) {
+        _cleanup_close_ int fd = -EBADF;
+        _cleanup_free_ char *key = NULL;
+        int cached, r;
+
+        assert(path);
+        assert(ret);
+
+        /* Reads a sysfs or procfs attribute like read_one_line_file() would (i.e. without the trailing
+         * newline), but keeps the file open for the next time. Callers which learn that the attribute went
+         * away (e.g. on a udev "remove" event) should call virtual_attribute_cache_invalidate(). */
+
+        virtual_attribute_cache_check_owner();
+
+        cached = PTR_TO_FD(hashmap_get(virtual_attribute_fds, path));
+        if (cached >= 0) {
+                if (pread_virtual_attribute(cached, ret) >= 0)
+                        return 0;
+
+                /* The device might have gone away and come back, hence try again with a fresh fd */
+                virtual_attribute_cache_drop(path);
+        }
+
+        fd = open(path, O_RDONLY|O_CLOEXEC|O_NOCTTY);
+        if (fd < 0)
+                return -errno;
+
+        r = pread_virtual_attribute(fd, ret);
+        if (r < 0)
+                return r;
+
+        /* Failing to remember the fd is not fatal, we just have to open the file again next time */
+        key = strdup(path);
+        if (!key)
+                return 0;
+
+        if (hashmap_ensure_put(&virtual_attribute_fds, &string_hash_ops_free, key, FD_TO_PTR(fd)) < 0)
+                return 0;
+
+        virtual_attribute_fds_pid = getpid_cached();
+        TAKE_PTR(key);
+        TAKE_FD(fd);
+        return 0;
+}
+
+void virtual_attribute_cache_invalidate(const char *prefix) {
+        const char *path;
+        void *fd;
+
+        /* Closes the fds of the attributes at or below the specified path, or all of them if NULL. */
+
+        virtual_attribute_cache_check_owner();
+
+        HASHMAP_FOREACH_KEY(fd, path, virtual_attribute_fds)
+                if (!prefix || path_startswith(path, prefix))
+                        virtual_attribute_cache_drop(path);
+
+        if (hashmap_isempty(virtual_attribute_fds))
+                virtual_attribute_fds = hashmap_free(virtual_attribute_fds);
+}
+
 int read_full_stream_full(
                 FILE *f,
                 const char *filename,
@@ -824,18 +954,26 @@ int executable_is_script(const char *path, char **interpreter) {
  */
 int get_proc_field(const char *filename, const char *pattern, const char *terminator, char **field) {
         _cleanup_free_ char *status = NULL;
-        char *t, *f;
         int r;
 
-        assert(terminator);
         assert(filename);
-        assert(pattern);
-        assert(field);
 
         r = read_full_virtual_file(filename, &status, NULL);
         if (r < 0)
                 return r;
 
+        return get_proc_field_from_string(status, pattern, terminator, field);
+}
+
+int get_proc_field_from_string(const char *status, const char *pattern, const char *terminator, char **field) {
+        const char *t;
+        char *f;
+
+        assert(status);
+        assert(terminator);
+        assert(pattern);
+        assert(field);
+
         t = status;
 
         do {
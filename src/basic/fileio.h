@@ -92,6 +92,9 @@ static inline int read_full_virtual_file(const char *filename, char **ret_conten
         return read_virtual_file(filename, SIZE_MAX, ret_contents, ret_size);
 }
 
+int read_virtual_attribute(const char *path, char **ret);
+void virtual_attribute_cache_invalidate(const char *prefix);
+
 int read_full_stream_full(FILE *f, const char *filename, uint64_t offset, size_t size, ReadFullFileFlags flags, char **ret_contents, size_t *ret_size);
 static inline int read_full_stream(FILE *f, char **ret_contents, size_t *ret_size) {
         return read_full_stream_full(f, NULL, UINT64_MAX, SIZE_MAX, 0, ret_contents, ret_size);
@@ -107,6 +110,7 @@ int executable_is_script(const char *path, char **interpreter);
 #endif // 0
 
 int get_proc_field(const char *filename, const char *pattern, const char *terminator, char **field);
+int get_proc_field_from_string(const char *status, const char *pattern, const char *terminator, char **field);
 
 DIR *xopendirat(int dirfd, const char *name, int flags);
 
@@ -98,6 +98,7 @@ enum pcapng_epb_options {
         PCAPNG_EPB_QUEUE,
         PCAPNG_EPB_VERDICT,
 };
+#endif // 0
 
 struct pcapng_statistics_block {
         uint32_t block_type;	/* 5 */
@@ -116,4 +117,3 @@ enum pcapng_isb_options {
         PCAPNG_ISB_OSDROP,
         PCAPNG_ISB_USRDELIV,
 };
-#endif // 0
@@ -243,7 +243,6 @@ usec_t timespec_load(const struct timespec *ts) {
                 (usec_t) ts->tv_nsec / NSEC_PER_USEC;
 }
 
-#if 0 /// UNNEEDED by elogind
 nsec_t timespec_load_nsec(const struct timespec *ts) {
         assert(ts);
 
@@ -255,7 +254,6 @@ nsec_t timespec_load_nsec(const struct timespec *ts) {
 
         return (nsec_t) ts->tv_sec * NSEC_PER_SEC + (nsec_t) ts->tv_nsec;
 }
-#endif // 0
 
 struct timespec *timespec_store(struct timespec *ts, usec_t u) {
         assert(ts);
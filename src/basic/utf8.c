@@ -28,6 +28,7 @@
 #include <stdlib.h>
 
 #include "alloc-util.h"
+#include "ascii-span.h"
 #include "gunicode.h"
 #include "hexdecoct.h"
 #include "macro.h"
@@ -152,7 +153,13 @@ char *utf8_is_valid_n(const char *str, size_t len_bytes) {
 
         assert(str);
 
-        for (const char *p = str; len_bytes != SIZE_MAX ? (size_t) (p - str) < len_bytes : *p != '\0'; ) {
+        /* Plain ASCII is valid as it is, and typically makes up all or most of the string. Skip over it
+         * quickly. If it's followed by anything, that starts on a character boundary. */
+        const char *p = str;
+        if (len_bytes != SIZE_MAX)
+                p += ascii_span(str, len_bytes);
+
+        while (len_bytes != SIZE_MAX ? (size_t) (p - str) < len_bytes : *p != '\0') {
                 int len;
 
                 if (_unlikely_(*p == '\0') && len_bytes != SIZE_MAX)
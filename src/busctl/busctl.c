@@ -3,12 +3,15 @@
 #include <getopt.h>
 
 #include "sd-bus.h"
+#include "sd-event.h"
 
 #include "alloc-util.h"
 #include "build.h"
 #include "bus-dump.h"
 #include "bus-internal.h"
+#include "bus-match.h"
 #include "bus-message.h"
+#include "bus-message-json.h"
 #include "bus-signature.h"
 #include "bus-type.h"
 #include "bus-util.h"
@@ -17,11 +20,15 @@
 #include "fd-util.h"
 #include "fileio.h"
 #include "format-table.h"
+#include "format-util.h"
 #include "glyph-util.h"
+#include "iovec-util.h"
 #include "json.h"
+#include "list.h"
 #include "log.h"
 #include "main-func.h"
 #include "memstream-util.h"
+#include "ordered-set.h"
 #include "os-util.h"
 #include "pager.h"
 #include "parse-argument.h"
@@ -33,6 +40,7 @@
 #include "sort-util.h"
 #include "strv.h"
 #include "terminal-util.h"
+#include "time-util.h"
 #include "user-util.h"
 #include "verbs.h"
 #include "version.h"
@@ -54,6 +62,10 @@ static size_t arg_snaplen = 4096;
 static bool arg_list = false;
 static bool arg_quiet = false;
 static bool arg_verbose = false;
+static unsigned arg_max_inflight = 64;
+static size_t arg_ring_size = 0;
+static usec_t arg_ring_time = 0;
+static char **arg_triggers = NULL;
 static bool arg_xml_interface = false;
 static bool arg_expect_reply = true;
 static bool arg_auto_start = true;
@@ -64,12 +76,11 @@ static usec_t arg_timeout = 0;
 static const char *arg_destination = NULL;
 
 STATIC_DESTRUCTOR_REGISTER(arg_matches, strv_freep);
+STATIC_DESTRUCTOR_REGISTER(arg_triggers, strv_freep);
 
 #define NAME_IS_ACQUIRED INT_TO_PTR(1)
 #define NAME_IS_ACTIVATABLE INT_TO_PTR(2)
 
-static int json_transform_message(sd_bus_message *m, JsonVariant **ret);
-
 static int acquire_bus(bool set_monitor, sd_bus **ret) {
         _cleanup_(sd_bus_close_unrefp) sd_bus *bus = NULL;
         int r;
@@ -159,6 +170,8 @@ static int list_bus_names(int argc, char **argv, void *userdata) {
         _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
         _cleanup_hashmap_free_ Hashmap *names = NULL;
         _cleanup_(table_unrefp) Table *table = NULL;
+        _cleanup_free_ char **sorted = NULL;
+        size_t n = 0;
         char *k;
         void *v;
         int r;
@@ -227,10 +240,6 @@ static int list_bus_names(int argc, char **argv, void *userdata) {
 
         table_set_ersatz_string(table, TABLE_ERSATZ_DASH);
 
-        r = table_set_sort(table, (size_t) COLUMN_NAME);
-        if (r < 0)
-                return log_error_errno(r, "Failed to set sort column: %m");
-
         if (arg_show_machine)
                 r = table_set_display(table, (size_t) COLUMN_NAME,
                                              (size_t) COLUMN_PID,
@@ -254,9 +263,34 @@ static int list_bus_names(int argc, char **argv, void *userdata) {
         if (r < 0)
                 return log_error_errno(r, "Failed to set columns to display: %m");
 
-        HASHMAP_FOREACH_KEY(v, k, names) {
+        /* Add the rows ordered by name already, rather than having the table sort them, so that they can be
+         * written out while the table is filled */
+        sorted = new(char*, hashmap_size(names) + 1);
+        if (!sorted)
+                return log_oom();
+
+        HASHMAP_FOREACH_KEY(v, k, names)
+                sorted[n++] = k;
+        sorted[n] = NULL;
+
+        strv_sort(sorted);
+
+        if (FLAGS_SET(arg_json_format_flags, JSON_FORMAT_OFF)) {
+                /* Rows are written out as they come, hence the pager needs to be running already */
+                pager_open(arg_pager_flags);
+                table_set_header(table, arg_legend);
+
+                r = table_set_stream(table, stdout, TABLE_STREAM_SAMPLE_DEFAULT);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to set up table output: %m");
+        }
+
+        STRV_FOREACH(i, sorted) {
                 _cleanup_(sd_bus_creds_unrefp) sd_bus_creds *creds = NULL;
 
+                k = *i;
+                v = hashmap_get(names, k);
+
                 if (v == NAME_IS_ACTIVATABLE) {
                         r = table_add_many(
                                         table,
@@ -437,79 +471,210 @@ static void print_tree(char **l) {
                 print_subtree("", "/", l);
 }
 
+typedef struct TreeWalk TreeWalk;
+
+typedef struct TreeCall {
+        TreeWalk *walk;
+        char *path;
+        sd_bus_slot *slot;
+
+        LIST_FIELDS(struct TreeCall, calls);
+} TreeCall;
+
+struct TreeWalk {
+        const char *service;
+
+        /* Paths we know about but did not ask for yet, in the order we found them */
+        OrderedSet *queue;
+        Set *seen;
+
+        Set *done, *failed;
+
+        LIST_HEAD(TreeCall, calls);
+        unsigned n_inflight, max_inflight;
+        unsigned n_calls;
+
+        int r;
+};
+
+static TreeCall* tree_call_free(TreeCall *c) {
+        if (!c)
+                return NULL;
+
+        if (c->walk) {
+                LIST_REMOVE(calls, c->walk->calls, c);
+                c->walk->n_inflight--;
+        }
+
+        sd_bus_slot_unref(c->slot);
+        free(c->path);
+        return mfree(c);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(TreeCall*, tree_call_free);
+
+static void tree_walk_done(TreeWalk *w) {
+        assert(w);
+
+        while (w->calls)
+                tree_call_free(w->calls);
+
+        ordered_set_free(w->queue);
+        set_free(w->seen);
+        set_free(w->done);
+        set_free(w->failed);
+}
+
 static int on_path(const char *path, void *userdata) {
-        Set *paths = ASSERT_PTR(userdata);
+        TreeWalk *w = ASSERT_PTR(userdata);
+        _cleanup_free_ char *p = NULL;
         int r;
 
-        r = set_put_strdup(&paths, path);
+        if (set_contains(w->seen, path))
+                return 0;
+
+        p = strdup(path);
+        if (!p)
+                return log_oom();
+
+        r = set_ensure_put(&w->seen, &string_hash_ops_free, p);
+        if (r < 0)
+                return log_oom();
+
+        /* The queue refers to the copy owned by the set of paths we saw */
+        r = ordered_set_ensure_put(&w->queue, &string_hash_ops, TAKE_PTR(p));
         if (r < 0)
                 return log_oom();
 
         return 0;
 }
 
-static int find_nodes(sd_bus *bus, const char *service, const char *path, Set *paths) {
+static int on_introspect_reply(sd_bus_message *reply, void *userdata, sd_bus_error *ret_error) {
         static const XMLIntrospectOps ops = {
                 .on_path = on_path,
         };
 
-        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
-        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        TreeCall *c = ASSERT_PTR(userdata);
+        TreeWalk *w = ASSERT_PTR(c->walk);
+        const sd_bus_error *e;
         const char *xml;
         int r;
 
-        r = sd_bus_call_method(bus, service, path,
-                               "org.freedesktop.DBus.Introspectable", "Introspect",
-                               &error, &reply, NULL);
-        if (r < 0) {
+        assert(reply);
+
+        e = sd_bus_message_get_error(reply);
+        if (e) {
+                r = -sd_bus_message_get_errno(reply);
                 printf("%sFailed to introspect object %s of service %s: %s%s\n",
                        ansi_highlight_red(),
-                       path, service, bus_error_message(&error, r),
+                       c->path, w->service, bus_error_message(e, r),
                        ansi_normal());
-                return r;
+                goto finish;
         }
 
         r = sd_bus_message_read(reply, "s", &xml);
+        if (r < 0) {
+                r = bus_log_parse_error(r);
+                goto finish;
+        }
+
+        /* The replies come in while further calls are still in flight, parse each right away */
+        r = parse_xml_introspect(c->path, xml, &ops, w);
+
+finish:
+        if (r < 0 && w->r >= 0)
+                w->r = r;
+
+        r = set_ensure_consume(r < 0 ? &w->failed : &w->done, &string_hash_ops_free, TAKE_PTR(c->path));
+        tree_call_free(c);
         if (r < 0)
-                return bus_log_parse_error(r);
+                return log_oom();
 
-        return parse_xml_introspect(path, xml, &ops, paths);
+        return 0;
+}
+
+static int tree_walk_call(sd_bus *bus, TreeWalk *w, const char *path) {
+        _cleanup_(tree_call_freep) TreeCall *c = NULL;
+        int r;
+
+        c = new0(TreeCall, 1);
+        if (!c)
+                return log_oom();
+
+        c->path = strdup(path);
+        if (!c->path)
+                return log_oom();
+
+        r = sd_bus_call_method_async(bus, &c->slot, w->service, path,
+                                     "org.freedesktop.DBus.Introspectable", "Introspect",
+                                     on_introspect_reply, c, NULL);
+        if (r < 0)
+                return log_error_errno(r, "Failed to introspect object %s of service %s: %m", path, w->service);
+
+        c->walk = w;
+        LIST_PREPEND(calls, w->calls, c);
+        w->n_inflight++;
+        w->n_calls++;
+
+        TAKE_PTR(c);
+        return 0;
 }
 
 static int tree_one(sd_bus *bus, const char *service) {
-        _cleanup_set_free_ Set *paths = NULL, *done = NULL, *failed = NULL;
+        _cleanup_(tree_walk_done) TreeWalk w = {
+                .service = service,
+                .max_inflight = arg_max_inflight,
+        };
         _cleanup_free_ char **l = NULL;
+        unsigned max_seen = 0;
+        usec_t begin;
         int r;
 
-        r = set_put_strdup(&paths, "/");
+        /* Walks the tree breadth-first. Instead of waiting for each reply before asking for the next
+         * object, keeps up to arg_max_inflight calls on the wire, so that services with many objects
+         * don't take one round trip per object. */
+
+        begin = now(CLOCK_MONOTONIC);
+
+        r = on_path("/", &w);
         if (r < 0)
-                return log_oom();
+                return r;
 
         for (;;) {
-                _cleanup_free_ char *p = NULL;
-                int q;
+                const char *p;
 
-                p = set_steal_first(paths);
-                if (!p)
+                while (w.n_inflight < w.max_inflight &&
+                       (p = ordered_set_steal_first(w.queue))) {
+                        r = tree_walk_call(bus, &w, p);
+                        if (r < 0)
+                                return r;
+                }
+
+                max_seen = MAX(max_seen, w.n_inflight);
+
+                if (w.n_inflight == 0)
                         break;
 
-                if (set_contains(done, p) ||
-                    set_contains(failed, p))
+                r = sd_bus_process(bus, NULL);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to process bus: %m");
+                if (r > 0)
                         continue;
 
-                q = find_nodes(bus, service, p, paths);
-                if (q < 0 && r >= 0)
-                        r = q;
-
-                q = set_ensure_consume(q < 0 ? &failed : &done, &string_hash_ops_free, TAKE_PTR(p));
-                assert(q != 0);
-                if (q < 0)
-                        return log_oom();
+                r = sd_bus_wait(bus, UINT64_MAX);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to wait for bus: %m");
         }
 
+        log_full(arg_verbose ? LOG_INFO : LOG_DEBUG,
+                 "Introspected %u objects of service %s in %s, with up to %u calls in flight.",
+                 w.n_calls, service,
+                 FORMAT_TIMESPAN(usec_sub_unsigned(now(CLOCK_MONOTONIC), begin), USEC_PER_MSEC),
+                 max_seen);
+
         pager_open(arg_pager_flags);
 
-        l = set_get_strv(done);
+        l = set_get_strv(w.done);
         if (!l)
                 return log_oom();
 
@@ -518,7 +683,7 @@ static int tree_one(sd_bus *bus, const char *service) {
 
         fflush(stdout);
 
-        return r;
+        return w.r;
 }
 
 static int tree(int argc, char **argv, void *userdata) {
@@ -1201,56 +1366,18 @@ static int message_pcap(sd_bus_message *m, FILE *f) {
 }
 
 static int message_json(sd_bus_message *m, FILE *f) {
-        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL, *w = NULL;
-        char e[2];
-        int r;
-        usec_t ts;
-
-        r = json_transform_message(m, &v);
-        if (r < 0)
-                return r;
-
-        e[0] = m->header->endian;
-        e[1] = 0;
-
-        ts = m->realtime;
-        if (ts == 0)
-                ts = now(CLOCK_REALTIME);
-
-        r = json_build(&w, JSON_BUILD_OBJECT(
-                JSON_BUILD_PAIR("type", JSON_BUILD_STRING(bus_message_type_to_string(m->header->type))),
-                JSON_BUILD_PAIR("endian", JSON_BUILD_STRING(e)),
-                JSON_BUILD_PAIR("flags", JSON_BUILD_INTEGER(m->header->flags)),
-                JSON_BUILD_PAIR("version", JSON_BUILD_INTEGER(m->header->version)),
-                JSON_BUILD_PAIR("cookie", JSON_BUILD_INTEGER(BUS_MESSAGE_COOKIE(m))),
-                JSON_BUILD_PAIR_CONDITION(m->reply_cookie != 0, "reply_cookie", JSON_BUILD_INTEGER(m->reply_cookie)),
-                JSON_BUILD_PAIR("timestamp-realtime", JSON_BUILD_UNSIGNED(ts)),
-                JSON_BUILD_PAIR_CONDITION(m->sender, "sender", JSON_BUILD_STRING(m->sender)),
-                JSON_BUILD_PAIR_CONDITION(m->destination, "destination", JSON_BUILD_STRING(m->destination)),
-                JSON_BUILD_PAIR_CONDITION(m->path, "path", JSON_BUILD_STRING(m->path)),
-                JSON_BUILD_PAIR_CONDITION(m->interface, "interface", JSON_BUILD_STRING(m->interface)),
-                JSON_BUILD_PAIR_CONDITION(m->member, "member", JSON_BUILD_STRING(m->member)),
-                JSON_BUILD_PAIR_CONDITION(m->monotonic != 0, "monotonic", JSON_BUILD_INTEGER(m->monotonic)),
-                JSON_BUILD_PAIR_CONDITION(m->realtime != 0, "realtime", JSON_BUILD_INTEGER(m->realtime)),
-                JSON_BUILD_PAIR_CONDITION(m->seqnum != 0, "seqnum", JSON_BUILD_INTEGER(m->seqnum)),
-                JSON_BUILD_PAIR_CONDITION(m->error.name, "error_name", JSON_BUILD_STRING(m->error.name)),
-                JSON_BUILD_PAIR("payload", JSON_BUILD_VARIANT(v))));
-        if (r < 0)
-                return log_error_errno(r, "Failed to build JSON object: %m");
-
-        json_variant_dump(w, arg_json_format_flags, f, NULL);
-        return 0;
+        return bus_message_dump_json(m, arg_json_format_flags, f);
 }
 
-static int monitor(int argc, char **argv, int (*dump)(sd_bus_message *m, FILE *f)) {
+static int become_monitor(int argc, char **argv, sd_bus **ret) {
         _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *message = NULL;
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         uint32_t flags = 0;
-        const char *unique_name;
-        bool is_monitor = false;
         int r;
 
+        assert(ret);
+
         r = acquire_bus(true, &bus);
         if (r < 0)
                 return r;
@@ -1312,6 +1439,20 @@ static int monitor(int argc, char **argv, int (*dump)(sd_bus_message *m, FILE *f
                 return log_error_errno(r, "Call to org.freedesktop.DBus.Monitoring.BecomeMonitor failed: %s",
                                        bus_error_message(&error, r));
 
+        *ret = TAKE_PTR(bus);
+        return 0;
+}
+
+static int monitor(int argc, char **argv, int (*dump)(sd_bus_message *m, FILE *f)) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        const char *unique_name;
+        bool is_monitor = false;
+        int r;
+
+        r = become_monitor(argc, argv, &bus);
+        if (r < 0)
+                return r;
+
         r = sd_bus_get_unique_name(bus, &unique_name);
         if (r < 0)
                 return log_error_errno(r, "Failed to get unique name: %m");
@@ -1371,6 +1512,360 @@ static int verb_monitor(int argc, char **argv, void *userdata) {
         return monitor(argc, argv, (arg_json_format_flags & JSON_FORMAT_OFF) ? message_dump : message_json);
 }
 
+/* In ring mode 'capture' keeps the most recent traffic in memory as pre-encoded pcapng blocks, and only
+ * writes it out on SIGUSR1 or when a message matches one of the --trigger= matches. Each dump is a pcapng
+ * section of its own, closed by an interface statistics block that carries the number of messages
+ * received and dropped from the ring since the previous dump. */
+
+#define CAPTURE_RING_SIZE_DEFAULT (16U * 1024U * 1024U)
+
+typedef struct CaptureFrame CaptureFrame;
+
+struct CaptureFrame {
+        LIST_FIELDS(CaptureFrame, frames);
+        usec_t timestamp; /* CLOCK_MONOTONIC */
+        size_t size;
+        uint8_t data[];
+};
+
+typedef struct CaptureRing {
+        sd_event *event;
+        const char *unique_name;
+        bool is_monitor;
+
+        /* Pre-encoded section header and interface description blocks */
+        char *header;
+        size_t header_size;
+
+        LIST_HEAD(CaptureFrame, frames);
+        CaptureFrame *frames_tail;
+        size_t n_frames;
+        size_t size;
+        size_t max_size;
+
+        usec_t since; /* CLOCK_REALTIME, start of the period the counters cover */
+        uint64_t n_received;
+        uint64_t n_dropped;
+
+        struct bus_match_node triggers;
+        sd_bus_slot *trigger_slots;
+        bool triggered;
+} CaptureRing;
+
+static void capture_ring_clear(CaptureRing *c) {
+        assert(c);
+
+        LIST_CLEAR(frames, c->frames, free);
+        c->frames_tail = NULL;
+        c->n_frames = 0;
+        c->size = 0;
+}
+
+static void capture_ring_done(CaptureRing *c) {
+        assert(c);
+
+        capture_ring_clear(c);
+        bus_match_free(&c->triggers);
+        c->trigger_slots = mfree(c->trigger_slots);
+        c->header = mfree(c->header);
+        c->event = sd_event_unref(c->event);
+}
+
+static void capture_ring_drop_oldest(CaptureRing *c) {
+        CaptureFrame *f;
+
+        assert(c);
+        assert_se(f = LIST_POP(frames, c->frames));
+
+        if (!c->frames)
+                c->frames_tail = NULL;
+
+        c->n_frames--;
+        c->size -= f->size;
+        c->n_dropped++;
+        free(f);
+}
+
+static void capture_ring_expire(CaptureRing *c, usec_t n) {
+        assert(c);
+
+        if (IN_SET(arg_ring_time, 0, USEC_INFINITY))
+                return;
+
+        while (c->frames && usec_add(c->frames->timestamp, arg_ring_time) < n)
+                capture_ring_drop_oldest(c);
+}
+
+static void capture_ring_add(CaptureRing *c, sd_bus_message *m) {
+        CaptureFrame *f;
+        size_t sz;
+
+        assert(c);
+        assert(m);
+
+        c->n_received++;
+
+        sz = bus_message_pcap_frame_size(m, arg_snaplen);
+        if (sz > c->max_size) {
+                c->n_dropped++;
+                return;
+        }
+
+        f = malloc(offsetof(CaptureFrame, data) + sz);
+        if (!f) {
+                /* Keep going, this is reported like any other loss */
+                c->n_dropped++;
+                return;
+        }
+
+        *f = (CaptureFrame) {
+                .timestamp = now(CLOCK_MONOTONIC),
+                .size = sz,
+        };
+        bus_message_pcap_frame_to_buffer(m, arg_snaplen, f->data);
+
+        capture_ring_expire(c, f->timestamp);
+        while (c->size + sz > c->max_size)
+                capture_ring_drop_oldest(c);
+
+        LIST_INSERT_AFTER(frames, c->frames, c->frames_tail, f);
+        c->frames_tail = f;
+        c->n_frames++;
+        c->size += sz;
+}
+
+static int capture_ring_flush(CaptureRing *c, const char *reason) {
+        _cleanup_(memstream_done) MemStream ms = {};
+        _cleanup_free_ struct iovec *iovec = NULL;
+        _cleanup_free_ char *statistics = NULL;
+        size_t n_iovec = 0, statistics_size;
+        usec_t n;
+        FILE *f;
+        int r;
+
+        assert(c);
+        assert(reason);
+
+        capture_ring_expire(c, now(CLOCK_MONOTONIC));
+
+        n = now(CLOCK_REALTIME);
+
+        f = memstream_init(&ms);
+        if (!f)
+                return log_oom();
+
+        r = bus_pcap_statistics(c->since, n, c->n_received, c->n_dropped, f);
+        if (r < 0)
+                return log_error_errno(r, "Failed to encode capture statistics: %m");
+
+        r = memstream_finalize(&ms, &statistics, &statistics_size);
+        if (r < 0)
+                return log_error_errno(r, "Failed to encode capture statistics: %m");
+
+        iovec = new(struct iovec, c->n_frames + 2);
+        if (!iovec)
+                return log_oom();
+
+        iovec[n_iovec++] = IOVEC_MAKE(c->header, c->header_size);
+        LIST_FOREACH(frames, i, c->frames)
+                iovec[n_iovec++] = IOVEC_MAKE(i->data, i->size);
+        iovec[n_iovec++] = IOVEC_MAKE(statistics, statistics_size);
+
+        /* Write out as many frames as the kernel takes with one call, rather than one frame at a time */
+        for (size_t k = 0; k < n_iovec;) {
+                ssize_t l;
+
+                l = writev(STDOUT_FILENO, iovec + k, MIN(n_iovec - k, (size_t) IOV_MAX));
+                if (l < 0) {
+                        if (errno == EINTR)
+                                continue;
+
+                        return log_error_errno(errno, "Couldn't write capture file: %m");
+                }
+
+                if (iovec_increment(iovec + k, MIN(n_iovec - k, (size_t) IOV_MAX), l))
+                        k += MIN(n_iovec - k, (size_t) IOV_MAX);
+        }
+
+        log_info("Wrote %zu messages (%s) on %s, %" PRIu64 " of %" PRIu64 " messages received since %s were dropped.",
+                 c->n_frames, FORMAT_BYTES(c->size), reason,
+                 c->n_dropped, c->n_received, FORMAT_TIMESTAMP(c->since));
+
+        capture_ring_clear(c);
+        c->since = n;
+        c->n_received = c->n_dropped = 0;
+
+        return 0;
+}
+
+static int on_capture_trigger(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        CaptureRing *c = ASSERT_PTR(userdata);
+
+        c->triggered = true;
+        return 0;
+}
+
+static int capture_ring_add_triggers(CaptureRing *c) {
+        size_t k = 0;
+        int r;
+
+        assert(c);
+
+        c->triggers = (struct bus_match_node) {
+                .type = BUS_MATCH_ROOT,
+        };
+
+        c->trigger_slots = new0(sd_bus_slot, strv_length(arg_triggers));
+        if (!c->trigger_slots)
+                return log_oom();
+
+        /* The triggers are evaluated locally, a monitor cannot install matches on the bus */
+        STRV_FOREACH(i, arg_triggers) {
+                struct bus_match_component *components = NULL;
+                size_t n_components = 0;
+                sd_bus_slot *s = c->trigger_slots + k++;
+
+                CLEANUP_ARRAY(components, n_components, bus_match_parse_free);
+
+                r = bus_match_parse(*i, &components, &n_components);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to parse trigger match '%s': %m", *i);
+
+                /* Messages carry the unique name of their sender only, and which well-known names that owns
+                 * is not known here, hence a match on those would never trigger */
+                FOREACH_ARRAY(component, components, n_components)
+                        if (component->type == BUS_MATCH_SENDER &&
+                            !startswith(component->value_str, ":") &&
+                            !streq(component->value_str, "org.freedesktop.DBus"))
+                                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                                       "Trigger match '%s' matches on the well-known name '%s', only unique names are supported.",
+                                                       *i, component->value_str);
+
+                s->userdata = c;
+                s->match_callback.callback = on_capture_trigger;
+
+                r = bus_match_add(&c->triggers, components, n_components, &s->match_callback);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to add trigger match '%s': %m", *i);
+        }
+
+        return 0;
+}
+
+static int on_capture_message(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        CaptureRing *c = ASSERT_PTR(userdata);
+        int r;
+
+        assert(m);
+
+        if (!c->is_monitor) {
+                const char *name;
+
+                /* wait until we lose our unique name */
+                if (sd_bus_message_is_signal(m, "org.freedesktop.DBus", "NameLost") <= 0)
+                        return 1;
+
+                r = sd_bus_message_read(m, "s", &name);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                if (streq(name, c->unique_name))
+                        c->is_monitor = true;
+
+                return 1;
+        }
+
+        capture_ring_add(c, m);
+
+        (void) bus_match_run(NULL, &c->triggers, m);
+        if (c->triggered) {
+                c->triggered = false;
+                (void) capture_ring_flush(c, "trigger");
+        }
+
+        if (sd_bus_message_is_signal(m, "org.freedesktop.DBus.Local", "Disconnected") > 0) {
+                if (!arg_quiet)
+                        log_info("Connection terminated, exiting.");
+                return sd_event_exit(c->event, 0);
+        }
+
+        return 1;
+}
+
+static int on_capture_signal(sd_event_source *s, const struct signalfd_siginfo *si, void *userdata) {
+        CaptureRing *c = ASSERT_PTR(userdata);
+
+        (void) capture_ring_flush(c, "SIGUSR1");
+        return 0;
+}
+
+static bool capture_ring_enabled(void) {
+        return arg_ring_size > 0 || arg_ring_time > 0 || !strv_isempty(arg_triggers);
+}
+
+static int capture_ring(int argc, char **argv, const char *osname, const char *info) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        _cleanup_(capture_ring_done) CaptureRing c = {
+                .max_size = arg_ring_size > 0 ? arg_ring_size : CAPTURE_RING_SIZE_DEFAULT,
+        };
+        _cleanup_(memstream_done) MemStream ms = {};
+        FILE *f;
+        int r;
+
+        f = memstream_init(&ms);
+        if (!f)
+                return log_oom();
+
+        r = bus_pcap_header(arg_snaplen, osname, info, f);
+        if (r < 0)
+                return log_error_errno(r, "Failed to encode capture header: %m");
+
+        r = memstream_finalize(&ms, &c.header, &c.header_size);
+        if (r < 0)
+                return log_error_errno(r, "Failed to encode capture header: %m");
+
+        r = capture_ring_add_triggers(&c);
+        if (r < 0)
+                return r;
+
+        r = become_monitor(argc, argv, &bus);
+        if (r < 0)
+                return r;
+
+        r = sd_bus_get_unique_name(bus, &c.unique_name);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get unique name: %m");
+
+        r = sd_event_default(&c.event);
+        if (r < 0)
+                return log_error_errno(r, "Failed to allocate event loop: %m");
+
+        r = sd_event_add_signal(c.event, NULL, SIGUSR1|SD_EVENT_SIGNAL_PROCMASK, on_capture_signal, &c);
+        if (r < 0)
+                return log_error_errno(r, "Failed to install SIGUSR1 handler: %m");
+
+        (void) sd_event_add_signal(c.event, NULL, SIGINT|SD_EVENT_SIGNAL_PROCMASK, NULL, NULL);
+        (void) sd_event_add_signal(c.event, NULL, SIGTERM|SD_EVENT_SIGNAL_PROCMASK, NULL, NULL);
+
+        r = sd_bus_add_filter(bus, NULL, on_capture_message, &c);
+        if (r < 0)
+                return log_error_errno(r, "Failed to add bus filter: %m");
+
+        r = sd_bus_attach_event(bus, c.event, SD_EVENT_PRIORITY_NORMAL);
+        if (r < 0)
+                return log_error_errno(r, "Failed to attach bus to event loop: %m");
+
+        c.since = now(CLOCK_REALTIME);
+
+        if (!arg_quiet)
+                log_info("Capturing bus message stream into %s ring buffer, send SIGUSR1 to write it out.",
+                         FORMAT_BYTES(c.max_size));
+
+        (void) sd_notify(/* unset_environment=false */ false, "READY=1");
+
+        return sd_event_loop(c.event);
+}
+
 static int verb_capture(int argc, char **argv, void *userdata) {
         _cleanup_free_ char *osname = NULL;
         static const char info[] =
@@ -1385,6 +1880,10 @@ static int verb_capture(int argc, char **argv, void *userdata) {
         if (r < 0)
                 log_full_errno(r == -ENOENT ? LOG_DEBUG : LOG_INFO, r,
                                "Failed to read os-release file, ignoring: %m");
+
+        if (capture_ring_enabled())
+                return capture_ring(argc, argv, osname, info);
+
         bus_pcap_header(arg_snaplen, osname, info, stdout);
 
         r = monitor(argc, argv, message_pcap);
@@ -2312,9 +2811,16 @@ static int help(void) {
                "     --activatable         Only show activatable names\n"
                "     --match=MATCH         Only show matching messages\n"
                "     --size=SIZE           Maximum length of captured packet\n"
+               "     --ring-size=SIZE      Keep the last SIZE bytes of captured traffic in memory,\n"
+               "                           and write them out on SIGUSR1 only\n"
+               "     --ring-time=SECS      Keep the traffic of the last SECS in memory\n"
+               "     --trigger=MATCH       Write out the traffic kept in memory when a message\n"
+               "                           matches\n"
                "     --list                Don't show tree, but simple object path list\n"
+               "     --max-inflight=N      Maximum number of concurrent calls when walking tree\n"
                "  -q --quiet               Don't show method call reply\n"
-               "     --verbose             Show result values in long format\n"
+               "     --verbose             Show result values in long format, and how long\n"
+               "                           walking the object tree took\n"
                "     --json=MODE           Output as JSON\n"
                "  -j                       Same as --json=pretty on tty, --json=short otherwise\n"
                "     --xml-interface       Dump the XML description in introspect command\n"
@@ -2355,7 +2861,11 @@ static int parse_argv(int argc, char *argv[]) {
                 ARG_ACQUIRED,
                 ARG_ACTIVATABLE,
                 ARG_SIZE,
+                ARG_RING_SIZE,
+                ARG_RING_TIME,
+                ARG_TRIGGER,
                 ARG_LIST,
+                ARG_MAX_INFLIGHT,
                 ARG_VERBOSE,
                 ARG_XML_INTERFACE,
                 ARG_EXPECT_REPLY,
@@ -2385,7 +2895,11 @@ static int parse_argv(int argc, char *argv[]) {
                 { "host",                            required_argument, NULL, 'H'                                 },
                 { "machine",                         required_argument, NULL, 'M'                                 },
                 { "size",                            required_argument, NULL, ARG_SIZE                            },
+                { "ring-size",                       required_argument, NULL, ARG_RING_SIZE                       },
+                { "ring-time",                       required_argument, NULL, ARG_RING_TIME                       },
+                { "trigger",                         required_argument, NULL, ARG_TRIGGER                         },
                 { "list",                            no_argument,       NULL, ARG_LIST                            },
+                { "max-inflight",                    required_argument, NULL, ARG_MAX_INFLIGHT                    },
                 { "quiet",                           no_argument,       NULL, 'q'                                 },
                 { "verbose",                         no_argument,       NULL, ARG_VERBOSE                         },
                 { "xml-interface",                   no_argument,       NULL, ARG_XML_INTERFACE                   },
@@ -2475,10 +2989,53 @@ static int parse_argv(int argc, char *argv[]) {
                         break;
                 }
 
+                case ARG_RING_SIZE: {
+                        uint64_t sz;
+
+                        r = parse_size(optarg, 1024, &sz);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to parse ring size '%s': %m", optarg);
+
+                        if (sz == 0)
+                                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                                       "Ring size must be positive.");
+
+                        if ((uint64_t) (size_t) sz != sz)
+                                return log_error_errno(SYNTHETIC_ERRNO(E2BIG),
+                                                       "Ring size out of range.");
+
+                        arg_ring_size = (size_t) sz;
+                        break;
+                }
+
+                case ARG_RING_TIME:
+                        r = parse_sec(optarg, &arg_ring_time);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to parse --ring-time= parameter '%s': %m", optarg);
+
+                        if (arg_ring_time == 0)
+                                return log_error_errno(SYNTHETIC_ERRNO(EINVAL),
+                                                       "--ring-time= parameter must be positive.");
+                        break;
+
+                case ARG_TRIGGER:
+                        if (strv_extend(&arg_triggers, optarg) < 0)
+                                return log_oom();
+                        break;
+
                 case ARG_LIST:
                         arg_list = true;
                         break;
 
+                case ARG_MAX_INFLIGHT:
+                        r = safe_atou(optarg, &arg_max_inflight);
+                        if (r < 0)
+                                return log_error_errno(r, "Failed to parse --max-inflight= parameter '%s': %m", optarg);
+                        if (arg_max_inflight == 0)
+                                return log_error_errno(SYNTHETIC_ERRNO(EINVAL), "--max-inflight= parameter must be positive.");
+
+                        break;
+
                 case 'H':
                         arg_transport = BUS_TRANSPORT_REMOTE;
                         arg_host = optarg;
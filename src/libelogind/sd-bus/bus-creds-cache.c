@@ -0,0 +1,278 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <poll.h>
+
+#include "sd-bus.h"
+
+#include "alloc-util.h"
+#include "bus-creds.h"
+#include "bus-creds-cache.h"
+#include "bus-internal.h"
+#include "hashmap.h"
+#include "io-util.h"
+#include "pidref.h"
+#include "string-util.h"
+
+/* If enabled with sd_bus_set_cache_sender_creds(), the credentials sd_bus_query_sender_creds() acquires for
+ * the sender of a message from the bus driver are remembered per unique name. Further messages from the
+ * same peer then do not need a round trip to the bus driver anymore.
+ *
+ * Only what the bus driver reports is cached, i.e. what the peer had when it connected. Fields added with
+ * SD_BUS_CREDS_AUGMENT describe the current state of the process, which may change at any time, e.g. when
+ * it drops privileges, moves to another cgroup or executes another binary under the same PID. None of them
+ * is hence safe to keep, not even for a process identified by pidfd and start time, and they are read from
+ * /proc again for every request, as without the cache. The counters thus count bus driver round trips,
+ * not /proc reads.
+ *
+ * Unique names are never reused on a bus. A single NameOwnerChanged match shared by all entries drops an
+ * entry once its name disappears from the bus. The match only asks for names that lost their owner, so
+ * that the bus does not wake us up for every name that is acquired or changes hands. The process is pinned
+ * by a pidfd, so that an entry cannot be used anymore once the process is gone and its PID might have been
+ * recycled. */
+
+#define BUS_CREDS_CACHE_MAX 1024U
+
+typedef struct BusCredsCacheEntry {
+        char *name;
+        PidRef pidref;
+        sd_bus_creds *creds;
+        uint64_t mask; /* what was requested from the bus driver */
+} BusCredsCacheEntry;
+
+static BusCredsCacheEntry* bus_creds_cache_entry_free(BusCredsCacheEntry *e) {
+        if (!e)
+                return NULL;
+
+        pidref_done(&e->pidref);
+        sd_bus_creds_unref(e->creds);
+        free(e->name);
+        return mfree(e);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(BusCredsCacheEntry*, bus_creds_cache_entry_free);
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(bus_creds_cache_hash_ops, char, string_hash_func, string_compare_func,
+                                              BusCredsCacheEntry, bus_creds_cache_entry_free);
+
+static void bus_creds_cache_remove(sd_bus *bus, const char *name) {
+        assert(bus);
+        assert(name);
+
+        bus_creds_cache_entry_free(ordered_hashmap_remove(bus->sender_creds_cache, name));
+}
+
+static int on_name_owner_changed(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        sd_bus *bus = ASSERT_PTR(userdata);
+        const char *name, *new_owner;
+        int r;
+
+        assert(message);
+
+        r = sd_bus_message_read(message, "sss", &name, NULL, &new_owner);
+        if (r < 0)
+                return 0;
+
+        /* Unique names never get a new owner, they only go away */
+        if (name[0] == ':' && isempty(new_owner))
+                bus_creds_cache_remove(bus, name);
+
+        return 0;
+}
+
+static int on_name_owner_changed_installed(sd_bus_message *message, void *userdata, sd_bus_error *error) {
+        const sd_bus_error *e;
+
+        assert(message);
+
+        /* Without the match, entries of disconnected peers linger until they are evicted. That only costs
+         * memory, the pidfd still keeps stale entries from being used. Hence don't fail the connection. */
+        e = sd_bus_message_get_error(message);
+        if (e)
+                log_debug_errno(sd_bus_error_get_errno(e),
+                                "Failed to watch for disconnecting peers, credentials cache entries are only evicted: %s",
+                                e->message);
+
+        return 0;
+}
+
+static int bus_creds_cache_watch(sd_bus *bus) {
+        int r;
+
+        assert(bus);
+
+        if (bus->sender_creds_cache_watching)
+                return 0;
+
+        /* The slot is floating, i.e. owned by the bus, so that the cache does not keep the bus alive. It is
+         * installed once and lives as long as the connection does. */
+        r = sd_bus_add_match_async(
+                        bus,
+                        NULL,
+                        "type='signal',"
+                        "sender='org.freedesktop.DBus',"
+                        "path='/org/freedesktop/DBus',"
+                        "interface='org.freedesktop.DBus',"
+                        "member='NameOwnerChanged',"
+                        "arg2=''",
+                        on_name_owner_changed,
+                        on_name_owner_changed_installed,
+                        bus);
+        if (r < 0)
+                return r;
+
+        bus->sender_creds_cache_watching = true;
+        return 0;
+}
+
+static bool bus_creds_cache_entry_alive(BusCredsCacheEntry *e) {
+        assert(e);
+
+        /* A pidfd becomes readable once the process exited. Until then its PID cannot be recycled. */
+        return fd_wait_for_event(e->pidref.fd, POLLIN, 0) == 0;
+}
+
+static int bus_creds_cache_entry_new(const char *name, pid_t pid, BusCredsCacheEntry **ret) {
+        _cleanup_(bus_creds_cache_entry_freep) BusCredsCacheEntry *e = NULL;
+        int r;
+
+        assert(name);
+        assert(pid > 0);
+        assert(ret);
+
+        e = new(BusCredsCacheEntry, 1);
+        if (!e)
+                return -ENOMEM;
+
+        *e = (BusCredsCacheEntry) {
+                .pidref = PIDREF_NULL,
+        };
+
+        e->name = strdup(name);
+        if (!e->name)
+                return -ENOMEM;
+
+        r = pidref_set_pid(&e->pidref, pid);
+        if (r < 0)
+                return r;
+        if (e->pidref.fd < 0)
+                return -EOPNOTSUPP; /* Without a pidfd we cannot tell whether the PID was recycled */
+
+        *ret = TAKE_PTR(e);
+        return 0;
+}
+
+static int bus_creds_cache_get(sd_bus *bus, const char *sender, uint64_t mask, sd_bus_creds **ret) {
+        _cleanup_(sd_bus_creds_unrefp) sd_bus_creds *c = NULL;
+        BusCredsCacheEntry *e;
+        int r;
+
+        assert(bus);
+        assert(sender);
+        assert(!(mask & SD_BUS_CREDS_AUGMENT));
+        assert(ret);
+
+        e = ordered_hashmap_get(bus->sender_creds_cache, sender);
+        if (e && !bus_creds_cache_entry_alive(e)) {
+                bus_creds_cache_remove(bus, sender);
+                e = NULL;
+        }
+
+        if (e && FLAGS_SET(e->mask, mask)) {
+                bus->n_sender_creds_driver_calls_avoided++;
+                *ret = sd_bus_creds_ref(e->creds);
+                return 0;
+        }
+
+        bus->n_sender_creds_driver_calls++;
+
+        /* Ask for everything that was asked for before, too, so that the result serves all those requests
+         * again. The PID is needed to pin the process. */
+        if (e)
+                mask |= e->mask;
+        mask |= SD_BUS_CREDS_PID;
+
+        r = sd_bus_get_name_creds(bus, sender, mask, &c);
+        if (r < 0)
+                return r;
+
+        if (!FLAGS_SET(c->mask, SD_BUS_CREDS_PID) || c->pid <= 0)
+                goto finish;
+
+        if (e && e->pidref.pid != c->pid) {
+                bus_creds_cache_remove(bus, sender);
+                e = NULL;
+        }
+
+        if (!e) {
+                _cleanup_(bus_creds_cache_entry_freep) BusCredsCacheEntry *n = NULL;
+
+                r = bus_creds_cache_entry_new(sender, c->pid, &n);
+                if (r < 0) {
+                        log_debug_errno(r, "Failed to create credentials cache entry for %s, not caching: %m", sender);
+                        goto finish;
+                }
+
+                r = bus_creds_cache_watch(bus);
+                if (r < 0) {
+                        log_debug_errno(r, "Failed to watch for disconnecting peers, not caching: %m");
+                        goto finish;
+                }
+
+                r = ordered_hashmap_ensure_allocated(&bus->sender_creds_cache, &bus_creds_cache_hash_ops);
+                if (r < 0)
+                        goto finish;
+
+                /* Entries of peers whose disconnect we missed are only dropped here, oldest first */
+                if (ordered_hashmap_size(bus->sender_creds_cache) >= BUS_CREDS_CACHE_MAX)
+                        bus_creds_cache_entry_free(ordered_hashmap_steal_first(bus->sender_creds_cache));
+
+                r = ordered_hashmap_put(bus->sender_creds_cache, n->name, n);
+                if (r < 0)
+                        goto finish;
+
+                e = TAKE_PTR(n);
+        }
+
+        sd_bus_creds_unref(e->creds);
+        e->creds = sd_bus_creds_ref(c);
+        e->mask = mask;
+
+finish:
+        *ret = TAKE_PTR(c);
+        return 0;
+}
+
+int bus_creds_cache_query(sd_bus *bus, const char *sender, uint64_t mask, sd_bus_creds **ret) {
+        _cleanup_(sd_bus_creds_unrefp) sd_bus_creds *c = NULL;
+        int r;
+
+        assert(bus);
+        assert(sender);
+        assert(ret);
+
+        if (!bus->cache_sender_creds || !bus->bus_client || sender[0] != ':' ||
+            (mask & ~SD_BUS_CREDS_AUGMENT) > _SD_BUS_CREDS_ALL)
+                return sd_bus_get_name_creds(bus, sender, mask, ret);
+
+        /* The same as sd_bus_get_name_creds() does, /proc is not going to match otherwise */
+        if (!bus->is_local)
+                mask &= ~SD_BUS_CREDS_AUGMENT;
+
+        r = bus_creds_cache_get(bus, sender, mask & ~SD_BUS_CREDS_AUGMENT, &c);
+        if (r < 0)
+                return r;
+
+        if (!FLAGS_SET(mask, SD_BUS_CREDS_AUGMENT)) {
+                *ret = TAKE_PTR(c);
+                return 0;
+        }
+
+        /* Whatever the bus driver did not tell us is read from /proc now, never taken from the cache, just
+         * like sd_bus_get_name_creds() does it. That needs the PID to be copied over, too. */
+        return bus_creds_extend_by_pid(c, mask | SD_BUS_CREDS_PID, ret);
+}
+
+void bus_creds_cache_flush(sd_bus *bus) {
+        assert(bus);
+
+        bus->sender_creds_cache = ordered_hashmap_free(bus->sender_creds_cache);
+}
@@ -0,0 +1,7 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include "sd-bus.h"
+
+int bus_creds_cache_query(sd_bus *bus, const char *sender, uint64_t mask, sd_bus_creds **ret);
+void bus_creds_cache_flush(sd_bus *bus);
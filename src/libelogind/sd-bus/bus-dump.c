@@ -13,6 +13,7 @@
 #include "format-util.h"
 #include "glyph-util.h"
 #include "macro.h"
+#include "memory-util.h"
 #include "pcapng.h"
 #include "string-util.h"
 // #include "strv.h"
@@ -595,39 +596,111 @@ int bus_pcap_header(size_t snaplen, const char *os, const char *info, FILE *f) {
         return fflush_and_check(f);
 }
 
-int bus_message_pcap_frame(sd_bus_message *m, size_t snaplen, FILE *f) {
-        struct bus_body_part *part;
-        size_t msglen, caplen, pad;
-        uint32_t length;
-        uint64_t ts;
-        unsigned i;
-        size_t w;
+int bus_pcap_statistics(usec_t start, usec_t end, uint64_t n_received, uint64_t n_dropped, FILE *f) {
+        uint32_t len, starttime[2] = { start >> 32, (uint32_t) start }, endtime[2] = { end >> 32, (uint32_t) end };
 
         if (!f)
                 f = stdout;
 
+        len = sizeof(struct pcapng_statistics_block) +
+                2 * pcapng_optlen(sizeof(starttime)) +
+                2 * pcapng_optlen(sizeof(uint64_t)) +
+                pcapng_optlen(0) +      /* OPT_END */
+                sizeof(uint32_t);       /* trailer length */
+
+        struct pcapng_statistics_block isb = {
+                .block_type = PCAPNG_INTERFACE_STATS_BLOCK,
+                .block_length = len,
+                .interface_id = 0,
+                .timestamp_hi = endtime[0],
+                .timestamp_lo = endtime[1],
+        };
+
+        fwrite(&isb, 1, sizeof(isb), f);
+        pcapng_putopt(f, PCAPNG_ISB_STARTTIME, starttime, sizeof(starttime));
+        pcapng_putopt(f, PCAPNG_ISB_ENDTIME, endtime, sizeof(endtime));
+        pcapng_putopt(f, PCAPNG_ISB_IFRECV, &n_received, sizeof(n_received));
+        pcapng_putopt(f, PCAPNG_ISB_IFDROP, &n_dropped, sizeof(n_dropped));
+        pcapng_putopt(f, PCAPNG_OPT_END, NULL, 0);
+        fwrite(&len, 1, sizeof(uint32_t), f);
+
+        return fflush_and_check(f);
+}
+
+static void pcapng_packet_block(sd_bus_message *m, size_t snaplen, struct pcapng_enhance_packet_block *ret) {
+        size_t msglen, caplen;
+        uint64_t ts;
+
         assert(m);
         assert(snaplen > 0);
         assert((size_t) (uint32_t) snaplen == snaplen);
+        assert(ret);
 
         ts = m->realtime ?: now(CLOCK_REALTIME);
         msglen = BUS_MESSAGE_SIZE(m);
         caplen = MIN(msglen, snaplen);
-        pad = ALIGN4(caplen) - caplen;
 
         /* packet block has no options */
-        length = sizeof(struct pcapng_enhance_packet_block)
-                + caplen + pad + sizeof(uint32_t);
-
-        struct pcapng_enhance_packet_block epb = {
+        *ret = (struct pcapng_enhance_packet_block) {
                 .block_type = PCAPNG_ENHANCED_PACKET_BLOCK,
-                .block_length = length,
+                .block_length = sizeof(struct pcapng_enhance_packet_block) + ALIGN4(caplen) + sizeof(uint32_t),
                 .interface_id = 0,
                 .timestamp_hi = (uint32_t)(ts >> 32),
                 .timestamp_lo = (uint32_t)ts,
                 .original_length = msglen,
                 .capture_length = caplen,
         };
+}
+
+size_t bus_message_pcap_frame_size(sd_bus_message *m, size_t snaplen) {
+        assert(m);
+
+        return sizeof(struct pcapng_enhance_packet_block) + ALIGN4(MIN(BUS_MESSAGE_SIZE(m), snaplen)) + sizeof(uint32_t);
+}
+
+void bus_message_pcap_frame_to_buffer(sd_bus_message *m, size_t snaplen, void *buf) {
+        struct pcapng_enhance_packet_block epb;
+        struct bus_body_part *part;
+        uint8_t *p = ASSERT_PTR(buf);
+        size_t pad, w;
+        unsigned i;
+
+        /* Encodes the same block bus_message_pcap_frame() writes, into a buffer of
+         * bus_message_pcap_frame_size() bytes */
+
+        pcapng_packet_block(m, snaplen, &epb);
+        pad = ALIGN4(epb.capture_length) - epb.capture_length;
+
+        p = mempcpy(p, &epb, sizeof(epb));
+
+        w = MIN(BUS_MESSAGE_BODY_BEGIN(m), snaplen);
+        p = mempcpy(p, m->header, w);
+        snaplen -= w;
+
+        MESSAGE_FOREACH_PART(part, i, m) {
+                if (snaplen <= 0)
+                        break;
+
+                w = MIN(part->size, snaplen);
+                p = mempcpy_safe(p, part->data, w);
+                snaplen -= w;
+        }
+
+        p = mempset(p, 0, pad);
+        memcpy(p, &epb.block_length, sizeof(uint32_t));
+}
+
+int bus_message_pcap_frame(sd_bus_message *m, size_t snaplen, FILE *f) {
+        struct pcapng_enhance_packet_block epb;
+        struct bus_body_part *part;
+        size_t pad, w;
+        unsigned i;
+
+        if (!f)
+                f = stdout;
+
+        pcapng_packet_block(m, snaplen, &epb);
+        pad = ALIGN4(epb.capture_length) - epb.capture_length;
 
         /* write the pcapng enhanced packet block header */
         fwrite(&epb, 1, sizeof(epb), f);
@@ -651,7 +724,7 @@ int bus_message_pcap_frame(sd_bus_message *m, size_t snaplen, FILE *f) {
                 fputc('\0', f);
 
         /* trailing block length */
-        fwrite(&length, 1, sizeof(uint32_t), f);
+        fwrite(&epb.block_length, 1, sizeof(uint32_t), f);
 
         return fflush_and_check(f);
 }
@@ -6,7 +6,12 @@
 
 #include "sd-bus.h"
 
+#include "time-util.h"
+
 int bus_creds_dump(sd_bus_creds *c, FILE *f, bool terse);
 
 int bus_pcap_header(size_t snaplen, const char *os, const char *app, FILE *f);
 int bus_message_pcap_frame(sd_bus_message *m, size_t snaplen, FILE *f);
+size_t bus_message_pcap_frame_size(sd_bus_message *m, size_t snaplen);
+void bus_message_pcap_frame_to_buffer(sd_bus_message *m, size_t snaplen, void *buf);
+int bus_pcap_statistics(usec_t start, usec_t end, uint64_t n_received, uint64_t n_dropped, FILE *f);
@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
 #include "alloc-util.h"
+#include "ascii-span.h"
 #include "bus-internal.h"
 #include "bus-message.h"
 #include "escape.h"
@@ -45,6 +46,29 @@ bool object_path_is_valid(const char *p) {
         return (q - p) <= BUS_PATH_SIZE_MAX;
 }
 
+bool object_path_is_valid_n(const char *p, size_t l) {
+
+        /* Like object_path_is_valid(), but for the l bytes at p, which hence must not contain NUL. The
+         * characters and the slashes in between are checked in one go, only the ends need extra care. */
+
+        if (!p)
+                return false;
+
+        if (l == 0 || l > BUS_PATH_SIZE_MAX)
+                return false;
+
+        if (p[0] != '/')
+                return false;
+
+        if (l == 1)
+                return true;
+
+        if (p[l-1] == '/')
+                return false;
+
+        return ascii_span_object_path(p, l) == l;
+}
+
 char* object_path_startswith(const char *a, const char *b) {
         const char *p;
 
@@ -73,6 +73,10 @@ struct node {
         LIST_HEAD(struct node_vtable, vtables);
         LIST_HEAD(struct node_enumerator, enumerators);
         LIST_HEAD(struct node_object_manager, object_managers);
+
+        /* Bumped by sd_bus_invalidate_node_enumerators(), so that results that were being enumerated while
+         * it was called are not cached */
+        uint64_t enumerators_generation;
 };
 
 struct node_callback {
@@ -93,6 +97,12 @@ struct node_enumerator {
 
         unsigned last_iteration;
 
+        /* For enumerators registered with sd_bus_add_node_enumerator_cached(): the (validated) nodes the
+         * callback returned, indexed by the prefix it was called for. Dropped by
+         * sd_bus_invalidate_node_enumerators(). */
+        bool cached:1;
+        Hashmap *cache;
+
         LIST_FIELDS(struct node_enumerator, enumerators);
 };
 
@@ -222,6 +232,10 @@ struct sd_bus {
         bool attach_timestamp:1;
         bool connected_signal:1;
         bool close_on_exit:1;
+        bool defer_properties_changed:1;
+        bool flushing_properties_changed:1;
+        bool cache_sender_creds:1;
+        bool sender_creds_cache_watching:1;
 
         RuntimeScope runtime_scope;
 
@@ -252,6 +266,14 @@ struct sd_bus {
         Hashmap *vtable_methods;
         Hashmap *vtable_properties;
 
+        /* PropertiesChanged signals to send before the event loop polls next, per path and interface */
+        OrderedHashmap *deferred_properties_changed;
+
+        /* Credentials of the senders of incoming messages, per unique name */
+        OrderedHashmap *sender_creds_cache;
+        uint64_t n_sender_creds_driver_calls_avoided;
+        uint64_t n_sender_creds_driver_calls;
+
         union sockaddr_union sockaddr;
         socklen_t sockaddr_size;
 
@@ -364,6 +386,7 @@ bool interface_name_is_valid(const char *p) _pure_;
 bool service_name_is_valid(const char *p) _pure_;
 bool member_name_is_valid(const char *p) _pure_;
 bool object_path_is_valid(const char *p) _pure_;
+bool object_path_is_valid_n(const char *p, size_t l) _pure_;
 
 char *object_path_startswith(const char *a, const char *b) _pure_;
 
@@ -52,10 +52,19 @@ static bool BUS_MATCH_IS_COMPARE(enum bus_match_node_type t) {
         return t >= BUS_MATCH_SENDER && t <= BUS_MATCH_ARG_HAS_LAST;
 }
 
+static bool BUS_MATCH_IS_PREFIX(enum bus_match_node_type t) {
+        return t == BUS_MATCH_PATH_NAMESPACE ||
+                (t >= BUS_MATCH_ARG_PATH && t <= BUS_MATCH_ARG_PATH_LAST) ||
+                (t >= BUS_MATCH_ARG_NAMESPACE && t <= BUS_MATCH_ARG_NAMESPACE_LAST);
+}
+
 static bool BUS_MATCH_CAN_HASH(enum bus_match_node_type t) {
+        /* Prefix matches are hashed too, by their full value. They are looked up once for each prefix of the
+         * tested string that ends at a label boundary, see bus_match_run_prefix(). */
         return (t >= BUS_MATCH_MESSAGE_TYPE && t <= BUS_MATCH_PATH) ||
                 (t >= BUS_MATCH_ARG && t <= BUS_MATCH_ARG_LAST) ||
-                (t >= BUS_MATCH_ARG_HAS && t <= BUS_MATCH_ARG_HAS_LAST);
+                (t >= BUS_MATCH_ARG_HAS && t <= BUS_MATCH_ARG_HAS_LAST) ||
+                BUS_MATCH_IS_PREFIX(t);
 }
 
 static void bus_match_node_free(struct bus_match_node *node) {
@@ -235,6 +244,123 @@ static bool value_node_same(
         }
 }
 
+static int bus_match_run_prefix_lookup(
+                sd_bus *bus,
+                struct bus_match_node *node,
+                const char *key,
+                sd_bus_message *m) {
+
+        struct bus_match_node *found;
+
+        found = hashmap_get(node->compare.children, key);
+        if (!found)
+                return 0;
+
+        return bus_match_run(bus, found, m);
+}
+
+static int bus_match_run_prefix(
+                sd_bus *bus,
+                struct bus_match_node *node,
+                const char *test_str,
+                sd_bus_message *m) {
+
+        _cleanup_free_ char *allocated = NULL;
+        bool is_complex;
+        size_t l;
+        char c, *p;
+        int r;
+
+        assert(node);
+        assert(BUS_MATCH_IS_PREFIX(node->type));
+        assert(m);
+
+        /* Instead of testing every value against the string, we look up the values the string may match:
+         * the string itself, and each of its prefixes that end right before or right after a separator.
+         * This walks the path down from the root, one label at a time, like a lookup in a trie would, with
+         * the hash table serving as the trie. Hence the cost only depends on the number of labels in the
+         * string, not on the number of installed matches.
+         *
+         * 'Simple' patterns (path_namespace=, argNnamespace=) match if they are equal to the string, or a
+         * prefix of it that is followed by a separator in the string or ends in one. 'Complex' patterns
+         * (argNpath=) match if they are equal to the string, or either is a prefix of the other that ends
+         * in a separator. */
+
+        if (!test_str)
+                return 0;
+
+        is_complex = node->type >= BUS_MATCH_ARG_PATH && node->type <= BUS_MATCH_ARG_PATH_LAST;
+        c = node->type >= BUS_MATCH_ARG_NAMESPACE && node->type <= BUS_MATCH_ARG_NAMESPACE_LAST ? '.' : '/';
+        l = strlen(test_str);
+
+        if (is_complex && l > 0 && test_str[l-1] == c) {
+                struct bus_match_node *i;
+
+                /* The string is a prefix of all values below it. Those cannot be found by looking up
+                 * prefixes of the string, hence fall back to testing all values in this rare case. */
+                HASHMAP_FOREACH(i, node->compare.children) {
+                        if (!path_complex_pattern(i->value.str, test_str))
+                                continue;
+
+                        r = bus_match_run(bus, i, m);
+                        if (r != 0)
+                                return r;
+
+                        if (bus && bus->match_callbacks_modified)
+                                return 0;
+                }
+
+                return 0;
+        }
+
+        /* We cut the prefixes off in place, on a copy of the string */
+        if (l < 256)
+                p = newa(char, l + 1);
+        else {
+                p = allocated = new(char, l + 1);
+                if (!p)
+                        return -ENOMEM;
+        }
+        memcpy(p, test_str, l + 1);
+
+        for (size_t k = 0; k < l; k++) {
+                char saved;
+
+                if (p[k] != c)
+                        continue;
+
+                /* The prefix without the separator. After a separator this is the same string as the
+                 * prefix with the previous separator, which was looked up already. */
+                if (!is_complex && (k == 0 || p[k-1] != c)) {
+                        p[k] = 0;
+                        r = bus_match_run_prefix_lookup(bus, node, p, m);
+                        p[k] = c;
+                        if (r != 0)
+                                return r;
+
+                        if (bus && bus->match_callbacks_modified)
+                                return 0;
+                }
+
+                /* The prefix including the separator. If the separator terminates the string, this is the
+                 * string itself, which is looked up below. */
+                if (k + 1 >= l)
+                        break;
+
+                saved = p[k+1];
+                p[k+1] = 0;
+                r = bus_match_run_prefix_lookup(bus, node, p, m);
+                p[k+1] = saved;
+                if (r != 0)
+                        return r;
+
+                if (bus && bus->match_callbacks_modified)
+                        return 0;
+        }
+
+        return bus_match_run_prefix_lookup(bus, node, p, m);
+}
+
 int bus_match_run(
                 sd_bus *bus,
                 struct bus_match_node *node,
@@ -375,7 +501,12 @@ int bus_match_run(
                 assert_not_reached();
         }
 
-        if (BUS_MATCH_CAN_HASH(node->type)) {
+        if (BUS_MATCH_IS_PREFIX(node->type)) {
+                r = bus_match_run_prefix(bus, node, test_str, m);
+                if (r != 0)
+                        return r;
+
+        } else if (BUS_MATCH_CAN_HASH(node->type)) {
                 struct bus_match_node *found;
 
                 /* Lookup via hash table, nice! So let's jump directly. */
@@ -1011,6 +1142,8 @@ void bus_match_dump(FILE *out, struct bus_match_node *node, unsigned level) {
         else if (node->type == BUS_MATCH_LEAF)
                 fprintf(out, " %p/%p\n", node->leaf.callback->callback,
                         container_of(node->leaf.callback, sd_bus_slot, match_callback)->userdata);
+        else if (BUS_MATCH_IS_PREFIX(node->type))
+                fprintf(out, " prefix index, %u values\n", hashmap_size(node->compare.children));
         else
                 putc('\n', out);
 
@@ -0,0 +1,331 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "sd-bus.h"
+
+#include "alloc-util.h"
+#include "bus-internal.h"
+#include "bus-message.h"
+#include "bus-signature.h"
+#include "bus-type.h"
+#include "string-util.h"
+
+/* A message template is a signature that has been split into its elements once, so that appending values
+ * for it doesn't have to take the signature apart again for every message. The elements are stored as a
+ * flat list in signature order, with each container knowing where its contents end. */
+
+typedef struct TemplateOp {
+        char type;      /* a basic type, or SD_BUS_TYPE_ARRAY, _VARIANT, _STRUCT, _DICT_ENTRY */
+        char *contents; /* arrays, structs and dict entries: the signature of the contents */
+        size_t end;     /* arrays, structs and dict entries: index of the first op following the contents */
+} TemplateOp;
+
+struct sd_bus_message_template {
+        unsigned n_ref;
+
+        char *signature;
+
+        TemplateOp *ops;
+        size_t n_ops;
+};
+
+static sd_bus_message_template* template_free(sd_bus_message_template *t) {
+        assert(t);
+
+        FOREACH_ARRAY(op, t->ops, t->n_ops)
+                free(op->contents);
+
+        free(t->ops);
+        free(t->signature);
+        return mfree(t);
+}
+
+DEFINE_PUBLIC_TRIVIAL_REF_UNREF_FUNC(sd_bus_message_template, sd_bus_message_template, template_free);
+
+static int template_compile(sd_bus_message_template *t, const char *s, size_t n) {
+        int r;
+
+        assert(t);
+        assert(s);
+
+        while (n > 0) {
+                size_t k, i;
+
+                r = signature_element_length(s, &k);
+                if (r < 0)
+                        return r;
+                if (k > n)
+                        return -EINVAL;
+
+                if (!GREEDY_REALLOC(t->ops, t->n_ops + 1))
+                        return -ENOMEM;
+
+                i = t->n_ops++;
+                t->ops[i] = (TemplateOp) {
+                        .type = *s,
+                };
+
+                switch (*s) {
+
+                case SD_BUS_TYPE_ARRAY:
+                        t->ops[i].contents = strndup(s + 1, k - 1);
+                        if (!t->ops[i].contents)
+                                return -ENOMEM;
+
+                        r = template_compile(t, s + 1, k - 1);
+                        if (r < 0)
+                                return r;
+
+                        t->ops[i].end = t->n_ops;
+                        break;
+
+                case SD_BUS_TYPE_STRUCT_BEGIN:
+                case SD_BUS_TYPE_DICT_ENTRY_BEGIN:
+                        if (k < 2)
+                                return -EINVAL;
+
+                        t->ops[i].type = *s == SD_BUS_TYPE_STRUCT_BEGIN ? SD_BUS_TYPE_STRUCT : SD_BUS_TYPE_DICT_ENTRY;
+                        t->ops[i].contents = strndup(s + 1, k - 2);
+                        if (!t->ops[i].contents)
+                                return -ENOMEM;
+
+                        r = template_compile(t, s + 1, k - 2);
+                        if (r < 0)
+                                return r;
+
+                        t->ops[i].end = t->n_ops;
+                        break;
+
+                default:
+                        if (!bus_type_is_basic(*s) && *s != SD_BUS_TYPE_VARIANT)
+                                return -EINVAL;
+                }
+
+                s += k;
+                n -= k;
+        }
+
+        return 0;
+}
+
+_public_ int sd_bus_message_template_new(sd_bus_message_template **ret, const char *types) {
+        _cleanup_(sd_bus_message_template_unrefp) sd_bus_message_template *t = NULL;
+        int r;
+
+        assert_return(ret, -EINVAL);
+        assert_return(types, -EINVAL);
+        assert_return(signature_is_valid(types, false), -EINVAL);
+
+        t = new(sd_bus_message_template, 1);
+        if (!t)
+                return -ENOMEM;
+
+        *t = (sd_bus_message_template) {
+                .n_ref = 1,
+                .signature = strdup(types),
+        };
+        if (!t->signature)
+                return -ENOMEM;
+
+        r = template_compile(t, types, strlen(types));
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(t);
+        return 0;
+}
+
+_public_ const char* sd_bus_message_template_get_signature(sd_bus_message_template *t) {
+        assert_return(t, NULL);
+
+        return t->signature;
+}
+
+static int template_append(sd_bus_message *m, const TemplateOp *ops, size_t from, size_t to, va_list *ap) {
+        int r;
+
+        assert(m);
+        assert(ops);
+        assert(ap);
+
+        for (size_t i = from; i < to; i++) {
+                const TemplateOp *op = ops + i;
+
+                switch (op->type) {
+
+                case SD_BUS_TYPE_BYTE: {
+                        uint8_t x;
+
+                        x = (uint8_t) va_arg(*ap, int);
+                        r = bus_message_append_basic_unchecked(m, op->type, &x);
+                        break;
+                }
+
+                case SD_BUS_TYPE_BOOLEAN:
+                case SD_BUS_TYPE_INT32:
+                case SD_BUS_TYPE_UINT32:
+                case SD_BUS_TYPE_UNIX_FD: {
+                        uint32_t x;
+
+                        x = va_arg(*ap, uint32_t);
+                        r = bus_message_append_basic_unchecked(m, op->type, &x);
+                        break;
+                }
+
+                case SD_BUS_TYPE_INT16:
+                case SD_BUS_TYPE_UINT16: {
+                        uint16_t x;
+
+                        x = (uint16_t) va_arg(*ap, int);
+                        r = bus_message_append_basic_unchecked(m, op->type, &x);
+                        break;
+                }
+
+                case SD_BUS_TYPE_INT64:
+                case SD_BUS_TYPE_UINT64: {
+                        uint64_t x;
+
+                        x = va_arg(*ap, uint64_t);
+                        r = bus_message_append_basic_unchecked(m, op->type, &x);
+                        break;
+                }
+
+                case SD_BUS_TYPE_DOUBLE: {
+                        double x;
+
+                        x = va_arg(*ap, double);
+                        r = bus_message_append_basic_unchecked(m, op->type, &x);
+                        break;
+                }
+
+                case SD_BUS_TYPE_STRING:
+                case SD_BUS_TYPE_OBJECT_PATH:
+                case SD_BUS_TYPE_SIGNATURE:
+                        r = bus_message_append_basic_unchecked(m, op->type, va_arg(*ap, const char*));
+                        break;
+
+                case SD_BUS_TYPE_ARRAY: {
+                        unsigned n;
+
+                        r = sd_bus_message_open_container(m, SD_BUS_TYPE_ARRAY, op->contents);
+                        if (r < 0)
+                                return r;
+
+                        n = va_arg(*ap, unsigned);
+                        for (unsigned j = 0; j < n; j++) {
+                                r = template_append(m, ops, i + 1, op->end, ap);
+                                if (r < 0)
+                                        return r;
+                        }
+
+                        r = sd_bus_message_close_container(m);
+                        i = op->end - 1;
+                        break;
+                }
+
+                case SD_BUS_TYPE_STRUCT:
+                case SD_BUS_TYPE_DICT_ENTRY:
+                        r = sd_bus_message_open_container(m, op->type, op->contents);
+                        if (r < 0)
+                                return r;
+
+                        r = template_append(m, ops, i + 1, op->end, ap);
+                        if (r < 0)
+                                return r;
+
+                        r = sd_bus_message_close_container(m);
+                        i = op->end - 1;
+                        break;
+
+                case SD_BUS_TYPE_VARIANT: {
+                        const char *s;
+
+                        /* The contents of variants are only known now, hence take the slow path for them */
+                        s = va_arg(*ap, const char*);
+                        if (!s)
+                                return -EINVAL;
+
+                        r = sd_bus_message_open_container(m, SD_BUS_TYPE_VARIANT, s);
+                        if (r < 0)
+                                return r;
+
+                        r = bus_message_appendv_internal(m, s, ap);
+                        if (r < 0)
+                                return r;
+
+                        r = sd_bus_message_close_container(m);
+                        break;
+                }
+
+                default:
+                        assert_not_reached();
+                }
+
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+_public_ int sd_bus_message_append_templatev(
+                sd_bus_message *m,
+                sd_bus_message_template *t,
+                va_list ap) {
+
+        struct bus_container *c;
+        bool extended = false;
+        va_list aq;
+        int r;
+
+        assert_return(m, -EINVAL);
+        assert_return(t, -EINVAL);
+        assert_return(!m->sealed, -EPERM);
+        assert_return(!m->poisoned, -ESTALE);
+
+        /* The whole template is checked against the signature of the current container once, instead of
+         * each value individually. On the top level the message signature may also be extended by the whole
+         * template at once. */
+        c = m->n_containers == 0 ? &m->root_container : m->containers + m->n_containers - 1;
+        if (isempty(t->signature))
+                ;
+        else if (c->signature && c->signature[c->index]) {
+                /* Array elements are appended one complete type at a time, the index doesn't move */
+                if (c->enclosing == SD_BUS_TYPE_ARRAY ? !streq(c->signature, t->signature)
+                                                      : !startswith(c->signature + c->index, t->signature))
+                        return -ENXIO;
+        } else {
+                if (c->enclosing != 0)
+                        return -ENXIO;
+
+                if (!strextend(&c->signature, t->signature)) {
+                        m->poisoned = true;
+                        return -ENOMEM;
+                }
+
+                extended = true;
+        }
+
+        va_copy(aq, ap);
+        r = template_append(m, t->ops, 0, t->n_ops, &aq);
+        va_end(aq);
+        if (r < 0) {
+                /* The signature now announces more than the body has, the message is unusable */
+                if (extended)
+                        m->poisoned = true;
+
+                return r;
+        }
+
+        return 1;
+}
+
+_public_ int sd_bus_message_append_template(sd_bus_message *m, sd_bus_message_template *t, ...) {
+        va_list ap;
+        int r;
+
+        va_start(ap, t);
+        r = sd_bus_message_append_templatev(m, t, ap);
+        va_end(ap);
+
+        return r;
+}
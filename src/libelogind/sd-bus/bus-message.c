@@ -1302,38 +1302,20 @@ static int message_push_fd(sd_bus_message *m, int fd) {
         return copy;
 }
 
-int message_append_basic(sd_bus_message *m, char type, const void *p, const void **stored) {
+static int message_append_basic_value(
+                sd_bus_message *m,
+                struct bus_container *c,
+                char type,
+                const void *p,
+                const void **stored) {
+
         _cleanup_close_ int fd = -EBADF;
-        struct bus_container *c;
         ssize_t align, sz;
         uint32_t u32;
         void *a;
 
-        assert_return(m, -EINVAL);
-        assert_return(!m->sealed, -EPERM);
-        assert_return(bus_type_is_basic(type), -EINVAL);
-        assert_return(!m->poisoned, -ESTALE);
-
-        c = message_get_last_container(m);
-
-        if (c->signature && c->signature[c->index]) {
-                /* Container signature is already set */
-
-                if (c->signature[c->index] != type)
-                        return -ENXIO;
-        } else {
-                char *e;
-
-                /* Maybe we can append to the signature? But only if this is the top-level container */
-                if (c->enclosing != 0)
-                        return -ENXIO;
-
-                e = strextend(&c->signature, CHAR_TO_STR(type));
-                if (!e) {
-                        m->poisoned = true;
-                        return -ENOMEM;
-                }
-        }
+        assert(m);
+        assert(c);
 
         switch (type) {
 
@@ -1342,7 +1324,7 @@ int message_append_basic(sd_bus_message *m, char type, const void *p, const void
                  * into the empty string */
                 p = strempty(p);
 
-                if (!utf8_is_valid(p))
+                if (!utf8_is_valid_n(p, strlen(p)))
                         return -EINVAL;
 
                 align = 4;
@@ -1354,7 +1336,7 @@ int message_append_basic(sd_bus_message *m, char type, const void *p, const void
                 if (!p)
                         return -EINVAL;
 
-                if (!object_path_is_valid(p))
+                if (!object_path_is_valid_n(p, strlen(p)))
                         return -EINVAL;
 
                 align = 4;
@@ -1438,6 +1420,53 @@ int message_append_basic(sd_bus_message *m, char type, const void *p, const void
         return 0;
 }
 
+int message_append_basic(sd_bus_message *m, char type, const void *p, const void **stored) {
+        struct bus_container *c;
+
+        assert_return(m, -EINVAL);
+        assert_return(!m->sealed, -EPERM);
+        assert_return(bus_type_is_basic(type), -EINVAL);
+        assert_return(!m->poisoned, -ESTALE);
+
+        c = message_get_last_container(m);
+
+        if (c->signature && c->signature[c->index]) {
+                /* Container signature is already set */
+
+                if (c->signature[c->index] != type)
+                        return -ENXIO;
+        } else {
+                char *e;
+
+                /* Maybe we can append to the signature? But only if this is the top-level container */
+                if (c->enclosing != 0)
+                        return -ENXIO;
+
+                e = strextend(&c->signature, CHAR_TO_STR(type));
+                if (!e) {
+                        m->poisoned = true;
+                        return -ENOMEM;
+                }
+        }
+
+        return message_append_basic_value(m, c, type, p, stored);
+}
+
+int bus_message_append_basic_unchecked(sd_bus_message *m, char type, const void *p) {
+        assert(m);
+        assert(!m->sealed);
+        assert(bus_type_is_basic(type));
+
+        /* Like sd_bus_message_append_basic(), but for callers that already made sure that the type is the
+         * next one in the signature of the current container, i.e. message templates. The value itself is
+         * still validated. */
+
+        if (m->poisoned)
+                return -ESTALE;
+
+        return message_append_basic_value(m, message_get_last_container(m), type, p, NULL);
+}
+
 _public_ int sd_bus_message_append_basic(sd_bus_message *m, char type, const void *p) {
         return message_append_basic(m, type, p, NULL);
 }
@@ -1862,20 +1891,19 @@ static int type_stack_pop(TypeStack *stack, unsigned max, unsigned *i, const cha
         return 1;
 }
 
-_public_ int sd_bus_message_appendv(
+int bus_message_appendv_internal(
                 sd_bus_message *m,
                 const char *types,
-                va_list ap) {
+                va_list *ap) {
 
         unsigned n_array, n_struct;
         TypeStack stack[BUS_CONTAINER_DEPTH];
         unsigned stack_ptr = 0;
         int r;
 
-        assert_return(m, -EINVAL);
-        assert_return(types, -EINVAL);
-        assert_return(!m->sealed, -EPERM);
-        assert_return(!m->poisoned, -ESTALE);
+        assert(m);
+        assert(types);
+        assert(ap);
 
         n_array = UINT_MAX;
         n_struct = strlen(types);
@@ -1910,7 +1938,7 @@ _public_ int sd_bus_message_appendv(
                 case SD_BUS_TYPE_BYTE: {
                         uint8_t x;
 
-                        x = (uint8_t) va_arg(ap, int);
+                        x = (uint8_t) va_arg(*ap, int);
                         r = sd_bus_message_append_basic(m, *t, &x);
                         break;
                 }
@@ -1924,7 +1952,7 @@ _public_ int sd_bus_message_appendv(
                         /* We assume a boolean is the same as int32_t */
                         assert_cc(sizeof(int32_t) == sizeof(int));
 
-                        x = va_arg(ap, uint32_t);
+                        x = va_arg(*ap, uint32_t);
                         r = sd_bus_message_append_basic(m, *t, &x);
                         break;
                 }
@@ -1933,7 +1961,7 @@ _public_ int sd_bus_message_appendv(
                 case SD_BUS_TYPE_UINT16: {
                         uint16_t x;
 
-                        x = (uint16_t) va_arg(ap, int);
+                        x = (uint16_t) va_arg(*ap, int);
                         r = sd_bus_message_append_basic(m, *t, &x);
                         break;
                 }
@@ -1942,7 +1970,7 @@ _public_ int sd_bus_message_appendv(
                 case SD_BUS_TYPE_UINT64: {
                         uint64_t x;
 
-                        x = va_arg(ap, uint64_t);
+                        x = va_arg(*ap, uint64_t);
                         r = sd_bus_message_append_basic(m, *t, &x);
                         break;
                 }
@@ -1950,7 +1978,7 @@ _public_ int sd_bus_message_appendv(
                 case SD_BUS_TYPE_DOUBLE: {
                         double x;
 
-                        x = va_arg(ap, double);
+                        x = va_arg(*ap, double);
                         r = sd_bus_message_append_basic(m, *t, &x);
                         break;
                 }
@@ -1960,7 +1988,7 @@ _public_ int sd_bus_message_appendv(
                 case SD_BUS_TYPE_SIGNATURE: {
                         const char *x;
 
-                        x = va_arg(ap, const char*);
+                        x = va_arg(*ap, const char*);
                         r = sd_bus_message_append_basic(m, *t, x);
                         break;
                 }
@@ -1993,7 +2021,7 @@ _public_ int sd_bus_message_appendv(
 
                         types = t + 1;
                         n_struct = k;
-                        n_array = va_arg(ap, unsigned);
+                        n_array = va_arg(*ap, unsigned);
 
                         break;
                 }
@@ -2001,7 +2029,7 @@ _public_ int sd_bus_message_appendv(
                 case SD_BUS_TYPE_VARIANT: {
                         const char *s;
 
-                        s = va_arg(ap, const char*);
+                        s = va_arg(*ap, const char*);
                         if (!s)
                                 return -EINVAL;
 
@@ -2068,6 +2096,26 @@ _public_ int sd_bus_message_appendv(
         return 1;
 }
 
+_public_ int sd_bus_message_appendv(
+                sd_bus_message *m,
+                const char *types,
+                va_list ap) {
+
+        va_list aq;
+        int r;
+
+        assert_return(m, -EINVAL);
+        assert_return(types, -EINVAL);
+        assert_return(!m->sealed, -EPERM);
+        assert_return(!m->poisoned, -ESTALE);
+
+        va_copy(aq, ap);
+        r = bus_message_appendv_internal(m, types, &aq);
+        va_end(aq);
+
+        return r;
+}
+
 _public_ int sd_bus_message_append(sd_bus_message *m, const char *types, ...) {
         va_list ap;
         int r;
@@ -2681,11 +2729,12 @@ static bool validate_nul(const char *s, size_t l) {
 
 static bool validate_string(const char *s, size_t l) {
 
-        if (!validate_nul(s, l))
+        /* Check for NUL termination */
+        if (s[l] != 0)
                 return false;
 
-        /* Check if valid UTF8 */
-        if (!utf8_is_valid(s))
+        /* Check if valid UTF8, this also refuses embedded NUL chars */
+        if (!utf8_is_valid_n(s, l))
                 return false;
 
         return true;
@@ -2705,10 +2754,12 @@ static bool validate_signature(const char *s, size_t l) {
 
 static bool validate_object_path(const char *s, size_t l) {
 
-        if (!validate_nul(s, l))
+        /* Check for NUL termination */
+        if (s[l] != 0)
                 return false;
 
-        if (!object_path_is_valid(s))
+        /* Embedded NUL chars are refused as invalid characters here */
+        if (!object_path_is_valid_n(s, l))
                 return false;
 
         return true;
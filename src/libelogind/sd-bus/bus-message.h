@@ -175,6 +175,9 @@ int bus_message_from_malloc(
 int bus_message_get_arg(sd_bus_message *m, unsigned i, const char **str);
 int bus_message_get_arg_strv(sd_bus_message *m, unsigned i, char ***strv);
 
+int bus_message_appendv_internal(sd_bus_message *m, const char *types, va_list *ap);
+int bus_message_append_basic_unchecked(sd_bus_message *m, char type, const void *p);
+
 #define MESSAGE_FOREACH_PART(part, i, m) \
         for ((i) = 0, (part) = &(m)->body; (i) < (m)->n_body_parts; (i)++, (part) = (part)->next)
 
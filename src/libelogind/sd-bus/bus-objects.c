@@ -94,6 +94,34 @@ static int vtable_property_get_userdata(
         return 1;
 }
 
+static void node_enumerator_cache_put(struct node_enumerator *c, const char *prefix, char **children) {
+        _cleanup_strv_free_ char **copy = NULL;
+        _cleanup_free_ char *p = NULL;
+
+        assert(c);
+        assert(prefix);
+
+        /* Invalid paths fail the enumeration, don't make that stick */
+        STRV_FOREACH(k, children)
+                if (!object_path_is_valid(*k))
+                        return;
+
+        p = strdup(prefix);
+        if (!p)
+                return;
+
+        copy = strv_copy(children);
+        if (!copy)
+                return;
+
+        /* Caching is best effort, if we can't remember the result the callback is simply called again */
+        if (hashmap_ensure_put(&c->cache, &string_hash_ops_free_strv_free, p, copy) < 0)
+                return;
+
+        TAKE_PTR(p);
+        TAKE_PTR(copy);
+}
+
 static int add_enumerated_to_set(
                 sd_bus *bus,
                 const char *prefix,
@@ -108,18 +136,42 @@ static int add_enumerated_to_set(
         assert(s);
 
         LIST_FOREACH(enumerators, c, first) {
-                char **children = NULL;
+                char **children = NULL, **cached;
                 sd_bus_slot *slot;
+                uint64_t generation;
 
                 if (bus->nodes_modified)
                         return 0;
 
+                cached = c->cached ? hashmap_get(c->cache, prefix) : NULL;
+                if (cached) {
+                        STRV_FOREACH(k, cached) {
+                                if (!object_path_startswith(*k, prefix))
+                                        continue;
+
+                                r = ordered_set_put_strdup(&s, *k);
+                                if (r < 0)
+                                        return r;
+                        }
+
+                        continue;
+                }
+
+                generation = c->node->enumerators_generation;
+
                 slot = container_of(c, sd_bus_slot, node_enumerator);
 
                 bus->current_slot = sd_bus_slot_ref(slot);
                 bus->current_userdata = slot->userdata;
                 r = c->callback(bus, prefix, slot->userdata, &children, error);
                 bus->current_userdata = NULL;
+
+                /* Don't remember anything if the callback failed, if it changed the object tree (which
+                 * might have removed this very enumerator), or if the enumerator was invalidated meanwhile */
+                if (c->cached && r >= 0 && !sd_bus_error_is_set(error) && !bus->nodes_modified &&
+                    generation == c->node->enumerators_generation)
+                        node_enumerator_cache_put(c, prefix, children);
+
                 bus->current_slot = sd_bus_slot_unref(slot);
 
                 if (r < 0)
@@ -2013,11 +2065,12 @@ _public_ int sd_bus_add_fallback_vtable(
         return add_object_vtable_internal(bus, slot, prefix, interface, vtable, true, find, userdata);
 }
 
-_public_ int sd_bus_add_node_enumerator(
+static int add_node_enumerator_internal(
                 sd_bus *bus,
                 sd_bus_slot **slot,
                 const char *path,
                 sd_bus_node_enumerator_t callback,
+                bool cached,
                 void *userdata) {
 
         sd_bus_slot *s;
@@ -2041,6 +2094,7 @@ _public_ int sd_bus_add_node_enumerator(
         }
 
         s->node_enumerator.callback = callback;
+        s->node_enumerator.cached = cached;
 
         s->node_enumerator.node = n;
         LIST_PREPEND(enumerators, n->enumerators, &s->node_enumerator);
@@ -2058,6 +2112,50 @@ fail:
         return r;
 }
 
+_public_ int sd_bus_add_node_enumerator(
+                sd_bus *bus,
+                sd_bus_slot **slot,
+                const char *path,
+                sd_bus_node_enumerator_t callback,
+                void *userdata) {
+
+        return add_node_enumerator_internal(bus, slot, path, callback, false, userdata);
+}
+
+_public_ int sd_bus_add_node_enumerator_cached(
+                sd_bus *bus,
+                sd_bus_slot **slot,
+                const char *path,
+                sd_bus_node_enumerator_t callback,
+                void *userdata) {
+
+        /* Like sd_bus_add_node_enumerator(), but the returned nodes are remembered and handed out again
+         * until sd_bus_invalidate_node_enumerators() is called for the path. Hence the callback must not
+         * return anything that depends on the message being processed, e.g. on its sender. */
+
+        return add_node_enumerator_internal(bus, slot, path, callback, true, userdata);
+}
+
+_public_ int sd_bus_invalidate_node_enumerators(sd_bus *bus, const char *path) {
+        struct node *n;
+
+        assert_return(bus, -EINVAL);
+        assert_return(bus = bus_resolve(bus), -ENOPKG);
+        assert_return(object_path_is_valid(path), -EINVAL);
+        assert_return(!bus_origin_changed(bus), -ECHILD);
+
+        n = hashmap_get(bus->nodes, path);
+        if (!n)
+                return 0;
+
+        LIST_FOREACH(enumerators, c, n->enumerators)
+                c->cache = hashmap_free(c->cache);
+
+        /* Tells enumerations that are in progress right now not to cache what they get */
+        n->enumerators_generation++;
+        return 1;
+}
+
 static int emit_properties_changed_on_interface(
                 sd_bus *bus,
                 const char *prefix,
@@ -2265,7 +2363,92 @@ static int emit_properties_changed_on_interface(
         return 1;
 }
 
-_public_ int sd_bus_emit_properties_changed_strv(
+typedef struct DeferredPropertiesChanged {
+        char *key; /* "<path> <interface>" */
+        char *path;
+        char *interface;
+        char **names;
+        bool all; /* include all properties, i.e. names was NULL at least once */
+} DeferredPropertiesChanged;
+
+static DeferredPropertiesChanged* deferred_properties_changed_free(DeferredPropertiesChanged *d) {
+        if (!d)
+                return NULL;
+
+        free(d->key);
+        free(d->path);
+        free(d->interface);
+        strv_free(d->names);
+        return mfree(d);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(DeferredPropertiesChanged*, deferred_properties_changed_free);
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(
+                deferred_properties_changed_hash_ops,
+                char, string_hash_func, string_compare_func,
+                DeferredPropertiesChanged, deferred_properties_changed_free);
+
+static int defer_properties_changed(sd_bus *bus, const char *path, const char *interface, char **names) {
+        _cleanup_(deferred_properties_changed_freep) DeferredPropertiesChanged *n = NULL;
+        _cleanup_free_ char *key = NULL;
+        DeferredPropertiesChanged *d;
+        int r;
+
+        assert(bus);
+        assert(path);
+        assert(interface);
+
+        STRV_FOREACH(property, names)
+                assert_return(member_name_is_valid(*property), -EINVAL);
+
+        key = strjoin(path, " ", interface);
+        if (!key)
+                return -ENOMEM;
+
+        d = ordered_hashmap_get(bus->deferred_properties_changed, key);
+        if (!d) {
+                n = new(DeferredPropertiesChanged, 1);
+                if (!n)
+                        return -ENOMEM;
+
+                *n = (DeferredPropertiesChanged) {
+                        .key = TAKE_PTR(key),
+                        .path = strdup(path),
+                        .interface = strdup(interface),
+                };
+                if (!n->path || !n->interface)
+                        return -ENOMEM;
+
+                r = ordered_hashmap_ensure_put(&bus->deferred_properties_changed, &deferred_properties_changed_hash_ops, n->key, n);
+                if (r < 0)
+                        return r;
+
+                d = TAKE_PTR(n);
+        }
+
+        if (d->all)
+                return 0;
+
+        if (!names) {
+                d->all = true;
+                d->names = strv_free(d->names);
+                return 0;
+        }
+
+        STRV_FOREACH(property, names) {
+                if (strv_contains(d->names, *property))
+                        continue;
+
+                r = strv_extend(&d->names, *property);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+static int emit_properties_changed_strv_now(
                 sd_bus *bus,
                 const char *path,
                 const char *interface,
@@ -2276,22 +2459,13 @@ _public_ int sd_bus_emit_properties_changed_strv(
         size_t pl;
         int r;
 
-        assert_return(bus, -EINVAL);
-        assert_return(bus = bus_resolve(bus), -ENOPKG);
-        assert_return(object_path_is_valid(path), -EINVAL);
-        assert_return(interface_name_is_valid(interface), -EINVAL);
-        assert_return(!bus_origin_changed(bus), -ECHILD);
+        assert(bus);
+        assert(path);
+        assert(interface);
 
         if (!BUS_IS_OPEN(bus->state))
                 return -ENOTCONN;
 
-        /* A non-NULL but empty names list means nothing needs to be
-           generated. A NULL list OTOH indicates that all properties
-           that are set to EMITS_CHANGE or EMITS_INVALIDATION shall be
-           included in the PropertiesChanged message. */
-        if (names && names[0] == NULL)
-                return 0;
-
         BUS_DONT_DESTROY(bus);
 
         pl = strlen(path);
@@ -2322,6 +2496,79 @@ _public_ int sd_bus_emit_properties_changed_strv(
         return found_interface ? 0 : -ENOENT;
 }
 
+int bus_flush_deferred_properties_changed(sd_bus *bus, const char *path) {
+        int r;
+
+        assert(bus);
+
+        /* Sends the pending changes of the object at path, or of all objects if path is NULL. Sending the
+         * signals below ends up in sd_bus_send() again, which flushes too. */
+        if (bus->flushing_properties_changed)
+                return 0;
+
+        bus->flushing_properties_changed = true;
+
+        for (;;) {
+                DeferredPropertiesChanged *d = NULL, *i;
+
+                /* Look the next one up again each time, emitting might have queued further changes */
+                if (path) {
+                        ORDERED_HASHMAP_FOREACH(i, bus->deferred_properties_changed)
+                                if (streq(i->path, path)) {
+                                        d = i;
+                                        break;
+                                }
+                } else
+                        d = ordered_hashmap_first(bus->deferred_properties_changed);
+                if (!d)
+                        break;
+
+                assert_se(ordered_hashmap_remove(bus->deferred_properties_changed, d->key) == d);
+
+                r = emit_properties_changed_strv_now(bus, d->path, d->interface, d->all ? NULL : d->names);
+                if (r < 0)
+                        /* The object might have vanished in the meantime, nothing to tell anyone about then. */
+                        log_debug_errno(r, "Failed to emit deferred PropertiesChanged signal for %s on %s, ignoring: %m",
+                                        d->interface, d->path);
+
+                deferred_properties_changed_free(d);
+        }
+
+        bus->flushing_properties_changed = false;
+        return 0;
+}
+
+_public_ int sd_bus_emit_properties_changed_strv(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                char **names) {
+
+        assert_return(bus, -EINVAL);
+        assert_return(bus = bus_resolve(bus), -ENOPKG);
+        assert_return(object_path_is_valid(path), -EINVAL);
+        assert_return(interface_name_is_valid(interface), -EINVAL);
+        assert_return(!bus_origin_changed(bus), -ECHILD);
+
+        if (!BUS_IS_OPEN(bus->state))
+                return -ENOTCONN;
+
+        /* A non-NULL but empty names list means nothing needs to be
+           generated. A NULL list OTOH indicates that all properties
+           that are set to EMITS_CHANGE or EMITS_INVALIDATION shall be
+           included in the PropertiesChanged message. */
+        if (names && names[0] == NULL)
+                return 0;
+
+        /* In deferred mode, changes of the same object and interface are merged, and sent as one signal
+         * right before the event loop polls the next time, or before another signal of the same object is
+         * sent, whatever comes first. */
+        if (bus->defer_properties_changed && bus->event)
+                return defer_properties_changed(bus, path, interface, names);
+
+        return emit_properties_changed_strv_now(bus, path, interface, names);
+}
+
 _public_ int sd_bus_emit_properties_changed(
                 sd_bus *bus,
                 const char *path,
@@ -8,6 +8,7 @@ const sd_bus_vtable* bus_vtable_next(const sd_bus_vtable *vtable, const sd_bus_v
 bool bus_vtable_has_names(const sd_bus_vtable *vtable);
 int bus_process_object(sd_bus *bus, sd_bus_message *m);
 void bus_node_gc(sd_bus *b, struct node *n);
+int bus_flush_deferred_properties_changed(sd_bus *bus, const char *path);
 
 int introspect_path(
                 sd_bus *bus,
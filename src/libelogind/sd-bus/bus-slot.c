@@ -7,6 +7,7 @@
 #include "bus-objects.h"
 #include "bus-slot.h"
 #include "string-util.h"
+#include "strv.h"
 
 sd_bus_slot *bus_slot_allocate(
                 sd_bus *bus,
@@ -99,6 +100,8 @@ void bus_slot_disconnect(sd_bus_slot *slot, bool unref) {
                         bus_node_gc(slot->bus, slot->node_enumerator.node);
                 }
 
+                slot->node_enumerator.cache = hashmap_free(slot->node_enumerator.cache);
+
                 break;
 
         case BUS_NODE_OBJECT_MANAGER:
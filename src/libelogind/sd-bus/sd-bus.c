@@ -16,6 +16,7 @@
 #include "alloc-util.h"
 #include "bus-container.h"
 #include "bus-control.h"
+#include "bus-creds-cache.h"
 #include "bus-internal.h"
 #include "bus-kernel.h"
 #include "bus-label.h"
@@ -224,6 +225,9 @@ static sd_bus* bus_free(sd_bus *b) {
         assert(hashmap_isempty(b->nodes));
         hashmap_free(b->nodes);
 
+        ordered_hashmap_free(b->deferred_properties_changed);
+        bus_creds_cache_flush(b);
+
         bus_flush_memfd(b);
 
         assert_se(pthread_mutex_destroy(&b->memfd_cache_mutex) == 0);
@@ -2146,6 +2150,13 @@ _public_ int sd_bus_send(sd_bus *bus, sd_bus_message *_m, uint64_t *cookie) {
         if (!BUS_IS_OPEN(bus->state))
                 return -ENOTCONN;
 
+        /* Property changes of an object that are still pending happened before this signal of the same
+         * object was generated, hence send them first, so that the signals of one object are not reordered.
+         * Everything else is left to the event loop, so that changes stay coalesced. */
+        if (m->header->type == SD_BUS_MESSAGE_SIGNAL && m->path &&
+            !ordered_hashmap_isempty(bus->deferred_properties_changed))
+                (void) bus_flush_deferred_properties_changed(bus, m->path);
+
         if (m->n_fds > 0) {
                 r = sd_bus_can_send(bus, SD_BUS_TYPE_UNIX_FD);
                 if (r < 0)
@@ -3409,6 +3420,8 @@ _public_ int sd_bus_flush(sd_bus *bus) {
         if (r < 0)
                 return r;
 
+        (void) bus_flush_deferred_properties_changed(bus, NULL);
+
         if (bus->wqueue_size <= 0)
                 return 0;
 
@@ -3664,6 +3677,10 @@ static int prepare_callback(sd_event_source *s, void *userdata) {
 
         assert(s);
 
+        /* Send the PropertiesChanged signals queued up during this event loop iteration, before we figure
+         * out whether there is something to write. */
+        (void) bus_flush_deferred_properties_changed(bus, NULL);
+
         e = sd_bus_get_events(bus);
         if (e < 0) {
                 r = e;
@@ -3874,6 +3891,9 @@ _public_ int sd_bus_detach_event(sd_bus *bus) {
         if (!bus->event)
                 return 0;
 
+        /* Without an event loop nobody would send these anymore */
+        (void) bus_flush_deferred_properties_changed(bus, NULL);
+
         bus_detach_io_events(bus);
         bus->inotify_event_source = sd_event_source_disable_unref(bus->inotify_event_source);
         bus->time_event_source = sd_event_source_disable_unref(bus->time_event_source);
@@ -4408,6 +4428,61 @@ _public_ int sd_bus_get_close_on_exit(sd_bus *bus) {
         return bus->close_on_exit;
 }
 
+_public_ int sd_bus_set_defer_properties_changed(sd_bus *bus, int b) {
+        assert_return(bus, -EINVAL);
+        assert_return(bus = bus_resolve(bus), -ENOPKG);
+        assert_return(!bus_origin_changed(bus), -ECHILD);
+
+        bus->defer_properties_changed = b;
+
+        /* Don't leave anything behind that would only be sent once the event loop comes around again. */
+        if (!b)
+                (void) bus_flush_deferred_properties_changed(bus, NULL);
+
+        return 0;
+}
+
+_public_ int sd_bus_get_defer_properties_changed(sd_bus *bus) {
+        assert_return(bus, -EINVAL);
+        assert_return(bus = bus_resolve(bus), -ENOPKG);
+
+        return bus->defer_properties_changed;
+}
+
+_public_ int sd_bus_set_cache_sender_creds(sd_bus *bus, int b) {
+        assert_return(bus, -EINVAL);
+        assert_return(bus = bus_resolve(bus), -ENOPKG);
+        assert_return(!bus_origin_changed(bus), -ECHILD);
+
+        bus->cache_sender_creds = b;
+
+        if (!b)
+                bus_creds_cache_flush(bus);
+
+        return 0;
+}
+
+_public_ int sd_bus_get_cache_sender_creds(sd_bus *bus) {
+        assert_return(bus, -EINVAL);
+        assert_return(bus = bus_resolve(bus), -ENOPKG);
+
+        return bus->cache_sender_creds;
+}
+
+_public_ int sd_bus_get_sender_creds_cache_stats(sd_bus *bus, uint64_t *ret_driver_calls_avoided, uint64_t *ret_driver_calls) {
+        assert_return(bus, -EINVAL);
+        assert_return(bus = bus_resolve(bus), -ENOPKG);
+
+        /* Counts the GetConnectionCredentials() round trips to the bus driver the cache saved, and the ones
+         * it made. Fields requested with SD_BUS_CREDS_AUGMENT are read from /proc either way. */
+        if (ret_driver_calls_avoided)
+                *ret_driver_calls_avoided = bus->n_sender_creds_driver_calls_avoided;
+        if (ret_driver_calls)
+                *ret_driver_calls = bus->n_sender_creds_driver_calls;
+
+        return 0;
+}
+
 _public_ int sd_bus_enqueue_for_read(sd_bus *bus, sd_bus_message *m) {
         int r;
 
@@ -0,0 +1,123 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "sd-bus.h"
+#include "sd-event.h"
+
+#include "bus-internal.h"
+#include "hashmap.h"
+#include "process-util.h"
+#include "tests.h"
+#include "time-util.h"
+
+static int method_query(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        _cleanup_(sd_bus_creds_unrefp) sd_bus_creds *augmented = NULL, *augmented2 = NULL, *reliable = NULL;
+        const char *comm;
+        pid_t pid;
+        uid_t euid;
+
+        assert_se(sd_bus_query_sender_creds(m, SD_BUS_CREDS_PID|SD_BUS_CREDS_COMM|SD_BUS_CREDS_AUGMENT, &augmented) >= 0);
+        assert_se(sd_bus_creds_get_pid(augmented, &pid) >= 0);
+        assert_se(pid == getpid_cached());
+        assert_se(sd_bus_creds_get_comm(augmented, &comm) >= 0);
+        assert_se(sd_bus_creds_get_augmented_mask(augmented) & SD_BUS_CREDS_COMM);
+
+        /* Augmented data is read from /proc every time, only the PID the bus driver told us is cached */
+        assert_se(sd_bus_query_sender_creds(m, SD_BUS_CREDS_PID|SD_BUS_CREDS_COMM|SD_BUS_CREDS_AUGMENT, &augmented2) >= 0);
+        assert_se(augmented2 != augmented);
+        assert_se(sd_bus_creds_get_comm(augmented2, &comm) >= 0);
+
+        /* Augmented data is never handed out when it wasn't asked for */
+        assert_se(sd_bus_query_sender_creds(m, SD_BUS_CREDS_EUID, &reliable) >= 0);
+        assert_se(reliable != augmented);
+        assert_se(sd_bus_creds_get_euid(reliable, &euid) >= 0);
+        assert_se(euid == geteuid());
+        assert_se((sd_bus_creds_get_augmented_mask(reliable) & SD_BUS_CREDS_EUID) == 0);
+
+        return sd_bus_reply_method_return(m, NULL);
+}
+
+static int query_reply(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        unsigned *n_replies = ASSERT_PTR(userdata);
+
+        assert_se(!sd_bus_message_is_method_error(m, NULL));
+        (*n_replies)++;
+        return 0;
+}
+
+static void run_until(sd_event *e, bool (*condition)(void *userdata), void *userdata) {
+        usec_t deadline = usec_add(now(CLOCK_MONOTONIC), 5 * USEC_PER_SEC);
+
+        while (!condition(userdata)) {
+                assert_se(now(CLOCK_MONOTONIC) < deadline);
+                assert_se(sd_event_run(e, 100 * USEC_PER_MSEC) >= 0);
+        }
+}
+
+static bool three_replies(void *userdata) {
+        return *(unsigned*) userdata >= 3;
+}
+
+static bool cache_empty(void *userdata) {
+        return ordered_hashmap_isempty(((sd_bus*) userdata)->sender_creds_cache);
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *a = NULL, *b = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *event = NULL;
+        bool use_system_bus = false;
+        const char *unique;
+        uint64_t avoided, calls;
+        unsigned n_replies = 0;
+        int r;
+
+        test_setup_logging(LOG_INFO);
+
+        assert_se(sd_event_default(&event) >= 0);
+
+        r = sd_bus_open_user(&a);
+        if (IN_SET(r, -ECONNREFUSED, -ENOENT, -ENOMEDIUM)) {
+                r = sd_bus_open_system(&a);
+                if (IN_SET(r, -ECONNREFUSED, -ENOENT))
+                        return log_tests_skipped("Failed to connect to bus");
+                use_system_bus = true;
+        }
+        assert_se(r >= 0);
+
+        assert_se(sd_bus_attach_event(a, event, SD_EVENT_PRIORITY_NORMAL) >= 0);
+        assert_se(sd_bus_get_cache_sender_creds(a) == 0);
+        assert_se(sd_bus_set_cache_sender_creds(a, true) >= 0);
+        assert_se(sd_bus_get_cache_sender_creds(a) > 0);
+        assert_se(sd_bus_add_object(a, NULL, "/test", method_query, NULL) >= 0);
+        assert_se(sd_bus_get_unique_name(a, &unique) >= 0);
+
+        if (use_system_bus)
+                assert_se(sd_bus_open_system(&b) >= 0);
+        else
+                assert_se(sd_bus_open_user(&b) >= 0);
+
+        assert_se(sd_bus_attach_event(b, event, SD_EVENT_PRIORITY_NORMAL) >= 0);
+
+        for (unsigned i = 0; i < 3; i++)
+                assert_se(sd_bus_call_method_async(b, NULL, unique, "/test", "org.freedesktop.elogind.Test", "Query",
+                                                   query_reply, &n_replies, NULL) >= 0);
+
+        run_until(event, three_replies, &n_replies);
+
+        /* The bus driver was asked twice, for the PID and then for the EUID, all other queries were served
+         * from the cache */
+        assert_se(sd_bus_get_sender_creds_cache_stats(a, &avoided, &calls) >= 0);
+        log_info("%" PRIu64 " bus driver calls avoided, %" PRIu64 " made", avoided, calls);
+
+        if (calls > 2 && ordered_hashmap_isempty(a->sender_creds_cache))
+                return log_tests_skipped("pidfds not supported");
+
+        assert_se(avoided == 7);
+        assert_se(calls == 2);
+        assert_se(ordered_hashmap_size(a->sender_creds_cache) == 1);
+
+        /* Once the peer disconnects, its entry is dropped */
+        b = sd_bus_flush_close_unref(b);
+        run_until(event, cache_empty, a);
+
+        return 0;
+}
@@ -0,0 +1,202 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <sys/socket.h>
+
+#include "sd-bus.h"
+
+#include "alloc-util.h"
+#include "bus-dump.h"
+#include "bus-message.h"
+#include "fd-util.h"
+#include "memstream-util.h"
+#include "pcapng.h"
+#include "tests.h"
+
+static sd_bus* new_bus(int pair[static 2]) {
+        sd_bus *bus;
+        int fd;
+
+        /* Messages can only be created once the bus is started, but we never need to talk to anyone */
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, pair) >= 0);
+        assert_se(sd_bus_new(&bus) >= 0);
+        fd = TAKE_FD(pair[0]);
+        assert_se(sd_bus_set_fd(bus, fd, fd) >= 0);
+        assert_se(sd_bus_start(bus) >= 0);
+
+        return bus;
+}
+
+static sd_bus_message* new_message(sd_bus *bus, size_t body_size) {
+        _cleanup_free_ char *s = NULL;
+        sd_bus_message *m;
+
+        assert_se(s = malloc(body_size + 1));
+        memset(s, 'x', body_size);
+        s[body_size] = 0;
+
+        assert_se(sd_bus_message_new_signal(bus, &m, "/foo", "org.freedesktop.elogind.Test", "Test") >= 0);
+        assert_se(sd_bus_message_append(m, "sus", s, (uint32_t) body_size, "end") >= 0);
+        assert_se(sd_bus_message_seal(m, 4711, 0) >= 0);
+
+        /* Both encoders take the time stamp from here, so that they agree on it */
+        m->realtime = 1234567890123;
+
+        return m;
+}
+
+static void check_frame(sd_bus_message *m, size_t snaplen) {
+        _cleanup_(memstream_done) MemStream ms = {};
+        _cleanup_free_ char *streamed = NULL;
+        _cleanup_free_ uint8_t *buf = NULL;
+        struct pcapng_enhance_packet_block epb;
+        size_t size, streamed_size, caplen;
+        uint32_t trailer;
+        FILE *f;
+
+        size = bus_message_pcap_frame_size(m, snaplen);
+        assert_se(size % 4 == 0);
+        assert_se(buf = malloc(size));
+        bus_message_pcap_frame_to_buffer(m, snaplen, buf);
+
+        assert_se(f = memstream_init(&ms));
+        assert_se(bus_message_pcap_frame(m, snaplen, f) >= 0);
+        assert_se(memstream_finalize(&ms, &streamed, &streamed_size) >= 0);
+
+        /* The ring buffer encoder must produce exactly what is streamed out */
+        assert_se(streamed_size == size);
+        assert_se(memcmp(streamed, buf, size) == 0);
+
+        memcpy(&epb, buf, sizeof(epb));
+        caplen = MIN(BUS_MESSAGE_SIZE(m), snaplen);
+        assert_se(epb.block_type == PCAPNG_ENHANCED_PACKET_BLOCK);
+        assert_se(epb.block_length == size);
+        assert_se(epb.original_length == BUS_MESSAGE_SIZE(m));
+        assert_se(epb.capture_length == caplen);
+        assert_se(epb.timestamp_hi == (uint32_t) (m->realtime >> 32));
+        assert_se(epb.timestamp_lo == (uint32_t) m->realtime);
+
+        /* The captured data is the start of the message, followed by zero padding up to 32 bits */
+        assert_se(memcmp(buf + sizeof(epb), m->header, MIN(caplen, BUS_MESSAGE_BODY_BEGIN(m))) == 0);
+        for (size_t i = sizeof(epb) + caplen; i < size - sizeof(uint32_t); i++)
+                assert_se(buf[i] == 0);
+
+        memcpy(&trailer, buf + size - sizeof(uint32_t), sizeof(trailer));
+        assert_se(trailer == size);
+}
+
+TEST(pcap_frame) {
+        _cleanup_close_pair_ int pair[2] = EBADF_PAIR;
+        _cleanup_(sd_bus_unrefp) sd_bus *bus = new_bus(pair);
+
+        /* Various body sizes, so that the capture length hits every remainder modulo 4 */
+        for (size_t body_size = 0; body_size < 8; body_size++) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = new_message(bus, body_size);
+                size_t header_size = BUS_MESSAGE_BODY_BEGIN(m), message_size = BUS_MESSAGE_SIZE(m);
+
+                /* Truncated within the header, at its end, within the body, and not at all */
+                size_t snaplens[] = {
+                        1, 2, 3, 5,
+                        header_size - 1, header_size, header_size + 1,
+                        message_size - 1, message_size, message_size + 1,
+                        65535,
+                };
+
+                FOREACH_ARRAY(snaplen, snaplens, ELEMENTSOF(snaplens))
+                        check_frame(m, *snaplen);
+        }
+
+        /* A body larger than the default snap length */
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *big = new_message(bus, 300000);
+        check_frame(big, 262144);
+        check_frame(big, BUS_MESSAGE_SIZE(big));
+}
+
+TEST(pcap_statistics) {
+        _cleanup_(memstream_done) MemStream ms = {};
+        struct pcapng_statistics_block isb;
+        _cleanup_free_ char *buf = NULL;
+        struct pcapng_option opt;
+        uint32_t ts[2], trailer;
+        uint64_t counter;
+        size_t size, offset;
+        FILE *f;
+
+        assert_se(f = memstream_init(&ms));
+        assert_se(bus_pcap_statistics(UINT64_C(0x0000000100000002), UINT64_C(0x0000000300000004), 42, 7, f) >= 0);
+        assert_se(memstream_finalize(&ms, &buf, &size) >= 0);
+
+        /* Fixed part, four options with 64-bit values, end of options, trailing length */
+        assert_se(size == sizeof(isb) + 4 * (sizeof(opt) + 8) + sizeof(opt) + sizeof(uint32_t));
+
+        memcpy(&isb, buf, sizeof(isb));
+        assert_se(isb.block_type == PCAPNG_INTERFACE_STATS_BLOCK);
+        assert_se(isb.block_length == size);
+        assert_se(isb.interface_id == 0);
+        assert_se(isb.timestamp_hi == 3);
+        assert_se(isb.timestamp_lo == 4);
+
+        offset = sizeof(isb);
+
+        /* Time stamps are written as high and low 32 bits */
+        for (uint16_t code = PCAPNG_ISB_STARTTIME; code <= PCAPNG_ISB_ENDTIME; code++) {
+                memcpy(&opt, buf + offset, sizeof(opt));
+                assert_se(opt.code == code);
+                assert_se(opt.length == sizeof(ts));
+                memcpy(ts, buf + offset + sizeof(opt), sizeof(ts));
+                assert_se(ts[0] == (code == PCAPNG_ISB_STARTTIME ? 1u : 3u));
+                assert_se(ts[1] == (code == PCAPNG_ISB_STARTTIME ? 2u : 4u));
+                offset += sizeof(opt) + sizeof(ts);
+        }
+
+        for (uint16_t code = PCAPNG_ISB_IFRECV; code <= PCAPNG_ISB_IFDROP; code++) {
+                memcpy(&opt, buf + offset, sizeof(opt));
+                assert_se(opt.code == code);
+                assert_se(opt.length == sizeof(counter));
+                memcpy(&counter, buf + offset + sizeof(opt), sizeof(counter));
+                assert_se(counter == (code == PCAPNG_ISB_IFRECV ? 42u : 7u));
+                offset += sizeof(opt) + sizeof(counter);
+        }
+
+        memcpy(&opt, buf + offset, sizeof(opt));
+        assert_se(opt.code == PCAPNG_OPT_END);
+        assert_se(opt.length == 0);
+        offset += sizeof(opt);
+
+        memcpy(&trailer, buf + offset, sizeof(trailer));
+        assert_se(trailer == size);
+        assert_se(offset + sizeof(trailer) == size);
+}
+
+TEST(pcap_header) {
+        _cleanup_(memstream_done) MemStream ms = {};
+        struct pcapng_interface_block idb;
+        _cleanup_free_ char *buf = NULL;
+        struct pcapng_section shb;
+        uint32_t trailer;
+        size_t size;
+        FILE *f;
+
+        /* Option strings whose lengths are not a multiple of 4, so that they need padding */
+        assert_se(f = memstream_init(&ms));
+        assert_se(bus_pcap_header(4096, "Linux", "elogind", f) >= 0);
+        assert_se(memstream_finalize(&ms, &buf, &size) >= 0);
+
+        memcpy(&shb, buf, sizeof(shb));
+        assert_se(shb.block_type == PCAPNG_SECTION_BLOCK);
+        assert_se(shb.byte_order_magic == PCAPNG_BYTE_ORDER_MAGIC);
+        assert_se(shb.block_length % 4 == 0);
+        assert_se(shb.block_length < size);
+        memcpy(&trailer, buf + shb.block_length - sizeof(uint32_t), sizeof(trailer));
+        assert_se(trailer == shb.block_length);
+
+        /* The interface description follows right after, and ends the header */
+        memcpy(&idb, buf + shb.block_length, sizeof(idb));
+        assert_se(idb.block_type == PCAPNG_INTERFACE_BLOCK);
+        assert_se(idb.block_length % 4 == 0);
+        assert_se(idb.snap_len == 4096);
+        assert_se(shb.block_length + idb.block_length == size);
+        memcpy(&trailer, buf + size - sizeof(uint32_t), sizeof(trailer));
+        assert_se(trailer == idb.block_length);
+}
+
+DEFINE_TEST_MAIN(LOG_DEBUG);
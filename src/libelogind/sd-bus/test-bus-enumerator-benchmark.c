@@ -0,0 +1,119 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <stdio.h>
+#include <sys/socket.h>
+
+#include "sd-bus.h"
+#include "sd-event.h"
+
+#include "bus-label.h"
+#include "fd-util.h"
+#include "parse-util.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tests.h"
+#include "time-util.h"
+
+/* Measures the cost of Introspect() on an object subtree with many enumerated children, with and without
+ * a cached node enumerator. The enumerator mimics what logind does for its sessions. */
+
+static unsigned arg_iterations = 100;
+static unsigned n_objects = 0;
+
+static int enumerator(sd_bus *bus, const char *path, void *userdata, char ***ret_nodes, sd_bus_error *error) {
+        _cleanup_strv_free_ char **l = NULL;
+        int r;
+
+        for (unsigned i = 0; i < n_objects; i++) {
+                _cleanup_free_ char *id = NULL, *t = NULL;
+                char *p;
+
+                if (asprintf(&id, "c%u", i) < 0)
+                        return -ENOMEM;
+
+                t = bus_label_escape(id);
+                if (!t)
+                        return -ENOMEM;
+
+                p = strjoin(path, "/", t);
+                if (!p)
+                        return -ENOMEM;
+
+                r = strv_consume(&l, p);
+                if (r < 0)
+                        return r;
+        }
+
+        *ret_nodes = TAKE_PTR(l);
+        return 1;
+}
+
+static int introspect_reply(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        bool *done = ASSERT_PTR(userdata);
+
+        assert_se(!sd_bus_message_is_method_error(m, NULL));
+        *done = true;
+        return 0;
+}
+
+static usec_t introspect(sd_event *e, sd_bus *client, const char *path) {
+        usec_t t = now(CLOCK_MONOTONIC);
+
+        for (unsigned i = 0; i < arg_iterations; i++) {
+                bool done = false;
+
+                assert_se(sd_bus_call_method_async(client, NULL, NULL, path, "org.freedesktop.DBus.Introspectable", "Introspect",
+                                                   introspect_reply, &done, NULL) >= 0);
+
+                while (!done)
+                        assert_se(sd_event_run(e, UINT64_MAX) >= 0);
+        }
+
+        return (now(CLOCK_MONOTONIC) - t) / arg_iterations;
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *server = NULL, *client = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        _cleanup_close_pair_ int pair[2] = EBADF_PAIR;
+        sd_id128_t id;
+
+        test_setup_logging(LOG_INFO);
+
+        if (argc > 1)
+                assert_se(safe_atou(argv[1], &arg_iterations) >= 0 && arg_iterations > 0);
+
+        assert_se(sd_event_default(&e) >= 0);
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, pair) >= 0);
+        assert_se(sd_id128_randomize(&id) >= 0);
+
+        assert_se(sd_bus_new(&server) >= 0);
+        assert_se(sd_bus_set_fd(server, pair[0], pair[0]) >= 0);
+        TAKE_FD(pair[0]);
+        assert_se(sd_bus_set_server(server, true, id) >= 0);
+        assert_se(sd_bus_add_node_enumerator(server, NULL, "/uncached", enumerator, NULL) >= 0);
+        assert_se(sd_bus_add_node_enumerator_cached(server, NULL, "/cached", enumerator, NULL) >= 0);
+        assert_se(sd_bus_start(server) >= 0);
+        assert_se(sd_bus_attach_event(server, e, SD_EVENT_PRIORITY_NORMAL) >= 0);
+
+        assert_se(sd_bus_new(&client) >= 0);
+        assert_se(sd_bus_set_fd(client, pair[1], pair[1]) >= 0);
+        TAKE_FD(pair[1]);
+        assert_se(sd_bus_start(client) >= 0);
+        assert_se(sd_bus_attach_event(client, e, SD_EVENT_PRIORITY_NORMAL) >= 0);
+
+        printf("OBJECTS\tUNCACHED USEC\tCACHED USEC\n");
+
+        for (n_objects = 10; n_objects <= 10000; n_objects *= 10) {
+                usec_t uncached, cached;
+
+                assert_se(sd_bus_invalidate_node_enumerators(server, "/cached") > 0);
+
+                uncached = introspect(e, client, "/uncached");
+                cached = introspect(e, client, "/cached");
+
+                printf("%u\t"USEC_FMT"\t"USEC_FMT"\n", n_objects, uncached, cached);
+        }
+
+        return 0;
+}
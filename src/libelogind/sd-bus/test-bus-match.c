@@ -1,5 +1,6 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
+#include "bus-internal.h"
 #include "bus-match.h"
 #include "bus-message.h"
 #include "bus-slot.h"
@@ -7,6 +8,7 @@
 #include "macro.h"
 #include "memory-util.h"
 #include "tests.h"
+#include "time-util.h"
 
 static bool mask[32];
 
@@ -36,24 +38,151 @@ static bool mask_contains(unsigned a[], unsigned n) {
         return true;
 }
 
-static int match_add(sd_bus_slot *slots, struct bus_match_node *root, const char *match, int value) {
+static int match_add_component(struct bus_match_node *root, const char *match, struct match_callback *callback) {
         struct bus_match_component *components;
         size_t n_components;
-        sd_bus_slot *s;
         int r;
 
-        s = slots + value;
-
         r = bus_match_parse(match, &components, &n_components);
         if (r < 0)
                 return r;
 
         CLEANUP_ARRAY(components, n_components, bus_match_parse_free);
 
+        return bus_match_add(root, components, n_components, callback);
+}
+
+static int match_add(sd_bus_slot *slots, struct bus_match_node *root, const char *match, int value) {
+        sd_bus_slot *s;
+
+        s = slots + value;
+
         s->userdata = INT_TO_PTR(value);
         s->match_callback.callback = filter;
 
-        return bus_match_add(root, components, n_components, &s->match_callback);
+        return match_add_component(root, match, &s->match_callback);
+}
+
+#define N_PREFIX_MATCHES 10000U
+#define N_PREFIX_RUNS 10000U
+
+static unsigned n_prefix_hits[N_PREFIX_MATCHES];
+
+static int prefix_filter(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        assert_se(PTR_TO_UINT(userdata) < N_PREFIX_MATCHES);
+        n_prefix_hits[PTR_TO_UINT(userdata)]++;
+        return 0;
+}
+
+static const char* prefix_match_value(unsigned i, char buf[static 64]) {
+        /* Sessions, a few namespaces above them, and some values that are no valid object paths, but are
+         * accepted in matches anyway */
+        if (i == 0)
+                return "/";
+        if (i == 1)
+                return "/org/freedesktop/login1";
+        if (i == 2)
+                return "/org/freedesktop/login1/";
+        if (i % 10 == 1)
+                return snprintf_ok(buf, 64, "/org/freedesktop/login1/session/_%u/", i);
+        if (i % 10 == 3)
+                return snprintf_ok(buf, 64, "/org//freedesktop/login1/session/_%u", i);
+
+        return snprintf_ok(buf, 64, "/org/freedesktop/login1/session/_%u", i);
+}
+
+static void test_prefix_index_one(sd_bus *bus, const char *type, bool path_arg) {
+        _cleanup_free_ sd_bus_slot *slots = NULL;
+        struct bus_match_node root = {
+                .type = BUS_MATCH_ROOT,
+        };
+        static const char *const paths[] = {
+                "/",
+                "/org/freedesktop/login1",
+                "/org/freedesktop/login1/",
+                "/org/freedesktop/login1/session/_5005",
+                "/org/freedesktop/login1/session/_5001/",
+                "/org/freedesktop/login1/session/_50051",
+                "/org/freedesktop/login1/session/_5004/sub",
+                "/org//freedesktop/login1/session/_13",
+                "/org/freedesktop/login1/session/",
+        };
+
+        log_info("/* %s(%s) */", __func__, type);
+
+        assert_se(slots = new0(sd_bus_slot, N_PREFIX_MATCHES));
+
+        for (unsigned i = 0; i < N_PREFIX_MATCHES; i++) {
+                _cleanup_free_ char *match = NULL;
+                char buf[64];
+
+                assert_se(asprintf(&match, "%s='%s'", type, prefix_match_value(i, buf)) >= 0);
+
+                slots[i].userdata = UINT_TO_PTR(i);
+                slots[i].match_callback.callback = prefix_filter;
+                assert_se(match_add_component(&root, match, &slots[i].match_callback) >= 0);
+        }
+
+        /* Compare the index against testing every value by itself */
+        for (size_t j = 0; j < ELEMENTSOF(paths); j++) {
+                const char *const *path = paths + j;
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+                unsigned n = 0;
+
+                /* Messages are only ever sent to valid object paths, arguments may be anything */
+                if (!path_arg && !object_path_is_valid(*path))
+                        continue;
+
+                if (path_arg) {
+                        assert_se(sd_bus_message_new_signal(bus, &m, "/", "foo.x", "bar") >= 0);
+                        assert_se(sd_bus_message_append(m, "s", *path) >= 0);
+                } else
+                        assert_se(sd_bus_message_new_signal(bus, &m, *path, "foo.x", "bar") >= 0);
+                assert_se(sd_bus_message_seal(m, 1, 0) >= 0);
+
+                zero(n_prefix_hits);
+                assert_se(bus_match_run(NULL, &root, m) == 0);
+
+                for (unsigned i = 0; i < N_PREFIX_MATCHES; i++) {
+                        char buf[64];
+                        const char *v = prefix_match_value(i, buf);
+
+                        assert_se(n_prefix_hits[i] == (unsigned) (path_arg ? path_complex_pattern(v, *path) : path_simple_pattern(v, *path)));
+                        n += n_prefix_hits[i];
+                }
+
+                log_debug("%s: %u matches", *path, n);
+        }
+
+        /* And time a message that hits one session among all others */
+        {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+                usec_t ts;
+
+                if (path_arg) {
+                        assert_se(sd_bus_message_new_signal(bus, &m, "/", "foo.x", "bar") >= 0);
+                        assert_se(sd_bus_message_append(m, "s", "/org/freedesktop/login1/session/_5005") >= 0);
+                } else
+                        assert_se(sd_bus_message_new_signal(bus, &m, "/org/freedesktop/login1/session/_5005", "foo.x", "bar") >= 0);
+                assert_se(sd_bus_message_seal(m, 1, 0) >= 0);
+
+                ts = now(CLOCK_MONOTONIC);
+                for (unsigned i = 0; i < N_PREFIX_RUNS; i++)
+                        assert_se(bus_match_run(NULL, &root, m) == 0);
+
+                log_info("%s=: %u installed matches, %" PRIu64 " ns per message",
+                         type, N_PREFIX_MATCHES, (now(CLOCK_MONOTONIC) - ts) * NSEC_PER_USEC / N_PREFIX_RUNS);
+        }
+
+        if (DEBUG_LOGGING)
+                bus_match_dump(stdout, &root, 0);
+
+        bus_match_free(&root);
+}
+
+static void test_prefix_index(sd_bus *bus) {
+        test_prefix_index_one(bus, "path_namespace", false);
+        test_prefix_index_one(bus, "arg0path", true);
 }
 
 static void test_match_scope(const char *match, enum bus_match_scope scope) {
@@ -134,6 +263,8 @@ int main(int argc, char *argv[]) {
 
         bus_match_free(&root);
 
+        test_prefix_index(bus);
+
         test_match_scope("interface='foobar'", BUS_MATCH_GENERIC);
         test_match_scope("", BUS_MATCH_GENERIC);
         test_match_scope("interface='org.freedesktop.DBus.Local'", BUS_MATCH_LOCAL);
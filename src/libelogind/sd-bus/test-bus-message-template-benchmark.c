@@ -0,0 +1,88 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <stdio.h>
+#include <sys/socket.h>
+
+#include "sd-bus.h"
+
+#include "fd-util.h"
+#include "parse-util.h"
+#include "tests.h"
+#include "time-util.h"
+
+/* Compares appending values dynamically via sd_bus_message_append() with appending them through a
+ * pre-parsed message template, for a ListSessions() style reply and a PropertiesChanged() payload. */
+
+static unsigned arg_iterations = 10000;
+
+#define N_SESSIONS 100
+
+static nsec_t list_sessions(sd_bus *bus, sd_bus_message_template *t) {
+        usec_t ts = now(CLOCK_MONOTONIC);
+
+        for (unsigned i = 0; i < arg_iterations / N_SESSIONS; i++) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+
+                assert_se(sd_bus_message_new_signal(bus, &m, "/foo", "org.freedesktop.elogind.Test", "Test") >= 0);
+                assert_se(sd_bus_message_open_container(m, 'a', "(susso)") >= 0);
+
+                for (unsigned j = 0; j < N_SESSIONS; j++)
+                        if (t)
+                                assert_se(sd_bus_message_append_template(m, t, "c1", (uint32_t) 1000, "foo", "seat0",
+                                                                         "/org/freedesktop/login1/session/c1") >= 0);
+                        else
+                                assert_se(sd_bus_message_append(m, "(susso)", "c1", (uint32_t) 1000, "foo", "seat0",
+                                                                "/org/freedesktop/login1/session/c1") >= 0);
+
+                assert_se(sd_bus_message_close_container(m) >= 0);
+        }
+
+        return (now(CLOCK_MONOTONIC) - ts) * NSEC_PER_USEC / (arg_iterations / N_SESSIONS * N_SESSIONS);
+}
+
+static nsec_t properties_changed(sd_bus *bus, sd_bus_message_template *t) {
+        usec_t ts = now(CLOCK_MONOTONIC);
+
+        for (unsigned i = 0; i < arg_iterations; i++) {
+                _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
+
+                assert_se(sd_bus_message_new_signal(bus, &m, "/foo", "org.freedesktop.DBus.Properties", "PropertiesChanged") >= 0);
+
+                if (t)
+                        assert_se(sd_bus_message_append_template(m, t, "org.freedesktop.login1.Session",
+                                                                 2, "Active", "b", 1, "State", "s", "active",
+                                                                 1, "IdleHint") >= 0);
+                else
+                        assert_se(sd_bus_message_append(m, "sa{sv}as", "org.freedesktop.login1.Session",
+                                                        2, "Active", "b", 1, "State", "s", "active",
+                                                        1, "IdleHint") >= 0);
+        }
+
+        return (now(CLOCK_MONOTONIC) - ts) * NSEC_PER_USEC / arg_iterations;
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_(sd_bus_message_template_unrefp) sd_bus_message_template *session = NULL, *changed = NULL;
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        _cleanup_close_pair_ int pair[2] = EBADF_PAIR;
+
+        test_setup_logging(LOG_INFO);
+
+        if (argc > 1)
+                assert_se(safe_atou(argv[1], &arg_iterations) >= 0 && arg_iterations >= N_SESSIONS);
+
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, pair) >= 0);
+        assert_se(sd_bus_new(&bus) >= 0);
+        assert_se(sd_bus_set_fd(bus, pair[0], pair[0]) >= 0);
+        TAKE_FD(pair[0]);
+        assert_se(sd_bus_start(bus) >= 0);
+
+        assert_se(SD_BUS_MESSAGE_TEMPLATE_NEW(&session, "(susso)") >= 0);
+        assert_se(SD_BUS_MESSAGE_TEMPLATE_NEW(&changed, "sa{sv}as") >= 0);
+
+        printf("SIGNATURE\tDYNAMIC NSEC\tTEMPLATE NSEC\n");
+        printf("(susso)\t%" PRIu64 "\t%" PRIu64 "\n", list_sessions(bus, NULL), list_sessions(bus, session));
+        printf("sa{sv}as\t%" PRIu64 "\t%" PRIu64 "\n", properties_changed(bus, NULL), properties_changed(bus, changed));
+
+        return 0;
+}
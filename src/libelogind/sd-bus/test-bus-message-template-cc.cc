@@ -0,0 +1,133 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* We use system assert.h here, because we don't want to keep macro.h and log.h C++ compatible */
+#undef NDEBUG
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+
+#include "sd-bus.h"
+
+static char* dump(sd_bus_message *m) {
+        char *buf = NULL;
+        size_t size = 0;
+        FILE *f;
+
+        assert(sd_bus_message_seal(m, 4711, 0) >= 0);
+
+        f = open_memstream(&buf, &size);
+        assert(f);
+        assert(sd_bus_message_dump(m, f, 0) >= 0);
+        assert(fclose(f) == 0);
+
+        return buf;
+}
+
+static sd_bus_message* new_signal(sd_bus *bus) {
+        sd_bus_message *m = NULL;
+
+        assert(sd_bus_message_new_signal(bus, &m, "/foo", "org.freedesktop.elogind.Test", "Test") >= 0);
+        return m;
+}
+
+static void test_template(sd_bus *bus) {
+        sd_bus_message_template *sessions = NULL, *properties = NULL;
+        sd_bus_message *a, *b;
+        char *x, *y;
+
+        assert(SD_BUS_MESSAGE_TEMPLATE_NEW(&sessions, "a(susso)") >= 0);
+        assert(SD_BUS_MESSAGE_TEMPLATE_NEW(&properties, "sa{sv}as") >= 0);
+        assert(strcmp(sd_bus_message_template_get_signature(sessions), "a(susso)") == 0);
+
+        /* The same values appended dynamically and through a template give identical messages */
+        a = new_signal(bus);
+        assert(sd_bus_message_append(a, "a(susso)", 2,
+                                     "1", (uint32_t) 1000, "foo", "seat0", "/org/freedesktop/login1/session/_31",
+                                     "c2", (uint32_t) 0, "root", "", "/org/freedesktop/login1/session/c2") >= 0);
+        assert(sd_bus_message_append(a, "sa{sv}as", "org.freedesktop.login1.Session",
+                                     3,
+                                     "Active", "b", 1,
+                                     "Timestamp", "t", UINT64_C(1234567890),
+                                     "Seats", "as", 2, "seat0", "seat1",
+                                     1, "IdleHint") >= 0);
+        assert(sd_bus_message_append(a, "u", (uint32_t) 42) >= 0);
+
+        b = new_signal(bus);
+        assert(sd_bus_message_append_template(b, sessions, 2,
+                                              "1", (uint32_t) 1000, "foo", "seat0", "/org/freedesktop/login1/session/_31",
+                                              "c2", (uint32_t) 0, "root", "", "/org/freedesktop/login1/session/c2") >= 0);
+        assert(sd_bus_message_append_template(b, properties, "org.freedesktop.login1.Session",
+                                              3,
+                                              "Active", "b", 1,
+                                              "Timestamp", "t", UINT64_C(1234567890),
+                                              "Seats", "as", 2, "seat0", "seat1",
+                                              1, "IdleHint") >= 0);
+        assert(sd_bus_message_append(b, "u", (uint32_t) 42) >= 0);
+
+        x = dump(a);
+        y = dump(b);
+        assert(strcmp(x, y) == 0);
+        fputs(y, stdout);
+
+        free(x);
+        free(y);
+        sd_bus_message_unref(a);
+        sd_bus_message_unref(b);
+
+        /* Templates can be used inside of containers, too */
+        a = new_signal(bus);
+        assert(sd_bus_message_append(a, "(ia(susso))", -1, 1, "3", (uint32_t) 1, "bar", "", "/org/freedesktop/login1/session/_33") >= 0);
+
+        b = new_signal(bus);
+        assert(sd_bus_message_open_container(b, 'r', "ia(susso)") >= 0);
+        assert(sd_bus_message_append(b, "i", -1) >= 0);
+        assert(sd_bus_message_append_template(b, sessions, 1, "3", (uint32_t) 1, "bar", "", "/org/freedesktop/login1/session/_33") >= 0);
+        assert(sd_bus_message_close_container(b) >= 0);
+
+        x = dump(a);
+        y = dump(b);
+        assert(strcmp(x, y) == 0);
+
+        free(x);
+        free(y);
+        sd_bus_message_unref(a);
+        sd_bus_message_unref(b);
+
+        /* A failed append leaves the message poisoned, as the signature was already extended */
+        a = new_signal(bus);
+        assert(sd_bus_message_append_template(a, properties, "org.freedesktop.login1.Session", 1, "Foo", NULL, 0) == -EINVAL);
+        assert(sd_bus_message_append(a, "u", (uint32_t) 42) == -ESTALE);
+        sd_bus_message_unref(a);
+
+        assert(sd_bus_message_template_new(&sessions, "a(susso") == -EINVAL);
+        assert(sd_bus_message_template_new(&sessions, "{sv}") == -EINVAL);
+
+        sd_bus_message_template_unref(sessions);
+        sd_bus_message_template_unref(properties);
+}
+
+int main(int argc, char **argv) {
+        sd_bus *bus = NULL;
+        int pair[2];
+
+        /* Messages can only be created once the bus is started, but we never need to talk to anyone */
+        assert(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, pair) >= 0);
+        assert(sd_bus_new(&bus) >= 0);
+        assert(sd_bus_set_fd(bus, pair[0], pair[0]) >= 0);
+        assert(sd_bus_start(bus) >= 0);
+
+        test_template(bus);
+
+        sd_bus_unref(bus);
+        close(pair[1]);
+
+        return 0;
+}
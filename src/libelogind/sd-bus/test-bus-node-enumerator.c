@@ -0,0 +1,129 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <sys/socket.h>
+
+#include "sd-bus.h"
+#include "sd-event.h"
+
+#include "fd-util.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tests.h"
+#include "time-util.h"
+
+static char **arg_nodes = NULL;
+static unsigned n_cached_calls = 0, n_uncached_calls = 0;
+
+STATIC_DESTRUCTOR_REGISTER(arg_nodes, strv_freep);
+
+static int cached_enumerator(sd_bus *bus, const char *path, void *userdata, char ***ret_nodes, sd_bus_error *error) {
+        n_cached_calls++;
+
+        *ret_nodes = strv_copy(arg_nodes);
+        return *ret_nodes ? 1 : -ENOMEM;
+}
+
+static int uncached_enumerator(sd_bus *bus, const char *path, void *userdata, char ***ret_nodes, sd_bus_error *error) {
+        n_uncached_calls++;
+
+        *ret_nodes = strv_new("/foo/self");
+        return *ret_nodes ? 1 : -ENOMEM;
+}
+
+static int introspect_reply(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        sd_bus_message **reply = ASSERT_PTR(userdata);
+
+        *reply = sd_bus_message_ref(m);
+        return 0;
+}
+
+static char* introspect(sd_event *e, sd_bus *client, const char *path) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        usec_t deadline = usec_add(now(CLOCK_MONOTONIC), 5 * USEC_PER_SEC);
+        const char *xml;
+        char *s;
+
+        assert_se(sd_bus_call_method_async(client, NULL, NULL, path, "org.freedesktop.DBus.Introspectable", "Introspect",
+                                           introspect_reply, &reply, NULL) >= 0);
+
+        while (!reply) {
+                assert_se(now(CLOCK_MONOTONIC) < deadline);
+                assert_se(sd_event_run(e, 100 * USEC_PER_MSEC) >= 0);
+        }
+
+        assert_se(!sd_bus_message_is_method_error(reply, NULL));
+        assert_se(sd_bus_message_read(reply, "s", &xml) >= 0);
+        assert_se(s = strdup(xml));
+        return s;
+}
+
+TEST(node_enumerator_cached) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *server = NULL, *client = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        _cleanup_close_pair_ int pair[2] = EBADF_PAIR;
+        _cleanup_free_ char *a = NULL, *b = NULL, *c = NULL;
+        sd_id128_t id;
+
+        assert_se(sd_event_default(&e) >= 0);
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, pair) >= 0);
+        assert_se(sd_id128_randomize(&id) >= 0);
+
+        assert_se(sd_bus_new(&server) >= 0);
+        assert_se(sd_bus_set_fd(server, pair[0], pair[0]) >= 0);
+        TAKE_FD(pair[0]);
+        assert_se(sd_bus_set_server(server, true, id) >= 0);
+        assert_se(sd_bus_add_node_enumerator_cached(server, NULL, "/foo", cached_enumerator, NULL) >= 0);
+        assert_se(sd_bus_add_node_enumerator(server, NULL, "/foo", uncached_enumerator, NULL) >= 0);
+        assert_se(sd_bus_start(server) >= 0);
+        assert_se(sd_bus_attach_event(server, e, SD_EVENT_PRIORITY_NORMAL) >= 0);
+
+        assert_se(sd_bus_new(&client) >= 0);
+        assert_se(sd_bus_set_fd(client, pair[1], pair[1]) >= 0);
+        TAKE_FD(pair[1]);
+        assert_se(sd_bus_start(client) >= 0);
+        assert_se(sd_bus_attach_event(client, e, SD_EVENT_PRIORITY_NORMAL) >= 0);
+
+        assert_se(arg_nodes = strv_new("/foo/a", "/foo/b", "/bar/c"));
+
+        a = introspect(e, client, "/foo");
+        assert_se(strstr(a, "<node name=\"a\"/>"));
+        assert_se(strstr(a, "<node name=\"b\"/>"));
+        assert_se(strstr(a, "<node name=\"self\"/>"));
+        assert_se(!strstr(a, "\"c\""));
+        assert_se(n_cached_calls == 1);
+        assert_se(n_uncached_calls == 1);
+
+        /* The second time around only the uncached enumerator is asked */
+        b = introspect(e, client, "/foo");
+        assert_se(streq(a, b));
+        assert_se(n_cached_calls == 1);
+        assert_se(n_uncached_calls == 2);
+
+        /* Changes are only picked up after an invalidation */
+        assert_se(strv_extend(&arg_nodes, "/foo/d") >= 0);
+        b = mfree(b);
+        b = introspect(e, client, "/foo");
+        assert_se(streq(a, b));
+        assert_se(n_cached_calls == 1);
+
+        assert_se(sd_bus_invalidate_node_enumerators(server, "/foo") > 0);
+        assert_se(sd_bus_invalidate_node_enumerators(server, "/foo/a") == 0);
+
+        c = introspect(e, client, "/foo");
+        assert_se(strstr(c, "<node name=\"d\"/>"));
+        assert_se(n_cached_calls == 2);
+        assert_se(n_uncached_calls == 4);
+
+        /* Results for different prefixes are remembered side by side */
+        for (unsigned i = 0; i < 3; i++) {
+                _cleanup_free_ char *x = NULL, *y = NULL;
+
+                x = introspect(e, client, "/foo/a");
+                assert_se(!strstr(x, "<node name=\"b\"/>"));
+                y = introspect(e, client, "/foo");
+                assert_se(streq(y, c));
+        }
+        assert_se(n_cached_calls == 3);
+}
+
+DEFINE_TEST_MAIN(LOG_DEBUG);
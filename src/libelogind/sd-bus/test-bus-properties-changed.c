@@ -0,0 +1,235 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <sys/socket.h>
+
+#include "sd-bus.h"
+#include "sd-event.h"
+
+#include "bus-internal.h"
+#include "fd-util.h"
+#include "hashmap.h"
+#include "strv.h"
+#include "tests.h"
+#include "time-util.h"
+
+typedef struct Context {
+        unsigned n_signals;
+        char *interface;
+        char **changed;
+        char **invalidated;
+        char **order;
+} Context;
+
+static void context_done(Context *c) {
+        c->interface = mfree(c->interface);
+        c->changed = strv_free(c->changed);
+        c->invalidated = strv_free(c->invalidated);
+        c->order = strv_free(c->order);
+}
+
+static int get_property(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        return sd_bus_message_append(reply, "u", 4711);
+}
+
+static const sd_bus_vtable vtable[] = {
+        SD_BUS_VTABLE_START(0),
+        SD_BUS_PROPERTY("Alpha", "u", get_property, 0, SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("Beta", "u", get_property, 0, SD_BUS_VTABLE_PROPERTY_EMITS_CHANGE),
+        SD_BUS_PROPERTY("Gamma", "u", get_property, 0, SD_BUS_VTABLE_PROPERTY_EMITS_INVALIDATION),
+        SD_BUS_VTABLE_END
+};
+
+static int filter(sd_bus_message *m, void *userdata, sd_bus_error *error) {
+        Context *c = ASSERT_PTR(userdata);
+        const char *interface;
+
+        if (sd_bus_message_is_signal(m, "org.freedesktop.elogind.Test", "Removed")) {
+                assert_se(strv_extend(&c->order, "Removed") >= 0);
+                return 0;
+        }
+
+        if (!sd_bus_message_is_signal(m, "org.freedesktop.DBus.Properties", "PropertiesChanged"))
+                return 0;
+
+        assert_se(strv_extend(&c->order, "PropertiesChanged") >= 0);
+
+        assert_se(streq(sd_bus_message_get_path(m), "/foo"));
+
+        assert_se(sd_bus_message_read(m, "s", &interface) >= 0);
+        assert_se(free_and_strdup(&c->interface, interface) >= 0);
+
+        assert_se(sd_bus_message_enter_container(m, 'a', "{sv}") >= 0);
+        for (;;) {
+                const char *name;
+                uint32_t value;
+                int r;
+
+                r = sd_bus_message_enter_container(m, 'e', "sv");
+                assert_se(r >= 0);
+                if (r == 0)
+                        break;
+
+                assert_se(sd_bus_message_read(m, "s", &name) >= 0);
+                assert_se(sd_bus_message_read(m, "v", "u", &value) >= 0);
+                assert_se(value == 4711);
+                assert_se(strv_extend(&c->changed, name) >= 0);
+
+                assert_se(sd_bus_message_exit_container(m) >= 0);
+        }
+        assert_se(sd_bus_message_exit_container(m) >= 0);
+
+        assert_se(sd_bus_message_read_strv_extend(m, &c->invalidated) >= 0);
+
+        c->n_signals++;
+        return 0;
+}
+
+static void run_until(sd_event *e, bool (*cond)(sd_bus *a, sd_bus *b, Context *c), sd_bus *a, sd_bus *b, Context *c) {
+        usec_t deadline = usec_add(now(CLOCK_MONOTONIC), 5 * USEC_PER_SEC);
+
+        while (!cond(a, b, c)) {
+                assert_se(now(CLOCK_MONOTONIC) < deadline);
+                assert_se(sd_event_run(e, 100 * USEC_PER_MSEC) >= 0);
+        }
+}
+
+static bool both_ready(sd_bus *a, sd_bus *b, Context *c) {
+        return sd_bus_is_ready(a) > 0 && sd_bus_is_ready(b) > 0;
+}
+
+static bool got_signal(sd_bus *a, sd_bus *b, Context *c) {
+        return c->n_signals > 0;
+}
+
+static bool got_removed(sd_bus *a, sd_bus *b, Context *c) {
+        return strv_contains(c->order, "Removed");
+}
+
+/* Spins the loop a few more times, so that a second, unexpected signal would have arrived too */
+static void settle(sd_event *e) {
+        for (unsigned i = 0; i < 10; i++)
+                assert_se(sd_event_run(e, 10 * USEC_PER_MSEC) >= 0);
+}
+
+TEST(properties_changed_deferred) {
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *server = NULL, *client = NULL;
+        _cleanup_(sd_bus_slot_unrefp) sd_bus_slot *slot = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        _cleanup_close_pair_ int pair[2] = EBADF_PAIR;
+        Context c = {};
+        sd_id128_t id;
+
+        assert_se(sd_event_default(&e) >= 0);
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, pair) >= 0);
+        assert_se(sd_id128_randomize(&id) >= 0);
+
+        assert_se(sd_bus_new(&server) >= 0);
+        assert_se(sd_bus_set_fd(server, pair[0], pair[0]) >= 0);
+        TAKE_FD(pair[0]);
+        assert_se(sd_bus_set_server(server, true, id) >= 0);
+        assert_se(sd_bus_add_object_vtable(server, NULL, "/foo", "org.freedesktop.elogind.Test", vtable, NULL) >= 0);
+        assert_se(sd_bus_start(server) >= 0);
+        assert_se(sd_bus_attach_event(server, e, SD_EVENT_PRIORITY_NORMAL) >= 0);
+
+        assert_se(sd_bus_new(&client) >= 0);
+        assert_se(sd_bus_set_fd(client, pair[1], pair[1]) >= 0);
+        TAKE_FD(pair[1]);
+        assert_se(sd_bus_add_filter(client, &slot, filter, &c) >= 0);
+        assert_se(sd_bus_start(client) >= 0);
+        assert_se(sd_bus_attach_event(client, e, SD_EVENT_PRIORITY_NORMAL) >= 0);
+
+        run_until(e, both_ready, server, client, &c);
+
+        assert_se(sd_bus_get_defer_properties_changed(server) == 0);
+        assert_se(sd_bus_set_defer_properties_changed(server, true) >= 0);
+        assert_se(sd_bus_get_defer_properties_changed(server) > 0);
+
+        /* Several changes within one iteration result in a single signal listing each property once */
+        assert_se(sd_bus_emit_properties_changed(server, "/foo", "org.freedesktop.elogind.Test", "Alpha", NULL) >= 0);
+        assert_se(sd_bus_emit_properties_changed(server, "/foo", "org.freedesktop.elogind.Test", "Beta", "Alpha", NULL) >= 0);
+        assert_se(sd_bus_emit_properties_changed(server, "/foo", "org.freedesktop.elogind.Test", "Gamma", NULL) >= 0);
+        assert_se(sd_bus_emit_properties_changed(server, "/foo", "org.freedesktop.elogind.Test", "Alpha", NULL) >= 0);
+
+        run_until(e, got_signal, server, client, &c);
+        settle(e);
+
+        assert_se(c.n_signals == 1);
+        assert_se(streq(c.interface, "org.freedesktop.elogind.Test"));
+        assert_se(strv_equal(c.changed, STRV_MAKE("Alpha", "Beta")));
+        assert_se(strv_equal(c.invalidated, STRV_MAKE("Gamma")));
+        context_done(&c);
+        c.n_signals = 0;
+
+        /* A NULL list swallows everything else */
+        assert_se(sd_bus_emit_properties_changed(server, "/foo", "org.freedesktop.elogind.Test", "Beta", NULL) >= 0);
+        assert_se(sd_bus_emit_properties_changed_strv(server, "/foo", "org.freedesktop.elogind.Test", NULL) >= 0);
+        assert_se(sd_bus_emit_properties_changed(server, "/foo", "org.freedesktop.elogind.Test", "Alpha", NULL) >= 0);
+
+        run_until(e, got_signal, server, client, &c);
+        settle(e);
+
+        assert_se(c.n_signals == 1);
+        assert_se(strv_equal(c.changed, STRV_MAKE("Alpha", "Beta")));
+        assert_se(strv_equal(c.invalidated, STRV_MAKE("Gamma")));
+        context_done(&c);
+        c.n_signals = 0;
+
+        /* Pending changes are sent before another signal of the same object, so that they are not reordered
+         * with it */
+        assert_se(sd_bus_emit_properties_changed(server, "/foo", "org.freedesktop.elogind.Test", "Beta", NULL) >= 0);
+        assert_se(sd_bus_emit_signal(server, "/foo", "org.freedesktop.elogind.Test", "Removed", NULL) >= 0);
+
+        run_until(e, got_removed, server, client, &c);
+        settle(e);
+
+        assert_se(c.n_signals == 1);
+        assert_se(strv_equal(c.order, STRV_MAKE("PropertiesChanged", "Removed")));
+        assert_se(strv_equal(c.changed, STRV_MAKE("Beta")));
+        context_done(&c);
+        c.n_signals = 0;
+
+        /* … but they are left alone by signals of other objects and method calls */
+        assert_se(sd_bus_emit_properties_changed(server, "/foo", "org.freedesktop.elogind.Test", "Beta", NULL) >= 0);
+        assert_se(sd_bus_emit_signal(server, "/", "org.freedesktop.elogind.Test", "Removed", NULL) >= 0);
+        assert_se(sd_bus_call_method_async(server, NULL, NULL, "/", "org.freedesktop.elogind.Test", "Nop", NULL, NULL, NULL) >= 0);
+        assert_se(ordered_hashmap_size(server->deferred_properties_changed) == 1);
+
+        run_until(e, got_signal, server, client, &c);
+        settle(e);
+
+        assert_se(c.n_signals == 1);
+        assert_se(strv_equal(c.order, STRV_MAKE("Removed", "PropertiesChanged")));
+        assert_se(strv_equal(c.changed, STRV_MAKE("Beta")));
+        context_done(&c);
+        c.n_signals = 0;
+
+        /* Unknown objects are only noticed when the signal is generated, and are ignored then */
+        assert_se(sd_bus_emit_properties_changed(server, "/bar", "org.freedesktop.elogind.Test", "Alpha", NULL) >= 0);
+        settle(e);
+        assert_se(c.n_signals == 0);
+
+        /* Turning the mode off sends out whatever is pending right away */
+        assert_se(sd_bus_emit_properties_changed(server, "/foo", "org.freedesktop.elogind.Test", "Beta", NULL) >= 0);
+        assert_se(sd_bus_set_defer_properties_changed(server, false) >= 0);
+        assert_se(sd_bus_emit_properties_changed(server, "/foo", "org.freedesktop.elogind.Test", "Alpha", NULL) >= 0);
+        assert_se(sd_bus_emit_properties_changed(server, "/bar", "org.freedesktop.elogind.Test", "Alpha", NULL) == -ENOENT);
+        assert_se(sd_bus_flush(server) >= 0);
+
+        run_until(e, got_signal, server, client, &c);
+        settle(e);
+
+        assert_se(c.n_signals == 2);
+        assert_se(strv_equal(c.changed, STRV_MAKE("Beta", "Alpha")));
+        assert_se(strv_isempty(c.invalidated));
+        context_done(&c);
+}
+
+DEFINE_TEST_MAIN(LOG_DEBUG);
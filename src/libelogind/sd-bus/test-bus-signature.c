@@ -3,9 +3,41 @@
 #include "bus-internal.h"
 #include "bus-signature.h"
 #include "log.h"
+#include "random-util.h"
 #include "string-util.h"
 #include "tests.h"
 
+static void test_object_path_is_valid_n(void) {
+        char buf[97];
+
+        /* Compare with the NUL terminated version, which checks byte by byte, on random paths of all
+         * lengths up to a few vectors. Mostly valid characters, with slashes and bad ones mixed in. */
+        for (unsigned i = 0; i < 100000; i++) {
+                size_t n = random_u64_range(sizeof(buf));
+
+                for (size_t j = 0; j < n; j++) {
+                        uint64_t k = random_u64_range(100);
+
+                        buf[j] = k < 85 ? "aZ09_"[k % 5] :
+                                 k < 98 ? '/' :
+                                          "-.\377"[k % 3];
+                }
+                buf[n] = 0;
+
+                if (n > 0 && random_u64_range(2) == 0)
+                        buf[0] = '/';
+
+                assert_se(object_path_is_valid_n(buf, n) == object_path_is_valid(buf));
+        }
+
+        assert_se(object_path_is_valid_n("/foo/bar", 8));
+        assert_se(object_path_is_valid_n("/foo/bar", 4));
+        assert_se(!object_path_is_valid_n("/foo/bar", 5));
+        assert_se(!object_path_is_valid_n("/foo\0bar", 8));
+        assert_se(!object_path_is_valid_n("", 0));
+        assert_se(!object_path_is_valid_n(NULL, 0));
+}
+
 int main(int argc, char *argv[]) {
         char prefix[256];
         int r;
@@ -122,6 +154,8 @@ int main(int argc, char *argv[]) {
         assert_se(!object_path_is_valid("/foo//bar"));
         assert_se(!object_path_is_valid("/foo/aaaäöä"));
 
+        test_object_path_is_valid_n();
+
         OBJECT_PATH_FOREACH_PREFIX(prefix, "/") {
                 log_info("<%s>", prefix);
                 assert_not_reached();
@@ -0,0 +1,135 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc-util.h"
+#include "device-arena.h"
+
+#define DEVICE_ARENA_CHUNK_MIN 256U
+#define DEVICE_ARENA_CHUNK_MAX 4096U
+
+struct DeviceArena {
+        DeviceArena *next;  /* older, full chunks */
+        size_t n_chunks;    /* including this one */
+        size_t size, used;
+        char data[];
+};
+
+DeviceArena *device_arena_free(DeviceArena *arena) {
+        while (arena) {
+                DeviceArena *next = arena->next;
+
+                free(arena);
+                arena = next;
+        }
+
+        return NULL;
+}
+
+char *device_arena_strdup(DeviceArena **arena, const char *s) {
+        DeviceArena *a;
+        size_t l;
+        char *p;
+
+        assert(arena);
+        assert(s);
+
+        l = strlen(s) + 1;
+
+        a = *arena;
+        if (!a || a->size - a->used < l) {
+                size_t size;
+
+                /* Devices carry anything between a handful and a few dozen properties. Start small and
+                 * double the chunk size from there, so that tiny devices do not waste memory. */
+                size = a ? MIN(a->size * 2, DEVICE_ARENA_CHUNK_MAX) : DEVICE_ARENA_CHUNK_MIN;
+                size = MAX(size, l);
+
+                a = malloc(offsetof(DeviceArena, data) + size);
+                if (!a)
+                        return NULL;
+
+                *a = (DeviceArena) {
+                        .next = *arena,
+                        .n_chunks = *arena ? (*arena)->n_chunks + 1 : 1,
+                        .size = size,
+                };
+
+                *arena = a;
+        }
+
+        p = memcpy(a->data + a->used, s, l);
+        a->used += l;
+
+        return p;
+}
+
+bool device_arena_contains(DeviceArena *arena, const char *p) {
+        for (; arena; arena = arena->next)
+                if (p >= arena->data && p < arena->data + arena->used)
+                        return true;
+
+        return false;
+}
+
+size_t device_arena_n_chunks(DeviceArena *arena) {
+        return arena ? arena->n_chunks : 0;
+}
+
+size_t device_arena_size(DeviceArena *arena) {
+        size_t n = 0;
+
+        for (; arena; arena = arena->next)
+                n += offsetof(DeviceArena, data) + arena->size;
+
+        return n;
+}
+
+/* Keep this sorted, it is looked up with bsearch(). */
+static const char* const interned_property_keys[] = {
+        "ACTION",
+        "CURRENT_TAGS",
+        "DEVLINKS",
+        "DEVNAME",
+        "DEVPATH",
+        "DEVTYPE",
+        "DRIVER",
+        "ID_BUS",
+        "ID_FOR_SEAT",
+        "ID_INPUT",
+        "ID_INPUT_KEY",
+        "ID_INPUT_KEYBOARD",
+        "ID_INPUT_MOUSE",
+        "ID_MODEL",
+        "ID_MODEL_ID",
+        "ID_PATH",
+        "ID_PATH_TAG",
+        "ID_SEAT",
+        "ID_SERIAL",
+        "ID_VENDOR",
+        "ID_VENDOR_ID",
+        "IFINDEX",
+        "INTERFACE",
+        "MAJOR",
+        "MINOR",
+        "MODALIAS",
+        "PRODUCT",
+        "SEQNUM",
+        "SUBSYSTEM",
+        "TAGS",
+        "USEC_INITIALIZED",
+};
+
+static int interned_key_compare(const void *a, const void *b) {
+        return strcmp(*(const char * const *) a, *(const char * const *) b);
+}
+
+const char *device_property_key_intern(const char *key) {
+        const char * const *k;
+
+        assert(key);
+
+        k = bsearch(&key, interned_property_keys, ELEMENTSOF(interned_property_keys), sizeof(const char*), interned_key_compare);
+        return k ? *k : NULL;
+}
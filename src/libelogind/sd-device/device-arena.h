@@ -0,0 +1,22 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "macro.h"
+
+/* A simple bump allocator for the strings of a single sd_device object. Strings allocated from it cannot
+ * be freed individually, they are all released together when the arena is freed. */
+typedef struct DeviceArena DeviceArena;
+
+DeviceArena *device_arena_free(DeviceArena *arena);
+DEFINE_TRIVIAL_CLEANUP_FUNC(DeviceArena*, device_arena_free);
+
+char *device_arena_strdup(DeviceArena **arena, const char *s);
+bool device_arena_contains(DeviceArena *arena, const char *p);
+size_t device_arena_n_chunks(DeviceArena *arena);
+size_t device_arena_size(DeviceArena *arena);
+
+/* Returns a static copy of well known property names, or NULL if the key is not one of them. */
+const char *device_property_key_intern(const char *key);
@@ -14,6 +14,16 @@ typedef enum MatchInitializedType {
         _MATCH_INITIALIZED_INVALID = -EINVAL,
 } MatchInitializedType;
 
+typedef enum DeviceEnumeratorFlags {
+        /* Store the properties of enumerated devices (and their parents) in a per-device arena with
+         * interned names, rather than allocating every name and value individually. */
+        DEVICE_ENUMERATOR_COMPACT_PROPERTIES = 1 << 0,
+        /* Read the udev db of enumerated devices, but look up only the entries that are asked for, until
+         * something requires the whole db. */
+        DEVICE_ENUMERATOR_LAZY_DB            = 1 << 1,
+} DeviceEnumeratorFlags;
+
+int device_enumerator_new_full(sd_device_enumerator **ret, DeviceEnumeratorFlags flags);
 int device_enumerator_scan_devices(sd_device_enumerator *enumerator);
 int device_enumerator_scan_subsystems(sd_device_enumerator *enumerator);
 #if 0 /// UNNEEDED by elogind
@@ -25,6 +35,7 @@ int device_enumerator_add_parent_devices(sd_device_enumerator *enumerator, sd_de
 int device_enumerator_add_match_is_initialized(sd_device_enumerator *enumerator, MatchInitializedType type);
 #endif // 0
 int device_enumerator_add_match_parent_incremental(sd_device_enumerator *enumerator, sd_device *parent);
+int device_enumerator_set_scan_threads(sd_device_enumerator *enumerator, unsigned n_threads);
 #if 0 /// UNNEEDED by elogind
 int device_enumerator_add_prioritized_subsystem(sd_device_enumerator *enumerator, const char *subsystem);
 sd_device *device_enumerator_get_first(sd_device_enumerator *enumerator);
@@ -1,6 +1,7 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
 #include <fcntl.h>
+#include <pthread.h>
 #include <unistd.h>
 
 #include "sd-device.h"
@@ -8,6 +9,8 @@
 #include "alloc-util.h"
 #include "device-enumerator-private.h"
 #include "device-filter.h"
+#include "device-internal.h"
+#include "device-private.h"
 #include "device-util.h"
 #include "dirent-util.h"
 #include "fd-util.h"
@@ -46,9 +49,16 @@ struct sd_device_enumerator {
         Set *match_tag;
         Set *match_parent;
         MatchInitializedType match_initialized;
+
+        DeviceEnumeratorFlags flags;
+        unsigned n_scan_threads;
 };
 
-_public_ int sd_device_enumerator_new(sd_device_enumerator **ret) {
+/* Upper bound for the number of threads scanning /sys/bus/ and /sys/class/ in parallel. Beyond this, the
+ * scan is limited by sysfs and the kernel rather than by us. */
+#define DEVICE_ENUMERATOR_SCAN_THREADS_MAX 16U
+
+int device_enumerator_new_full(sd_device_enumerator **ret, DeviceEnumeratorFlags flags) {
         _cleanup_(sd_device_enumerator_unrefp) sd_device_enumerator *enumerator = NULL;
 
         assert(ret);
@@ -61,6 +71,8 @@ _public_ int sd_device_enumerator_new(sd_device_enumerator **ret) {
                 .n_ref = 1,
                 .type = _DEVICE_ENUMERATION_TYPE_INVALID,
                 .match_initialized = MATCH_INITIALIZED_COMPAT,
+                .flags = flags,
+                .n_scan_threads = 1,
         };
 
         *ret = TAKE_PTR(enumerator);
@@ -68,6 +80,12 @@ _public_ int sd_device_enumerator_new(sd_device_enumerator **ret) {
         return 0;
 }
 
+_public_ int sd_device_enumerator_new(sd_device_enumerator **ret) {
+        assert_return(ret, -EINVAL);
+
+        return device_enumerator_new_full(ret, 0);
+}
+
 static void device_unref_many(sd_device **devices, size_t n) {
         assert(devices || n == 0);
 
@@ -276,6 +294,21 @@ _public_ int sd_device_enumerator_allow_uninitialized(sd_device_enumerator *enum
         return 1;
 }
 
+int device_enumerator_set_scan_threads(sd_device_enumerator *enumerator, unsigned n_threads) {
+        assert(enumerator);
+
+        /* 0 selects one thread per online CPU, 1 (the default) scans serially in the calling thread. */
+        if (n_threads == 0) {
+                long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+                n_threads = n > 0 ? (unsigned) n : 1;
+        }
+
+        enumerator->n_scan_threads = MIN(n_threads, DEVICE_ENUMERATOR_SCAN_THREADS_MAX);
+
+        return 0;
+}
+
 #if 0 /// UNNEEDED by elogind
 int device_enumerator_add_match_is_initialized(sd_device_enumerator *enumerator, MatchInitializedType type) {
         assert_return(enumerator, -EINVAL);
@@ -457,24 +490,48 @@ failed:
         return r;
 }
 
-int device_enumerator_add_device(sd_device_enumerator *enumerator, sd_device *device) {
+static int enumerator_prepare_device(sd_device_enumerator *enumerator, sd_device *device) {
+        assert(enumerator);
+        assert(device);
+
+        device_set_lazy_db(device, FLAGS_SET(enumerator->flags, DEVICE_ENUMERATOR_LAZY_DB));
+
+        if (FLAGS_SET(enumerator->flags, DEVICE_ENUMERATOR_COMPACT_PROPERTIES))
+                return device_enable_compact_properties(device);
+
+        return 0;
+}
+
+static int devices_by_syspath_add(Hashmap **devices_by_syspath, sd_device *device) {
         const char *syspath;
         int r;
 
-        assert_return(enumerator, -EINVAL);
-        assert_return(device, -EINVAL);
+        assert(devices_by_syspath);
+        assert(device);
 
         r = sd_device_get_syspath(device, &syspath);
         if (r < 0)
                 return r;
 
-        r = hashmap_ensure_put(&enumerator->devices_by_syspath, &string_hash_ops, syspath, device);
+        r = hashmap_ensure_put(devices_by_syspath, &string_hash_ops, syspath, device);
         if (IN_SET(r, -EEXIST, 0))
                 return 0;
         if (r < 0)
                 return r;
 
         sd_device_ref(device);
+        return 1;
+}
+
+int device_enumerator_add_device(sd_device_enumerator *enumerator, sd_device *device) {
+        int r;
+
+        assert_return(enumerator, -EINVAL);
+        assert_return(device, -EINVAL);
+
+        r = devices_by_syspath_add(&enumerator->devices_by_syspath, device);
+        if (r <= 0)
+                return r;
 
         enumerator->sorted = false;
         return 1;
@@ -644,12 +701,14 @@ static int test_matches(
 
 static int enumerator_add_parent_devices(
                 sd_device_enumerator *enumerator,
+                Hashmap **devices_by_syspath,
                 sd_device *device,
                 MatchFlag flags) {
 
         int r;
 
         assert(enumerator);
+        assert(devices_by_syspath);
         assert(device);
 
         for (;;) {
@@ -665,7 +724,7 @@ static int enumerator_add_parent_devices(
                 if (r == 0)
                         continue;
 
-                r = device_enumerator_add_device(enumerator, device);
+                r = devices_by_syspath_add(devices_by_syspath, device);
                 if (r < 0)
                         return r;
                 if (r == 0) /* Exists already? Then no need to go further up. */
@@ -675,7 +734,11 @@ static int enumerator_add_parent_devices(
 
 #if 0 /// UNNEEDED by elogind
 int device_enumerator_add_parent_devices(sd_device_enumerator *enumerator, sd_device *device) {
-        return enumerator_add_parent_devices(enumerator, device, MATCH_ALL & (~MATCH_PARENT));
+        int r;
+
+        r = enumerator_add_parent_devices(enumerator, &enumerator->devices_by_syspath, device, MATCH_ALL & (~MATCH_PARENT));
+        enumerator->sorted = false;
+        return r;
 }
 #endif // 0
 
@@ -692,6 +755,7 @@ static bool relevant_sysfs_subdir(const struct dirent *de) {
 
 static int enumerator_scan_dir_and_add_devices(
                 sd_device_enumerator *enumerator,
+                Hashmap **devices_by_syspath,
                 const char *basedir,
                 const char *subdir1,
                 const char *subdir2) {
@@ -701,6 +765,7 @@ static int enumerator_scan_dir_and_add_devices(
         int k, r = 0;
 
         assert(enumerator);
+        assert(devices_by_syspath);
         assert(basedir);
 
         path = strjoina("/sys/", basedir, "/");
@@ -743,6 +808,12 @@ static int enumerator_scan_dir_and_add_devices(
                         continue;
                 }
 
+                k = enumerator_prepare_device(enumerator, device);
+                if (k < 0) {
+                        r = k;
+                        continue;
+                }
+
                 k = test_matches(enumerator, device, MATCH_ALL & (~MATCH_SYSNAME)); /* sysname is already tested. */
                 if (k <= 0) {
                         if (k < 0)
@@ -750,14 +821,14 @@ static int enumerator_scan_dir_and_add_devices(
                         continue;
                 }
 
-                k = device_enumerator_add_device(enumerator, device);
+                k = devices_by_syspath_add(devices_by_syspath, device);
                 if (k < 0)
                         r = k;
 
                 /* Also include all potentially matching parent devices in the enumeration. These are things
                  * like root busses — e.g. /sys/devices/pci0000:00/ or /sys/devices/pnp0/, which ar not
                  * linked from /sys/class/ or /sys/bus/, hence pick them up explicitly here. */
-                k = enumerator_add_parent_devices(enumerator, device, MATCH_ALL);
+                k = enumerator_add_parent_devices(enumerator, devices_by_syspath, device, MATCH_ALL);
                 if (k < 0)
                         r = k;
         }
@@ -796,7 +867,7 @@ static int enumerator_scan_dir(
                 if (!match_subsystem(enumerator, subsystem ?: de->d_name))
                         continue;
 
-                k = enumerator_scan_dir_and_add_devices(enumerator, basedir, de->d_name, subdir);
+                k = enumerator_scan_dir_and_add_devices(enumerator, &enumerator->devices_by_syspath, basedir, de->d_name, subdir);
                 if (k < 0)
                         r = k;
         }
@@ -804,6 +875,190 @@ static int enumerator_scan_dir(
         return r;
 }
 
+typedef struct ScanDir {
+        const char *basedir;
+        char *subdir1;
+        const char *subdir2;
+} ScanDir;
+
+static void scan_dir_done_many(ScanDir *dirs, size_t n) {
+        assert(dirs || n == 0);
+
+        FOREACH_ARRAY(d, dirs, n)
+                free(d->subdir1);
+
+        free(dirs);
+}
+
+static int enumerator_collect_scan_dirs(
+                sd_device_enumerator *enumerator,
+                const char *basedir,
+                const char *subdir,
+                const char *subsystem,
+                ScanDir **dirs,
+                size_t *n_dirs) {
+
+        _cleanup_closedir_ DIR *dir = NULL;
+        char *path;
+
+        assert(enumerator);
+        assert(basedir);
+        assert(dirs);
+        assert(n_dirs);
+
+        /* Same as enumerator_scan_dir(), but only collects the subsystem directories to scan, so that
+         * they can be sharded across threads. */
+
+        path = strjoina("/sys/", basedir);
+
+        dir = opendir(path);
+        if (!dir) {
+                bool ignore = errno == ENOENT;
+
+                log_debug_errno(errno,
+                                "sd-device-enumerator: Failed to open directory %s%s: %m",
+                                path, ignore ? ", ignoring" : "");
+                return ignore ? 0 : -errno;
+        }
+
+        FOREACH_DIRENT_ALL(de, dir, return -errno) {
+                _cleanup_free_ char *d = NULL;
+
+                if (!relevant_sysfs_subdir(de))
+                        continue;
+
+                if (!match_subsystem(enumerator, subsystem ?: de->d_name))
+                        continue;
+
+                d = strdup(de->d_name);
+                if (!d)
+                        return -ENOMEM;
+
+                if (!GREEDY_REALLOC(*dirs, *n_dirs + 1))
+                        return -ENOMEM;
+
+                (*dirs)[(*n_dirs)++] = (ScanDir) {
+                        .basedir = basedir,
+                        .subdir1 = TAKE_PTR(d),
+                        .subdir2 = subdir,
+                };
+        }
+
+        return 0;
+}
+
+typedef struct ScanWorker {
+        sd_device_enumerator *enumerator;
+        const ScanDir *dirs;
+        size_t n_dirs;
+        size_t *next_dir;
+        Hashmap *devices_by_syspath;
+        pthread_t thread;
+        bool started;
+        int r;
+} ScanWorker;
+
+static void* scan_worker_thread(void *userdata) {
+        ScanWorker *w = ASSERT_PTR(userdata);
+
+        /* Workers pick directories from the shared list one at a time, so that a single huge subsystem
+         * does not leave the other threads idle. Everything found is collected in a per-thread hashmap,
+         * the enumerator itself is only read here. */
+        for (;;) {
+                size_t i;
+                int k;
+
+                i = __atomic_fetch_add(w->next_dir, 1, __ATOMIC_RELAXED);
+                if (i >= w->n_dirs)
+                        break;
+
+                k = enumerator_scan_dir_and_add_devices(
+                                w->enumerator,
+                                &w->devices_by_syspath,
+                                w->dirs[i].basedir,
+                                w->dirs[i].subdir1,
+                                w->dirs[i].subdir2);
+                if (k < 0)
+                        w->r = k;
+        }
+
+        return NULL;
+}
+
+static int enumerator_scan_devices_all_threaded(sd_device_enumerator *enumerator) {
+        ScanDir *dirs = NULL;
+        _cleanup_free_ ScanWorker *workers = NULL;
+        size_t n_dirs = 0, next_dir = 0;
+        unsigned n_workers;
+        int k, r = 0;
+
+        assert(enumerator);
+        assert(enumerator->n_scan_threads > 1);
+
+        CLEANUP_ARRAY(dirs, n_dirs, scan_dir_done_many);
+
+        k = enumerator_collect_scan_dirs(enumerator, "bus", "devices", NULL, &dirs, &n_dirs);
+        if (k < 0)
+                r = log_debug_errno(k, "sd-device-enumerator: Failed to scan /sys/bus: %m");
+
+        k = enumerator_collect_scan_dirs(enumerator, "class", NULL, NULL, &dirs, &n_dirs);
+        if (k < 0)
+                r = log_debug_errno(k, "sd-device-enumerator: Failed to scan /sys/class: %m");
+
+        n_workers = MIN(enumerator->n_scan_threads, MAX(n_dirs, (size_t) 1));
+
+        workers = new0(ScanWorker, n_workers);
+        if (!workers)
+                return -ENOMEM;
+
+        for (unsigned i = 0; i < n_workers; i++) {
+                workers[i] = (ScanWorker) {
+                        .enumerator = enumerator,
+                        .dirs = dirs,
+                        .n_dirs = n_dirs,
+                        .next_dir = &next_dir,
+                };
+
+                /* The calling thread takes part in the scan as worker 0. */
+                if (i == 0)
+                        continue;
+
+                k = pthread_create(&workers[i].thread, NULL, scan_worker_thread, &workers[i]);
+                if (k != 0) {
+                        log_debug_errno(k, "sd-device-enumerator: Failed to start scan thread, continuing with fewer threads: %m");
+                        continue;
+                }
+
+                workers[i].started = true;
+        }
+
+        (void) scan_worker_thread(&workers[0]);
+
+        FOREACH_ARRAY(w, workers, n_workers) {
+                sd_device *device;
+
+                if (w->started)
+                        assert_se(pthread_join(w->thread, NULL) == 0);
+
+                if (w->r < 0)
+                        r = w->r;
+
+                /* Merge the per-thread results. The final order is established by enumerator_sort_devices(),
+                 * hence it does not matter which thread found a device first. */
+                while ((device = hashmap_steal_first(w->devices_by_syspath))) {
+                        k = devices_by_syspath_add(&enumerator->devices_by_syspath, device);
+                        if (k < 0)
+                                r = k;
+
+                        sd_device_unref(device);
+                }
+
+                w->devices_by_syspath = hashmap_free(w->devices_by_syspath);
+        }
+
+        return r;
+}
+
 static int enumerator_scan_devices_tag(sd_device_enumerator *enumerator, const char *tag) {
         _cleanup_closedir_ DIR *dir = NULL;
         char *path;
@@ -842,6 +1097,12 @@ static int enumerator_scan_devices_tag(sd_device_enumerator *enumerator, const c
                         continue;
                 }
 
+                k = enumerator_prepare_device(enumerator, device);
+                if (k < 0) {
+                        r = k;
+                        continue;
+                }
+
                 /* Generated from tag, hence not necessary to check tag again. */
                 k = test_matches(enumerator, device, MATCH_ALL & (~MATCH_TAG));
                 if (k < 0)
@@ -887,6 +1148,10 @@ static int parent_add_child(sd_device_enumerator *enumerator, const char *path,
         else if (r < 0)
                 return r;
 
+        r = enumerator_prepare_device(enumerator, device);
+        if (r < 0)
+                return r;
+
         r = test_matches(enumerator, device, flags);
         if (r <= 0)
                 return r;
@@ -975,6 +1240,9 @@ static int enumerator_scan_devices_children(sd_device_enumerator *enumerator) {
 static int enumerator_scan_devices_all(sd_device_enumerator *enumerator) {
         int k, r = 0;
 
+        if (enumerator->n_scan_threads > 1)
+                return enumerator_scan_devices_all_threaded(enumerator);
+
         k = enumerator_scan_dir(enumerator, "bus", "devices", NULL);
         if (k < 0)
                 r = log_debug_errno(k, "sd-device-enumerator: Failed to scan /sys/bus: %m");
@@ -1011,6 +1279,7 @@ int device_enumerator_scan_devices(sd_device_enumerator *enumerator) {
                         r = k;
         }
 
+        enumerator->sorted = false;
         enumerator->scan_uptodate = true;
         enumerator->type = DEVICE_ENUMERATION_TYPE_DEVICES;
 
@@ -1059,14 +1328,14 @@ int device_enumerator_scan_subsystems(sd_device_enumerator *enumerator) {
 
         /* modules */
         if (match_subsystem(enumerator, "module")) {
-                k = enumerator_scan_dir_and_add_devices(enumerator, "module", NULL, NULL);
+                k = enumerator_scan_dir_and_add_devices(enumerator, &enumerator->devices_by_syspath, "module", NULL, NULL);
                 if (k < 0)
                         r = log_debug_errno(k, "sd-device-enumerator: Failed to scan modules: %m");
         }
 
         /* subsystems (only buses support coldplug) */
         if (match_subsystem(enumerator, "subsystem")) {
-                k = enumerator_scan_dir_and_add_devices(enumerator, "bus", NULL, NULL);
+                k = enumerator_scan_dir_and_add_devices(enumerator, &enumerator->devices_by_syspath, "bus", NULL, NULL);
                 if (k < 0)
                         r = log_debug_errno(k, "sd-device-enumerator: Failed to scan subsystems: %m");
         }
@@ -1078,6 +1347,7 @@ int device_enumerator_scan_subsystems(sd_device_enumerator *enumerator) {
                         r = log_debug_errno(k, "sd-device-enumerator: Failed to scan drivers: %m");
         }
 
+        enumerator->sorted = false;
         enumerator->scan_uptodate = true;
         enumerator->type = DEVICE_ENUMERATION_TYPE_SUBSYSTEMS;
 
@@ -1135,12 +1405,12 @@ int device_enumerator_scan_devices_and_subsystems(sd_device_enumerator *enumerat
                 r = enumerator_scan_devices_all(enumerator);
 
                 if (match_subsystem(enumerator, "module")) {
-                        k = enumerator_scan_dir_and_add_devices(enumerator, "module", NULL, NULL);
+                        k = enumerator_scan_dir_and_add_devices(enumerator, &enumerator->devices_by_syspath, "module", NULL, NULL);
                         if (k < 0)
                                 r = log_debug_errno(k, "sd-device-enumerator: Failed to scan modules: %m");
                 }
                 if (match_subsystem(enumerator, "subsystem")) {
-                        k = enumerator_scan_dir_and_add_devices(enumerator, "bus", NULL, NULL);
+                        k = enumerator_scan_dir_and_add_devices(enumerator, &enumerator->devices_by_syspath, "bus", NULL, NULL);
                         if (k < 0)
                                 r = log_debug_errno(k, "sd-device-enumerator: Failed to scan subsystems: %m");
                 }
@@ -3,6 +3,7 @@
 
 #include "sd-device.h"
 
+#include "device-arena.h"
 #include "device-private.h"
 #include "hashmap.h"
 #include "set.h"
@@ -31,6 +32,15 @@ struct sd_device {
         /* the subset of the properties that should be written to the db */
         OrderedHashmap *properties_db;
 
+        /* In compact mode, property names and values are not allocated individually: well known names are
+         * interned, everything else is allocated from this arena and released with the device. Once a
+         * property was replaced or removed, new strings are allocated on the heap instead, so that devices
+         * that are updated over and over do not grow their arena. */
+        DeviceArena *properties_arena;
+
+        char *db_buf; /* the contents of the udev db, when it is not parsed yet, see device_set_lazy_db() */
+        size_t db_buf_size;
+
         Hashmap *sysattr_values; /* cached sysattr values */
 
         Set *sysattrs; /* names of sysattrs */
@@ -92,13 +102,18 @@ struct sd_device {
         bool driver_set:1; /* don't reread driver */
         bool uevent_loaded:1; /* don't reread uevent */
         bool db_loaded; /* don't reread db */
+        bool db_lazy:1; /* look up single db entries in db_buf rather than loading the whole db */
 
         bool is_initialized:1;
         bool sealed:1; /* don't read more information from uevent/db */
         bool db_persist:1; /* don't clean up the db when switching from initrd to real root */
+        bool compact_properties:1; /* properties are interned or allocated from properties_arena */
+        bool properties_updated:1; /* in compact mode, new strings are no longer allocated from the arena */
 };
 
 int device_new_aux(sd_device **ret);
+int device_enable_compact_properties(sd_device *device);
+size_t device_get_properties_allocations(sd_device *device);
 int device_add_property_aux(sd_device *device, const char *key, const char *value, bool db);
 static inline int device_add_property_internal(sd_device *device, const char *key, const char *value) {
         return device_add_property_aux(device, key, value, false);
@@ -22,3 +22,4 @@ int device_monitor_get_fd(sd_device_monitor *m);
 #endif // 0
 int device_monitor_send_device(sd_device_monitor *m, sd_device_monitor *destination, sd_device *device);
 int device_monitor_receive_device(sd_device_monitor *m, sd_device **ret);
+int device_monitor_receive_devices(sd_device_monitor *m, sd_device ***ret, size_t *ret_n);
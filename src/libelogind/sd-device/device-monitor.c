@@ -5,6 +5,7 @@
 #include <linux/netlink.h>
 #include <linux/sockios.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 #include "sd-device.h"
@@ -39,6 +40,12 @@
 #define log_device_monitor_errno(d, m, r, format, ...)                  \
         log_device_debug_errno(d, r, "sd-device-monitor(%s): " format, strna(m ? m->description : NULL), ##__VA_ARGS__)
 
+typedef struct DeviceMonitorSlot {
+        struct iovec iov;
+        union sockaddr_union snl;
+        CMSG_BUFFER_TYPE(CMSG_SPACE(sizeof(struct ucred))) control;
+} DeviceMonitorSlot;
+
 struct sd_device_monitor {
         unsigned n_ref;
 
@@ -61,9 +68,27 @@ struct sd_device_monitor {
         sd_event_source *event_source;
         char *description;
         sd_device_monitor_handler_t callback;
+        sd_device_monitor_batch_handler_t batch_callback;
         void *userdata;
+
+        size_t batch_size;
+
+        /* Preallocated receive slots for recvmmsg(), see device_monitor_receive_devices() */
+        struct mmsghdr *batch_msgs;
+        DeviceMonitorSlot *batch_slots;
+        uint8_t *batch_buffer;
+        size_t batch_allocated;
 };
 
+#define DEVICE_MONITOR_BATCH_DEFAULT   64U
+#define DEVICE_MONITOR_BATCH_MAX       256U
+
+/* The kernel refuses to queue a netlink message that is larger than the sender's socket send buffer, which is
+ * wmem_default (208 KiB) unless the sender raised it. Hence a slot of this size takes any message of a sender
+ * with default buffers. The buffer is mapped with MAP_NORESERVE, only the pages that messages are actually
+ * written to consume memory. */
+#define DEVICE_MONITOR_BATCH_SLOT_SIZE (256U * 1024U)
+
 #define UDEV_MONITOR_MAGIC                0xfeedcafe
 
 typedef struct monitor_netlink_header {
@@ -251,11 +276,55 @@ _public_ int sd_device_monitor_stop(sd_device_monitor *m) {
         return 0;
 }
 
+static void device_unref_array(sd_device **devices, size_t n) {
+        assert(devices || n == 0);
+
+        FOREACH_ARRAY(d, devices, n)
+                sd_device_unref(*d);
+
+        free(devices);
+}
+
+static int device_monitor_dispatch_batch(sd_device_monitor *m) {
+        sd_device **devices = NULL;
+        size_t n_devices = 0;
+        int r;
+
+        assert(m);
+
+        CLEANUP_ARRAY(devices, n_devices, device_unref_array);
+
+        if (device_monitor_receive_devices(m, &devices, &n_devices) <= 0)
+                return 0;
+
+        if (m->batch_callback)
+                return m->batch_callback(m, devices, n_devices, m->userdata);
+
+        if (!m->callback)
+                return 0;
+
+        FOREACH_ARRAY(d, devices, n_devices) {
+                _unused_ _cleanup_(log_context_unrefp) LogContext *c = NULL;
+
+                if (log_context_enabled())
+                        c = log_context_new_strv_consume(device_make_log_fields(*d));
+
+                r = m->callback(m, *d, m->userdata);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
 static int device_monitor_event_handler(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
         _cleanup_(sd_device_unrefp) sd_device *device = NULL;
         _unused_ _cleanup_(log_context_unrefp) LogContext *c = NULL;
         sd_device_monitor *m = ASSERT_PTR(userdata);
 
+        if (m->batch_size > 1 || m->batch_callback)
+                return device_monitor_dispatch_batch(m);
+
         if (device_monitor_receive_device(m, &device) <= 0)
                 return 0;
 
@@ -268,10 +337,15 @@ static int device_monitor_event_handler(sd_event_source *s, int fd, uint32_t rev
         return 0;
 }
 
-_public_ int sd_device_monitor_start(sd_device_monitor *m, sd_device_monitor_handler_t callback, void *userdata) {
+static int device_monitor_start_internal(
+                sd_device_monitor *m,
+                sd_device_monitor_handler_t callback,
+                sd_device_monitor_batch_handler_t batch_callback,
+                void *userdata) {
+
         int r;
 
-        assert_return(m, -EINVAL);
+        assert(m);
 
         if (!m->event) {
                 r = sd_device_monitor_attach_event(m, NULL);
@@ -284,6 +358,7 @@ _public_ int sd_device_monitor_start(sd_device_monitor *m, sd_device_monitor_han
                 return r;
 
         m->callback = callback;
+        m->batch_callback = batch_callback;
         m->userdata = userdata;
 
         r = sd_event_add_io(m->event, &m->event_source, m->sock, EPOLLIN, device_monitor_event_handler, m);
@@ -295,6 +370,43 @@ _public_ int sd_device_monitor_start(sd_device_monitor *m, sd_device_monitor_han
         return 0;
 }
 
+_public_ int sd_device_monitor_start(sd_device_monitor *m, sd_device_monitor_handler_t callback, void *userdata) {
+        assert_return(m, -EINVAL);
+
+        return device_monitor_start_internal(m, callback, NULL, userdata);
+}
+
+_public_ int sd_device_monitor_start_batch(sd_device_monitor *m, sd_device_monitor_batch_handler_t callback, void *userdata) {
+        assert_return(m, -EINVAL);
+
+        /* Receiving in batches is the whole point here, hence enable it if the caller did not pick a size. */
+        if (m->batch_size <= 1)
+                (void) sd_device_monitor_set_batch_size(m, DEVICE_MONITOR_BATCH_DEFAULT);
+
+        return device_monitor_start_internal(m, NULL, callback, userdata);
+}
+
+_public_ int sd_device_monitor_set_batch_size(sd_device_monitor *m, size_t size) {
+        assert_return(m, -EINVAL);
+        assert_return(size <= DEVICE_MONITOR_BATCH_MAX, -ERANGE);
+
+        /* A batch handler expects to be called with batches, refuse to turn them off underneath it. */
+        if (size <= 1 && m->batch_callback)
+                return -EBUSY;
+
+        m->batch_size = size;
+
+        return 0;
+}
+
+_public_ int sd_device_monitor_get_batch_size(sd_device_monitor *m, size_t *ret) {
+        assert_return(m, -EINVAL);
+        assert_return(ret, -EINVAL);
+
+        *ret = MAX(m->batch_size, 1U);
+        return 0;
+}
+
 _public_ int sd_device_monitor_detach_event(sd_device_monitor *m) {
         assert_return(m, -EINVAL);
 
@@ -384,6 +496,58 @@ int device_monitor_enable_receiving(sd_device_monitor *m) {
         return 0;
 }
 
+static void device_monitor_free_batch(sd_device_monitor *m) {
+        assert(m);
+
+        if (m->batch_buffer)
+                (void) munmap(m->batch_buffer, m->batch_allocated * DEVICE_MONITOR_BATCH_SLOT_SIZE);
+
+        m->batch_buffer = NULL;
+        m->batch_msgs = mfree(m->batch_msgs);
+        m->batch_slots = mfree(m->batch_slots);
+        m->batch_allocated = 0;
+}
+
+static int device_monitor_alloc_batch(sd_device_monitor *m, size_t n) {
+        void *p;
+
+        assert(m);
+        assert(n > 0);
+
+        if (m->batch_allocated == n)
+                return 0;
+
+        device_monitor_free_batch(m);
+
+        m->batch_msgs = new0(struct mmsghdr, n);
+        m->batch_slots = new0(DeviceMonitorSlot, n);
+        if (!m->batch_msgs || !m->batch_slots) {
+                device_monitor_free_batch(m);
+                return -ENOMEM;
+        }
+
+        p = mmap(NULL, n * DEVICE_MONITOR_BATCH_SLOT_SIZE, PROT_READ|PROT_WRITE,
+                 MAP_PRIVATE|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) {
+                device_monitor_free_batch(m);
+                return -errno;
+        }
+
+        m->batch_buffer = p;
+        m->batch_allocated = n;
+
+        for (size_t i = 0; i < n; i++) {
+                m->batch_slots[i].iov = IOVEC_MAKE(m->batch_buffer + i * DEVICE_MONITOR_BATCH_SLOT_SIZE,
+                                                   DEVICE_MONITOR_BATCH_SLOT_SIZE);
+                m->batch_msgs[i].msg_hdr = (struct msghdr) {
+                        .msg_iov = &m->batch_slots[i].iov,
+                        .msg_iovlen = 1,
+                };
+        }
+
+        return 0;
+}
+
 static sd_device_monitor *device_monitor_free(sd_device_monitor *m) {
         assert(m);
 
@@ -397,6 +561,7 @@ static sd_device_monitor *device_monitor_free(sd_device_monitor *m) {
         hashmap_free(m->nomatch_sysattr_filter);
         set_free(m->match_parent_filter);
         set_free(m->nomatch_parent_filter);
+        device_monitor_free_batch(m);
 
         return mfree(m);
 }
@@ -495,81 +660,55 @@ static bool check_sender_uid(sd_device_monitor *m, uid_t uid) {
         return false;
 }
 
-int device_monitor_receive_device(sd_device_monitor *m, sd_device **ret) {
+static int device_monitor_parse_message(
+                sd_device_monitor *m,
+                struct msghdr *smsg,
+                uint8_t *buf,
+                ssize_t n,
+                sd_device **ret) {
+
         _cleanup_(sd_device_unrefp) sd_device *device = NULL;
-        _cleanup_free_ uint8_t *buf_alloc = NULL;
         union {
                 monitor_netlink_header *nlh;
                 char *nulstr;
                 uint8_t *buf;
-        } message;
-        struct iovec iov;
-        CMSG_BUFFER_TYPE(CMSG_SPACE(sizeof(struct ucred))) control;
-        union sockaddr_union snl;
-        struct msghdr smsg = {
-                .msg_iov = &iov,
-                .msg_iovlen = 1,
-                .msg_control = &control,
-                .msg_controllen = sizeof(control),
-                .msg_name = &snl,
-                .msg_namelen = sizeof(snl),
+        } message = {
+                .buf = buf,
         };
+        const union sockaddr_union *snl;
         struct ucred *cred;
         size_t offset;
-        ssize_t n;
         bool is_initialized = false;
         int r;
 
         assert(m);
+        assert(smsg);
+        assert(buf);
         assert(ret);
 
-        n = next_datagram_size_fd(m->sock);
-        if (n < 0) {
-                if (!ERRNO_IS_TRANSIENT(n))
-                        log_monitor_errno(m, n, "Failed to get the received message size: %m");
-                return n;
-        }
-
-        if ((size_t) n < ALLOCA_MAX / sizeof(uint8_t) / 2)
-                message.buf = newa(uint8_t, n);
-        else {
-                buf_alloc = new(uint8_t, n);
-                if (!buf_alloc)
-                        return log_oom_debug();
+        snl = smsg->msg_name;
 
-                message.buf = buf_alloc;
-        }
-
-        iov = IOVEC_MAKE(message.buf, n);
-
-        n = recvmsg(m->sock, &smsg, 0);
-        if (n < 0) {
-                if (!ERRNO_IS_TRANSIENT(errno))
-                        log_monitor_errno(m, errno, "Failed to receive message: %m");
-                return -errno;
-        }
-
-        if (smsg.msg_flags & MSG_TRUNC)
+        if (smsg->msg_flags & MSG_TRUNC)
                 return log_monitor_errno(m, SYNTHETIC_ERRNO(EINVAL), "Received truncated message, ignoring message.");
 
         if (n < 32)
                 return log_monitor_errno(m, SYNTHETIC_ERRNO(EINVAL), "Invalid message length (%zi), ignoring message.", n);
 
-        if (snl.nl.nl_groups == MONITOR_GROUP_NONE) {
+        if (snl->nl.nl_groups == MONITOR_GROUP_NONE) {
                 /* unicast message, check if we trust the sender */
                 if (m->snl_trusted_sender.nl.nl_pid == 0 ||
-                    snl.nl.nl_pid != m->snl_trusted_sender.nl.nl_pid)
+                    snl->nl.nl_pid != m->snl_trusted_sender.nl.nl_pid)
                         return log_monitor_errno(m, SYNTHETIC_ERRNO(EAGAIN),
                                                  "Unicast netlink message ignored.");
 
-        } else if (snl.nl.nl_groups == MONITOR_GROUP_KERNEL) {
-                if (snl.nl.nl_pid > 0)
+        } else if (snl->nl.nl_groups == MONITOR_GROUP_KERNEL) {
+                if (snl->nl.nl_pid > 0)
                         return log_monitor_errno(m, SYNTHETIC_ERRNO(EAGAIN),
                                                  "Multicast kernel netlink message from PID %"PRIu32" ignored.",
-                                                 snl.nl.nl_pid);
+                                                 snl->nl.nl_pid);
         }
 
-        cred = CMSG_FIND_DATA(&smsg, SOL_SOCKET, SCM_CREDENTIALS, struct ucred);
+        cred = CMSG_FIND_DATA(smsg, SOL_SOCKET, SCM_CREDENTIALS, struct ucred);
         if (!cred)
                 return log_monitor_errno(m, SYNTHETIC_ERRNO(EAGAIN),
                                          "No sender credentials received, ignoring message.");
@@ -627,6 +766,142 @@ int device_monitor_receive_device(sd_device_monitor *m, sd_device **ret) {
         return r;
 }
 
+static int device_monitor_receive_message(sd_device_monitor *m, size_t size, sd_device **ret) {
+        _cleanup_free_ uint8_t *buf_alloc = NULL;
+        uint8_t *buf;
+        struct iovec iov;
+        CMSG_BUFFER_TYPE(CMSG_SPACE(sizeof(struct ucred))) control;
+        union sockaddr_union snl;
+        struct msghdr smsg = {
+                .msg_iov = &iov,
+                .msg_iovlen = 1,
+                .msg_control = &control,
+                .msg_controllen = sizeof(control),
+                .msg_name = &snl,
+                .msg_namelen = sizeof(snl),
+        };
+        ssize_t n;
+
+        assert(m);
+        assert(ret);
+
+        if (size < ALLOCA_MAX / sizeof(uint8_t) / 2)
+                buf = newa(uint8_t, size);
+        else {
+                buf_alloc = new(uint8_t, size);
+                if (!buf_alloc)
+                        return log_oom_debug();
+
+                buf = buf_alloc;
+        }
+
+        iov = IOVEC_MAKE(buf, size);
+
+        n = recvmsg(m->sock, &smsg, 0);
+        if (n < 0) {
+                if (!ERRNO_IS_TRANSIENT(errno))
+                        log_monitor_errno(m, errno, "Failed to receive message: %m");
+                return -errno;
+        }
+
+        return device_monitor_parse_message(m, &smsg, buf, n, ret);
+}
+
+int device_monitor_receive_device(sd_device_monitor *m, sd_device **ret) {
+        ssize_t n;
+
+        assert(m);
+        assert(ret);
+
+        n = next_datagram_size_fd(m->sock);
+        if (n < 0) {
+                if (!ERRNO_IS_TRANSIENT(n))
+                        log_monitor_errno(m, n, "Failed to get the received message size: %m");
+                return n;
+        }
+
+        return device_monitor_receive_message(m, n, ret);
+}
+
+int device_monitor_receive_devices(sd_device_monitor *m, sd_device ***ret, size_t *ret_n) {
+        sd_device **devices = NULL;
+        size_t n_devices = 0, batch_size;
+        ssize_t n;
+        int k, r;
+
+        assert(m);
+        assert(ret);
+        assert(ret_n);
+
+        CLEANUP_ARRAY(devices, n_devices, device_unref_array);
+
+        batch_size = MAX(m->batch_size, 1U);
+
+        devices = new(sd_device*, batch_size);
+        if (!devices)
+                return log_oom_debug();
+
+        /* recvmmsg() consumes a datagram that does not fit into its slot and only reports it as truncated
+         * afterwards. The slots are large enough for any message a sender with default socket buffers can
+         * send, and the size of the message at the head of the queue is checked beforehand, so that an
+         * even larger one is received on its own into a buffer of the right size instead. */
+        n = next_datagram_size_fd(m->sock);
+        if (n < 0) {
+                if (!ERRNO_IS_TRANSIENT(n))
+                        log_monitor_errno(m, n, "Failed to get the received message size: %m");
+                return n;
+        }
+        if ((size_t) n > DEVICE_MONITOR_BATCH_SLOT_SIZE) {
+                r = device_monitor_receive_message(m, n, &devices[0]);
+                if (r <= 0)
+                        return r;
+
+                *ret = TAKE_PTR(devices);
+                *ret_n = 1;
+                return 1;
+        }
+
+        r = device_monitor_alloc_batch(m, batch_size);
+        if (r < 0)
+                return log_monitor_errno(m, r, "Failed to allocate receive buffers: %m");
+
+        for (size_t i = 0; i < batch_size; i++) {
+                /* The kernel updates these on each call, reset them to the full size of the slot. */
+                m->batch_msgs[i].msg_hdr.msg_name = &m->batch_slots[i].snl;
+                m->batch_msgs[i].msg_hdr.msg_namelen = sizeof(m->batch_slots[i].snl);
+                m->batch_msgs[i].msg_hdr.msg_control = &m->batch_slots[i].control;
+                m->batch_msgs[i].msg_hdr.msg_controllen = sizeof(m->batch_slots[i].control);
+                m->batch_msgs[i].msg_hdr.msg_flags = 0;
+        }
+
+        k = recvmmsg(m->sock, m->batch_msgs, batch_size, MSG_DONTWAIT, NULL);
+        if (k < 0) {
+                if (!ERRNO_IS_TRANSIENT(errno))
+                        log_monitor_errno(m, errno, "Failed to receive messages: %m");
+                return -errno;
+        }
+
+        for (int i = 0; i < k; i++) {
+                _cleanup_(sd_device_unrefp) sd_device *device = NULL;
+
+                /* Filtering is still done per device, a message that fails to parse only drops itself. */
+                if (device_monitor_parse_message(m, &m->batch_msgs[i].msg_hdr, m->batch_slots[i].iov.iov_base,
+                                                 m->batch_msgs[i].msg_len, &device) <= 0)
+                        continue;
+
+                devices[n_devices++] = TAKE_PTR(device);
+        }
+
+        log_monitor(m, "Received %i messages in one batch, %zu devices passed the filter.", k, n_devices);
+
+        if (n_devices == 0)
+                return 0;
+
+        *ret = TAKE_PTR(devices);
+        *ret_n = n_devices;
+        return 1;
+}
+
 static uint32_t string_hash32(const char *str) {
         return MurmurHash2(str, strlen(str), 0);
 }
@@ -81,6 +81,7 @@ int device_delete_db(sd_device *device);
 #endif // 0
 int device_read_db_internal_filename(sd_device *device, const char *filename); /* For fuzzer */
 int device_read_db_internal(sd_device *device, bool force);
+void device_set_lazy_db(sd_device *device, bool b);
 static inline int device_read_db(sd_device *device) {
         return device_read_db_internal(device, false);
 }
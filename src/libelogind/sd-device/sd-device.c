@@ -55,6 +55,36 @@ int device_new_aux(sd_device **ret) {
         return 0;
 }
 
+static bool device_property_string_is_allocated(sd_device *device, const char *s) {
+        assert(device);
+        assert(s);
+
+        /* In compact mode, a string is either an interned name, allocated from the arena, or was added
+         * after a property was updated and is allocated on its own. */
+        return !device_arena_contains(device->properties_arena, s) && device_property_key_intern(s) != s;
+}
+
+static void device_free_property_string(sd_device *device, const char *s) {
+        assert(device);
+
+        if (s && device_property_string_is_allocated(device, s))
+                free((char*) s);
+}
+
+static void device_free_compact_properties(sd_device *device, OrderedHashmap *properties) {
+        const char *key, *value;
+
+        assert(device);
+
+        if (!device->compact_properties || !device->properties_updated)
+                return;
+
+        ORDERED_HASHMAP_FOREACH_KEY(value, key, properties) {
+                device_free_property_string(device, key);
+                device_free_property_string(device, value);
+        }
+}
+
 static sd_device *device_free(sd_device *device) {
         assert(device);
 
@@ -70,8 +100,12 @@ static sd_device *device_free(sd_device *device) {
         free(device->properties_strv);
         free(device->properties_nulstr);
 
+        device_free_compact_properties(device, device->properties);
+        device_free_compact_properties(device, device->properties_db);
         ordered_hashmap_free(device->properties);
         ordered_hashmap_free(device->properties_db);
+        device_arena_free(device->properties_arena);
+        free(device->db_buf);
         hashmap_free(device->sysattr_values);
         set_free(device->sysattrs);
         set_free(device->all_tags);
@@ -84,6 +118,68 @@ static sd_device *device_free(sd_device *device) {
 
 DEFINE_PUBLIC_TRIVIAL_REF_UNREF_FUNC(sd_device, sd_device, device_free);
 
+static int device_add_property_compact(sd_device *device, OrderedHashmap **properties, const char *key, const char *value) {
+        _cleanup_free_ char *allocated_key = NULL, *allocated_value = NULL;
+        const char *old_value, *new_key, *new_value;
+        char *old_key = NULL;
+        int r;
+
+        assert(device);
+        assert(properties);
+        assert(key);
+
+        if (!value) {
+                old_value = ordered_hashmap_remove2(*properties, key, (void**) &old_key);
+                if (!old_value)
+                        return 0;
+
+                device->properties_updated = true;
+                device_free_property_string(device, old_key);
+                device_free_property_string(device, old_value);
+                return 0;
+        }
+
+        r = ordered_hashmap_ensure_allocated(properties, &string_hash_ops);
+        if (r < 0)
+                return r;
+
+        old_value = ordered_hashmap_get2(*properties, key, (void**) &old_key);
+        if (streq_ptr(old_value, value))
+                return 0;
+
+        /* Strings in the arena cannot be freed, hence only fill it while the device is populated. Once
+         * something is replaced, the device is being updated, which may happen any number of times. */
+        if (old_value)
+                device->properties_updated = true;
+
+        new_key = old_key ?: device_property_key_intern(key);
+        if (!new_key) {
+                if (device->properties_updated)
+                        new_key = allocated_key = strdup(key);
+                else
+                        new_key = device_arena_strdup(&device->properties_arena, key);
+                if (!new_key)
+                        return -ENOMEM;
+        }
+
+        if (device->properties_updated)
+                new_value = allocated_value = strdup(value);
+        else
+                new_value = device_arena_strdup(&device->properties_arena, value);
+        if (!new_value)
+                return -ENOMEM;
+
+        r = ordered_hashmap_replace(*properties, (char*) new_key, (char*) new_value);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(allocated_key);
+        TAKE_PTR(allocated_value);
+        device_free_property_string(device, old_value);
+
+        return 0;
+}
+
 int device_add_property_aux(sd_device *device, const char *key, const char *value, bool db) {
         OrderedHashmap **properties;
 
@@ -95,7 +191,14 @@ int device_add_property_aux(sd_device *device, const char *key, const char *valu
         else
                 properties = &device->properties;
 
-        if (value) {
+        if (device->compact_properties) {
+                int r;
+
+                r = device_add_property_compact(device, properties, key, value);
+                if (r < 0)
+                        return r;
+
+        } else if (value) {
                 _unused_ _cleanup_free_ char *old_value = NULL;
                 _cleanup_free_ char *new_key = NULL, *new_value = NULL, *old_key = NULL;
                 int r;
@@ -136,6 +239,78 @@ int device_add_property_aux(sd_device *device, const char *key, const char *valu
         return 0;
 }
 
+static int device_compact_properties_one(sd_device *device, OrderedHashmap *properties, OrderedHashmap **ret) {
+        _cleanup_ordered_hashmap_free_ OrderedHashmap *compact = NULL;
+        const char *key, *value;
+        int r;
+
+        assert(device);
+        assert(ret);
+
+        ORDERED_HASHMAP_FOREACH_KEY(value, key, properties) {
+                r = device_add_property_compact(device, &compact, key, value);
+                if (r < 0)
+                        return r;
+        }
+
+        *ret = TAKE_PTR(compact);
+        return 0;
+}
+
+int device_enable_compact_properties(sd_device *device) {
+        _cleanup_ordered_hashmap_free_ OrderedHashmap *properties = NULL, *properties_db = NULL;
+        int r;
+
+        assert(device);
+
+        if (device->compact_properties)
+                return 0;
+
+        /* Move the properties that were already added into the arena. The new hashmaps are built first, so
+         * that the device stays untouched on failure. */
+        r = device_compact_properties_one(device, device->properties, &properties);
+        if (r < 0)
+                return r;
+
+        r = device_compact_properties_one(device, device->properties_db, &properties_db);
+        if (r < 0)
+                return r;
+
+        free_and_replace_full(device->properties, properties, ordered_hashmap_free);
+        free_and_replace_full(device->properties_db, properties_db, ordered_hashmap_free);
+
+        device->compact_properties = true;
+        device->properties_generation++;
+        device->properties_buf_outdated = true;
+
+        return 1;
+}
+
+size_t device_get_properties_allocations(sd_device *device) {
+        assert(device);
+
+        /* Only meant for tests, hence this is derived from the current state rather than counted as
+         * properties are added. Strings that were replaced in the meantime are not accounted for. */
+        if (device->compact_properties) {
+                size_t n = device_arena_n_chunks(device->properties_arena);
+                const char *key, *value;
+
+                if (device->properties_updated) {
+                        ORDERED_HASHMAP_FOREACH_KEY(value, key, device->properties)
+                                n += device_property_string_is_allocated(device, key) +
+                                        device_property_string_is_allocated(device, value);
+                        ORDERED_HASHMAP_FOREACH_KEY(value, key, device->properties_db)
+                                n += device_property_string_is_allocated(device, key) +
+                                        device_property_string_is_allocated(device, value);
+                }
+
+                return n;
+        }
+
+        /* Every name and every value is allocated on its own. */
+        return 2 * (ordered_hashmap_size(device->properties) + ordered_hashmap_size(device->properties_db));
+}
+
 int device_set_syspath(sd_device *device, const char *_syspath, bool verify) {
         _cleanup_free_ char *syspath = NULL;
         const char *devpath;
@@ -1093,6 +1268,16 @@ _public_ int sd_device_get_parent(sd_device *child, sd_device **ret) {
                 if (r < 0 && r != -ENODEV)
                         return r;
 
+                /* Parents of compact devices are compact, too, they usually come from the same enumeration. */
+                if (child->parent && child->compact_properties) {
+                        r = device_enable_compact_properties(child->parent);
+                        if (r < 0)
+                                return r;
+                }
+
+                if (child->parent)
+                        device_set_lazy_db(child->parent, child->db_lazy);
+
                 child->parent_set = true;
         }
 
@@ -1701,10 +1886,8 @@ int device_get_device_id(sd_device *device, const char **ret) {
         return 0;
 }
 
-int device_read_db_internal_filename(sd_device *device, const char *filename) {
-        _cleanup_free_ char *db = NULL;
+static int device_parse_db(sd_device *device, char *db, size_t db_len) {
         const char *value;
-        size_t db_len;
         char key = '\0';  /* Unnecessary initialization to appease gcc-12.0.0-0.4.fc36 */
         int r;
 
@@ -1717,15 +1900,7 @@ int device_read_db_internal_filename(sd_device *device, const char *filename) {
         } state = PRE_KEY;
 
         assert(device);
-        assert(filename);
-
-        r = read_full_file(filename, &db, &db_len);
-        if (r < 0) {
-                if (r == -ENOENT)
-                        return 0;
-
-                return log_device_debug_errno(device, r, "sd-device: Failed to read db '%s': %m", filename);
-        }
+        assert(db || db_len == 0);
 
         /* devices with a database entry are initialized */
         device->is_initialized = true;
@@ -1784,6 +1959,235 @@ int device_read_db_internal_filename(sd_device *device, const char *filename) {
         return 0;
 }
 
+int device_read_db_internal_filename(sd_device *device, const char *filename) {
+        _cleanup_free_ char *db = NULL;
+        size_t db_len;
+        int r;
+
+        assert(device);
+        assert(filename);
+
+        r = read_full_file(filename, &db, &db_len);
+        if (r < 0) {
+                if (r == -ENOENT)
+                        return 0;
+
+                return log_device_debug_errno(device, r, "sd-device: Failed to read db '%s': %m", filename);
+        }
+
+        return device_parse_db(device, db, db_len);
+}
+
+void device_set_lazy_db(sd_device *device, bool b) {
+        assert(device);
+
+        device->db_lazy = b;
+}
+
+static bool device_db_is_lazy(sd_device *device) {
+        assert(device);
+
+        /* Same conditions as in device_read_db_internal(): sealed devices never read the db. */
+        return device->db_lazy && !device->db_loaded && !device->sealed;
+}
+
+static int device_read_db_buffer(sd_device *device) {
+        _cleanup_free_ char *buf = NULL;
+        const char *id, *path;
+        size_t size;
+        int r;
+
+        assert(device);
+        assert(device_db_is_lazy(device));
+
+        /* Reads the db file of the device without parsing it. Returns > 0 if the db was read, 0 if the
+         * device has no db entry, and -EAGAIN if the db had to be loaded the classic way (empty file). The
+         * buffer is kept until the whole db is needed, and then parsed in place. */
+
+        if (device->db_buf)
+                return 1;
+
+        r = device_get_device_id(device, &id);
+        if (r < 0)
+                return r;
+
+        path = strjoina("/run/udev/data/", id);
+
+        r = read_full_file(path, &buf, &size);
+        if (r == -ENOENT)
+                return 0;
+        if (r < 0)
+                return log_device_debug_errno(device, r, "sd-device: Failed to read db '%s': %m", path);
+
+        if (size == 0) {
+                /* Nothing to look up, there is nothing to parse either. */
+                r = device_parse_db(device, NULL, 0);
+                return r < 0 ? r : -EAGAIN;
+        }
+
+        device->db_buf = TAKE_PTR(buf);
+        device->db_buf_size = size;
+        device->is_initialized = true;
+
+        return 1;
+}
+
+static int device_find_db_entry(
+                sd_device *device,
+                char key,
+                const char *match,
+                char match_separator,
+                const char **ret_value,
+                size_t *ret_len) {
+
+        const char *p, *end, *found = NULL;
+        size_t match_len, found_len = 0;
+
+        assert(device);
+        assert(device->db_buf);
+
+        /* Looks up an entry in the db buffer without parsing anything else. If 'match' is specified, the
+         * value must be equal to it. If 'match_separator' is specified as well, the value must start with
+         * 'match' followed by the separator instead, and only what follows the separator is returned. The
+         * value of the last matching entry is returned, as later entries override earlier ones when the
+         * db is parsed. */
+
+        match_len = strlen_ptr(match);
+
+        p = device->db_buf;
+        end = p + device->db_buf_size;
+
+        while (p < end) {
+                const char *eol, *value;
+                size_t len;
+
+                eol = memchr(p, '\n', end - p) ?: end;
+
+                if (eol - p >= 2 && p[0] == key && p[1] == ':') {
+                        value = p + 2;
+                        len = eol - value;
+
+                        if (!match) {
+                                found = value;
+                                found_len = len;
+                        } else if (match_separator == '\0') {
+                                if (len == match_len && memcmp(value, match, match_len) == 0) {
+                                        found = value;
+                                        found_len = len;
+                                }
+                        } else if (len > match_len &&
+                                   value[match_len] == match_separator &&
+                                   memcmp(value, match, match_len) == 0) {
+                                found = value + match_len + 1;
+                                found_len = len - match_len - 1;
+                        }
+                }
+
+                p = eol + 1;
+        }
+
+        if (!found)
+                return 0;
+
+        if (ret_value)
+                *ret_value = found;
+        if (ret_len)
+                *ret_len = found_len;
+        return 1;
+}
+
+static int device_get_db_property_lazy(sd_device *device, const char *key, const char **ret_value) {
+        _cleanup_free_ char *v = NULL;
+        const char *value;
+        size_t len;
+        int r;
+
+        assert(device);
+        assert(key);
+        assert(ret_value);
+
+        /* Returns 1 and the value if the property is found in the db, 0 if not, and -EAGAIN if the
+         * property cannot be resolved lazily. */
+
+        /* These are derived from other db entries, and the uevent file must be consulted as well, since
+         * db entries override the properties read from there. */
+        if (STR_IN_SET(key, "DEVLINKS", "TAGS", "CURRENT_TAGS", "USEC_INITIALIZED"))
+                return -EAGAIN;
+
+        r = device_read_db_buffer(device);
+        if (r <= 0)
+                return r;
+
+        r = device_find_db_entry(device, 'E', key, '=', &value, &len);
+        if (r <= 0)
+                return r;
+
+        /* An empty value removes the property, let the classic path deal with that. */
+        if (len == 0)
+                return -EAGAIN;
+
+        v = strndup(value, len);
+        if (!v)
+                return -ENOMEM;
+
+        /* Store the property like handle_db_line() would do, so that the returned string has the
+         * lifetime of the device. */
+        r = device_add_property_aux(device, key, v, false);
+        if (r < 0)
+                return r;
+
+        r = device_add_property_aux(device, key, v, true);
+        if (r < 0)
+                return r;
+
+        value = ordered_hashmap_get(device->properties, key);
+        if (!value)
+                return 0;
+
+        *ret_value = value;
+        return 1;
+}
+
+static int device_has_db_tag_lazy(sd_device *device, const char *tag, bool current) {
+        const char *value;
+        unsigned version = 0;
+        int r;
+
+        assert(device);
+        assert(tag);
+
+        /* Returns > 0 if the tag is set, 0 if not, and -EAGAIN if this cannot be determined lazily. */
+
+        r = device_read_db_buffer(device);
+        if (r <= 0)
+                return r;
+
+        if (current) {
+                _cleanup_free_ char *v = NULL;
+                size_t len;
+
+                r = device_find_db_entry(device, 'V', NULL, '\0', &value, &len);
+                if (r > 0) {
+                        v = strndup(value, len);
+                        if (!v)
+                                return -ENOMEM;
+
+                        if (safe_atou(v, &version) < 0)
+                                return -EAGAIN;
+                }
+
+                /* See device_database_supports_current_tags(). */
+                if (version < 1)
+                        current = false;
+        }
+
+        r = device_find_db_entry(device, 'Q', tag, '\0', NULL, NULL);
+        if (r != 0 || current)
+                return r;
+
+        return device_find_db_entry(device, 'G', tag, '\0', NULL, NULL);
+}
+
 int device_read_db_internal(sd_device *device, bool force) {
         const char *id, *path;
         int r;
@@ -1793,6 +2197,13 @@ int device_read_db_internal(sd_device *device, bool force) {
         if (device->db_loaded || (!force && device->sealed))
                 return 0;
 
+        if (device->db_buf) {
+                _cleanup_free_ char *db = TAKE_PTR(device->db_buf);
+
+                /* The db was already read for lazy lookups, parse everything from that buffer. */
+                return device_parse_db(device, db, TAKE_GENERIC(device->db_buf_size, size_t, 0));
+        }
+
         r = device_get_device_id(device, &id);
         if (r < 0)
                 return r;
@@ -1807,6 +2218,13 @@ _public_ int sd_device_get_is_initialized(sd_device *device) {
 
         assert_return(device, -EINVAL);
 
+        if (device_db_is_lazy(device)) {
+                /* Reading the db is enough to know whether the device is initialized. */
+                r = device_read_db_buffer(device);
+                if (r >= 0 || r == -EAGAIN)
+                        return device->is_initialized;
+        }
+
         r = device_read_db(device);
         if (r == -ENOENT)
                 /* The device may be already removed or renamed. */
@@ -2189,6 +2607,14 @@ _public_ int sd_device_has_tag(sd_device *device, const char *tag) {
         assert_return(device, -EINVAL);
         assert_return(tag, -EINVAL);
 
+        if (device_db_is_lazy(device)) {
+                int r;
+
+                r = device_has_db_tag_lazy(device, tag, /* current = */ false);
+                if (r >= 0)
+                        return r;
+        }
+
         (void) device_read_db(device);
 
         return set_contains(device->all_tags, tag);
@@ -2198,6 +2624,14 @@ _public_ int sd_device_has_current_tag(sd_device *device, const char *tag) {
         assert_return(device, -EINVAL);
         assert_return(tag, -EINVAL);
 
+        if (device_db_is_lazy(device)) {
+                int r;
+
+                r = device_has_db_tag_lazy(device, tag, /* current = */ true);
+                if (r >= 0)
+                        return r;
+        }
+
         if (!device_database_supports_current_tags(device))
                 return sd_device_has_tag(device, tag);
 
@@ -2213,11 +2647,30 @@ _public_ int sd_device_get_property_value(sd_device *device, const char *key, co
         assert_return(device, -EINVAL);
         assert_return(key, -EINVAL);
 
-        r = device_properties_prepare(device);
-        if (r < 0)
-                return r;
+        if (device_db_is_lazy(device)) {
+                /* Read the uevent file first, so that the db entries override its properties, as they do
+                 * in device_properties_prepare(). */
+                r = device_read_uevent_file(device);
+                if (r < 0)
+                        return r;
+
+                r = device_get_db_property_lazy(device, key, &value);
+                if (r < 0 && r != -EAGAIN)
+                        return r;
+                if (r == 0)
+                        /* Not in the db, hence only the uevent file may provide it. */
+                        value = ordered_hashmap_get(device->properties, key);
+        } else
+                r = -EAGAIN;
+
+        if (r == -EAGAIN) {
+                r = device_properties_prepare(device);
+                if (r < 0)
+                        return r;
+
+                value = ordered_hashmap_get(device->properties, key);
+        }
 
-        value = ordered_hashmap_get(device->properties, key);
         if (!value)
                 return -ENOENT;
 
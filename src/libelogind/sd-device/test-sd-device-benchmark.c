@@ -0,0 +1,54 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <stdio.h>
+
+#include "sd-device.h"
+
+#include "device-enumerator-private.h"
+#include "device-util.h"
+#include "parse-util.h"
+#include "tests.h"
+#include "time-util.h"
+
+static unsigned arg_iterations = 10;
+
+static usec_t enumerate(unsigned n_threads, size_t *ret_n_devices) {
+        usec_t t, total = 0;
+        size_t n = 0;
+
+        for (unsigned i = 0; i < arg_iterations; i++) {
+                _cleanup_(sd_device_enumerator_unrefp) sd_device_enumerator *e = NULL;
+
+                assert_se(sd_device_enumerator_new(&e) >= 0);
+                assert_se(device_enumerator_set_scan_threads(e, n_threads) >= 0);
+                assert_se(sd_device_enumerator_allow_uninitialized(e) >= 0);
+
+                n = 0;
+                t = now(CLOCK_MONOTONIC);
+                FOREACH_DEVICE(e, d)
+                        n++;
+                total += now(CLOCK_MONOTONIC) - t;
+        }
+
+        *ret_n_devices = n;
+        return total / arg_iterations;
+}
+
+int main(int argc, char *argv[]) {
+        test_setup_logging(LOG_INFO);
+
+        if (argc > 1)
+                assert_se(safe_atou(argv[1], &arg_iterations) >= 0 && arg_iterations > 0);
+
+        printf("THREADS\tDEVICES\tUSEC\n");
+
+        for (unsigned n_threads = 1; n_threads <= 16; n_threads *= 2) {
+                size_t n_devices;
+                usec_t t;
+
+                t = enumerate(n_threads, &n_devices);
+                printf("%u\t%zu\t"USEC_FMT"\n", n_threads, n_devices, t);
+        }
+
+        return 0;
+}
@@ -6,10 +6,12 @@
 #include "sd-device.h"
 #include "sd-event.h"
 
+#include "alloc-util.h"
 #include "device-monitor-private.h"
 #include "device-private.h"
 #include "device-util.h"
 #include "macro.h"
+#include "memory-util.h"
 #include "path-util.h"
 #include "stat-util.h"
 #include "string-util.h"
@@ -86,6 +88,64 @@ static void test_send_receive_one(sd_device *device, bool subsystem_filter, bool
         assert_se(sd_event_loop(sd_device_monitor_get_event(monitor_client)) == 100);
 }
 
+static int monitor_batch_handler(sd_device_monitor *m, sd_device **devices, size_t n_devices, void *userdata) {
+        const char *s, *syspath = userdata;
+
+        /* All devices were queued before the event loop ran, hence they must arrive in one batch. */
+        assert_se(n_devices == 8);
+
+        FOREACH_ARRAY(d, devices, n_devices) {
+                assert_se(sd_device_get_syspath(*d, &s) >= 0);
+                assert_se(streq(s, syspath));
+                assert_se((sd_device_get_property_value(*d, "LARGE_PROPERTY", &s) >= 0) == (d == devices + 3));
+        }
+
+        return sd_event_exit(sd_device_monitor_get_event(m), 100);
+}
+
+static void test_send_receive_batch(sd_device *device) {
+        _cleanup_(sd_device_monitor_unrefp) sd_device_monitor *monitor_server = NULL, *monitor_client = NULL;
+        _cleanup_(sd_device_unrefp) sd_device *large = NULL;
+        _cleanup_free_ char *value = NULL;
+        const char *syspath;
+        size_t batch_size;
+
+        log_device_info(device, "/* %s */", __func__);
+
+        assert_se(sd_device_get_syspath(device, &syspath) >= 0);
+
+        /* A message that is larger than any of its neighbours in the queue must not get lost. */
+        assert_se(sd_device_new_from_syspath(&large, syspath) >= 0);
+        assert_se(value = new(char, 64 * 1024 + 1));
+        *((char*) mempset(value, 'x', 64 * 1024)) = '\0';
+        assert_se(device_add_property(large, "LARGE_PROPERTY", value) >= 0);
+        assert_se(device_add_property(large, "ACTION", "add") >= 0);
+        assert_se(device_add_property(large, "SEQNUM", "10") >= 0);
+
+        assert_se(device_monitor_new_full(&monitor_server, MONITOR_GROUP_NONE, -1) >= 0);
+        assert_se(sd_device_monitor_set_description(monitor_server, "sender") >= 0);
+        assert_se(sd_device_monitor_start(monitor_server, NULL, NULL) >= 0);
+
+        assert_se(device_monitor_new_full(&monitor_client, MONITOR_GROUP_NONE, -1) >= 0);
+        assert_se(sd_device_monitor_set_description(monitor_client, "receiver") >= 0);
+        assert_se(device_monitor_allow_unicast_sender(monitor_client, monitor_server) >= 0);
+        assert_se(sd_device_monitor_set_batch_size(monitor_client, 16) >= 0);
+        assert_se(sd_device_monitor_get_batch_size(monitor_client, &batch_size) >= 0);
+        assert_se(batch_size == 16);
+        assert_se(sd_device_monitor_start_batch(monitor_client, monitor_batch_handler, (void *) syspath) >= 0);
+
+        /* The batch handler must not silently stop being called. */
+        assert_se(sd_device_monitor_set_batch_size(monitor_client, 1) == -EBUSY);
+        assert_se(sd_device_monitor_set_batch_size(monitor_client, 0) == -EBUSY);
+        assert_se(sd_device_monitor_get_batch_size(monitor_client, &batch_size) >= 0);
+        assert_se(batch_size == 16);
+
+        for (unsigned i = 0; i < 8; i++)
+                assert_se(device_monitor_send_device(monitor_server, monitor_client, i == 3 ? large : device) >= 0);
+
+        assert_se(sd_event_loop(sd_device_monitor_get_event(monitor_client)) == 100);
+}
+
 static void test_subsystem_filter(sd_device *device) {
         _cleanup_(sd_device_monitor_unrefp) sd_device_monitor *monitor_server = NULL, *monitor_client = NULL;
         _cleanup_(sd_device_enumerator_unrefp) sd_device_enumerator *e = NULL;
@@ -316,6 +376,8 @@ int main(int argc, char *argv[]) {
         test_send_receive_one(loopback, false,  true,  true);
         test_send_receive_one(loopback,  true,  true,  true);
 
+        test_send_receive_batch(loopback);
+
         test_subsystem_filter(loopback);
         test_tag_filter(loopback);
         test_sysattr_filter(loopback, "ifindex");
@@ -9,11 +9,17 @@
 #include "device-private.h"
 #include "device-util.h"
 #include "errno-util.h"
+#include "fileio.h"
+#include "format-util.h"
 #include "fd-util.h"
 #include "hashmap.h"
+#include "mallinfo-util.h"
+#include "memory-util.h"
 #include "nulstr-util.h"
 #include "path-util.h"
 #include "rm-rf.h"
+#include "stdio-util.h"
+#include "strv.h"
 //#include "stat-util.h"
 #include "string-util.h"
 #include "tests.h"
@@ -208,6 +214,258 @@ TEST(sd_device_enumerator_devices) {
                 test_sd_device_one(d);
 }
 
+static char **enumerate_syspaths(unsigned n_threads) {
+        _cleanup_(sd_device_enumerator_unrefp) sd_device_enumerator *e = NULL;
+        _cleanup_strv_free_ char **l = NULL;
+
+        assert_se(sd_device_enumerator_new(&e) >= 0);
+        assert_se(device_enumerator_set_scan_threads(e, n_threads) >= 0);
+        assert_se(sd_device_enumerator_allow_uninitialized(e) >= 0);
+        /* See comments in TEST(sd_device_enumerator_devices). */
+        assert_se(sd_device_enumerator_add_match_subsystem(e, "bdi", false) >= 0);
+        assert_se(sd_device_enumerator_add_nomatch_sysname(e, "loop*") >= 0);
+        assert_se(sd_device_enumerator_add_match_subsystem(e, "net", false) >= 0);
+
+        FOREACH_DEVICE(e, d) {
+                const char *syspath;
+
+                assert_se(sd_device_get_syspath(d, &syspath) >= 0);
+                assert_se(strv_extend(&l, syspath) >= 0);
+        }
+
+        return TAKE_PTR(l);
+}
+
+TEST(sd_device_enumerator_scan_threads) {
+        _cleanup_strv_free_ char **serial = NULL, **threaded = NULL, **automatic = NULL;
+
+        /* The threaded scan must yield exactly the same devices in exactly the same order. */
+        serial = enumerate_syspaths(1);
+        threaded = enumerate_syspaths(4);
+        automatic = enumerate_syspaths(0);
+
+        log_info("Enumerated %zu devices.", strv_length(serial));
+
+        assert_se(strv_equal(serial, threaded));
+        assert_se(strv_equal(serial, automatic));
+}
+
+static size_t get_rss(void) {
+        _cleanup_free_ char *line = NULL;
+        size_t size, resident;
+
+        assert_se(read_one_line_file("/proc/self/statm", &line) >= 0);
+        assert_se(sscanf(line, "%zu %zu", &size, &resident) == 2);
+
+        return resident * page_size();
+}
+
+static void enumerate_properties(
+                DeviceEnumeratorFlags flags,
+                char ***ret_properties,
+                size_t *ret_allocations,
+                size_t *ret_heap,
+                size_t *ret_rss) {
+
+        _cleanup_(sd_device_enumerator_unrefp) sd_device_enumerator *e = NULL;
+        _cleanup_strv_free_ char **l = NULL;
+        generic_mallinfo before, after;
+        size_t n_allocations = 0, rss;
+
+        /* Collect the output first, so that the strv does not skew the numbers below. */
+        assert_se(device_enumerator_new_full(&e, flags) >= 0);
+        assert_se(sd_device_enumerator_allow_uninitialized(e) >= 0);
+        /* See comments in TEST(sd_device_enumerator_devices). */
+        assert_se(sd_device_enumerator_add_match_subsystem(e, "bdi", false) >= 0);
+        assert_se(sd_device_enumerator_add_nomatch_sysname(e, "loop*") >= 0);
+        assert_se(sd_device_enumerator_add_match_subsystem(e, "net", false) >= 0);
+
+        FOREACH_DEVICE(e, d)
+                FOREACH_DEVICE_PROPERTY(d, key, value)
+                        assert_se(strv_extendf(&l, "%s=%s", key, value) >= 0);
+
+        e = sd_device_enumerator_unref(e);
+
+        rss = get_rss();
+        before = generic_mallinfo_get();
+
+        assert_se(device_enumerator_new_full(&e, flags) >= 0);
+        assert_se(sd_device_enumerator_allow_uninitialized(e) >= 0);
+        assert_se(sd_device_enumerator_add_match_subsystem(e, "bdi", false) >= 0);
+        assert_se(sd_device_enumerator_add_nomatch_sysname(e, "loop*") >= 0);
+        assert_se(sd_device_enumerator_add_match_subsystem(e, "net", false) >= 0);
+
+        FOREACH_DEVICE(e, d) {
+                FOREACH_DEVICE_PROPERTY(d, key, value)
+                        ;
+
+                n_allocations += device_get_properties_allocations(d);
+        }
+
+        after = generic_mallinfo_get();
+
+        *ret_properties = TAKE_PTR(l);
+        *ret_allocations = n_allocations;
+        *ret_heap = LESS_BY((size_t) after.uordblks, (size_t) before.uordblks);
+        *ret_rss = LESS_BY(get_rss(), rss);
+}
+
+TEST(sd_device_enumerator_compact_properties) {
+        _cleanup_strv_free_ char **classic = NULL, **compact = NULL;
+        size_t classic_allocations, compact_allocations, classic_heap, compact_heap, classic_rss, compact_rss;
+
+        enumerate_properties(0, &classic, &classic_allocations, &classic_heap, &classic_rss);
+        enumerate_properties(DEVICE_ENUMERATOR_COMPACT_PROPERTIES, &compact, &compact_allocations, &compact_heap, &compact_rss);
+
+        log_info("classic: %zu properties, %zu allocations, %s heap, %s RSS",
+                 strv_length(classic), classic_allocations, FORMAT_BYTES(classic_heap), FORMAT_BYTES(classic_rss));
+        log_info("compact: %zu properties, %zu allocations, %s heap, %s RSS",
+                 strv_length(compact), compact_allocations, FORMAT_BYTES(compact_heap), FORMAT_BYTES(compact_rss));
+
+        /* Devices may come and go while we enumerate, hence only compare the contents if nothing changed. */
+        if (strv_length(classic) == strv_length(compact))
+                assert_se(strv_equal(classic, compact));
+
+        if (classic_allocations > 0)
+                assert_se(compact_allocations < classic_allocations);
+}
+
+TEST(sd_device_compact_properties_update) {
+        _cleanup_(sd_device_unrefp) sd_device *d = NULL;
+        const char *value;
+        size_t n_chunks;
+
+        assert_se(device_new_aux(&d) >= 0);
+        d->sealed = true; /* nothing to read from sysfs or the db */
+
+        assert_se(device_add_property(d, "ID_SEAT", "seat0") >= 0);
+        assert_se(device_add_property(d, "FOO", "bar") >= 0);
+        assert_se(device_enable_compact_properties(d) > 0);
+        assert_se(device_add_property(d, "BAR", "baz") >= 0);
+        assert_se(!d->properties_updated);
+
+        n_chunks = device_arena_n_chunks(d->properties_arena);
+        assert_se(n_chunks > 0);
+
+        /* Replacing values over and over again must not grow the arena */
+        for (unsigned i = 0; i < 1000; i++) {
+                char buf[DECIMAL_STR_MAX(unsigned)];
+
+                xsprintf(buf, "%u", i);
+                assert_se(device_add_property(d, "FOO", buf) >= 0);
+                assert_se(device_add_property(d, "NEW", buf) >= 0);
+                assert_se(device_add_property(d, i % 2 == 0 ? "NEW" : "BAR", NULL) >= 0);
+        }
+
+        assert_se(d->properties_updated);
+        assert_se(device_arena_n_chunks(d->properties_arena) == n_chunks);
+
+        assert_se(sd_device_get_property_value(d, "ID_SEAT", &value) >= 0);
+        assert_se(streq(value, "seat0"));
+        assert_se(sd_device_get_property_value(d, "FOO", &value) >= 0);
+        assert_se(streq(value, "999"));
+        assert_se(sd_device_get_property_value(d, "NEW", &value) >= 0);
+        assert_se(streq(value, "999"));
+        assert_se(sd_device_get_property_value(d, "BAR", &value) == -ENOENT);
+
+        /* The strings of the initial population stay in the arena. The value of FOO, and the name and value
+         * of NEW are allocated, once for the properties and once for the db. */
+        assert_se(device_get_properties_allocations(d) == n_chunks + 2 * 3);
+}
+
+static void test_lazy_db_one(sd_device *d) {
+        _cleanup_(sd_device_unrefp) sd_device *lazy = NULL;
+        const char *syspath, *seat, *lazy_seat;
+        int r;
+
+        assert_se(sd_device_get_syspath(d, &syspath) >= 0);
+
+        r = sd_device_new_from_syspath(&lazy, syspath);
+        if (ERRNO_IS_NEG_DEVICE_ABSENT(r))
+                return;
+        assert_se(r >= 0);
+
+        device_set_lazy_db(lazy, true);
+
+        assert_se(sd_device_get_is_initialized(lazy) == sd_device_get_is_initialized(d));
+
+        FOREACH_DEVICE_TAG(d, tag)
+                assert_se(sd_device_has_tag(lazy, tag) > 0);
+        FOREACH_DEVICE_CURRENT_TAG(d, tag)
+                assert_se(sd_device_has_current_tag(lazy, tag) > 0);
+        assert_se(sd_device_has_tag(lazy, "no-such-tag") == 0);
+        assert_se(sd_device_has_current_tag(lazy, "no-such-tag") == 0);
+
+        r = sd_device_get_property_value(d, "ID_SEAT", &seat);
+        assert_se(IN_SET(r, 0, -ENOENT));
+        assert_se(sd_device_get_property_value(lazy, "ID_SEAT", &lazy_seat) == r);
+        if (r >= 0)
+                assert_se(streq(seat, lazy_seat));
+
+        /* None of the above requires loading the whole db. */
+        assert_se(!lazy->db_loaded);
+
+        FOREACH_DEVICE_PROPERTY(d, key, value) {
+                const char *v;
+
+                assert_se(sd_device_get_property_value(lazy, key, &v) >= 0);
+                assert_se(streq(value, v));
+        }
+}
+
+TEST(sd_device_lazy_db_buffer) {
+        _cleanup_(sd_device_unrefp) sd_device *d = NULL;
+        const char *value;
+
+        assert_se(device_new_aux(&d) >= 0);
+        device_set_lazy_db(d, true);
+        d->uevent_loaded = true; /* nothing to read from sysfs */
+
+        /* As if read from /run/udev/data/, names that are prefixes of each other must not be confused */
+        assert_se(d->db_buf = strdup("E:ID_SEATX=foo\n"
+                                     "E:ID_SEAT=seat1\n"
+                                     "E:ID=bar\n"
+                                     "E:ID_SEAT=seat2\n"
+                                     "G:seat\n"
+                                     "Q:seat\n"
+                                     "V:1"));
+        d->db_buf_size = strlen(d->db_buf);
+
+        assert_se(sd_device_get_property_value(d, "ID_SEAT", &value) >= 0);
+        assert_se(streq(value, "seat2"));
+        assert_se(sd_device_get_property_value(d, "ID", &value) >= 0);
+        assert_se(streq(value, "bar"));
+        assert_se(sd_device_get_property_value(d, "ID_SEATX", &value) >= 0);
+        assert_se(streq(value, "foo"));
+        assert_se(sd_device_get_property_value(d, "ID_SEA", &value) == -ENOENT);
+
+        assert_se(sd_device_has_tag(d, "seat") > 0);
+        assert_se(sd_device_has_tag(d, "sea") == 0);
+        assert_se(sd_device_has_current_tag(d, "seat") > 0);
+        assert_se(!d->db_loaded);
+
+        /* Everything else parses the buffer as a whole */
+        assert_se(device_read_db(d) >= 0);
+        assert_se(d->db_loaded);
+        assert_se(!d->db_buf);
+        assert_se(sd_device_get_property_value(d, "ID_SEAT", &value) >= 0);
+        assert_se(streq(value, "seat2"));
+}
+
+TEST(sd_device_lazy_db) {
+        _cleanup_(sd_device_enumerator_unrefp) sd_device_enumerator *e = NULL;
+
+        assert_se(sd_device_enumerator_new(&e) >= 0);
+        assert_se(sd_device_enumerator_allow_uninitialized(e) >= 0);
+        /* See comments in TEST(sd_device_enumerator_devices). */
+        assert_se(sd_device_enumerator_add_match_subsystem(e, "bdi", false) >= 0);
+        assert_se(sd_device_enumerator_add_nomatch_sysname(e, "loop*") >= 0);
+        assert_se(sd_device_enumerator_add_match_subsystem(e, "net", false) >= 0);
+
+        FOREACH_DEVICE(e, d)
+                test_lazy_db_one(d);
+}
+
 TEST(sd_device_enumerator_subsystems) {
         _cleanup_(sd_device_enumerator_unrefp) sd_device_enumerator *e = NULL;
 
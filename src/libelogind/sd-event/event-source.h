@@ -1,6 +1,7 @@
 #pragma once
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
+#include <pthread.h>
 #include <sys/epoll.h>
 #include <sys/timerfd.h>
 #include <sys/wait.h>
@@ -28,6 +29,7 @@ typedef enum EventSourceType {
         SOURCE_WATCHDOG,
         SOURCE_INOTIFY,
         SOURCE_MEMORY_PRESSURE,
+        SOURCE_WORK,
         _SOURCE_EVENT_SOURCE_TYPE_MAX,
         _SOURCE_EVENT_SOURCE_TYPE_INVALID = -EINVAL,
 } EventSourceType;
@@ -40,11 +42,14 @@ typedef enum WakeupType {
         WAKEUP_CLOCK_DATA,
         WAKEUP_SIGNAL_DATA,
         WAKEUP_INOTIFY_DATA,
+        WAKEUP_WORK_DATA,
         _WAKEUP_TYPE_MAX,
         _WAKEUP_TYPE_INVALID = -EINVAL,
 } WakeupType;
 
 struct inode_data;
+struct work_data;
+struct work_item;
 
 struct sd_event_source {
         WakeupType wakeup;
@@ -141,6 +146,13 @@ struct sd_event_source {
                         bool locked:1;
                         bool in_write_list:1;
                 } memory_pressure;
+                struct {
+                        sd_event_work_handler_t work;
+                        sd_event_completion_handler_t callback;
+                        struct work_data *work_data;
+                        struct work_item *item; /* The submitted work, if any. Protected by the work_data mutex. */
+                        int result;
+                } work;
         };
 };
 
@@ -237,3 +249,55 @@ struct inotify_data {
          * to make it efficient to figure out what inotify objects to process data on next. */
         LIST_FIELDS(struct inotify_data, buffered);
 };
+
+typedef enum WorkItemState {
+        WORK_ITEM_WAITING,   /* Without work function, waiting for sd_event_post_completion() */
+        WORK_ITEM_QUEUED,    /* Waiting for a worker thread to pick it up */
+        WORK_ITEM_RUNNING,   /* The work function is being run by a worker thread */
+        WORK_ITEM_COMPLETED, /* The result is waiting for the event loop to pick it up */
+} WorkItemState;
+
+/* One submission of a work event source. This is kept separate from the event source, since a worker thread
+ * might still be running the work function when the event source is disabled or freed. If it is freed, the
+ * item is orphaned: its result is dropped, and the destroy callback of the event source, if any, is invoked
+ * only once the work function returned. If it is only disabled, the item is cancelled: it stays with the
+ * event source, so that the work is not submitted again before the running function returned, but its
+ * result is dropped. */
+struct work_item {
+        WorkItemState state;
+        sd_event_source *source; /* NULL if orphaned */
+        bool cancelled;
+        sd_event_work_handler_t work;
+        void *userdata;
+        sd_event_destroy_t destroy_callback;
+        int64_t priority;
+        uint64_t seqnum;
+        unsigned queued_index;
+        int result;
+
+        LIST_FIELDS(struct work_item, completed);
+};
+
+#define WORK_THREADS_MAX 4U
+
+/* The worker threads of an event loop, created on first use. Completions are signalled to the event loop
+ * through an eventfd. */
+struct work_data {
+        WakeupType wakeup;
+        int fd;
+
+        pthread_mutex_t mutex;
+        pthread_cond_t cond;
+
+        /* Everything below is protected by the mutex */
+
+        /* Queued work ordered by priority, and completed work waiting for the event loop */
+        Prioq *queued;
+        uint64_t seqnum;
+        LIST_HEAD(struct work_item, completed);
+
+        pthread_t threads[WORK_THREADS_MAX];
+        unsigned n_threads;
+        unsigned n_idle;
+        bool shutdown;
+};
@@ -1,6 +1,8 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
+#include <pthread.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/timerfd.h>
 #include <sys/wait.h>
 
@@ -74,6 +76,7 @@ static const char* const event_source_type_table[_SOURCE_EVENT_SOURCE_TYPE_MAX]
         [SOURCE_WATCHDOG]            = "watchdog",
         [SOURCE_INOTIFY]             = "inotify",
         [SOURCE_MEMORY_PRESSURE]     = "memory-pressure",
+        [SOURCE_WORK]                = "work",
 };
 
 DEFINE_PRIVATE_STRING_TABLE_LOOKUP_TO_STRING(event_source_type, int);
@@ -145,6 +148,9 @@ struct sd_event {
         /* A list of memory pressure event sources that still need their subscription string written */
         LIST_HEAD(sd_event_source, memory_pressure_write_list);
 
+        /* The worker threads for work event sources */
+        struct work_data *work_data;
+
         uint64_t origin_id;
 
         uint64_t iteration;
@@ -181,6 +187,8 @@ static thread_local sd_event *default_event = NULL;
 
 static void source_disconnect(sd_event_source *s);
 static void event_gc_inode_data(sd_event *e, struct inode_data *d);
+static void event_shutdown_work_data(sd_event *e);
+static void event_free_work_data(sd_event *e);
 
 static sd_event *event_resolve(sd_event *e) {
         return e == SD_EVENT_DEFAULT ? default_event : e;
@@ -346,6 +354,9 @@ static sd_event *event_free(sd_event *e) {
         e->sigterm_event_source = sd_event_source_unref(e->sigterm_event_source);
         e->sigint_event_source = sd_event_source_unref(e->sigint_event_source);
 
+        /* Let the worker threads finish before the event sources they work for go away */
+        event_shutdown_work_data(e);
+
         while ((s = e->sources)) {
                 assert(s->floating);
                 source_disconnect(s);
@@ -354,6 +365,8 @@ static sd_event *event_free(sd_event *e) {
 
         assert(e->n_sources == 0);
 
+        event_free_work_data(e);
+
         if (e->default_event_ptr)
                 *(e->default_event_ptr) = NULL;
 
@@ -615,6 +628,365 @@ static void source_memory_pressure_remove_from_write_list(sd_event_source *s) {
         s->memory_pressure.in_write_list = false;
 }
 
+static int work_item_compare(const void *a, const void *b) {
+        const struct work_item *x = a, *y = b;
+        int r;
+
+        /* Lower priority values first, and first come first serve within the same priority */
+        r = CMP(x->priority, y->priority);
+        if (r != 0)
+                return r;
+
+        return CMP(x->seqnum, y->seqnum);
+}
+
+static void work_data_complete_locked(struct work_data *d, struct work_item *w) {
+        bool was_empty;
+
+        assert(d);
+        assert(w);
+
+        if (!w->source && !w->destroy_callback) {
+                /* Orphaned, and nothing for the event loop to do about it */
+                free(w);
+                return;
+        }
+
+        /* The event loop is only woken up for the first completion, it picks up all of them at once */
+        was_empty = !d->completed;
+        w->state = WORK_ITEM_COMPLETED;
+        LIST_PREPEND(completed, d->completed, w);
+
+        if (was_empty)
+                (void) eventfd_write(d->fd, 1);
+}
+
+static void* work_thread(void *p) {
+        struct work_data *d = ASSERT_PTR(p);
+
+        (void) pthread_setname_np(pthread_self(), "sd-event-work");
+
+        assert_se(pthread_mutex_lock(&d->mutex) == 0);
+
+        for (;;) {
+                struct work_item *w;
+                int r;
+
+                while (prioq_isempty(d->queued) && !d->shutdown) {
+                        d->n_idle++;
+                        assert_se(pthread_cond_wait(&d->cond, &d->mutex) == 0);
+                        d->n_idle--;
+                }
+
+                if (d->shutdown)
+                        break;
+
+                w = prioq_pop(d->queued);
+                w->state = WORK_ITEM_RUNNING;
+
+                assert_se(pthread_mutex_unlock(&d->mutex) == 0);
+                r = w->work(w->userdata);
+                assert_se(pthread_mutex_lock(&d->mutex) == 0);
+
+                w->result = r;
+                work_data_complete_locked(d, w);
+        }
+
+        assert_se(pthread_mutex_unlock(&d->mutex) == 0);
+        return NULL;
+}
+
+static int work_data_start_thread_locked(struct work_data *d) {
+        sigset_t ss, saved_ss;
+        int r, k;
+
+        assert(d);
+        assert(d->n_threads < WORK_THREADS_MAX);
+
+        /* No signals in the worker threads please, they are all meant for the thread running the event
+         * loop. We set the mask before creating the thread, so that it never runs with anything else. */
+        if (sigfillset(&ss) < 0)
+                return -errno;
+
+        r = pthread_sigmask(SIG_BLOCK, &ss, &saved_ss);
+        if (r > 0)
+                return -r;
+
+        r = pthread_create(d->threads + d->n_threads, NULL, work_thread, d);
+
+        k = pthread_sigmask(SIG_SETMASK, &saved_ss, NULL);
+        if (r > 0)
+                return -r;
+
+        d->n_threads++;
+
+        if (k > 0)
+                return -k;
+
+        return 0;
+}
+
+static int event_make_work_data(sd_event *e, struct work_data **ret) {
+        _cleanup_close_ int fd = -EBADF;
+        struct work_data *d;
+        int r;
+
+        assert(e);
+        assert(ret);
+
+        if (e->work_data) {
+                *ret = e->work_data;
+                return 0;
+        }
+
+        fd = eventfd(0, EFD_CLOEXEC|EFD_NONBLOCK);
+        if (fd < 0)
+                return -errno;
+
+        fd = fd_move_above_stdio(fd);
+
+        d = new(struct work_data, 1);
+        if (!d)
+                return -ENOMEM;
+
+        *d = (struct work_data) {
+                .wakeup = WAKEUP_WORK_DATA,
+                .fd = TAKE_FD(fd),
+                .mutex = PTHREAD_MUTEX_INITIALIZER,
+                .cond = PTHREAD_COND_INITIALIZER,
+        };
+
+        d->queued = prioq_new(work_item_compare);
+        if (!d->queued) {
+                safe_close(d->fd);
+                free(d);
+                return -ENOMEM;
+        }
+
+        if (epoll_ctl(e->epoll_fd, EPOLL_CTL_ADD, d->fd, &(struct epoll_event) { .events = EPOLLIN, .data.ptr = d }) < 0) {
+                r = -errno;
+                prioq_free(d->queued);
+                safe_close(d->fd);
+                free(d);
+                return r;
+        }
+
+        *ret = e->work_data = d;
+        return 1;
+}
+
+static void event_shutdown_work_data(sd_event *e) {
+        struct work_data *d;
+
+        assert(e);
+
+        d = e->work_data;
+        if (!d)
+                return;
+
+        /* Wait for work functions that are still running. Anything still queued is dropped. */
+        assert_se(pthread_mutex_lock(&d->mutex) == 0);
+        d->shutdown = true;
+        assert_se(pthread_cond_broadcast(&d->cond) == 0);
+        assert_se(pthread_mutex_unlock(&d->mutex) == 0);
+
+        for (unsigned i = 0; i < d->n_threads; i++)
+                (void) pthread_join(d->threads[i], NULL);
+
+        d->n_threads = 0;
+}
+
+static void event_free_work_data(sd_event *e) {
+        struct work_data *d;
+        struct work_item *w;
+
+        assert(e);
+
+        d = TAKE_PTR(e->work_data);
+        if (!d)
+                return;
+
+        assert(d->n_threads == 0);
+        assert(prioq_isempty(d->queued));
+
+        /* Orphaned items whose work function returned after the last iteration of the event loop */
+        while ((w = d->completed)) {
+                LIST_REMOVE(completed, d->completed, w);
+
+                assert(!w->source);
+                if (w->destroy_callback)
+                        w->destroy_callback(w->userdata);
+
+                free(w);
+        }
+
+        prioq_free(d->queued);
+        safe_close(d->fd);
+        (void) pthread_mutex_destroy(&d->mutex);
+        (void) pthread_cond_destroy(&d->cond);
+        free(d);
+}
+
+static int source_work_submit(sd_event_source *s) {
+        struct work_data *d;
+        struct work_item *w;
+        int r = 0;
+
+        assert(s);
+        assert(s->type == SOURCE_WORK);
+        assert(s->work.work_data);
+
+        if (s->work.item)
+                return 0;
+
+        d = s->work.work_data;
+
+        w = new(struct work_item, 1);
+        if (!w)
+                return -ENOMEM;
+
+        *w = (struct work_item) {
+                .state = s->work.work ? WORK_ITEM_QUEUED : WORK_ITEM_WAITING,
+                .source = s,
+                .work = s->work.work,
+                .userdata = s->userdata,
+                .priority = s->priority,
+                .queued_index = PRIOQ_IDX_NULL,
+        };
+
+        assert_se(pthread_mutex_lock(&d->mutex) == 0);
+
+        if (w->state == WORK_ITEM_QUEUED) {
+                /* Start another thread if all existing ones are busy */
+                if (prioq_size(d->queued) >= d->n_idle && d->n_threads < WORK_THREADS_MAX) {
+                        r = work_data_start_thread_locked(d);
+                        if (r < 0 && d->n_threads > 0) {
+                                log_debug_errno(r, "Failed to start worker thread, continuing with %u threads: %m", d->n_threads);
+                                r = 0;
+                        }
+                }
+
+                if (r >= 0) {
+                        w->seqnum = d->seqnum++;
+
+                        r = prioq_put(d->queued, w, &w->queued_index);
+                        if (r >= 0 && d->n_idle > 0)
+                                assert_se(pthread_cond_signal(&d->cond) == 0);
+                }
+        }
+
+        if (r >= 0)
+                s->work.item = w;
+
+        assert_se(pthread_mutex_unlock(&d->mutex) == 0);
+
+        if (r < 0)
+                free(w);
+
+        return r;
+}
+
+static void source_work_cancel(sd_event_source *s, bool orphan_destroy_callback) {
+        struct work_data *d;
+        struct work_item *w;
+
+        assert(s);
+        assert(s->type == SOURCE_WORK);
+
+        if (!s->work.item)
+                return;
+
+        d = ASSERT_PTR(s->work.work_data);
+
+        assert_se(pthread_mutex_lock(&d->mutex) == 0);
+
+        w = TAKE_PTR(s->work.item);
+
+        switch (w->state) {
+
+        case WORK_ITEM_QUEUED:
+                assert_se(prioq_remove(d->queued, w, &w->queued_index) > 0);
+                break;
+
+        case WORK_ITEM_COMPLETED:
+                LIST_REMOVE(completed, d->completed, w);
+                break;
+
+        case WORK_ITEM_RUNNING:
+                /* We cannot stop the work function, let the worker thread dispose of the item. Since the
+                 * work function might still use the userdata, leave releasing it to the item, too. */
+                w->source = NULL;
+
+                if (orphan_destroy_callback) {
+                        w->userdata = s->userdata;
+                        w->destroy_callback = TAKE_PTR(s->destroy_callback);
+                }
+
+                w = NULL;
+                break;
+
+        case WORK_ITEM_WAITING:
+                break;
+
+        default:
+                assert_not_reached();
+        }
+
+        assert_se(pthread_mutex_unlock(&d->mutex) == 0);
+
+        free(w);
+}
+
+static void source_work_disable(sd_event_source *s) {
+        struct work_data *d;
+        bool running;
+
+        assert(s);
+        assert(s->type == SOURCE_WORK);
+
+        if (!s->work.item)
+                return;
+
+        d = ASSERT_PTR(s->work.work_data);
+
+        assert_se(pthread_mutex_lock(&d->mutex) == 0);
+
+        /* A running work function cannot be stopped. Keep the item around until it returns, so that
+         * enabling the event source again in the meantime does not run the same work function twice
+         * concurrently. process_work() submits the work again then, if the event source is enabled. */
+        running = s->work.item->state == WORK_ITEM_RUNNING;
+        if (running)
+                s->work.item->cancelled = true;
+
+        assert_se(pthread_mutex_unlock(&d->mutex) == 0);
+
+        if (!running)
+                source_work_cancel(s, /* orphan_destroy_callback= */ false);
+}
+
+static void source_work_reprioritize(sd_event_source *s) {
+        struct work_data *d;
+        struct work_item *w;
+
+        assert(s);
+        assert(s->type == SOURCE_WORK);
+
+        if (!s->work.item)
+                return;
+
+        d = ASSERT_PTR(s->work.work_data);
+
+        assert_se(pthread_mutex_lock(&d->mutex) == 0);
+
+        w = s->work.item;
+        w->priority = s->priority;
+
+        if (w->state == WORK_ITEM_QUEUED)
+                prioq_reshuffle(d->queued, w, &w->queued_index);
+
+        assert_se(pthread_mutex_unlock(&d->mutex) == 0);
+}
+
 static clockid_t event_source_type_to_clock(EventSourceType t) {
 
         switch (t) {
@@ -1043,6 +1415,10 @@ static void source_disconnect(sd_event_source *s) {
                 source_memory_pressure_unregister(s);
                 break;
 
+        case SOURCE_WORK:
+                source_work_cancel(s, /* orphan_destroy_callback= */ false);
+                break;
+
         default:
                 assert_not_reached();
         }
@@ -1070,6 +1446,11 @@ static void source_disconnect(sd_event_source *s) {
 static sd_event_source* source_free(sd_event_source *s) {
         assert(s);
 
+        /* If a worker thread still runs the work function, it might still use the userdata. Hence leave
+         * calling the destroy callback to it. */
+        if (s->type == SOURCE_WORK)
+                source_work_cancel(s, /* orphan_destroy_callback= */ true);
+
         source_disconnect(s);
 
         if (s->type == SOURCE_IO && s->io.owned)
@@ -1194,6 +1575,7 @@ static sd_event_source *source_new(sd_event *e, bool floating, EventSourceType t
                 [SOURCE_EXIT]                = endoffsetof_field(sd_event_source, exit),
                 [SOURCE_INOTIFY]             = endoffsetof_field(sd_event_source, inotify),
                 [SOURCE_MEMORY_PRESSURE]     = endoffsetof_field(sd_event_source, memory_pressure),
+                [SOURCE_WORK]                = endoffsetof_field(sd_event_source, work),
         };
 
         sd_event_source *s;
@@ -2127,6 +2509,80 @@ _public_ int sd_event_add_memory_pressure(
         return 0;
 }
 
+_public_ int sd_event_add_work(
+                sd_event *e,
+                sd_event_source **ret,
+                sd_event_work_handler_t work,
+                sd_event_completion_handler_t callback,
+                void *userdata) {
+
+        _cleanup_(source_freep) sd_event_source *s = NULL;
+        struct work_data *d;
+        int r;
+
+        assert_return(e, -EINVAL);
+        assert_return(e = event_resolve(e), -ENOPKG);
+        assert_return(callback, -EINVAL);
+        assert_return(e->state != SD_EVENT_FINISHED, -ESTALE);
+        assert_return(!event_origin_changed(e), -ECHILD);
+
+        r = event_make_work_data(e, &d);
+        if (r < 0)
+                return r;
+
+        s = source_new(e, !ret, SOURCE_WORK);
+        if (!s)
+                return -ENOMEM;
+
+        s->work.work = work;
+        s->work.callback = callback;
+        s->work.work_data = d;
+        s->userdata = userdata;
+        s->enabled = SD_EVENT_ONESHOT;
+
+        r = source_work_submit(s);
+        if (r < 0)
+                return r;
+
+        if (ret)
+                *ret = s;
+        TAKE_PTR(s);
+
+        return 0;
+}
+
+_public_ int sd_event_post_completion(sd_event_source *s, int result) {
+        struct work_data *d;
+        struct work_item *w;
+        int r;
+
+        /* This may be called from any thread. Hence, this only looks at fields of the event source that
+         * don't change during its lifetime, or are protected by the mutex. */
+
+        assert_return(s, -EINVAL);
+        assert_return(s->type == SOURCE_WORK, -EDOM);
+        assert_return(!s->work.work, -EDOM);
+
+        d = ASSERT_PTR(s->work.work_data);
+
+        assert_se(pthread_mutex_lock(&d->mutex) == 0);
+
+        w = s->work.item;
+        if (!w)
+                r = -ESTALE; /* Disabled, or the completion is already being dispatched */
+        else if (w->state != WORK_ITEM_WAITING)
+                r = -EBUSY;
+        else {
+                w->result = result;
+                work_data_complete_locked(d, w);
+                r = 0;
+        }
+
+        assert_se(pthread_mutex_unlock(&d->mutex) == 0);
+
+        return r;
+}
+
 static void event_free_inotify_data(sd_event *e, struct inotify_data *d) {
         assert(e);
 
@@ -2839,6 +3295,9 @@ _public_ int sd_event_source_set_priority(sd_event_source *s, int64_t priority)
         } else
                 s->priority = priority;
 
+        if (s->type == SOURCE_WORK)
+                source_work_reprioritize(s);
+
         event_source_pp_prioq_reshuffle(s);
 
         if (s->type == SOURCE_EXIT)
@@ -2924,6 +3383,10 @@ static int event_source_offline(
                 source_memory_pressure_unregister(s);
                 break;
 
+        case SOURCE_WORK:
+                source_work_disable(s);
+                break;
+
         case SOURCE_TIME_REALTIME:
         case SOURCE_TIME_BOOTTIME:
         case SOURCE_TIME_MONOTONIC:
@@ -3018,6 +3481,13 @@ static int event_source_online(
 
                 break;
 
+        case SOURCE_WORK:
+                r = source_work_submit(s);
+                if (r < 0)
+                        return r;
+
+                break;
+
         case SOURCE_TIME_REALTIME:
         case SOURCE_TIME_BOOTTIME:
         case SOURCE_TIME_MONOTONIC:
@@ -4115,6 +4585,74 @@ static int source_memory_pressure_initiate_dispatch(sd_event_source *s) {
         return 0; /* go on, dispatch to user callback */
 }
 
+static int process_work(sd_event *e, struct work_data *d, uint32_t revents) {
+        bool something_new = false;
+        eventfd_t value;
+        int r;
+
+        assert(e);
+        assert(d);
+
+        if (revents != EPOLLIN)
+                log_debug("Got unexpected poll event (0x%" PRIx32 ") on work eventfd.", revents);
+
+        /* Reset the eventfd before looking at the list, so that no completion can get lost in between */
+        (void) eventfd_read(d->fd, &value);
+
+        for (;;) {
+                struct work_item *w;
+                sd_event_source *s;
+                bool cancelled;
+
+                assert_se(pthread_mutex_lock(&d->mutex) == 0);
+                w = d->completed;
+                assert_se(pthread_mutex_unlock(&d->mutex) == 0);
+
+                if (!w)
+                        break;
+
+                /* Completed items are only ever touched by the thread running the event loop, hence they
+                 * may be looked at without holding the mutex. */
+                s = w->source;
+                cancelled = w->cancelled;
+
+                if (s && !cancelled) {
+                        s->work.result = w->result;
+
+                        r = source_set_pending(s, true);
+                        if (r < 0) {
+                                /* Leave this and all further completions in place, and make sure we come
+                                 * back for them, as the eventfd was reset already. */
+                                (void) eventfd_write(d->fd, 1);
+                                return r;
+                        }
+
+                        something_new = true;
+                }
+
+                assert_se(pthread_mutex_lock(&d->mutex) == 0);
+                LIST_REMOVE(completed, d->completed, w);
+                if (s)
+                        s->work.item = NULL;
+                assert_se(pthread_mutex_unlock(&d->mutex) == 0);
+
+                if (!s && w->destroy_callback)
+                        w->destroy_callback(w->userdata);
+
+                free(w);
+
+                /* The event source was disabled while its work function was running, and might have been
+                 * enabled again since. Now that the function returned, the work can be submitted again. */
+                if (s && cancelled && s->event && event_source_is_online(s)) {
+                        r = source_work_submit(s);
+                        if (r < 0)
+                                log_debug_errno(r, "Failed to resubmit work of event source %s: %m", strna(s->description));
+                }
+        }
+
+        return something_new;
+}
+
 static int source_dispatch(sd_event_source *s) {
         EventSourceType saved_type;
         sd_event *saved_event;
@@ -4263,6 +4801,17 @@ static int source_dispatch(sd_event_source *s) {
                 r = s->memory_pressure.callback(s, s->userdata);
                 break;
 
+        case SOURCE_WORK:
+                r = s->work.callback(s, s->work.result, s->userdata);
+
+                /* If the event source stays enabled, submit the work again right away */
+                if (r >= 0 && s->n_ref > 0 && s->event && event_source_is_online(s)) {
+                        r = source_work_submit(s);
+                        if (r < 0)
+                                log_debug_errno(r, "Failed to resubmit work of event source %s: %m", strna(s->description));
+                }
+                break;
+
         case SOURCE_WATCHDOG:
         case _SOURCE_EVENT_SOURCE_TYPE_MAX:
         case _SOURCE_EVENT_SOURCE_TYPE_INVALID:
@@ -4671,6 +5220,10 @@ static int process_epoll(sd_event *e, usec_t timeout, int64_t threshold, int64_t
                                 r = event_inotify_data_read(e, e->event_queue[i].data.ptr, e->event_queue[i].events, threshold);
                                 break;
 
+                        case WAKEUP_WORK_DATA:
+                                r = process_work(e, e->event_queue[i].data.ptr, e->event_queue[i].events);
+                                break;
+
                         default:
                                 assert_not_reached();
                         }
@@ -1,5 +1,6 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
+#include <pthread.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
@@ -899,4 +900,178 @@ TEST(leave_ratelimit) {
         assert_se(manually_left_ratelimit);
 }
 
+static unsigned n_work_started = 0, n_work_completed = 0, n_work_destroyed = 0;
+
+static int work_blocking(void *userdata) {
+        int fd = PTR_TO_FD(userdata);
+        char c;
+
+        assert_se(gettid() != getpid());
+
+        __atomic_add_fetch(&n_work_started, 1, __ATOMIC_SEQ_CST);
+
+        /* Block until the main thread writes a byte for us */
+        assert_se(read(fd, &c, 1) == 1);
+
+        return c;
+}
+
+static int work_completed(sd_event_source *s, int result, void *userdata) {
+        assert_se(gettid() == getpid());
+        assert_se(result == 'x');
+
+        n_work_completed++;
+        return 0;
+}
+
+static int work_not_completed(sd_event_source *s, int result, void *userdata) {
+        assert_not_reached();
+}
+
+static void work_destroy(void *userdata) {
+        assert_se(gettid() == getpid());
+
+        n_work_destroyed++;
+}
+
+static void work_run_until(sd_event *e, const unsigned *counter, unsigned n) {
+        usec_t deadline = usec_add(now(CLOCK_MONOTONIC), 10 * USEC_PER_SEC);
+
+        while (__atomic_load_n(counter, __ATOMIC_SEQ_CST) < n) {
+                assert_se(now(CLOCK_MONOTONIC) < deadline);
+                assert_se(sd_event_run(e, 10 * USEC_PER_MSEC) >= 0);
+        }
+}
+
+TEST(work) {
+        _cleanup_(sd_event_source_unrefp) sd_event_source *cancelled = NULL, *orphaned = NULL;
+        sd_event_source *blockers[4] = {};
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        _cleanup_close_pair_ int pfd[2] = EBADF_PAIR;
+
+        assert_se(sd_event_new(&e) >= 0);
+        assert_se(pipe2(pfd, O_CLOEXEC) >= 0);
+
+        /* Occupy all worker threads */
+        for (size_t i = 0; i < ELEMENTSOF(blockers); i++)
+                assert_se(sd_event_add_work(e, blockers + i, work_blocking, work_completed, FD_TO_PTR(pfd[0])) >= 0);
+        work_run_until(e, &n_work_started, 4);
+
+        /* Work that didn't start yet is dropped when its event source is disabled */
+        assert_se(sd_event_add_work(e, &cancelled, work_blocking, work_not_completed, FD_TO_PTR(pfd[0])) >= 0);
+        assert_se(sd_event_source_set_priority(cancelled, SD_EVENT_PRIORITY_IMPORTANT) >= 0);
+        assert_se(sd_event_source_set_enabled(cancelled, SD_EVENT_OFF) >= 0);
+
+        assert_se(write(pfd[1], "xxxx", 4) == 4);
+        work_run_until(e, &n_work_completed, 4);
+        assert_se(__atomic_load_n(&n_work_started, __ATOMIC_SEQ_CST) == 4);
+
+        /* Enabling a oneshot work source again submits the work again */
+        assert_se(sd_event_source_get_enabled(blockers[0], NULL) == 0);
+        assert_se(sd_event_source_set_enabled(blockers[0], SD_EVENT_ONESHOT) >= 0);
+        work_run_until(e, &n_work_started, 5);
+        assert_se(write(pfd[1], "x", 1) == 1);
+        work_run_until(e, &n_work_completed, 5);
+
+        /* Disabling the event source while its work function is running drops the result. Enabling it
+         * again submits the work again, but only once the running function returned. */
+        assert_se(sd_event_source_set_enabled(blockers[1], SD_EVENT_ONESHOT) >= 0);
+        work_run_until(e, &n_work_started, 6);
+        assert_se(sd_event_source_set_enabled(blockers[1], SD_EVENT_OFF) >= 0);
+        assert_se(sd_event_source_set_enabled(blockers[1], SD_EVENT_ONESHOT) >= 0);
+        for (unsigned i = 0; i < 10; i++)
+                assert_se(sd_event_run(e, 10 * USEC_PER_MSEC) >= 0);
+        assert_se(__atomic_load_n(&n_work_started, __ATOMIC_SEQ_CST) == 6);
+
+        assert_se(write(pfd[1], "x", 1) == 1);
+        work_run_until(e, &n_work_started, 7);
+        assert_se(n_work_completed == 5);
+        assert_se(write(pfd[1], "x", 1) == 1);
+        work_run_until(e, &n_work_completed, 6);
+
+        /* When the event source goes away while its work function is running, the result is dropped, and
+         * the destroy callback is called once the work function is done */
+        assert_se(sd_event_add_work(e, &orphaned, work_blocking, work_not_completed, FD_TO_PTR(pfd[0])) >= 0);
+        assert_se(sd_event_source_set_destroy_callback(orphaned, work_destroy) >= 0);
+        work_run_until(e, &n_work_started, 8);
+        orphaned = sd_event_source_unref(orphaned);
+        assert_se(n_work_destroyed == 0);
+
+        assert_se(write(pfd[1], "x", 1) == 1);
+        work_run_until(e, &n_work_destroyed, 1);
+        assert_se(n_work_completed == 6);
+
+        FOREACH_ARRAY(b, blockers, ELEMENTSOF(blockers))
+                sd_event_source_unref(*b);
+}
+
+static int work_counting(void *userdata) {
+        return 7;
+}
+
+static int work_counting_completed(sd_event_source *s, int result, void *userdata) {
+        unsigned *n = ASSERT_PTR(userdata);
+
+        assert_se(result == 7);
+
+        /* An enabled work source is resubmitted after each completion */
+        if (++(*n) >= 3)
+                assert_se(sd_event_exit(sd_event_source_get_event(s), 0) >= 0);
+
+        return 0;
+}
+
+TEST(work_enabled) {
+        _cleanup_(sd_event_source_unrefp) sd_event_source *s = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        unsigned n = 0;
+
+        assert_se(sd_event_new(&e) >= 0);
+        assert_se(sd_event_add_work(e, &s, work_counting, work_counting_completed, &n) >= 0);
+        assert_se(sd_event_source_set_enabled(s, SD_EVENT_ON) >= 0);
+        assert_se(sd_event_loop(e) >= 0);
+        assert_se(n == 3);
+}
+
+static void* post_completion_thread(void *p) {
+        assert_se(sd_event_post_completion(p, 42) >= 0);
+        return NULL;
+}
+
+static int post_completion_handler(sd_event_source *s, int result, void *userdata) {
+        unsigned *n = ASSERT_PTR(userdata);
+
+        assert_se(gettid() == getpid());
+        assert_se(result == 42);
+
+        (*n)++;
+        return 0;
+}
+
+TEST(post_completion) {
+        _cleanup_(sd_event_source_unrefp) sd_event_source *s = NULL, *d = NULL;
+        _cleanup_(sd_event_unrefp) sd_event *e = NULL;
+        unsigned n = 0;
+        pthread_t t;
+
+        assert_se(sd_event_new(&e) >= 0);
+
+        /* Without a work function, it's up to some other thread to complete the event source */
+        assert_se(sd_event_add_work(e, &s, NULL, post_completion_handler, &n) >= 0);
+        assert_se(pthread_create(&t, NULL, post_completion_thread, s) == 0);
+        work_run_until(e, &n, 1);
+        assert_se(pthread_join(t, NULL) == 0);
+
+        /* Disabled, and hence not waiting for a completion anymore */
+        assert_se(sd_event_post_completion(s, 42) == -ESTALE);
+
+        assert_se(sd_event_source_set_enabled(s, SD_EVENT_ONESHOT) >= 0);
+        assert_se(sd_event_post_completion(s, 42) >= 0);
+        assert_se(sd_event_post_completion(s, 43) == -EBUSY);
+        work_run_until(e, &n, 2);
+
+        assert_se(sd_event_add_defer(e, &d, NULL, NULL) >= 0);
+        assert_se(sd_event_post_completion(d, 42) == -EDOM);
+}
+
 DEFINE_TEST_MAIN(LOG_DEBUG);
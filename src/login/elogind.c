@@ -434,6 +434,11 @@ int elogind_manager_new( Manager* m ) {
         /* allow manipulating Nvidia cards */
         m->handle_nvidia_sleep = false;
 
+        /* Run sleep hook scripts one after the other */
+        m->sleep_hooks_parallel     = false;
+        m->sleep_hooks_max_parallel = 0;
+        m->sleep_hook_timeout_usec  = USEC_INFINITY;
+
         /* Init sleep values */
         m->allow[SLEEP_SUSPEND]                = true;
         m->allow[SLEEP_HIBERNATE]              = true;
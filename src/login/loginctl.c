@@ -29,6 +29,7 @@
 #include "process-util.h"
 #include "rlimit-util.h"
 #include "sigbus.h"
+#include "sort-util.h"
 //#include "signal-util.h"
 #include "spawn-polkit-agent.h"
 #include "string-table.h"
@@ -41,6 +42,7 @@
 
 /// Additional includes needed by elogind
 #include "eloginctl.h"
+#include "errno-list.h"
 #include "musl_missing.h"
 
 static char **arg_property = NULL;
@@ -117,12 +119,29 @@ typedef struct SeatStatusInfo {
         char **sessions;
 } SeatStatusInfo;
 
+typedef struct SessionListEntry {
+        const char *id;
+        uid_t uid;
+        const char *user;
+        const char *seat;
+        SessionStatusInfo info;
+} SessionListEntry;
+
 static void user_status_info_done(UserStatusInfo *info) {
         assert(info);
 
         strv_free(info->sessions);
 }
 
+static void user_status_info_array_free(UserStatusInfo *infos, size_t n) {
+        assert(infos || n == 0);
+
+        FOREACH_ARRAY(i, infos, n)
+                user_status_info_done(i);
+
+        free(infos);
+}
+
 static void seat_status_info_done(SeatStatusInfo *info) {
         assert(info);
 
@@ -136,16 +155,38 @@ static OutputFlags get_output_flags(void) {
                 colors_enabled() * OUTPUT_COLOR;
 }
 
-static int show_table(Table *table, const char *word) {
+static int show_table_begin(Table *table) {
+        int r;
+
+        assert(table);
+
+        /* Call this before adding rows that are sorted already, to have them written out while they are
+         * added, rather than all at the end. JSON output needs all rows at once. */
+
+        if (OUTPUT_MODE_IS_JSON(arg_output))
+                return 0;
+
+        table_set_header(table, arg_legend);
+
+        r = table_set_stream(table, NULL, TABLE_STREAM_SAMPLE_DEFAULT);
+        if (r < 0)
+                return log_error_errno(r, "Failed to set up table output: %m");
+
+        return 0;
+}
+
+static int show_table(Table *table, const char *word, bool sorted) {
         int r;
 
         assert(table);
         assert(word);
 
         if (table_get_rows(table) > 1 || OUTPUT_MODE_IS_JSON(arg_output)) {
-                r = table_set_sort(table, (size_t) 0);
-                if (r < 0)
-                        return table_log_sort_error(r);
+                if (!sorted) {
+                        r = table_set_sort(table, (size_t) 0);
+                        if (r < 0)
+                                return table_log_sort_error(r);
+                }
 
                 table_set_header(table, arg_legend);
 
@@ -167,6 +208,11 @@ static int show_table(Table *table, const char *word) {
         return 0;
 }
 
+static int session_list_entry_compare(const size_t *a, const size_t *b, SessionListEntry *entries) {
+        /* Ordered like the table would order them, by ID, and in the order they were listed otherwise */
+        return strcmp(entries[*a].id, entries[*b].id) ?: CMP(*a, *b);
+}
+
 static int list_sessions(int argc, char *argv[], void *userdata) {
 
         static const struct bus_properties_map map[] = {
@@ -180,9 +226,15 @@ static int list_sessions(int argc, char *argv[], void *userdata) {
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         _cleanup_(table_unrefp) Table *table = NULL;
+        _cleanup_free_ SessionListEntry *entries = NULL;
+        _cleanup_free_ size_t *order = NULL;
+        BusMapPropertiesRequest *requests = NULL;
         sd_bus *bus = ASSERT_PTR(userdata);
+        size_t n = 0;
         int r;
 
+        CLEANUP_ARRAY(requests, n, bus_map_properties_request_array_free);
+
         assert(argv);
 
         pager_open(arg_pager_flags);
@@ -195,6 +247,53 @@ static int list_sessions(int argc, char *argv[], void *userdata) {
         if (r < 0)
                 return bus_log_parse_error(r);
 
+        for (;;) {
+                const char *id, *user, *seat, *object;
+                uint32_t uid;
+
+                r = sd_bus_message_read(reply, "(susso)", &id, &uid, &user, &seat, &object);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+                if (r == 0)
+                        break;
+
+                if (!GREEDY_REALLOC(entries, n + 1) ||
+                    !GREEDY_REALLOC0(requests, n + 1))
+                        return log_oom();
+
+                entries[n] = (SessionListEntry) {
+                        .id = id,
+                        .uid = uid,
+                        .user = user,
+                        .seat = seat,
+                };
+                requests[n++].path = object;
+        }
+
+        r = sd_bus_message_exit_container(reply);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        /* Only now that the array won't move anymore */
+        for (size_t k = 0; k < n; k++)
+                requests[k].userdata = &entries[k].info;
+
+        /* Ask for the properties of all sessions at once, one round trip each would add up on systems with
+         * many sessions */
+        r = bus_map_all_properties_many(bus, "org.freedesktop.login1", map, BUS_MAP_BOOLEAN_AS_BOOL,
+                                        BUS_MAP_PROPERTIES_MAX_INFLIGHT, requests, n);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get session properties: %m");
+
+        order = new(size_t, n);
+        if (!order)
+                return log_oom();
+
+        for (size_t k = 0; k < n; k++)
+                order[k] = k;
+
+        typesafe_qsort_r(order, n, session_list_entry_compare, entries);
+
         table = table_new("session", "uid", "user", "seat", "tty", "state", "idle", "since");
         if (!table)
                 return log_oom();
@@ -205,52 +304,47 @@ static int list_sessions(int argc, char *argv[], void *userdata) {
 
         (void) table_set_ersatz_string(table, TABLE_ERSATZ_DASH);
 
-        for (;;) {
-                _cleanup_(sd_bus_error_free) sd_bus_error e = SD_BUS_ERROR_NULL;
-                const char *id, *user, *seat, *object;
-                uint32_t uid;
-                _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = NULL;
-                SessionStatusInfo i = {};
+        r = show_table_begin(table);
+        if (r < 0)
+                return r;
 
-                r = sd_bus_message_read(reply, "(susso)", &id, &uid, &user, &seat, &object);
-                if (r < 0)
-                        return bus_log_parse_error(r);
-                if (r == 0)
-                        break;
+        for (size_t k = 0; k < n; k++) {
+                const BusMapPropertiesRequest *q = requests + order[k];
+                const SessionListEntry *e = entries + order[k];
+                const SessionStatusInfo *i = &e->info;
 
-                r = bus_map_all_properties(bus, "org.freedesktop.login1", object, map, BUS_MAP_BOOLEAN_AS_BOOL, &e, &m, &i);
-                if (r < 0) {
-                        log_full_errno(sd_bus_error_has_name(&e, SD_BUS_ERROR_UNKNOWN_OBJECT) ? LOG_DEBUG : LOG_WARNING,
-                                       r,
+                if (q->result < 0) {
+                        log_full_errno(sd_bus_error_has_name(&q->error, SD_BUS_ERROR_UNKNOWN_OBJECT) ? LOG_DEBUG : LOG_WARNING,
+                                       q->result,
                                        "Failed to get properties of session %s, ignoring: %s",
-                                       id, bus_error_message(&e, r));
+                                       e->id, bus_error_message(&q->error, q->result));
                         continue;
                 }
 
                 r = table_add_many(table,
-                                   TABLE_STRING, id,
-                                   TABLE_UID, (uid_t) uid,
-                                   TABLE_STRING, user,
-                                   TABLE_STRING, empty_to_null(seat),
-                                   TABLE_STRING, empty_to_null(i.tty),
-                                   TABLE_STRING, i.state,
-                                   TABLE_BOOLEAN, i.idle_hint);
+                                   TABLE_STRING, e->id,
+                                   TABLE_UID, (uid_t) e->uid,
+                                   TABLE_STRING, e->user,
+                                   TABLE_STRING, empty_to_null(e->seat),
+                                   TABLE_STRING, empty_to_null(i->tty),
+                                   TABLE_STRING, i->state,
+                                   TABLE_BOOLEAN, i->idle_hint);
                 if (r < 0)
                         return table_log_add_error(r);
 
-                if (i.idle_hint)
-                        r = table_add_cell(table, NULL, TABLE_TIMESTAMP_RELATIVE_MONOTONIC, &i.idle_hint_timestamp.monotonic);
+                if (i->idle_hint)
+                        r = table_add_cell(table, NULL, TABLE_TIMESTAMP_RELATIVE_MONOTONIC, &i->idle_hint_timestamp.monotonic);
                 else
                         r = table_add_cell(table, NULL, TABLE_EMPTY, NULL);
                 if (r < 0)
                         return table_log_add_error(r);
         }
 
-        r = sd_bus_message_exit_container(reply);
-        if (r < 0)
-                return bus_log_parse_error(r);
+        return show_table(table, "sessions", /* sorted= */ true);
+}
 
-        return show_table(table, "sessions");
+static int user_status_info_compare(const size_t *a, const size_t *b, UserStatusInfo *infos) {
+        return CMP(infos[*a].uid, infos[*b].uid) ?: CMP(*a, *b);
 }
 
 static int list_users(int argc, char *argv[], void *userdata) {
@@ -264,9 +358,16 @@ static int list_users(int argc, char *argv[], void *userdata) {
         _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
         _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
         _cleanup_(table_unrefp) Table *table = NULL;
+        _cleanup_free_ size_t *order = NULL;
+        UserStatusInfo *infos = NULL;
+        BusMapPropertiesRequest *requests = NULL;
         sd_bus *bus = ASSERT_PTR(userdata);
+        size_t n = 0;
         int r;
 
+        CLEANUP_ARRAY(infos, n, user_status_info_array_free);
+        CLEANUP_ARRAY(requests, n, bus_map_properties_request_array_free);
+
         assert(argv);
 
         pager_open(arg_pager_flags);
@@ -279,17 +380,7 @@ static int list_users(int argc, char *argv[], void *userdata) {
         if (r < 0)
                 return bus_log_parse_error(r);
 
-        table = table_new("uid", "user", "linger", "state");
-        if (!table)
-                return log_oom();
-
-        (void) table_set_align_percent(table, TABLE_HEADER_CELL(0), 100);
-        (void) table_set_ersatz_string(table, TABLE_ERSATZ_DASH);
-
         for (;;) {
-                _cleanup_(sd_bus_error_free) sd_bus_error error_property = SD_BUS_ERROR_NULL;
-                _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply_property = NULL;
-                _cleanup_(user_status_info_done) UserStatusInfo info = {};
                 const char *user, *object;
                 uint32_t uid;
 
@@ -299,36 +390,72 @@ static int list_users(int argc, char *argv[], void *userdata) {
                 if (r == 0)
                         break;
 
-                r = bus_map_all_properties(bus,
-                                           "org.freedesktop.login1",
-                                           object,
-                                           property_map,
-                                           BUS_MAP_BOOLEAN_AS_BOOL,
-                                           &error_property,
-                                           &reply_property,
-                                           &info);
-                if (r < 0) {
-                        log_full_errno(sd_bus_error_has_name(&error_property, SD_BUS_ERROR_UNKNOWN_OBJECT) ? LOG_DEBUG : LOG_WARNING,
-                                       r,
+                if (!GREEDY_REALLOC(infos, n + 1) ||
+                    !GREEDY_REALLOC0(requests, n + 1))
+                        return log_oom();
+
+                /* The uid and name come from the list, the rest from the properties */
+                infos[n] = (UserStatusInfo) {
+                        .uid = uid,
+                        .name = user,
+                };
+                requests[n++].path = object;
+        }
+
+        r = sd_bus_message_exit_container(reply);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        for (size_t k = 0; k < n; k++)
+                requests[k].userdata = infos + k;
+
+        r = bus_map_all_properties_many(bus, "org.freedesktop.login1", property_map, BUS_MAP_BOOLEAN_AS_BOOL,
+                                        BUS_MAP_PROPERTIES_MAX_INFLIGHT, requests, n);
+        if (r < 0)
+                return log_error_errno(r, "Failed to get user properties: %m");
+
+        order = new(size_t, n);
+        if (!order)
+                return log_oom();
+
+        for (size_t k = 0; k < n; k++)
+                order[k] = k;
+
+        typesafe_qsort_r(order, n, user_status_info_compare, infos);
+
+        table = table_new("uid", "user", "linger", "state");
+        if (!table)
+                return log_oom();
+
+        (void) table_set_align_percent(table, TABLE_HEADER_CELL(0), 100);
+        (void) table_set_ersatz_string(table, TABLE_ERSATZ_DASH);
+
+        r = show_table_begin(table);
+        if (r < 0)
+                return r;
+
+        for (size_t k = 0; k < n; k++) {
+                const BusMapPropertiesRequest *q = requests + order[k];
+                const UserStatusInfo *info = infos + order[k];
+
+                if (q->result < 0) {
+                        log_full_errno(sd_bus_error_has_name(&q->error, SD_BUS_ERROR_UNKNOWN_OBJECT) ? LOG_DEBUG : LOG_WARNING,
+                                       q->result,
                                        "Failed to get properties of user %s, ignoring: %s",
-                                       user, bus_error_message(&error_property, r));
+                                       info->name, bus_error_message(&q->error, q->result));
                         continue;
                 }
 
                 r = table_add_many(table,
-                                   TABLE_UID, (uid_t) uid,
-                                   TABLE_STRING, user,
-                                   TABLE_BOOLEAN, info.linger,
-                                   TABLE_STRING, info.state);
+                                   TABLE_UID, info->uid,
+                                   TABLE_STRING, info->name,
+                                   TABLE_BOOLEAN, info->linger,
+                                   TABLE_STRING, info->state);
                 if (r < 0)
                         return table_log_add_error(r);
         }
 
-        r = sd_bus_message_exit_container(reply);
-        if (r < 0)
-                return bus_log_parse_error(r);
-
-        return show_table(table, "users");
+        return show_table(table, "users", /* sorted= */ true);
 }
 
 static int list_seats(int argc, char *argv[], void *userdata) {
@@ -374,7 +501,7 @@ static int list_seats(int argc, char *argv[], void *userdata) {
         if (r < 0)
                 return bus_log_parse_error(r);
 
-        return show_table(table, "seats");
+        return show_table(table, "seats", /* sorted= */ false);
 }
 
 #if 0 /// UNNEEDED by elogind
@@ -1431,6 +1558,114 @@ static int reload_config(int argc, char *argv[], void *userdata) {
 }
 #endif // 1
 
+#if 1 /// elogind records how long the phases of shutdown and sleep operations took
+typedef struct TimelineEntry {
+        const char *phase;
+        usec_t realtime;
+        usec_t monotonic;
+} TimelineEntry;
+
+static int show_timeline(int argc, char *argv[], void *userdata) {
+        _cleanup_(sd_bus_error_free) sd_bus_error error = SD_BUS_ERROR_NULL;
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *reply = NULL;
+        _cleanup_(table_unrefp) Table *table = NULL;
+        _cleanup_free_ TimelineEntry *entries = NULL;
+        sd_bus *bus = ASSERT_PTR(userdata);
+        int r;
+
+        assert(argv);
+
+        pager_open(arg_pager_flags);
+
+        r = bus_get_property(bus, bus_login_mgr, "ShutdownOrSleepTimeline", &error, &reply, "a(sia(stt))");
+        if (r < 0)
+                return log_error_errno(r, "Failed to get shutdown and sleep timeline: %s", bus_error_message(&error, r));
+
+        r = sd_bus_message_enter_container(reply, 'a', "(sia(stt))");
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        table = table_new("action", "phase", "time", "offset", "duration", "result");
+        if (!table)
+                return log_oom();
+
+        (void) table_set_ersatz_string(table, TABLE_ERSATZ_DASH);
+
+        for (;;) {
+                const char *action;
+                size_t n_entries = 0;
+                int result;
+
+                r = sd_bus_message_enter_container(reply, 'r', "sia(stt)");
+                if (r < 0)
+                        return bus_log_parse_error(r);
+                if (r == 0)
+                        break;
+
+                r = sd_bus_message_read(reply, "si", &action, &result);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                r = sd_bus_message_enter_container(reply, 'a', "(stt)");
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                /* The durations are only known once the next phase began, hence collect the run first */
+                for (;;) {
+                        TimelineEntry e;
+
+                        r = sd_bus_message_read(reply, "(stt)", &e.phase, &e.realtime, &e.monotonic);
+                        if (r < 0)
+                                return bus_log_parse_error(r);
+                        if (r == 0)
+                                break;
+
+                        if (!GREEDY_REALLOC(entries, n_entries + 1))
+                                return log_oom();
+
+                        entries[n_entries++] = e;
+                }
+
+                for (size_t i = 0; i < n_entries; i++) {
+                        bool last = i + 1 == n_entries;
+
+                        r = table_add_many(table,
+                                           TABLE_STRING, action,
+                                           TABLE_STRING, entries[i].phase,
+                                           TABLE_TIMESTAMP, entries[i].realtime,
+                                           TABLE_TIMESPAN_MSEC, usec_sub_unsigned(entries[i].monotonic, entries[0].monotonic));
+                        if (r < 0)
+                                return table_log_add_error(r);
+
+                        if (last)
+                                r = table_add_many(table,
+                                                   TABLE_EMPTY,
+                                                   TABLE_STRING, result == 0 ? "success" : errno_to_name(result));
+                        else
+                                r = table_add_many(table,
+                                                   TABLE_TIMESPAN_MSEC, usec_sub_unsigned(entries[i + 1].monotonic, entries[i].monotonic),
+                                                   TABLE_EMPTY);
+                        if (r < 0)
+                                return table_log_add_error(r);
+                }
+
+                r = sd_bus_message_exit_container(reply);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                r = sd_bus_message_exit_container(reply);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+        }
+
+        r = sd_bus_message_exit_container(reply);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        return show_table(table, "phases", /* sorted= */ true);
+}
+#endif // 1
+
 static int help(int argc, char *argv[], void *userdata) {
         _cleanup_free_ char *link = NULL;
         int r;
@@ -1483,6 +1718,8 @@ static int help(int argc, char *argv[], void *userdata) {
                "  hybrid-sleep              Suspend the machine to memory and disk\n"
                "  suspend-then-hibernate    Suspend the system, wake after a period of\n"
                "                            time and put it into hibernate\n"
+               "  timeline                  Show how long the phases of the recent shutdown\n"
+               "                            and sleep operations took\n"
 #endif // 1
                "\n%3$sOptions:%4$s\n"
                "  -h --help                Show this help\n"
@@ -1787,6 +2024,7 @@ static int loginctl_main(int argc, char *argv[], sd_bus *bus) {
                 { "hybrid-sleep",      VERB_ANY, 1,        0,            start_special     },
                 { "suspend-then-hibernate", VERB_ANY, 1,   0,            start_special     },
                 { "cancel-shutdown",   VERB_ANY, 1,        0,            start_special     },
+                { "timeline",          VERB_ANY, 1,        0,            show_timeline     },
 #endif // 1
                 {}
         };
@@ -20,6 +20,9 @@
 
 #define LONG_PRESS_DURATION (5 * USEC_PER_SEC)
 
+/* How many input events to read at once */
+#define BUTTON_READ_EVENTS_MAX 64U
+
 static bool bitset_get(const unsigned long *bits, unsigned i) {
         return (bits[i / ULONG_BITS] >> (i % ULONG_BITS)) & 1UL;
 }
@@ -85,7 +88,7 @@ static void button_lid_switch_handle_action(Manager *manager, bool is_edge) {
          * differently */
         if (manager_is_docked_or_external_displays(manager))
                 handle_action = manager->handle_lid_switch_docked;
-        else if (handle_action_valid(manager->handle_lid_switch_ep) && manager_is_on_external_power())
+        else if (handle_action_valid(manager->handle_lid_switch_ep) && manager_is_on_external_power(manager))
                 handle_action = manager->handle_lid_switch_ep;
         else
                 handle_action = manager->handle_lid_switch;
@@ -197,23 +200,12 @@ static void start_long_press(Manager *m, sd_event_source **e, sd_event_time_hand
                 log_warning_errno(r, "Failed to add long press timer event, ignoring: %m");
 }
 
-static int button_dispatch(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
-        Button *b = ASSERT_PTR(userdata);
-        struct input_event ev;
-        ssize_t l;
-
-        assert(s);
-        assert(fd == b->fd);
-
-        l = read(b->fd, &ev, sizeof(ev));
-        if (l < 0)
-                return errno != EAGAIN ? -errno : 0;
-        if ((size_t) l < sizeof(ev))
-                return -EIO;
+static void button_handle_key(Button *b, uint16_t code, int32_t value) {
+        assert(b);
 
-        if (ev.type == EV_KEY && ev.value > 0) {
+        if (value > 0) {
 
-                switch (ev.code) {
+                switch (code) {
 
                 case KEY_POWER:
                 case KEY_POWER2:
@@ -276,9 +268,9 @@ static int button_dispatch(sd_event_source *s, int fd, uint32_t revents, void *u
                         break;
                 }
 
-        } else if (ev.type == EV_KEY && ev.value == 0) {
+        } else {
 
-                switch (ev.code) {
+                switch (code) {
 
                 case KEY_POWER:
                 case KEY_POWER2:
@@ -332,10 +324,15 @@ static int button_dispatch(sd_event_source *s, int fd, uint32_t revents, void *u
                         }
                         break;
                 }
+        }
+}
 
-        } else if (ev.type == EV_SW && ev.value > 0) {
+static void button_handle_switch(Button *b, uint16_t code, bool on) {
+        assert(b);
 
-                if (ev.code == SW_LID) {
+        if (on) {
+
+                if (code == SW_LID) {
                         log_struct(LOG_INFO,
                                    LOG_MESSAGE("Lid closed."),
                                    "MESSAGE_ID=" SD_MESSAGE_LID_CLOSED_STR);
@@ -344,7 +341,7 @@ static int button_dispatch(sd_event_source *s, int fd, uint32_t revents, void *u
                         button_lid_switch_handle_action(b->manager, true);
                         button_install_check_event_source(b);
 
-                } else if (ev.code == SW_DOCK) {
+                } else if (code == SW_DOCK) {
                         log_struct(LOG_INFO,
                                    LOG_MESSAGE("System docked."),
                                    "MESSAGE_ID=" SD_MESSAGE_SYSTEM_DOCKED_STR);
@@ -352,9 +349,9 @@ static int button_dispatch(sd_event_source *s, int fd, uint32_t revents, void *u
                         b->docked = true;
                 }
 
-        } else if (ev.type == EV_SW && ev.value == 0) {
+        } else {
 
-                if (ev.code == SW_LID) {
+                if (code == SW_LID) {
                         log_struct(LOG_INFO,
                                    LOG_MESSAGE("Lid opened."),
                                    "MESSAGE_ID=" SD_MESSAGE_LID_OPENED_STR);
@@ -362,7 +359,7 @@ static int button_dispatch(sd_event_source *s, int fd, uint32_t revents, void *u
                         b->lid_closed = false;
                         b->check_event_source = sd_event_source_unref(b->check_event_source);
 
-                } else if (ev.code == SW_DOCK) {
+                } else if (code == SW_DOCK) {
                         log_struct(LOG_INFO,
                                    LOG_MESSAGE("System undocked."),
                                    "MESSAGE_ID=" SD_MESSAGE_SYSTEM_UNDOCKED_STR);
@@ -370,10 +367,126 @@ static int button_dispatch(sd_event_source *s, int fd, uint32_t revents, void *u
                         b->docked = false;
                 }
         }
+}
+
+static void button_handle_frame(Button *b, bool *lid_closed, bool *docked) {
+        assert(b);
+        assert(lid_closed);
+        assert(docked);
+
+        FOREACH_ARRAY(ev, b->frame, b->n_frame) {
+                if (ev->type == EV_KEY)
+                        button_handle_key(b, ev->code, ev->value);
+                else if (ev->code == SW_LID)
+                        *lid_closed = ev->value > 0;
+                else if (ev->code == SW_DOCK)
+                        *docked = ev->value > 0;
+        }
+
+        b->n_frame = 0;
+}
+
+static void button_resync_switches(Button *b, bool *lid_closed, bool *docked) {
+        unsigned long switches[CONST_MAX(SW_LID, SW_DOCK)/ULONG_BITS+1] = {};
+
+        assert(b);
+        assert(lid_closed);
+        assert(docked);
+
+        /* Events were dropped because we didn't keep up, hence ask the device for the current state of the
+         * switches, and treat any difference like a change reported by the device. */
+
+        if (b->fd < 0)
+                return;
+
+        if (ioctl(b->fd, EVIOCGSW(sizeof(switches)), switches) < 0) {
+                log_debug_errno(errno, "Failed to query switch state of /dev/input/%s, ignoring: %m", b->name);
+                return;
+        }
+
+        *lid_closed = bitset_get(switches, SW_LID);
+        *docked = bitset_get(switches, SW_DOCK);
+}
+
+int button_process_events(Button *b, const struct input_event *events, size_t n) {
+        bool lid_closed, docked;
+
+        assert(b);
+        assert(events || n == 0);
+
+        /* Events are handled a frame at a time, once the SYN_REPORT that terminates a frame is seen. Events
+         * of an incomplete frame are kept until then. Key presses and releases are handled in the order they
+         * were reported in. Switches report a state rather than an event, hence only the state they are in
+         * after the last frame of the batch is acted on. This way a bouncing lid switch triggers the lid
+         * switch handling only once, and the dock state is up-to-date when the lid state is acted on, if
+         * both change at once. */
+
+        lid_closed = b->lid_closed;
+        docked = b->docked;
+
+        FOREACH_ARRAY(ev, events, n) {
+                if (ev->type == EV_SYN && ev->code == SYN_DROPPED) {
+                        /* Everything up to and including the next SYN_REPORT is incomplete, ignore it */
+                        log_debug("Input events on /dev/input/%s were dropped, resynchronizing.", b->name);
+                        b->frame_dropped = true;
+                        b->n_frame = 0;
+                        continue;
+                }
+
+                if (ev->type == EV_SYN && ev->code == SYN_REPORT) {
+                        if (b->frame_dropped) {
+                                b->frame_dropped = false;
+                                button_resync_switches(b, &lid_closed, &docked);
+                        } else
+                                button_handle_frame(b, &lid_closed, &docked);
+                        continue;
+                }
+
+                if (b->frame_dropped || !IN_SET(ev->type, EV_KEY, EV_SW))
+                        continue;
+
+                /* Frames with more events than we can hold are split rather than dropped */
+                if (b->n_frame >= ELEMENTSOF(b->frame))
+                        button_handle_frame(b, &lid_closed, &docked);
+
+                b->frame[b->n_frame++] = *ev;
+        }
+
+        if (docked != b->docked)
+                button_handle_switch(b, SW_DOCK, docked);
+
+        if (lid_closed != b->lid_closed)
+                button_handle_switch(b, SW_LID, lid_closed);
 
         return 0;
 }
 
+static int button_dispatch(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        Button *b = ASSERT_PTR(userdata);
+        struct input_event ev[BUTTON_READ_EVENTS_MAX];
+        ssize_t l;
+
+        assert(s);
+        assert(fd == b->fd);
+
+        /* Read as many events as are queued at once, rather than taking a trip through the event loop for
+         * each of them. A key press or switch change comes with a SYN_REPORT at least, i.e. is two events. */
+
+        for (;;) {
+                l = read(b->fd, ev, sizeof(ev));
+                if (l < 0)
+                        return errno != EAGAIN ? -errno : 0;
+                if (l == 0 || (size_t) l % sizeof(struct input_event) != 0)
+                        return -EIO;
+
+                (void) button_process_events(b, ev, (size_t) l / sizeof(struct input_event));
+
+                /* A short read means the queue is empty, no need to find that out with another read() */
+                if ((size_t) l < sizeof(ev))
+                        return 0;
+        }
+}
+
 static int button_suitable(int fd) {
         unsigned long types[CONST_MAX(EV_KEY, EV_SW)/ULONG_BITS+1];
 
@@ -4,6 +4,10 @@
 typedef struct Button Button;
 
 #include "logind.h"
+#include "missing_input.h"
+
+/* The most events of interest to us that are held for a single frame */
+#define BUTTON_FRAME_EVENTS_MAX 16U
 
 struct Button {
         Manager *manager;
@@ -17,6 +21,11 @@ struct Button {
 
         bool lid_closed;
         bool docked;
+
+        /* Key and switch events of the current frame, until its SYN_REPORT is read */
+        struct input_event frame[BUTTON_FRAME_EVENTS_MAX];
+        size_t n_frame;
+        bool frame_dropped;
 };
 
 Button* button_new(Manager *m, const char *name);
@@ -24,3 +33,4 @@ Button *button_free(Button *b);
 int button_open(Button *b);
 int button_set_seat(Button *b, const char *sn);
 int button_check_switches(Button *b);
+int button_process_events(Button *b, const struct input_event *events, size_t n);
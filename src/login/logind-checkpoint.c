@@ -0,0 +1,599 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "alloc-util.h"
+#include "env-file.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "fs-util.h"
+#include "logind-checkpoint.h"
+#include "logind.h"
+#include "path-util.h"
+#include "set.h"
+#include "siphash24.h"
+#include "sparse-endian.h"
+#include "string-util.h"
+#include "strv.h"
+#include "tmpfile-util.h"
+
+/* On start-up, logind reads back the state of every user, session and inhibitor from their files below
+ * /run/systemd/. With thousands of sessions this means thousands of open()/read()/parse_env_file() calls.
+ * The checkpoint consolidates the already parsed key/value pairs of all those files in one binary file,
+ * which is read in one go. Every entry records the inode, size and mtime of the file it was generated
+ * from, and is only used if the file still matches, otherwise the file is parsed as before. Hence, a
+ * stale or missing checkpoint only makes start-up slower, never incorrect. If the state directories have
+ * not been touched since the checkpoint was written, no file can have changed, and the entries are used
+ * without looking at the files at all.
+ *
+ * While running, the entries are kept in memory. Whenever a state file is written or removed, its path
+ * is noted, and only those files are read again before the checkpoint is rewritten.
+ *
+ * The checkpoint lives in /run/ and is never shared between machines, hence the format is not meant to
+ * be stable: a checkpoint with a different magic is simply ignored.
+ *
+ * Layout: CheckpointHeader, followed by CheckpointHeader.n_entries entries. Each entry consists of a
+ * CheckpointEntryHeader, followed by CheckpointEntryHeader.n_strings NUL-terminated strings: the path of
+ * the state file, and the keys and values read from it. */
+
+#define CHECKPOINT_MAGIC "ELCKPT02"
+
+typedef struct CheckpointHeader {
+        char magic[8];
+        le64_t n_entries;
+        le64_t payload_size;
+        le64_t checksum; /* siphash24() of the payload, to notice truncated or garbled files */
+        le64_t dirs_mtime_nsec; /* latest mtime of the state directories when the checkpoint was written */
+} _packed_ CheckpointHeader;
+
+typedef struct CheckpointEntryHeader {
+        le64_t inode;
+        le64_t size;
+        le64_t mtime_nsec;
+        le64_t n_strings;
+} _packed_ CheckpointEntryHeader;
+
+typedef struct CheckpointEntry {
+        char *path;
+        uint64_t inode;
+        uint64_t size;
+        nsec_t mtime;
+        char **pairs;
+        bool used;
+} CheckpointEntry;
+
+static const uint8_t checkpoint_hash_key[16] = {
+        0x1d, 0x7a, 0x4c, 0x3e, 0x92, 0x05, 0x4b, 0x61, 0x8f, 0x22, 0xd0, 0x9c, 0x55, 0xe3, 0x17, 0xa8,
+};
+
+const char* const logind_checkpoint_dirs[] = {
+        "/run/systemd/users",
+        "/run/systemd/sessions",
+        "/run/systemd/inhibit",
+        NULL,
+};
+
+static CheckpointEntry* checkpoint_entry_free(CheckpointEntry *e) {
+        if (!e)
+                return NULL;
+
+        free(e->path);
+        strv_free(e->pairs);
+        return mfree(e);
+}
+
+DEFINE_TRIVIAL_CLEANUP_FUNC(CheckpointEntry*, checkpoint_entry_free);
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(
+                checkpoint_entry_hash_ops,
+                char, path_hash_func, path_compare,
+                CheckpointEntry, checkpoint_entry_free);
+
+static bool checkpoint_entry_matches(const CheckpointEntry *e, const struct stat *st) {
+        assert(e);
+        assert(st);
+
+        return S_ISREG(st->st_mode) &&
+                e->inode == (uint64_t) st->st_ino &&
+                e->size == (uint64_t) st->st_size &&
+                e->mtime == timespec_load_nsec(&st->st_mtim);
+}
+
+static int checkpoint_entry_new_from_file(const char *path, CheckpointEntry **ret) {
+        _cleanup_(checkpoint_entry_freep) CheckpointEntry *e = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        struct stat st;
+        int r;
+
+        assert(path);
+        assert(ret);
+
+        f = fopen(path, "re");
+        if (!f)
+                return -errno;
+
+        if (fstat(fileno(f), &st) < 0)
+                return -errno;
+
+        if (!S_ISREG(st.st_mode))
+                return -EBADFD;
+
+        e = new(CheckpointEntry, 1);
+        if (!e)
+                return -ENOMEM;
+
+        *e = (CheckpointEntry) {
+                .inode = st.st_ino,
+                .size = st.st_size,
+                .mtime = timespec_load_nsec(&st.st_mtim),
+        };
+
+        e->path = strdup(path);
+        if (!e->path)
+                return -ENOMEM;
+
+        r = load_env_file_pairs(f, path, &e->pairs);
+        if (r < 0)
+                return r;
+
+        *ret = TAKE_PTR(e);
+        return 0;
+}
+
+static int buffer_append(char **buf, size_t *size, const void *data, size_t n) {
+        assert(buf);
+        assert(size);
+        assert(data || n == 0);
+
+        if (!GREEDY_REALLOC(*buf, *size + n))
+                return -ENOMEM;
+
+        memcpy_safe(*buf + *size, data, n);
+        *size += n;
+        return 0;
+}
+
+static int checkpoint_append_entry(const CheckpointEntry *e, char **buf, size_t *size) {
+        CheckpointEntryHeader h;
+        int r;
+
+        assert(e);
+        assert(buf);
+        assert(size);
+
+        h = (CheckpointEntryHeader) {
+                .inode = htole64(e->inode),
+                .size = htole64(e->size),
+                .mtime_nsec = htole64(e->mtime),
+                .n_strings = htole64(1 + strv_length(e->pairs)),
+        };
+
+        r = buffer_append(buf, size, &h, sizeof(h));
+        if (r < 0)
+                return r;
+
+        r = buffer_append(buf, size, e->path, strlen(e->path) + 1);
+        if (r < 0)
+                return r;
+
+        STRV_FOREACH(s, e->pairs) {
+                r = buffer_append(buf, size, *s, strlen(*s) + 1);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
+
+nsec_t logind_checkpoint_dirs_mtime(const char* const *dirs) {
+        nsec_t t = 0;
+
+        /* Adding, replacing or removing a state file changes the mtime of its directory. */
+
+        STRV_FOREACH(d, (char**) dirs) {
+                struct stat st;
+
+                if (stat(*d, &st) < 0)
+                        continue;
+
+                t = MAX(t, timespec_load_nsec(&st.st_mtim));
+        }
+
+        return t;
+}
+
+int logind_checkpoint_update(Hashmap **entries, Set *paths) {
+        const char *p;
+        int r;
+
+        assert(entries);
+
+        /* Re-reads the given state files, and drops the entries of those that are gone. All other entries
+         * are kept as they are, hence only files that were changed since the last checkpoint need to be
+         * listed here. */
+
+        SET_FOREACH(p, paths) {
+                _cleanup_(checkpoint_entry_freep) CheckpointEntry *e = NULL;
+
+                checkpoint_entry_free(hashmap_remove(*entries, p));
+
+                r = checkpoint_entry_new_from_file(p, &e);
+                if (r == -ENOMEM)
+                        return r;
+                if (r < 0) {
+                        /* Most likely the file has been removed, it will be parsed (or not) on start-up as
+                         * usual. */
+                        if (r != -ENOENT)
+                                log_debug_errno(r, "Failed to add %s to checkpoint, ignoring: %m", p);
+                        continue;
+                }
+
+                r = hashmap_ensure_put(entries, &checkpoint_entry_hash_ops, e->path, e);
+                if (r < 0)
+                        return r;
+
+                TAKE_PTR(e);
+        }
+
+        return 0;
+}
+
+void logind_checkpoint_prune(Hashmap *entries) {
+        CheckpointEntry *e;
+
+        /* Every state file is looked up during start-up, hence entries that were not are stale. */
+
+        HASHMAP_FOREACH(e, entries)
+                if (!e->used)
+                        checkpoint_entry_free(hashmap_remove(entries, e->path));
+}
+
+int logind_checkpoint_write(const char *path, Hashmap *entries, const char* const *dirs) {
+        _cleanup_(unlink_and_freep) char *temp_path = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_free_ char *payload = NULL;
+        size_t payload_size = 0;
+        CheckpointEntry *e;
+        CheckpointHeader h;
+        int r;
+
+        assert(path);
+
+        HASHMAP_FOREACH(e, entries) {
+                r = checkpoint_append_entry(e, &payload, &payload_size);
+                if (r < 0)
+                        return r;
+        }
+
+        h = (CheckpointHeader) {
+                .n_entries = htole64(hashmap_size(entries)),
+                .payload_size = htole64(payload_size),
+                .checksum = htole64(siphash24(strempty(payload), payload_size, checkpoint_hash_key)),
+                .dirs_mtime_nsec = htole64(logind_checkpoint_dirs_mtime(dirs)),
+        };
+        memcpy(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic));
+
+        r = fopen_temporary(path, &f, &temp_path);
+        if (r < 0)
+                return r;
+
+        (void) fchmod(fileno(f), 0600);
+
+        if (fwrite(&h, 1, sizeof(h), f) != sizeof(h))
+                return errno_or_else(EIO);
+
+        if (payload_size > 0 && fwrite(payload, 1, payload_size, f) != payload_size)
+                return errno_or_else(EIO);
+
+        r = fflush_and_check(f);
+        if (r < 0)
+                return r;
+
+        if (rename(temp_path, path) < 0)
+                return -errno;
+
+        temp_path = mfree(temp_path);
+
+        log_debug("Wrote checkpoint %s with %u entries (%zu bytes).", path, hashmap_size(entries), payload_size);
+        return 0;
+}
+
+static int checkpoint_read_string(const char *buf, size_t size, size_t *offset, const char **ret) {
+        size_t n;
+
+        assert(buf);
+        assert(offset);
+        assert(*offset <= size);
+        assert(ret);
+
+        n = strnlen(buf + *offset, size - *offset);
+        if (n >= size - *offset)
+                return -EBADMSG; /* not NUL-terminated */
+
+        *ret = buf + *offset;
+        *offset += n + 1;
+        return 0;
+}
+
+static int checkpoint_read_entry(const char *buf, size_t size, size_t *offset, CheckpointEntry **ret) {
+        _cleanup_(checkpoint_entry_freep) CheckpointEntry *e = NULL;
+        CheckpointEntryHeader h;
+        uint64_t n_strings;
+        const char *s;
+        int r;
+
+        assert(buf);
+        assert(offset);
+        assert(ret);
+
+        if (size - *offset < sizeof(h))
+                return -EBADMSG;
+
+        memcpy(&h, buf + *offset, sizeof(h));
+        *offset += sizeof(h);
+
+        /* The path plus key/value pairs, each string takes at least one byte. */
+        n_strings = le64toh(h.n_strings);
+        if (n_strings % 2 != 1 || n_strings > size - *offset)
+                return -EBADMSG;
+
+        e = new(CheckpointEntry, 1);
+        if (!e)
+                return -ENOMEM;
+
+        *e = (CheckpointEntry) {
+                .inode = le64toh(h.inode),
+                .size = le64toh(h.size),
+                .mtime = le64toh(h.mtime_nsec),
+        };
+
+        r = checkpoint_read_string(buf, size, offset, &s);
+        if (r < 0)
+                return r;
+
+        if (!path_is_absolute(s))
+                return -EBADMSG;
+
+        e->path = strdup(s);
+        if (!e->path)
+                return -ENOMEM;
+
+        e->pairs = new0(char*, n_strings);
+        if (!e->pairs)
+                return -ENOMEM;
+
+        for (uint64_t i = 0; i < n_strings - 1; i++) {
+                r = checkpoint_read_string(buf, size, offset, &s);
+                if (r < 0)
+                        return r;
+
+                e->pairs[i] = strdup(s);
+                if (!e->pairs[i])
+                        return -ENOMEM;
+        }
+
+        *ret = TAKE_PTR(e);
+        return 0;
+}
+
+int logind_checkpoint_load(const char *path, const char* const *dirs, Hashmap **ret) {
+        _cleanup_hashmap_free_ Hashmap *h = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_free_ char *buf = NULL;
+        CheckpointHeader header;
+        size_t size, offset;
+        nsec_t dirs_mtime;
+        struct stat st;
+        int r;
+
+        assert(path);
+        assert(ret);
+
+        f = fopen(path, "re");
+        if (!f)
+                return -errno;
+
+        if (fstat(fileno(f), &st) < 0)
+                return -errno;
+
+        r = read_full_stream(f, &buf, &size);
+        if (r < 0)
+                return r;
+
+        if (size < sizeof(header))
+                return -EBADMSG;
+
+        memcpy(&header, buf, sizeof(header));
+
+        if (memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) != 0)
+                return -EBADMSG;
+
+        if (le64toh(header.payload_size) != size - sizeof(header))
+                return -EBADMSG;
+
+        if (siphash24(buf + sizeof(header), size - sizeof(header), checkpoint_hash_key) != le64toh(header.checksum))
+                return -EBADMSG;
+
+        offset = sizeof(header);
+        for (uint64_t i = 0; i < le64toh(header.n_entries); i++) {
+                _cleanup_(checkpoint_entry_freep) CheckpointEntry *e = NULL;
+
+                r = checkpoint_read_entry(buf, size, &offset, &e);
+                if (r < 0)
+                        return r;
+
+                r = hashmap_ensure_put(&h, &checkpoint_entry_hash_ops, e->path, e);
+                if (r == -EEXIST)
+                        return -EBADMSG;
+                if (r < 0)
+                        return r;
+
+                TAKE_PTR(e);
+        }
+
+        if (offset != size)
+                return -EBADMSG;
+
+        *ret = TAKE_PTR(h);
+
+        /* The directories must not have changed since the checkpoint was written. As timestamps are
+         * coarse, a change right after writing the checkpoint might not show up in the mtime of the
+         * directory, hence also require the checkpoint to be strictly newer. */
+        dirs_mtime = logind_checkpoint_dirs_mtime(dirs);
+        return dirs_mtime == le64toh(header.dirs_mtime_nsec) &&
+                dirs_mtime < timespec_load_nsec(&st.st_mtim);
+}
+
+int logind_checkpoint_parse_state_filev(Hashmap *checkpoint, bool trusted, const char *fname, va_list ap) {
+        CheckpointEntry *e;
+        struct stat st;
+        int r;
+
+        assert(fname);
+
+        /* Like parse_env_filev(), but takes the values from the checkpoint if it has an entry for the
+         * file that is still up-to-date. Returns > 0 in that case, and 0 if the file was parsed. If
+         * 'trusted' is true, the entries are known to be up-to-date, and the file is not looked at. */
+
+        e = hashmap_get(checkpoint, fname);
+        if (!e || (!trusted && (stat(fname, &st) < 0 || !checkpoint_entry_matches(e, &st))))
+                return parse_env_filev(NULL, fname, ap);
+
+        e->used = true;
+
+        STRV_FOREACH_PAIR(k, v, e->pairs) {
+                const char *key;
+                va_list aq;
+
+                va_copy(aq, ap);
+                while ((key = va_arg(aq, const char*))) {
+                        char **value = va_arg(aq, char**);
+
+                        if (streq(*k, key)) {
+                                r = free_and_strdup(value, empty_to_null(*v));
+                                if (r < 0) {
+                                        va_end(aq);
+                                        return r;
+                                }
+
+                                break;
+                        }
+                }
+                va_end(aq);
+        }
+
+        return 1;
+}
+
+int manager_parse_state_file_sentinel(Manager *m, const char *fname, ...) {
+        va_list ap;
+        int r;
+
+        assert(m);
+        assert(fname);
+
+        va_start(ap, fname);
+        r = logind_checkpoint_parse_state_filev(m->checkpoint, m->checkpoint_trusted, fname, ap);
+        va_end(ap);
+        if (r < 0)
+                return r;
+
+        if (r > 0)
+                m->n_checkpoint_hits++;
+        else
+                /* Not in the checkpoint yet, add it with the next one */
+                manager_checkpoint_mark_dirty(m, fname);
+
+        return 0;
+}
+
+void manager_checkpoint_mark_dirty(Manager *m, const char *fname) {
+        int r;
+
+        assert(m);
+        assert(fname);
+
+        r = set_put_strdup(&m->checkpoint_dirty, fname);
+        if (r < 0)
+                /* Forget all entries rather than keeping a stale one */
+                m->checkpoint = hashmap_free(m->checkpoint);
+}
+
+int manager_load_checkpoint(Manager *m) {
+        int r;
+
+        assert(m);
+
+        r = logind_checkpoint_load(LOGIND_CHECKPOINT_FILE, logind_checkpoint_dirs, &m->checkpoint);
+        if (r == -ENOENT)
+                return 0;
+        if (r < 0)
+                return log_debug_errno(r, "Failed to load checkpoint %s, reading state files individually: %m",
+                                       LOGIND_CHECKPOINT_FILE);
+
+        m->checkpoint_trusted = r > 0;
+
+        log_debug("Loaded checkpoint %s with %u entries%s.", LOGIND_CHECKPOINT_FILE, hashmap_size(m->checkpoint),
+                  m->checkpoint_trusted ? ", state directories unchanged" : "");
+        return 1;
+}
+
+void manager_prune_checkpoint(Manager *m) {
+        assert(m);
+
+        if (m->checkpoint)
+                log_debug("Restored %u of %u state files from checkpoint.",
+                          m->n_checkpoint_hits, hashmap_size(m->checkpoint));
+
+        logind_checkpoint_prune(m->checkpoint);
+        m->checkpoint_trusted = false;
+        m->n_checkpoint_hits = 0;
+}
+
+int manager_write_checkpoint(Manager *m) {
+        int r;
+
+        assert(m);
+
+        if (set_isempty(m->checkpoint_dirty))
+                return 0;
+
+        r = logind_checkpoint_update(&m->checkpoint, m->checkpoint_dirty);
+        if (r >= 0)
+                r = logind_checkpoint_write(LOGIND_CHECKPOINT_FILE, m->checkpoint, logind_checkpoint_dirs);
+        if (r < 0)
+                return log_warning_errno(r, "Failed to write checkpoint %s, ignoring: %m", LOGIND_CHECKPOINT_FILE);
+
+        set_clear(m->checkpoint_dirty);
+        return 0;
+}
+
+static int manager_dispatch_checkpoint(sd_event_source *s, uint64_t usec, void *userdata) {
+        Manager *m = ASSERT_PTR(userdata);
+
+        /* Only rewrites the checkpoint if state files were written or removed since the last one. */
+        (void) manager_write_checkpoint(m);
+
+        return sd_event_source_set_time_relative(s, LOGIND_CHECKPOINT_INTERVAL_USEC);
+}
+
+int manager_start_checkpoint_timer(Manager *m) {
+        int r;
+
+        assert(m);
+
+        r = sd_event_add_time_relative(
+                        m->event,
+                        &m->checkpoint_event_source,
+                        CLOCK_MONOTONIC,
+                        LOGIND_CHECKPOINT_INTERVAL_USEC,
+                        USEC_PER_MINUTE,
+                        manager_dispatch_checkpoint, m);
+        if (r < 0)
+                return r;
+
+        (void) sd_event_source_set_description(m->checkpoint_event_source, "checkpoint");
+
+        return sd_event_source_set_enabled(m->checkpoint_event_source, SD_EVENT_ON);
+}
@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <stdarg.h>
+
+#include "hashmap.h"
+#include "macro.h"
+#include "set.h"
+#include "time-util.h"
+
+typedef struct Manager Manager;
+
+#define LOGIND_CHECKPOINT_FILE "/run/systemd/elogind.checkpoint"
+#define LOGIND_CHECKPOINT_INTERVAL_USEC (5 * USEC_PER_MINUTE)
+
+/* The state directories whose files are covered by the checkpoint. */
+extern const char* const logind_checkpoint_dirs[];
+
+int logind_checkpoint_update(Hashmap **entries, Set *paths);
+void logind_checkpoint_prune(Hashmap *entries);
+int logind_checkpoint_write(const char *path, Hashmap *entries, const char* const *dirs);
+int logind_checkpoint_load(const char *path, const char* const *dirs, Hashmap **ret);
+int logind_checkpoint_parse_state_filev(Hashmap *checkpoint, bool trusted, const char *fname, va_list ap);
+nsec_t logind_checkpoint_dirs_mtime(const char* const *dirs);
+
+int manager_load_checkpoint(Manager *m);
+void manager_prune_checkpoint(Manager *m);
+void manager_checkpoint_mark_dirty(Manager *m, const char *fname);
+int manager_write_checkpoint(Manager *m);
+int manager_start_checkpoint_timer(Manager *m);
+
+int manager_parse_state_file_sentinel(Manager *m, const char *fname, ...) _sentinel_;
+#define manager_parse_state_file(m, fname, ...) manager_parse_state_file_sentinel(m, fname, __VA_ARGS__, NULL)
@@ -18,6 +18,7 @@
 #include "efi-loader.h"
 #include "errno-util.h"
 //#include "fd-util.h"
+#include "fileio.h"
 #include "limits-util.h"
 #include "logind.h"
 //#include "parse-util.h"
@@ -444,13 +445,52 @@ int manager_get_user_by_pid(Manager *m, pid_t pid, User **ret) {
         return !!u;
 }
 
+void manager_invalidate_idle_hint(Manager *m) {
+        assert(m);
+
+        /* Sessions were added or removed, or any of them changed its idle hint explicitly. */
+        m->idle_hint_generation++;
+}
+
+bool idle_hint_cache_get(const IdleHintCache *c, Manager *m, dual_timestamp *t, int *ret) {
+        assert(c);
+        assert(m);
+        assert(ret);
+
+        if (c->generation != m->idle_hint_generation || now(CLOCK_MONOTONIC) >= c->until)
+                return false;
+
+        if (t)
+                *t = c->timestamp;
+
+        *ret = c->idle_hint;
+        return true;
+}
+
+void idle_hint_cache_put(IdleHintCache *c, Manager *m, int idle_hint, const dual_timestamp *t) {
+        assert(c);
+        assert(m);
+        assert(t);
+
+        *c = (IdleHintCache) {
+                .generation = m->idle_hint_generation,
+                .until = usec_add(now(CLOCK_MONOTONIC), IDLE_HINT_CACHE_USEC),
+                .idle_hint = idle_hint,
+                .timestamp = *t,
+        };
+}
+
 int manager_get_idle_hint(Manager *m, dual_timestamp *t) {
         Session *s;
         bool idle_hint;
         dual_timestamp ts = DUAL_TIMESTAMP_NULL;
+        int r;
 
         assert(m);
 
+        if (idle_hint_cache_get(&m->idle_hint_cache, m, t, &r))
+                return r;
+
         idle_hint = !manager_is_inhibited(m, INHIBIT_IDLE, INHIBIT_BLOCK, t, false, false, 0, NULL);
 
         HASHMAP_FOREACH(s, m->sessions) {
@@ -476,6 +516,8 @@ int manager_get_idle_hint(Manager *m, dual_timestamp *t) {
                 }
         }
 
+        idle_hint_cache_put(&m->idle_hint_cache, m, idle_hint, &ts);
+
         if (t)
                 *t = ts;
 
@@ -699,11 +741,16 @@ bool manager_is_docked_or_external_displays(Manager *m) {
         return false;
 }
 
-bool manager_is_on_external_power(void) {
+bool manager_is_on_external_power(Manager *m) {
         int r;
 
+        assert(m);
+
         /* For now we only check for AC power, but 'external power' can apply to anything that isn't an internal
          * battery */
+        if (m->power_supplies_enumerated)
+                return power_supplies_on_ac_power(m->power_supplies);
+
         r = on_ac_power();
         if (r < 0)
                 log_warning_errno(r, "Failed to read AC power status: %m");
@@ -740,92 +787,212 @@ bool manager_all_buttons_ignored(Manager *m) {
         return true;
 }
 
-int manager_read_utmp(Manager *m) {
 #if ENABLE_UTMP
+/* Logins and logouts rewrite utmp in quick succession, coalesce the modifications into one pass */
+#define UTMP_READ_DELAY_USEC (100 * USEC_PER_MSEC)
+
+static void manager_drop_utmp_records(Manager *m) {
+        assert(m);
+
+        m->utmp_records = mfree(m->utmp_records);
+        m->utmp_records_pending = mfree(m->utmp_records_pending);
+        m->n_utmp_records = 0;
+}
+
+/* Returns > 0 if the record is for a login we have no session for (yet), which hence needs to be looked
+ * at again in later passes even if the record doesn't change. */
+static int manager_process_utmp_record(Manager *m, const struct utmpx *u) {
+        _cleanup_free_ char *t = NULL;
+        const char *c;
+        Session *s;
         int r;
+
+        assert(m);
+        assert(u);
+
+        if (u->ut_type != USER_PROCESS)
+                return 0;
+
+        if (!pid_is_valid(u->ut_pid))
+                return 0;
+
+        t = strndup(u->ut_line, sizeof(u->ut_line));
+        if (!t)
+                return -ENOMEM;
+
+        c = path_startswith(t, "/dev/");
+        if (c) {
+                r = free_and_strdup(&t, c);
+                if (r < 0)
+                        return r;
+        }
+
+        if (isempty(t))
+                return 0;
+
+        if (manager_get_session_by_pidref(m, &PIDREF_MAKE_FROM_PID(u->ut_pid), &s) <= 0)
+                return 1;
+
+        if (s->tty_validity == TTY_FROM_UTMP && !streq_ptr(s->tty, t)) {
+                /* This may happen on multiplexed SSH connection (i.e. 'SSH connection sharing'). In
+                 * this case PAM and utmp sessions don't match. In such a case let's invalidate the TTY
+                 * information and never acquire it again. */
+
+                s->tty = mfree(s->tty);
+                s->tty_validity = TTY_UTMP_INCONSISTENT;
+                log_debug("Session '%s' has inconsistent TTY information, dropping TTY information.", s->id);
+                return 0;
+        }
+
+        /* Never override what we figured out once */
+        if (s->tty || s->tty_validity >= 0)
+                return 0;
+
+        s->tty = TAKE_PTR(t);
+        s->tty_validity = TTY_FROM_UTMP;
+        log_debug("Acquired TTY information '%s' from utmp for session '%s'.", s->tty, s->id);
+        return 0;
+}
+#endif
+
+int manager_read_utmp(Manager *m) {
+#if ENABLE_UTMP
         _unused_ _cleanup_(utxent_cleanup) bool utmpx = false;
+        _cleanup_free_ struct utmpx *records = NULL;
+        _cleanup_free_ bool *pending = NULL;
+        size_t n = 0, n_processed = 0;
+        int r;
 
         assert(m);
 
+        /* utmp is a file of fixed size records, which are updated in place on logout and appended (or
+         * reused) on login. Copy all of them first, and then only look at the records that differ from what
+         * we saw at the same position last time, plus those that didn't match any session back then. */
+
         if (utmpxname(_PATH_UTMPX) < 0)
                 return log_error_errno(errno, "Failed to set utmp path to " _PATH_UTMPX ": %m");
 
         utmpx = utxent_start();
 
         for (;;) {
-                _cleanup_free_ char *t = NULL;
                 struct utmpx *u;
-                const char *c;
-                Session *s;
 
                 errno = 0;
                 u = getutxent();
                 if (!u) {
+                        if (errno == 0)
+                                break;
+
                         if (errno == ENOENT)
                                 log_debug_errno(errno, _PATH_UTMPX " does not exist, ignoring.");
-                        else if (errno != 0)
+                        else
                                 log_warning_errno(errno, "Failed to read " _PATH_UTMPX ", ignoring: %m");
+
+                        manager_drop_utmp_records(m);
                         return 0;
                 }
 
-                if (u->ut_type != USER_PROCESS)
-                        continue;
-
-                if (!pid_is_valid(u->ut_pid))
-                        continue;
-
-                t = strndup(u->ut_line, sizeof(u->ut_line));
-                if (!t)
+                if (!GREEDY_REALLOC(records, n + 1)) {
+                        manager_drop_utmp_records(m);
                         return log_oom();
-
-                c = path_startswith(t, "/dev/");
-                if (c) {
-                        r = free_and_strdup(&t, c);
-                        if (r < 0)
-                                return log_oom();
                 }
 
-                if (isempty(t))
-                        continue;
-
-                if (manager_get_session_by_pidref(m, &PIDREF_MAKE_FROM_PID(u->ut_pid), &s) <= 0)
-                        continue;
+                records[n++] = *u;
+        }
 
-                if (s->tty_validity == TTY_FROM_UTMP && !streq_ptr(s->tty, t)) {
-                        /* This may happen on multiplexed SSH connection (i.e. 'SSH connection sharing'). In
-                         * this case PAM and utmp sessions don't match. In such a case let's invalidate the TTY
-                         * information and never acquire it again. */
+        pending = new0(bool, MAX(n, 1u));
+        if (!pending) {
+                manager_drop_utmp_records(m);
+                return log_oom();
+        }
 
-                        s->tty = mfree(s->tty);
-                        s->tty_validity = TTY_UTMP_INCONSISTENT;
-                        log_debug("Session '%s' has inconsistent TTY information, dropping TTY information.", s->id);
+        for (size_t i = 0; i < n; i++) {
+                if (i < m->n_utmp_records &&
+                    !m->utmp_records_pending[i] &&
+                    memcmp(records + i, m->utmp_records + i, sizeof(struct utmpx)) == 0)
                         continue;
-                }
 
-                /* Never override what we figured out once */
-                if (s->tty || s->tty_validity >= 0)
-                        continue;
+                r = manager_process_utmp_record(m, records + i);
+                if (r < 0) {
+                        /* Start from scratch next time */
+                        manager_drop_utmp_records(m);
+                        return log_oom();
+                }
 
-                s->tty = TAKE_PTR(t);
-                s->tty_validity = TTY_FROM_UTMP;
-                log_debug("Acquired TTY information '%s' from utmp for session '%s'.", s->tty, s->id);
+                pending[i] = r > 0;
+                n_processed++;
         }
 
+        log_debug("Processed %zu of %zu utmp records.", n_processed, n);
+
+        free_and_replace(m->utmp_records, records);
+        free_and_replace(m->utmp_records_pending, pending);
+        m->n_utmp_records = n;
+        return 0;
 #else
         return 0;
 #endif
 }
 
 #if ENABLE_UTMP
+static int manager_dispatch_utmp_read(sd_event_source *s, uint64_t usec, void *userdata) {
+        Manager *m = ASSERT_PTR(userdata);
+
+        (void) manager_read_utmp(m);
+        return 0;
+}
+
+static int manager_schedule_read_utmp(Manager *m) {
+        int r;
+
+        assert(m);
+
+        if (m->utmp_read_event_source) {
+                r = sd_event_source_get_enabled(m->utmp_read_event_source, NULL);
+                if (r < 0)
+                        return r;
+                if (r > 0) /* Already scheduled, the pass will cover this modification, too */
+                        return 0;
+
+                r = sd_event_source_set_time_relative(m->utmp_read_event_source, UTMP_READ_DELAY_USEC);
+                if (r < 0)
+                        return r;
+
+                return sd_event_source_set_enabled(m->utmp_read_event_source, SD_EVENT_ONESHOT);
+        }
+
+        r = sd_event_add_time_relative(
+                        m->event,
+                        &m->utmp_read_event_source,
+                        CLOCK_MONOTONIC,
+                        UTMP_READ_DELAY_USEC, 0,
+                        manager_dispatch_utmp_read, m);
+        if (r < 0)
+                return r;
+
+        r = sd_event_source_set_priority(m->utmp_read_event_source, SD_EVENT_PRIORITY_IDLE);
+        if (r < 0)
+                log_warning_errno(r, "Failed to adjust utmp read event source priority, ignoring: %m");
+
+        (void) sd_event_source_set_description(m->utmp_read_event_source, "utmp-read");
+        return 0;
+}
+
 static int manager_dispatch_utmp(sd_event_source *s, const struct inotify_event *event, void *userdata) {
         Manager *m = ASSERT_PTR(userdata);
+        int r;
 
         /* If there's indication the file itself might have been removed or became otherwise unavailable, then let's
          * reestablish the watch on whatever there's now. */
         if ((event->mask & (IN_ATTRIB|IN_DELETE_SELF|IN_MOVE_SELF|IN_Q_OVERFLOW|IN_UNMOUNT)) != 0)
                 manager_connect_utmp(m);
 
-        (void) manager_read_utmp(m);
+        r = manager_schedule_read_utmp(m);
+        if (r < 0) {
+                log_warning_errno(r, "Failed to schedule reading " _PATH_UTMPX ", reading it right away: %m");
+                (void) manager_read_utmp(m);
+        }
+
         return 0;
 }
 #endif
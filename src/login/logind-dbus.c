@@ -18,6 +18,7 @@
 //#include "bus-unit-util.h"
 //#include "bus-util.h"
 #include "cgroup-util.h"
+#include "device-enumerator-private.h"
 #include "device-util.h"
 #include "dirent-util.h"
 #include "efi-api.h"
@@ -378,10 +379,115 @@ static int property_get_scheduled_shutdown(
         return sd_bus_message_close_container(reply);
 }
 
+static int property_get_shutdown_or_sleep_timeline(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        Manager *m = ASSERT_PTR(userdata);
+        int r;
+
+        assert(bus);
+        assert(reply);
+
+        r = sd_bus_message_open_container(reply, 'a', "(sia(stt))");
+        if (r < 0)
+                return r;
+
+        FOREACH_ARRAY(i, m->timelines, m->n_timelines) {
+                Timeline *t = *i;
+
+                r = sd_bus_message_open_container(reply, 'r', "sia(stt)");
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_append(reply, "si", t->action, -t->result);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_open_container(reply, 'a', "(stt)");
+                if (r < 0)
+                        return r;
+
+                FOREACH_ARRAY(mark, t->marks, t->n_marks) {
+                        r = sd_bus_message_append(reply, "(stt)",
+                                                  timeline_phase_to_string(mark->phase),
+                                                  mark->timestamp.realtime,
+                                                  mark->timestamp.monotonic);
+                        if (r < 0)
+                                return r;
+                }
+
+                r = sd_bus_message_close_container(reply);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_close_container(reply);
+                if (r < 0)
+                        return r;
+        }
+
+        return sd_bus_message_close_container(reply);
+}
+
+static int property_get_startup_phases(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        Manager *m = ASSERT_PTR(userdata);
+        int r;
+
+        assert(bus);
+        assert(reply);
+
+        r = sd_bus_message_open_container(reply, 'a', "(stt)");
+        if (r < 0)
+                return r;
+
+        for (StartupPhase i = 0; i < _STARTUP_PHASE_MAX; i++) {
+                const StartupPhaseTrace *p = m->startup_trace.phases + i;
+
+                if (!p->recorded)
+                        continue;
+
+                r = sd_bus_message_append(reply, "(stt)", startup_phase_to_string(i), p->usec, p->n_objects);
+                if (r < 0)
+                        return r;
+        }
+
+        return sd_bus_message_close_container(reply);
+}
+
+static int property_get_startup_usec(
+                sd_bus *bus,
+                const char *path,
+                const char *interface,
+                const char *property,
+                sd_bus_message *reply,
+                void *userdata,
+                sd_bus_error *error) {
+
+        Manager *m = ASSERT_PTR(userdata);
+
+        assert(bus);
+        assert(reply);
+
+        return sd_bus_message_append(reply, "t", startup_trace_total(&m->startup_trace));
+}
+
 static BUS_DEFINE_PROPERTY_GET_ENUM(property_get_handle_action, handle_action, HandleAction);
 static BUS_DEFINE_PROPERTY_GET(property_get_docked, "b", Manager, manager_is_docked_or_external_displays);
 static BUS_DEFINE_PROPERTY_GET(property_get_lid_closed, "b", Manager, manager_is_lid_closed);
-static BUS_DEFINE_PROPERTY_GET_GLOBAL(property_get_on_external_power, "b", manager_is_on_external_power());
+static BUS_DEFINE_PROPERTY_GET(property_get_on_external_power, "b", Manager, manager_is_on_external_power);
 static BUS_DEFINE_PROPERTY_GET_GLOBAL(property_get_compat_user_tasks_max, "t", CGROUP_LIMIT_MAX);
 static BUS_DEFINE_PROPERTY_GET_REF(property_get_hashmap_size, "t", Hashmap *, (uint64_t) hashmap_size);
 
@@ -559,7 +665,7 @@ static int method_list_sessions(sd_bus_message *message, void *userdata, sd_bus_
                 if (!p)
                         return -ENOMEM;
 
-                r = sd_bus_message_append(reply, "(susso)",
+                r = manager_append_bus_template(m, reply, MANAGER_BUS_TEMPLATE_SESSION,
                                           session->id,
                                           (uint32_t) session->user->user_record->uid,
                                           session->user->user_record->user_name,
@@ -599,7 +705,7 @@ static int method_list_users(sd_bus_message *message, void *userdata, sd_bus_err
                 if (!p)
                         return -ENOMEM;
 
-                r = sd_bus_message_append(reply, "(uso)",
+                r = manager_append_bus_template(m, reply, MANAGER_BUS_TEMPLATE_USER,
                                           (uint32_t) user->user_record->uid,
                                           user->user_record->user_name,
                                           p);
@@ -637,7 +743,7 @@ static int method_list_seats(sd_bus_message *message, void *userdata, sd_bus_err
                 if (!p)
                         return -ENOMEM;
 
-                r = sd_bus_message_append(reply, "(so)", seat->id, p);
+                r = manager_append_bus_template(m, reply, MANAGER_BUS_TEMPLATE_ID_PATH, seat->id, p);
                 if (r < 0)
                         return r;
         }
@@ -667,7 +773,7 @@ static int method_list_inhibitors(sd_bus_message *message, void *userdata, sd_bu
 
         HASHMAP_FOREACH(inhibitor, m->inhibitors) {
 
-                r = sd_bus_message_append(reply, "(ssssuu)",
+                r = manager_append_bus_template(m, reply, MANAGER_BUS_TEMPLATE_INHIBITOR,
                                           strempty(inhibit_what_to_string(inhibitor->what)),
                                           strempty(inhibitor->who),
                                           strempty(inhibitor->why),
@@ -1463,6 +1569,11 @@ static int trigger_device(Manager *m, sd_device *parent) {
                 r = sd_device_enumerator_add_match_parent(e, parent);
                 if (r < 0)
                         return r;
+        } else {
+                /* Without a parent, all of /sys/bus/ and /sys/class/ is walked, spread that over all CPUs. */
+                r = device_enumerator_set_scan_threads(e, 0);
+                if (r < 0)
+                        return r;
         }
 
         FOREACH_DEVICE(e, d) {
@@ -1791,6 +1902,7 @@ static int elogind_run_helper( Manager* m, const char* helper, const char* arg_v
         m->callback_failed       = false;
         m->callback_must_succeed = m->allow_poweroff_interrupts;
 
+        manager_timeline_mark(m, TIMELINE_SHUTDOWN_HOOKS);
         r = execute_directories( dirs, DEFAULT_TIMEOUT_USEC, gather_output, gather_args, verb_args, NULL, EXEC_DIR_NONE );
 
         if ( m->callback_must_succeed && ( ( r < 0 ) || m->callback_failed ) ) {
@@ -1814,6 +1926,7 @@ static int elogind_run_helper( Manager* m, const char* helper, const char* arg_v
         if ( m->allow_poweroff_interrupts )
                 (void) send_prepare_for(m, handle_action_lookup(HANDLE_POWEROFF), true );
 
+        manager_timeline_mark(m, TIMELINE_SHUTDOWN_HELPER);
         r = safe_fork( helper, FORK_RESET_SIGNALS | FORK_REOPEN_LOG, &m->tool_fork_pid );
 
         if ( r < 0 )
@@ -1866,7 +1979,7 @@ static int elogind_execute_shutdown_or_sleep(
                 sd_bus_error *error) {
 
         char** argv_utmp = NULL;
-        int t = -1, r;
+        int t = -1, r, timeline_fd;
         const char *forker;
 
         assert( m );
@@ -1893,6 +2006,7 @@ static int elogind_execute_shutdown_or_sleep(
                 }
 
                 /* This comes from our patched update-utmp/update-utmp.c */
+                manager_timeline_mark( m, TIMELINE_UTMP );
                 update_utmp( 2, argv_utmp );
                 strv_free( argv_utmp );
         }
@@ -1903,11 +2017,18 @@ static int elogind_execute_shutdown_or_sleep(
          * make it impossible to talk to ourselves.
          */
         forker = strjoina( "e-", handle_action_to_string( a->handle ) );
-        t = safe_fork( forker,
-                       FORK_LOG|FORK_REOPEN_LOG|FORK_DEATHSIG_SIGTERM|FORK_CLOSE_ALL_FDS|FORK_REARRANGE_STDIO,
-                       &m->sleep_fork_pid );
+        manager_timeline_mark( m, TIMELINE_FORK );
+        timeline_fd = manager_timeline_prepare_fork( m );
+        t = safe_fork_full( forker,
+                            NULL,
+                            timeline_fd >= 0 ? &timeline_fd : NULL,
+                            timeline_fd >= 0,
+                            FORK_LOG|FORK_REOPEN_LOG|FORK_DEATHSIG_SIGTERM|FORK_CLOSE_ALL_FDS|FORK_REARRANGE_STDIO,
+                            &m->sleep_fork_pid );
 
         if ( t ) {
+                manager_timeline_forked( m );
+
                 /* no more pending actions, whether this failed or not */
                 m->delayed_action = NULL;
                 log_debug_elogind( "Forking off '%s' returned %d and set PID %d", forker, t, m->sleep_fork_pid );
@@ -1926,6 +2047,8 @@ static int elogind_execute_shutdown_or_sleep(
                 log_error_errno( r, "%s: shutdown_or_sleep failed: %m", program_invocation_short_name );
         }
 
+        manager_timeline_end( m, r );
+
         /* As elogind cannot rely on a systemd manager to call all
          * sleeping processes to wake up, we have to tell them all
          * by ourselves.
@@ -1954,6 +2077,8 @@ static int execute_shutdown_or_sleep(
         assert(m);
         assert(a);
 
+        manager_timeline_mark(m, TIMELINE_EXECUTE);
+
         if (a->inhibit_what == INHIBIT_SHUTDOWN)
                 bus_manager_log_shutdown(m, a);
 
@@ -1992,6 +2117,8 @@ error:
         /* Tell people that they now may take a lock again */
         (void) send_prepare_for(m, a, false);
 
+        manager_timeline_end(m, r);
+
         return r;
 }
 
@@ -2021,6 +2148,8 @@ int manager_dispatch_delayed(Manager *manager, bool timeout) {
                 log_notice("Delay lock is active (UID "UID_FMT"/%s, PID "PID_FMT"/%s) but inhibitor timeout is reached.",
                            offending->uid, strna(u),
                            offending->pid.pid, strna(comm));
+
+                manager_timeline_mark(manager, TIMELINE_INHIBITOR_TIMEOUT);
         }
 
         /* Actually do the operation */
@@ -2075,6 +2204,7 @@ static int delay_shutdown_or_sleep(
         }
 
         m->delayed_action = a;
+        manager_timeline_mark(m, TIMELINE_INHIBITOR_DELAY);
 
         return 0;
 }
@@ -2103,6 +2233,8 @@ int bus_manager_shutdown_or_sleep_now_or_later(
                                         a->target, load_state);
 #endif // 0
 
+        manager_timeline_begin(m, handle_action_to_string(a->handle));
+
 #if 1 /// elogind allows hook scripts to interrupt sleep/shutdown, only signal if no cancellation is possible.
         if ( ( (INHIBIT_SHUTDOWN == a->inhibit_what) && !m->allow_poweroff_interrupts) ||
              ( (INHIBIT_SLEEP    == a->inhibit_what) && !m->allow_suspend_interrupts ) ) {
@@ -2118,11 +2250,13 @@ int bus_manager_shutdown_or_sleep_now_or_later(
                 manager_is_inhibited(m, a->inhibit_what, INHIBIT_DELAY, NULL, false, false, 0, NULL);
 
         log_debug_elogind("Called for '%s' (%sdelayed)", handle_action_to_string(a->handle), delayed ? "" : "NOT ");
-        if (delayed)
+        if (delayed) {
                 /* Shutdown is delayed, keep in mind what we
                  * want to do, and start a timeout */
                 r = delay_shutdown_or_sleep(m, a);
-        else
+                if (r < 0)
+                        manager_timeline_end(m, r);
+        } else
                 /* Shutdown is not delayed, execute it
                  * immediately */
                 r = execute_shutdown_or_sleep(m, a, error);
@@ -3880,6 +4014,9 @@ static const sd_bus_vtable manager_vtable[] = {
         SD_BUS_PROPERTY("PreparingForShutdown", "b", property_get_preparing, 0, 0),
         SD_BUS_PROPERTY("PreparingForSleep", "b", property_get_preparing, 0, 0),
         SD_BUS_PROPERTY("ScheduledShutdown", "(st)", property_get_scheduled_shutdown, 0, 0),
+        SD_BUS_PROPERTY("ShutdownOrSleepTimeline", "a(sia(stt))", property_get_shutdown_or_sleep_timeline, 0, 0),
+        SD_BUS_PROPERTY("StartupUSec", "t", property_get_startup_usec, 0, SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("StartupPhases", "a(stt)", property_get_startup_phases, 0, SD_BUS_VTABLE_PROPERTY_CONST),
         SD_BUS_PROPERTY("Docked", "b", property_get_docked, 0, 0),
         SD_BUS_PROPERTY("LidClosed", "b", property_get_lid_closed, 0, 0),
         SD_BUS_PROPERTY("OnExternalPower", "b", property_get_on_external_power, 0, 0),
@@ -4449,6 +4586,48 @@ int manager_send_changed(Manager *manager, const char *property, ...) {
                         l);
 }
 
+static const char* const manager_bus_template_signature[_MANAGER_BUS_TEMPLATE_MAX] = {
+        [MANAGER_BUS_TEMPLATE_SESSION]   = "(susso)",
+        [MANAGER_BUS_TEMPLATE_USER]      = "(uso)",
+        [MANAGER_BUS_TEMPLATE_INHIBITOR] = "(ssssuu)",
+        [MANAGER_BUS_TEMPLATE_ID_PATH]   = "(so)",
+        [MANAGER_BUS_TEMPLATE_UID_PATH]  = "(uo)",
+};
+
+int manager_append_bus_template(Manager *manager, sd_bus_message *m, ManagerBusTemplate t, ...) {
+        va_list ap;
+        int r;
+
+        assert(manager);
+        assert(m);
+        assert(t >= 0 && t < _MANAGER_BUS_TEMPLATE_MAX);
+
+        /* The templates are compiled on first use and kept for the lifetime of the manager */
+        if (!manager->bus_templates[t]) {
+                r = sd_bus_message_template_new(&manager->bus_templates[t], manager_bus_template_signature[t]);
+                if (r < 0)
+                        return r;
+        }
+
+        va_start(ap, t);
+        r = sd_bus_message_append_templatev(m, manager->bus_templates[t], ap);
+        va_end(ap);
+
+        return r;
+}
+
+void manager_invalidate_bus_nodes(Manager *manager, const char *path) {
+        assert(manager);
+        assert(path);
+
+        /* Sessions, users and seats are enumerated by cached node enumerators, tell them whenever one
+         * appears or goes away */
+        if (!manager->bus)
+                return;
+
+        (void) sd_bus_invalidate_node_enumerators(manager->bus, path);
+}
+
 #if 0 /// UNNEEDED by elogind
 static int strdup_job(sd_bus_message *reply, char **job) {
         const char *j;
@@ -16,6 +16,7 @@
 #include "format-util.h"
 #include "fs-util.h"
 #include "io-util.h"
+#include "logind-checkpoint.h"
 #include "logind-dbus.h"
 #include "logind-inhibit.h"
 #include "missing_threads.h"
@@ -153,10 +154,12 @@ static int inhibitor_save(Inhibitor *i) {
         }
 
         temp_path = mfree(temp_path);
+        manager_checkpoint_mark_dirty(i->manager, i->state_file);
         return 0;
 
 fail:
         (void) unlink(i->state_file);
+        manager_checkpoint_mark_dirty(i->manager, i->state_file);
 
         return log_error_errno(r, "Failed to save inhibit data %s: %m", i->state_file);
 }
@@ -188,6 +191,9 @@ int inhibitor_start(Inhibitor *i) {
 
         inhibitor_save(i);
 
+        if (i->what & INHIBIT_IDLE)
+                manager_invalidate_idle_hint(i->manager);
+
         bus_manager_send_inhibited_change(i);
 
         return 0;
@@ -205,11 +211,16 @@ void inhibitor_stop(Inhibitor *i) {
 
         inhibitor_remove_fifo(i);
 
-        if (i->state_file)
+        if (i->state_file) {
                 (void) unlink(i->state_file);
+                manager_checkpoint_mark_dirty(i->manager, i->state_file);
+        }
 
         i->started = false;
 
+        if (i->what & INHIBIT_IDLE)
+                manager_invalidate_idle_hint(i->manager);
+
         bus_manager_send_inhibited_change(i);
 }
 
@@ -221,14 +232,14 @@ int inhibitor_load(Inhibitor *i) {
         ssize_t l;
         int r;
 
-        r = parse_env_file(NULL, i->state_file,
-                           "WHAT", &what,
-                           "UID", &uid,
-                           "PID", &pid,
-                           "WHO", &who,
-                           "WHY", &why,
-                           "MODE", &mode,
-                           "FIFO", &i->fifo_path);
+        r = manager_parse_state_file(i->manager, i->state_file,
+                                     "WHAT", &what,
+                                     "UID", &uid,
+                                     "PID", &pid,
+                                     "WHO", &who,
+                                     "WHY", &why,
+                                     "MODE", &mode,
+                                     "FIFO", &i->fifo_path);
         if (r < 0)
                 return log_error_errno(r, "Failed to read %s: %m", i->state_file);
 
@@ -41,7 +41,8 @@ static int property_get_active_session(
         if (!p)
                 return -ENOMEM;
 
-        return sd_bus_message_append(reply, "(so)", s->active ? s->active->id : "", p);
+        return manager_append_bus_template(s->manager, reply, MANAGER_BUS_TEMPLATE_ID_PATH,
+                                           s->active ? s->active->id : "", p);
 }
 
 static int property_get_sessions(
@@ -70,7 +71,7 @@ static int property_get_sessions(
                 if (!p)
                         return -ENOMEM;
 
-                r = sd_bus_message_append(reply, "(so)", session->id, p);
+                r = manager_append_bus_template(s->manager, reply, MANAGER_BUS_TEMPLATE_ID_PATH, session->id, p);
                 if (r < 0)
                         return r;
 
@@ -299,7 +300,6 @@ char *seat_bus_path(Seat *s) {
 
 static int seat_node_enumerator(sd_bus *bus, const char *path, void *userdata, char ***nodes, sd_bus_error *error) {
         _cleanup_strv_free_ char **l = NULL;
-        sd_bus_message *message;
         Manager *m = userdata;
         Seat *seat;
         int r;
@@ -320,6 +320,21 @@ static int seat_node_enumerator(sd_bus *bus, const char *path, void *userdata, c
                         return r;
         }
 
+        *nodes = TAKE_PTR(l);
+        return 1;
+}
+
+/* The "self" and "auto" aliases depend on the caller, hence unlike the list above they are never cached */
+static int seat_alias_node_enumerator(sd_bus *bus, const char *path, void *userdata, char ***nodes, sd_bus_error *error) {
+        _cleanup_strv_free_ char **l = NULL;
+        sd_bus_message *message;
+        Manager *m = userdata;
+        int r;
+
+        assert(bus);
+        assert(path);
+        assert(nodes);
+
         message = sd_bus_get_current_message(bus);
         if (message) {
                 _cleanup_(sd_bus_creds_unrefp) sd_bus_creds *creds = NULL;
@@ -438,5 +453,6 @@ const BusObjectImplementation seat_object = {
         "/org/freedesktop/login1/seat",
         "org.freedesktop.login1.Seat",
         .fallback_vtables = BUS_FALLBACK_VTABLES({seat_vtable, seat_object_find}),
-        .node_enumerator = seat_node_enumerator,
+        .node_enumerator = seat_alias_node_enumerator,
+        .cached_node_enumerator = seat_node_enumerator,
 };
@@ -14,6 +14,7 @@
 #include "fileio.h"
 #include "format-util.h"
 #include "fs-util.h"
+#include "logind-dbus.h"
 #include "logind-seat-dbus.h"
 #include "logind-seat.h"
 #include "logind-session-dbus.h"
@@ -54,6 +55,8 @@ int seat_new(Seat** ret, Manager *m, const char *id) {
         if (r < 0)
                 return r;
 
+        manager_invalidate_bus_nodes(m, "/org/freedesktop/login1/seat");
+
         *ret = TAKE_PTR(s);
         return 0;
 }
@@ -75,6 +78,7 @@ Seat* seat_free(Seat *s) {
                 device_free(s->devices);
 
         hashmap_remove(s->manager->seats, s->id);
+        manager_invalidate_bus_nodes(s->manager, "/org/freedesktop/login1/seat");
 
         free(s->positions);
         free(s->state_file);
@@ -551,6 +555,7 @@ int seat_attach_session(Seat *s, Session *session) {
         session->seat = s;
         LIST_PREPEND(sessions_by_seat, s->sessions, session);
         seat_assign_position(s, session);
+        manager_invalidate_idle_hint(s->manager);
 
         /* On seats with VTs, the VT logic defines which session is active. On
          * seats without VTs, we automatically activate new sessions. */
@@ -608,9 +613,13 @@ bool seat_can_graphical(Seat *s) {
 int seat_get_idle_hint(Seat *s, dual_timestamp *t) {
         bool idle_hint = true;
         dual_timestamp ts = DUAL_TIMESTAMP_NULL;
+        int r;
 
         assert(s);
 
+        if (idle_hint_cache_get(&s->idle_hint_cache, s->manager, t, &r))
+                return r;
+
         LIST_FOREACH(sessions_by_seat, session, s->sessions) {
                 dual_timestamp k;
                 int ih;
@@ -634,6 +643,8 @@ int seat_get_idle_hint(Seat *s, dual_timestamp *t) {
                 }
         }
 
+        idle_hint_cache_put(&s->idle_hint_cache, s->manager, idle_hint, &ts);
+
         if (t)
                 *t = ts;
 
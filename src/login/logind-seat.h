@@ -20,6 +20,8 @@ struct Seat {
 
         Session **positions;
 
+        IdleHintCache idle_hint_cache;
+
         bool in_gc_queue:1;
         bool started:1;
 
@@ -45,7 +45,8 @@ static int property_get_user(
         if (!p)
                 return -ENOMEM;
 
-        return sd_bus_message_append(reply, "(uo)", (uint32_t) s->user->user_record->uid, p);
+        return manager_append_bus_template(s->manager, reply, MANAGER_BUS_TEMPLATE_UID_PATH,
+                                           (uint32_t) s->user->user_record->uid, p);
 }
 
 static int property_get_name(
@@ -84,7 +85,8 @@ static int property_get_seat(
         if (!p)
                 return -ENOMEM;
 
-        return sd_bus_message_append(reply, "(so)", s->seat ? s->seat->id : "", p);
+        return manager_append_bus_template(s->manager, reply, MANAGER_BUS_TEMPLATE_ID_PATH,
+                                           s->seat ? s->seat->id : "", p);
 }
 
 static BUS_DEFINE_PROPERTY_GET_ENUM(property_get_type, session_type, SessionType);
@@ -667,7 +669,6 @@ char *session_bus_path(Session *s) {
 
 static int session_node_enumerator(sd_bus *bus, const char *path, void *userdata, char ***nodes, sd_bus_error *error) {
         _cleanup_strv_free_ char **l = NULL;
-        sd_bus_message *message;
         Manager *m = userdata;
         Session *session;
         int r;
@@ -688,6 +689,22 @@ static int session_node_enumerator(sd_bus *bus, const char *path, void *userdata
                         return r;
         }
 
+        *nodes = TAKE_PTR(l);
+        return 1;
+}
+
+/* The "self" and "auto" aliases depend on the caller, hence unlike the list above they are never cached */
+static int session_alias_node_enumerator(sd_bus *bus, const char *path, void *userdata, char ***nodes, sd_bus_error *error) {
+        _cleanup_strv_free_ char **l = NULL;
+        sd_bus_message *message;
+        Manager *m = userdata;
+        Session *session;
+        int r;
+
+        assert(bus);
+        assert(path);
+        assert(nodes);
+
         message = sd_bus_get_current_message(bus);
         if (message) {
                 _cleanup_(sd_bus_creds_unrefp) sd_bus_creds *creds = NULL;
@@ -1002,5 +1019,6 @@ const BusObjectImplementation session_object = {
         "/org/freedesktop/login1/session",
         "org.freedesktop.login1.Session",
         .fallback_vtables = BUS_FALLBACK_VTABLES({session_vtable, session_object_find}),
-        .node_enumerator = session_node_enumerator,
+        .node_enumerator = session_alias_node_enumerator,
+        .cached_node_enumerator = session_node_enumerator,
 };
@@ -23,6 +23,7 @@
 #include "format-util.h"
 #include "fs-util.h"
 #include "io-util.h"
+#include "logind-checkpoint.h"
 #include "logind-dbus.h"
 #include "logind-seat-dbus.h"
 #include "logind-session-dbus.h"
@@ -86,6 +87,8 @@ int session_new(Session **ret, Manager *m, const char *id) {
         if (r < 0)
                 return r;
 
+        manager_invalidate_bus_nodes(m, "/org/freedesktop/login1/session");
+
         *ret = TAKE_PTR(s);
         return 0;
 }
@@ -163,10 +166,14 @@ Session* session_free(Session *s) {
         free(s->desktop);
 
         hashmap_remove(s->manager->sessions, s->id);
+        manager_invalidate_bus_nodes(s->manager, "/org/freedesktop/login1/session");
 
         sd_event_source_unref(s->fifo_event_source);
         safe_close(s->fifo_fd);
 
+        free(s->idle_tty);
+        manager_invalidate_idle_hint(s->manager);
+
         /* Note that we remove neither the state file nor the fifo path here, since we want both to survive
          * daemon restarts */
         free(s->state_file);
@@ -185,6 +192,7 @@ void session_set_user(Session *s, User *u) {
         LIST_PREPEND(sessions_by_user, u->sessions, s);
 
         user_update_last_session_timer(u);
+        manager_invalidate_idle_hint(s->manager);
 }
 
 int session_set_leader_consume(Session *s, PidRef _leader) {
@@ -200,6 +208,8 @@ int session_set_leader_consume(Session *s, PidRef _leader) {
         session_reset_leader(s);
 
         s->leader = TAKE_PIDREF(pidref);
+        s->idle_tty = mfree(s->idle_tty);
+        manager_invalidate_idle_hint(s->manager);
 
         r = hashmap_ensure_put(&s->manager->sessions_by_leader, &pidref_hash_ops, &s->leader, s);
         if (r < 0)
@@ -373,10 +383,12 @@ int session_save(Session *s) {
         }
 
         temp_path = mfree(temp_path);
+        manager_checkpoint_mark_dirty(s->manager, s->state_file);
         return 0;
 
 fail:
         (void) unlink(s->state_file);
+        manager_checkpoint_mark_dirty(s->manager, s->state_file);
 
         return log_error_errno(r, "Failed to save session data %s: %m", s->state_file);
 }
@@ -441,35 +453,35 @@ int session_load(Session *s) {
 
         assert(s);
 
-        r = parse_env_file(NULL, s->state_file,
-                           "REMOTE",         &remote,
-                           "SCOPE",          &s->scope,
+        r = manager_parse_state_file(s->manager, s->state_file,
+                                     "REMOTE",         &remote,
+                                     "SCOPE",          &s->scope,
 #if 0 /// elogind does not support systemd scope_jobs
-                           "SCOPE_JOB",      &s->scope_job,
+                                     "SCOPE_JOB",      &s->scope_job,
 #endif // 0
-                           "FIFO",           &s->fifo_path,
-                           "SEAT",           &seat,
-                           "TTY",            &s->tty,
-                           "TTY_VALIDITY",   &tty_validity,
-                           "DISPLAY",        &s->display,
-                           "REMOTE_HOST",    &s->remote_host,
-                           "REMOTE_USER",    &s->remote_user,
-                           "SERVICE",        &s->service,
-                           "DESKTOP",        &s->desktop,
-                           "VTNR",           &vtnr,
-                           "STATE",          &state,
-                           "POSITION",       &position,
-                           "LEADER",         &leader,
-                           "TYPE",           &type,
-                           "ORIGINAL_TYPE",  &original_type,
-                           "CLASS",          &class,
-                           "UID",            &uid,
-                           "REALTIME",       &realtime,
-                           "MONOTONIC",      &monotonic,
-                           "CONTROLLER",     &controller,
-                           "ACTIVE",         &active,
-                           "DEVICES",        &devices,
-                           "IS_DISPLAY",     &is_display);
+                                     "FIFO",           &s->fifo_path,
+                                     "SEAT",           &seat,
+                                     "TTY",            &s->tty,
+                                     "TTY_VALIDITY",   &tty_validity,
+                                     "DISPLAY",        &s->display,
+                                     "REMOTE_HOST",    &s->remote_host,
+                                     "REMOTE_USER",    &s->remote_user,
+                                     "SERVICE",        &s->service,
+                                     "DESKTOP",        &s->desktop,
+                                     "VTNR",           &vtnr,
+                                     "STATE",          &state,
+                                     "POSITION",       &position,
+                                     "LEADER",         &leader,
+                                     "TYPE",           &type,
+                                     "ORIGINAL_TYPE",  &original_type,
+                                     "CLASS",          &class,
+                                     "UID",            &uid,
+                                     "REALTIME",       &realtime,
+                                     "MONOTONIC",      &monotonic,
+                                     "CONTROLLER",     &controller,
+                                     "ACTIVE",         &active,
+                                     "DEVICES",        &devices,
+                                     "IS_DISPLAY",     &is_display);
         if (r < 0)
                 return log_error_errno(r, "Failed to read %s: %m", s->state_file);
 
@@ -1020,6 +1032,7 @@ int session_finalize(Session *s) {
                 session_device_free(sd);
 
         (void) unlink(s->state_file);
+        manager_checkpoint_mark_dirty(s->manager, s->state_file);
         session_add_to_gc_queue(s);
         user_add_to_gc_queue(s->user);
 
@@ -1107,57 +1120,53 @@ static int get_tty_atime(const char *tty, usec_t *atime) {
         return 0;
 }
 
-static int get_process_ctty_atime(pid_t pid, usec_t *atime) {
+static int session_get_tty_atime(Session *s, usec_t *atime) {
         _cleanup_free_ char *p = NULL;
         int r;
 
-        assert(pid > 0);
-        assert(atime);
-
-        r = get_ctty(pid, NULL, &p);
-        if (r < 0)
-                return r;
-
-        return get_tty_atime(p, atime);
-}
-
-int session_get_idle_hint(Session *s, dual_timestamp *t) {
-        usec_t atime = 0, dtime = 0;
-        int r;
-
         assert(s);
+        assert(atime);
 
-        /* Graphical sessions have an explicit idle hint */
-        if (SESSION_TYPE_IS_GRAPHICAL(s->type)) {
-                if (t)
-                        *t = s->idle_hint_timestamp;
+        /* Resolving the controlling tty of the leader requires reading /proc, hence remember the tty we
+         * found, and only look it up again if it went away or the session changed its tty or leader. */
+        if (s->idle_tty) {
+                r = get_tty_atime(s->idle_tty, atime);
+                if (r >= 0)
+                        return 0;
 
-                return s->idle_hint;
+                s->idle_tty = mfree(s->idle_tty);
         }
 
         /* For sessions with an explicitly configured tty, let's check its atime */
         if (s->tty) {
-                r = get_tty_atime(s->tty, &atime);
-                if (r >= 0)
-                        goto found_atime;
+                r = get_tty_atime(s->tty, atime);
+                if (r >= 0) {
+                        (void) free_and_strdup(&s->idle_tty, s->tty);
+                        return 0;
+                }
         }
 
         /* For sessions with a leader but no explicitly configured tty, let's check the controlling tty of
          * the leader */
-        if (pidref_is_set(&s->leader)) {
-                r = get_process_ctty_atime(s->leader.pid, &atime);
-                if (r >= 0)
-                        goto found_atime;
-        }
+        if (!pidref_is_set(&s->leader))
+                return -ENXIO;
 
-        if (t)
-                *t = DUAL_TIMESTAMP_NULL;
+        r = get_ctty(s->leader.pid, NULL, &p);
+        if (r < 0)
+                return r;
+
+        r = get_tty_atime(p, atime);
+        if (r < 0)
+                return r;
 
-        return false;
+        free_and_replace(s->idle_tty, p);
+        return 0;
+}
 
-found_atime:
-        if (t)
-                dual_timestamp_from_realtime(t, atime);
+static bool session_tty_is_idle(Session *s, usec_t atime) {
+        usec_t dtime;
+
+        assert(s);
 
         if (s->manager->idle_action_usec > 0 && s->manager->stop_idle_session_usec != USEC_INFINITY)
                 dtime = MIN(s->manager->idle_action_usec, s->manager->stop_idle_session_usec);
@@ -1171,6 +1180,37 @@ found_atime:
         return usec_add(atime, dtime) <= now(CLOCK_REALTIME);
 }
 
+int session_get_idle_hint(Session *s, dual_timestamp *t) {
+        dual_timestamp ts = DUAL_TIMESTAMP_NULL;
+        usec_t atime;
+        int idle = false;
+
+        assert(s);
+
+        /* Graphical sessions have an explicit idle hint */
+        if (SESSION_TYPE_IS_GRAPHICAL(s->type)) {
+                if (t)
+                        *t = s->idle_hint_timestamp;
+
+                return s->idle_hint;
+        }
+
+        if (idle_hint_cache_get(&s->idle_hint_cache, s->manager, t, &idle))
+                return idle;
+
+        if (session_get_tty_atime(s, &atime) >= 0) {
+                dual_timestamp_from_realtime(&ts, atime);
+                idle = session_tty_is_idle(s, atime);
+        }
+
+        idle_hint_cache_put(&s->idle_hint_cache, s->manager, idle, &ts);
+
+        if (t)
+                *t = ts;
+
+        return idle;
+}
+
 int session_set_idle_hint(Session *s, bool b) {
         assert(s);
 
@@ -1182,6 +1222,7 @@ int session_set_idle_hint(Session *s, bool b) {
 
         s->idle_hint = b;
         dual_timestamp_now(&s->idle_hint_timestamp);
+        manager_invalidate_idle_hint(s->manager);
 
         session_send_changed(s, "IdleHint", "IdleSinceHint", "IdleSinceHintMonotonic", NULL);
 
@@ -1219,6 +1260,7 @@ void session_set_type(Session *s, SessionType t) {
 
         s->type = t;
         session_save(s);
+        manager_invalidate_idle_hint(s->manager);
 
         session_send_changed(s, "Type", NULL);
 }
@@ -1250,6 +1292,9 @@ int session_set_tty(Session *s, const char *tty) {
         if (r <= 0)  /* 0 means the strings were equal */
                 return r;
 
+        s->idle_tty = mfree(s->idle_tty);
+        manager_invalidate_idle_hint(s->manager);
+
         session_save(s);
 
         session_send_changed(s, "TTY", NULL);
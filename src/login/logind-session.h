@@ -101,6 +101,8 @@ struct Session {
 
         bool idle_hint;
         dual_timestamp idle_hint_timestamp;
+        char *idle_tty; /* the tty whose atime was checked last, see session_get_tty_atime() */
+        IdleHintCache idle_hint_cache;
 
         bool locked_hint;
 
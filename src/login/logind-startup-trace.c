@@ -0,0 +1,144 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "alloc-util.h"
+#include "fileio.h"
+#include "log.h"
+#include "logind-startup-trace.h"
+#include "string-table.h"
+
+/* Records how long each phase of the start-up took, and how many objects (devices, users, sessions, …) it
+ * handled, so that it can be told which of them to blame when start-up is slow. The phases run one after
+ * the other, hence each one is simply timed from the end of the previous one. */
+
+void startup_trace_init(StartupTrace *t, usec_t begin) {
+        assert(t);
+
+        *t = (StartupTrace) {
+                .begin = begin,
+                .last = begin,
+        };
+}
+
+void startup_trace_mark_at(StartupTrace *t, StartupPhase phase, uint64_t n_objects, usec_t at) {
+        StartupPhaseTrace *p;
+
+        assert(t);
+        assert(phase >= 0 && phase < _STARTUP_PHASE_MAX);
+
+        /* Phases that happen to run again later on (e.g. session enumeration) are not start-up anymore */
+        if (t->ready > 0)
+                return;
+
+        p = t->phases + phase;
+
+        /* A phase that runs more than once is accounted for in total */
+        p->recorded = true;
+        p->usec = usec_add(p->usec, usec_sub_unsigned(at, t->last));
+        p->n_objects += n_objects;
+
+        t->last = MAX(t->last, at);
+}
+
+void startup_trace_mark(StartupTrace *t, StartupPhase phase, uint64_t n_objects) {
+        startup_trace_mark_at(t, phase, n_objects, now(CLOCK_MONOTONIC));
+}
+
+void startup_trace_ready(StartupTrace *t) {
+        assert(t);
+
+        t->ready = now(CLOCK_MONOTONIC);
+
+        for (StartupPhase i = 0; i < _STARTUP_PHASE_MAX; i++)
+                if (t->phases[i].recorded)
+                        log_debug("Start-up phase %s took %s, %" PRIu64 " objects.",
+                                  startup_phase_to_string(i),
+                                  FORMAT_TIMESPAN(t->phases[i].usec, 1),
+                                  t->phases[i].n_objects);
+
+        log_debug("Start-up finished in %s.", FORMAT_TIMESPAN(startup_trace_total(t), 1));
+}
+
+usec_t startup_trace_total(const StartupTrace *t) {
+        assert(t);
+
+        if (t->ready == 0)
+                return 0;
+
+        return usec_sub_unsigned(t->ready, t->begin);
+}
+
+int startup_trace_build_json(const StartupTrace *t, JsonVariant **ret) {
+        _cleanup_(json_variant_unrefp) JsonVariant *phases = NULL;
+        int r;
+
+        assert(t);
+        assert(ret);
+
+        for (StartupPhase i = 0; i < _STARTUP_PHASE_MAX; i++) {
+                if (!t->phases[i].recorded)
+                        continue;
+
+                r = json_variant_append_arrayb(
+                                &phases,
+                                JSON_BUILD_OBJECT(
+                                                JSON_BUILD_PAIR("phase", JSON_BUILD_STRING(startup_phase_to_string(i))),
+                                                JSON_BUILD_PAIR_UNSIGNED("usec", t->phases[i].usec),
+                                                JSON_BUILD_PAIR_UNSIGNED("objects", t->phases[i].n_objects)));
+                if (r < 0)
+                        return r;
+        }
+
+        if (!phases) {
+                r = json_variant_new_array(&phases, NULL, 0);
+                if (r < 0)
+                        return r;
+        }
+
+        return json_build(ret,
+                          JSON_BUILD_OBJECT(
+                                          JSON_BUILD_PAIR_UNSIGNED("totalUSec", startup_trace_total(t)),
+                                          JSON_BUILD_PAIR("phases", JSON_BUILD_VARIANT(phases))));
+}
+
+int startup_trace_write(const StartupTrace *t, const char *path) {
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        _cleanup_free_ char *s = NULL;
+        int r;
+
+        assert(t);
+        assert(path);
+
+        r = startup_trace_build_json(t, &v);
+        if (r < 0)
+                return r;
+
+        r = json_variant_format(v, 0, &s);
+        if (r < 0)
+                return r;
+
+        return write_string_file(path, s, WRITE_STRING_FILE_CREATE|WRITE_STRING_FILE_ATOMIC|WRITE_STRING_FILE_MKDIR_0755);
+}
+
+static const char* const startup_phase_table[_STARTUP_PHASE_MAX] = {
+        [STARTUP_DAEMONIZE]                = "daemonize",
+        [STARTUP_MANAGER]                  = "manager",
+        [STARTUP_CONFIG]                   = "config",
+        [STARTUP_SIGNALS]                  = "signals",
+        [STARTUP_CONNECT_CONSOLE]          = "connect-console",
+        [STARTUP_CONNECT_UDEV]             = "connect-udev",
+        [STARTUP_CONNECT_BUS]              = "connect-bus",
+        [STARTUP_CHECKPOINT]               = "checkpoint",
+        [STARTUP_ENUMERATE_DEVICES]        = "enumerate-devices",
+        [STARTUP_ENUMERATE_SEATS]          = "enumerate-seats",
+        [STARTUP_ENUMERATE_USERS]          = "enumerate-users",
+        [STARTUP_ENUMERATE_SESSIONS]       = "enumerate-sessions",
+        [STARTUP_ATTACH_FDS]               = "attach-fds",
+        [STARTUP_ENUMERATE_INHIBITORS]     = "enumerate-inhibitors",
+        [STARTUP_ENUMERATE_BUTTONS]        = "enumerate-buttons",
+        [STARTUP_ENUMERATE_POWER_SUPPLIES] = "enumerate-power-supplies",
+        [STARTUP_GC]                       = "gc",
+        [STARTUP_READ_UTMP]                = "read-utmp",
+        [STARTUP_START]                    = "start",
+};
+
+DEFINE_STRING_TABLE_LOOKUP(startup_phase, StartupPhase);
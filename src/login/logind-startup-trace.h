@@ -0,0 +1,65 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include "json.h"
+#include "macro.h"
+#include "time-util.h"
+
+/* The phases of the daemon's start-up, in the order they run in. Each one lasts from the end of the
+ * previous one until it is marked. "manager" includes setting up the cgroup hierarchy, "signals" the
+ * elogind specific signal handlers. */
+typedef enum StartupPhase {
+        STARTUP_DAEMONIZE,
+        STARTUP_MANAGER,
+        STARTUP_CONFIG,
+        STARTUP_SIGNALS,
+        STARTUP_CONNECT_CONSOLE,
+        STARTUP_CONNECT_UDEV,
+        STARTUP_CONNECT_BUS,
+        STARTUP_CHECKPOINT,
+        STARTUP_ENUMERATE_DEVICES,
+        STARTUP_ENUMERATE_SEATS,
+        STARTUP_ENUMERATE_USERS,
+        STARTUP_ENUMERATE_SESSIONS,
+        STARTUP_ATTACH_FDS,
+        STARTUP_ENUMERATE_INHIBITORS,
+        STARTUP_ENUMERATE_BUTTONS,
+        STARTUP_ENUMERATE_POWER_SUPPLIES,
+        STARTUP_GC,
+        STARTUP_READ_UTMP,
+        STARTUP_START,
+        _STARTUP_PHASE_MAX,
+        _STARTUP_PHASE_INVALID = -EINVAL,
+} StartupPhase;
+
+typedef struct StartupPhaseTrace {
+        bool recorded;
+        usec_t usec;
+        uint64_t n_objects;
+} StartupPhaseTrace;
+
+typedef struct StartupTrace {
+        usec_t begin; /* CLOCK_MONOTONIC, all of them */
+        usec_t last;
+        usec_t ready;
+        StartupPhaseTrace phases[_STARTUP_PHASE_MAX];
+} StartupTrace;
+
+/* If set, the start-up trace is written to this file as JSON once the daemon is ready, so that test suites
+ * can check it for regressions */
+#define STARTUP_TRACE_ENV "ELOGIND_STARTUP_TRACE"
+
+void startup_trace_init(StartupTrace *t, usec_t begin);
+void startup_trace_mark_at(StartupTrace *t, StartupPhase phase, uint64_t n_objects, usec_t at);
+void startup_trace_mark(StartupTrace *t, StartupPhase phase, uint64_t n_objects);
+void startup_trace_ready(StartupTrace *t);
+
+usec_t startup_trace_total(const StartupTrace *t);
+int startup_trace_build_json(const StartupTrace *t, JsonVariant **ret);
+int startup_trace_write(const StartupTrace *t, const char *path);
+
+const char* startup_phase_to_string(StartupPhase p) _const_;
+StartupPhase startup_phase_from_string(const char *s) _pure_;
@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "sd-event.h"
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "hashmap.h"
+#include "logind-button.h"
+#include "logind-test-util.h"
+#include "logind-timeline.h"
+#include "tests.h"
+
+Manager* test_manager_free(Manager *m) {
+        Button *b;
+
+        if (!m)
+                return NULL;
+
+        while ((b = hashmap_first(m->buttons)))
+                button_free(b);
+
+        hashmap_free(m->buttons);
+
+        manager_timeline_flush(m);
+
+        sd_event_source_unref(m->power_key_long_press_event_source);
+        sd_event_source_unref(m->reboot_key_long_press_event_source);
+        sd_event_source_unref(m->suspend_key_long_press_event_source);
+        sd_event_source_unref(m->hibernate_key_long_press_event_source);
+        sd_event_unref(m->event);
+
+        return mfree(m);
+}
+
+Manager* test_manager_new(void) {
+        _cleanup_(test_manager_freep) Manager *m = NULL;
+
+        assert_se(m = new0(Manager, 1));
+        assert_se(sd_event_new(&m->event) >= 0);
+        assert_se(m->buttons = hashmap_new(&string_hash_ops));
+        m->handle_lid_switch_ep = _HANDLE_ACTION_INVALID;
+        m->timeline_fd = -EBADF;
+
+        return TAKE_PTR(m);
+}
@@ -0,0 +1,12 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include "logind.h"
+#include "macro.h"
+
+/* A Manager with just an event loop and an empty set of buttons, for tests that drive parts of logind
+ * without connecting to anything. All actions are left at HANDLE_IGNORE, so that nothing is acted on for
+ * real. */
+Manager* test_manager_new(void);
+Manager* test_manager_free(Manager *m);
+DEFINE_TRIVIAL_CLEANUP_FUNC(Manager*, test_manager_free);
@@ -0,0 +1,293 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <sys/socket.h>
+
+#include "sd-event.h"
+
+#include "alloc-util.h"
+#include "errno-util.h"
+#include "fd-util.h"
+#include "logind-timeline.h"
+#include "logind.h"
+#include "string-table.h"
+#include "string-util.h"
+
+/* A shutdown or sleep operation passes through logind itself (the request, the wait for delay inhibitors),
+ * and then through a forked off child, which runs the hooks and does the actual work, see
+ * elogind_execute_shutdown_or_sleep(). The timeline records when each of the phases began, so that it can
+ * be told where the time went. The child cannot record its marks directly, hence it sends them back to
+ * logind over a socket, one datagram per mark.
+ *
+ * Durations are taken from CLOCK_MONOTONIC, which does not advance while the system is suspended: the
+ * "sleep" phase covers the time the kernel needed to suspend and resume, not the time spent asleep. */
+
+typedef struct TimelineMessage {
+        TimelinePhase phase;
+        int result;
+        dual_timestamp timestamp;
+} TimelineMessage;
+
+Timeline* timeline_free(Timeline *t) {
+        if (!t)
+                return NULL;
+
+        free(t->marks);
+        return mfree(t);
+}
+
+static int timeline_add_mark(Timeline *t, TimelinePhase phase, const dual_timestamp *ts) {
+        assert(t);
+        assert(ts);
+
+        if (!GREEDY_REALLOC(t->marks, t->n_marks + 1))
+                return -ENOMEM;
+
+        t->marks[t->n_marks++] = (TimelineMark) {
+                .phase = phase,
+                .timestamp = *ts,
+        };
+
+        return 0;
+}
+
+static void timeline_log(const Timeline *t) {
+        _cleanup_free_ char *phases = NULL;
+        usec_t total;
+
+        assert(t);
+
+        if (t->n_marks == 0)
+                return;
+
+        for (size_t i = 0; i + 1 < t->n_marks; i++)
+                if (strextendf_with_separator(
+                                    &phases, ", ", "%s %s",
+                                    timeline_phase_to_string(t->marks[i].phase),
+                                    FORMAT_TIMESPAN(usec_sub_unsigned(t->marks[i + 1].timestamp.monotonic,
+                                                                      t->marks[i].timestamp.monotonic),
+                                                    USEC_PER_MSEC)) < 0) {
+                        log_oom_debug();
+                        return;
+                }
+
+        total = usec_sub_unsigned(t->marks[t->n_marks - 1].timestamp.monotonic, t->marks[0].timestamp.monotonic);
+
+        if (t->result < 0)
+                log_notice_errno(t->result, "Operation '%s' failed after %s (%m): %s",
+                                 t->action, FORMAT_TIMESPAN(total, USEC_PER_MSEC), strna(phases));
+        else
+                log_info("Operation '%s' finished after %s: %s",
+                         t->action, FORMAT_TIMESPAN(total, USEC_PER_MSEC), strna(phases));
+}
+
+static void manager_timeline_send(Manager *m, TimelinePhase phase, int result) {
+        TimelineMessage message = {
+                .phase = phase,
+                .result = result,
+        };
+
+        assert(m);
+        assert(m->timeline_fd >= 0);
+
+        dual_timestamp_now(&message.timestamp);
+
+        /* Whatever happened to logind, the operation must not block on or be killed by this */
+        if (send(m->timeline_fd, &message, sizeof(message), MSG_DONTWAIT|MSG_NOSIGNAL) < 0)
+                log_debug_errno(errno, "Failed to send timeline mark '%s', ignoring: %m",
+                                timeline_phase_to_string(phase));
+}
+
+static void manager_timeline_end_at(Manager *m, int result, const dual_timestamp *ts) {
+        _cleanup_(timeline_freep) Timeline *t = NULL;
+
+        assert(m);
+        assert(ts);
+
+        m->timeline_event_source = sd_event_source_disable_unref(m->timeline_event_source);
+
+        t = TAKE_PTR(m->timeline);
+        if (!t)
+                return;
+
+        t->result = result;
+        if (timeline_add_mark(t, TIMELINE_FINISH, ts) < 0)
+                return (void) log_oom_debug();
+
+        timeline_log(t);
+
+        if (!GREEDY_REALLOC(m->timelines, m->n_timelines + 1))
+                return (void) log_oom_debug();
+
+        if (m->n_timelines >= TIMELINES_MAX) {
+                timeline_free(m->timelines[0]);
+                memmove(m->timelines, m->timelines + 1, (m->n_timelines - 1) * sizeof(Timeline*));
+                m->n_timelines--;
+        }
+
+        m->timelines[m->n_timelines++] = TAKE_PTR(t);
+}
+
+void manager_timeline_begin(Manager *m, const char *action) {
+        _cleanup_(timeline_freep) Timeline *t = NULL;
+        dual_timestamp ts;
+
+        assert(m);
+        assert(action);
+
+        /* Timelines are informational only, hence failures here never affect the operation itself */
+
+        if (m->timeline)
+                /* The child of the previous operation is still running, stop waiting for it */
+                manager_timeline_end(m, -ECANCELED);
+
+        t = new(Timeline, 1);
+        if (!t)
+                return (void) log_oom_debug();
+
+        *t = (Timeline) {
+                .action = action,
+        };
+
+        if (timeline_add_mark(t, TIMELINE_REQUEST, dual_timestamp_now(&ts)) < 0)
+                return (void) log_oom_debug();
+
+        m->timeline = TAKE_PTR(t);
+}
+
+void manager_timeline_mark(Manager *m, TimelinePhase phase) {
+        dual_timestamp ts;
+
+        assert(m);
+        assert(phase >= 0 && phase < _TIMELINE_PHASE_MAX);
+
+        if (m->timeline_fd >= 0)
+                return manager_timeline_send(m, phase, 0);
+
+        if (!m->timeline)
+                return;
+
+        if (timeline_add_mark(m->timeline, phase, dual_timestamp_now(&ts)) < 0)
+                log_oom_debug();
+}
+
+void manager_timeline_end(Manager *m, int result) {
+        dual_timestamp ts;
+
+        assert(m);
+
+        if (m->timeline_fd >= 0)
+                return manager_timeline_send(m, TIMELINE_FINISH, result);
+
+        manager_timeline_end_at(m, result, dual_timestamp_now(&ts));
+}
+
+void manager_timeline_flush(Manager *m) {
+        assert(m);
+
+        m->timeline_event_source = sd_event_source_disable_unref(m->timeline_event_source);
+        m->timeline_fd = safe_close(m->timeline_fd);
+        m->timeline = timeline_free(m->timeline);
+
+        FOREACH_ARRAY(t, m->timelines, m->n_timelines)
+                timeline_free(*t);
+        m->timelines = mfree(m->timelines);
+        m->n_timelines = 0;
+}
+
+static int manager_timeline_dispatch(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
+        Manager *m = ASSERT_PTR(userdata);
+        TimelineMessage message;
+        ssize_t n;
+
+        assert(m->timeline_event_source == s);
+
+        n = recv(fd, &message, sizeof(message), MSG_DONTWAIT);
+        if (n < 0) {
+                if (ERRNO_IS_TRANSIENT(errno))
+                        return 0;
+
+                log_debug_errno(errno, "Failed to receive timeline mark, not waiting for further ones: %m");
+                n = 0;
+        }
+        if (n == 0) {
+                /* The child is gone without telling us how the operation went */
+                manager_timeline_end(m, -EPIPE);
+                return 0;
+        }
+
+        if (n != sizeof(message) || message.phase < 0 || message.phase >= _TIMELINE_PHASE_MAX) {
+                log_debug("Received malformed timeline mark, ignoring.");
+                return 0;
+        }
+
+        if (message.phase == TIMELINE_FINISH)
+                manager_timeline_end_at(m, message.result, &message.timestamp);
+        else if (m->timeline && timeline_add_mark(m->timeline, message.phase, &message.timestamp) < 0)
+                log_oom_debug();
+
+        return 0;
+}
+
+int manager_timeline_prepare_fork(Manager *m) {
+        _cleanup_close_pair_ int pair[2] = EBADF_PAIR;
+        int r;
+
+        assert(m);
+        assert(m->timeline_fd < 0);
+
+        /* Returns the fd the child has to keep open to report its marks. Call manager_timeline_forked() in
+         * the parent once the child was forked off. */
+
+        if (!m->timeline)
+                return -ENODATA;
+
+        m->timeline_event_source = sd_event_source_disable_unref(m->timeline_event_source);
+
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, pair) < 0)
+                return log_debug_errno(errno, "Failed to create timeline socket pair: %m");
+
+        r = sd_event_add_io(m->event, &m->timeline_event_source, pair[0], EPOLLIN, manager_timeline_dispatch, m);
+        if (r < 0)
+                return log_debug_errno(r, "Failed to watch timeline socket: %m");
+
+        r = sd_event_source_set_io_fd_own(m->timeline_event_source, true);
+        if (r < 0) {
+                m->timeline_event_source = sd_event_source_disable_unref(m->timeline_event_source);
+                return log_debug_errno(r, "Failed to pass ownership of timeline socket: %m");
+        }
+
+        TAKE_FD(pair[0]);
+
+        (void) sd_event_source_set_description(m->timeline_event_source, "timeline");
+
+        return m->timeline_fd = TAKE_FD(pair[1]);
+}
+
+void manager_timeline_forked(Manager *m) {
+        assert(m);
+
+        /* Only the child reports through the socket, everything else in here is recorded directly again */
+        m->timeline_fd = safe_close(m->timeline_fd);
+}
+
+static const char* const timeline_phase_table[_TIMELINE_PHASE_MAX] = {
+        [TIMELINE_REQUEST]            = "request",
+        [TIMELINE_INHIBITOR_DELAY]    = "inhibitor-delay",
+        [TIMELINE_INHIBITOR_TIMEOUT]  = "inhibitor-timeout",
+        [TIMELINE_EXECUTE]            = "execute",
+        [TIMELINE_UTMP]               = "utmp",
+        [TIMELINE_FORK]               = "fork",
+        [TIMELINE_SLEEP_CONFIG]       = "sleep-config",
+        [TIMELINE_HIBERNATION_DEVICE] = "hibernation-device",
+        [TIMELINE_PRE_HOOKS]          = "pre-hooks",
+        [TIMELINE_NVIDIA_SUSPEND]     = "nvidia-suspend",
+        [TIMELINE_SLEEP]              = "sleep",
+        [TIMELINE_RESUME]             = "resume",
+        [TIMELINE_NVIDIA_RESUME]      = "nvidia-resume",
+        [TIMELINE_POST_HOOKS]         = "post-hooks",
+        [TIMELINE_SHUTDOWN_HOOKS]     = "shutdown-hooks",
+        [TIMELINE_SHUTDOWN_HELPER]    = "shutdown-helper",
+        [TIMELINE_FINISH]             = "finish",
+};
+
+DEFINE_STRING_TABLE_LOOKUP(timeline_phase, TimelinePhase);
@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include "macro.h"
+#include "time-util.h"
+
+typedef struct Manager Manager;
+
+/* Each mark records when a phase of a shutdown or sleep operation began, a phase lasts until the next mark */
+typedef enum TimelinePhase {
+        TIMELINE_REQUEST,
+        TIMELINE_INHIBITOR_DELAY,
+        TIMELINE_INHIBITOR_TIMEOUT,
+        TIMELINE_EXECUTE,
+        TIMELINE_UTMP,
+        TIMELINE_FORK,
+        TIMELINE_SLEEP_CONFIG,
+        TIMELINE_HIBERNATION_DEVICE,
+        TIMELINE_PRE_HOOKS,
+        TIMELINE_NVIDIA_SUSPEND,
+        TIMELINE_SLEEP,
+        TIMELINE_RESUME,
+        TIMELINE_NVIDIA_RESUME,
+        TIMELINE_POST_HOOKS,
+        TIMELINE_SHUTDOWN_HOOKS,
+        TIMELINE_SHUTDOWN_HELPER,
+        TIMELINE_FINISH,
+        _TIMELINE_PHASE_MAX,
+        _TIMELINE_PHASE_INVALID = -EINVAL,
+} TimelinePhase;
+
+typedef struct TimelineMark {
+        TimelinePhase phase;
+        dual_timestamp timestamp;
+} TimelineMark;
+
+typedef struct Timeline {
+        const char *action;
+        int result;
+        TimelineMark *marks;
+        size_t n_marks;
+} Timeline;
+
+/* How many finished operations are kept */
+#define TIMELINES_MAX 16U
+
+Timeline* timeline_free(Timeline *t);
+DEFINE_TRIVIAL_CLEANUP_FUNC(Timeline*, timeline_free);
+
+void manager_timeline_begin(Manager *m, const char *action);
+void manager_timeline_mark(Manager *m, TimelinePhase phase);
+void manager_timeline_end(Manager *m, int result);
+void manager_timeline_flush(Manager *m);
+
+int manager_timeline_prepare_fork(Manager *m);
+void manager_timeline_forked(Manager *m);
+
+const char* timeline_phase_to_string(TimelinePhase p) _const_;
+TimelinePhase timeline_phase_from_string(const char *s) _pure_;
@@ -89,7 +89,8 @@ static int property_get_display(
         if (!p)
                 return -ENOMEM;
 
-        return sd_bus_message_append(reply, "(so)", u->display ? u->display->id : "", p);
+        return manager_append_bus_template(u->manager, reply, MANAGER_BUS_TEMPLATE_ID_PATH,
+                                           u->display ? u->display->id : "", p);
 }
 
 static int property_get_sessions(
@@ -118,7 +119,7 @@ static int property_get_sessions(
                 if (!p)
                         return -ENOMEM;
 
-                r = sd_bus_message_append(reply, "(so)", session->id, p);
+                r = manager_append_bus_template(u->manager, reply, MANAGER_BUS_TEMPLATE_ID_PATH, session->id, p);
                 if (r < 0)
                         return r;
 
@@ -304,7 +305,6 @@ char *user_bus_path(User *u) {
 
 static int user_node_enumerator(sd_bus *bus, const char *path, void *userdata, char ***nodes, sd_bus_error *error) {
         _cleanup_strv_free_ char **l = NULL;
-        sd_bus_message *message;
         Manager *m = userdata;
         User *user;
         int r;
@@ -325,6 +325,22 @@ static int user_node_enumerator(sd_bus *bus, const char *path, void *userdata, c
                         return r;
         }
 
+        *nodes = TAKE_PTR(l);
+        return 1;
+}
+
+/* The "self" alias depends on the caller, hence unlike the list above it is never cached */
+static int user_alias_node_enumerator(sd_bus *bus, const char *path, void *userdata, char ***nodes, sd_bus_error *error) {
+        _cleanup_strv_free_ char **l = NULL;
+        sd_bus_message *message;
+        Manager *m = userdata;
+        User *user;
+        int r;
+
+        assert(bus);
+        assert(path);
+        assert(nodes);
+
         message = sd_bus_get_current_message(bus);
         if (message) {
                 _cleanup_(sd_bus_creds_unrefp) sd_bus_creds *creds = NULL;
@@ -382,7 +398,8 @@ const BusObjectImplementation user_object = {
         "/org/freedesktop/login1/user",
         "org.freedesktop.login1.User",
         .fallback_vtables = BUS_FALLBACK_VTABLES({user_vtable, user_object_find}),
-        .node_enumerator = user_node_enumerator,
+        .node_enumerator = user_alias_node_enumerator,
+        .cached_node_enumerator = user_node_enumerator,
 };
 
 int user_send_signal(User *u, bool new_user) {
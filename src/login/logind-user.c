@@ -19,6 +19,7 @@
 #include "hashmap.h"
 // #include "label-util.h"
 #include "limits-util.h"
+#include "logind-checkpoint.h"
 #include "logind-dbus.h"
 #include "logind-user-dbus.h"
 #include "logind-user.h"
@@ -92,6 +93,8 @@ int user_new(User **ret,
         if (r < 0)
                 return r;
 
+        manager_invalidate_bus_nodes(m, "/org/freedesktop/login1/user");
+
         r = hashmap_put(m->user_units, u->slice, u);
         if (r < 0)
                 return r;
@@ -133,6 +136,7 @@ User *user_free(User *u) {
                 hashmap_remove_value(u->manager->user_units, u->slice, u);
 
         hashmap_remove_value(u->manager->users, UID_TO_PTR(u->user_record->uid), u);
+        manager_invalidate_bus_nodes(u->manager, "/org/freedesktop/login1/user");
 
         sd_event_source_unref(u->timer_event_source);
 
@@ -299,10 +303,12 @@ static int user_save_internal(User *u) {
         }
 
         temp_path = mfree(temp_path);
+        manager_checkpoint_mark_dirty(u->manager, u->state_file);
         return 0;
 
 fail:
         (void) unlink(u->state_file);
+        manager_checkpoint_mark_dirty(u->manager, u->state_file);
 
         return log_error_errno(r, "Failed to save user data %s: %m", u->state_file);
 }
@@ -322,14 +328,14 @@ int user_load(User *u) {
 
         assert(u);
 
-        r = parse_env_file(NULL, u->state_file,
+        r = manager_parse_state_file(u->manager, u->state_file,
 #if 0 /// elogind does not support service jobs.
-                           "SERVICE_JOB",            &u->service_job,
+                                     "SERVICE_JOB",            &u->service_job,
 #endif // 0
-                           "STOPPING",               &stopping,
-                           "REALTIME",               &realtime,
-                           "MONOTONIC",              &monotonic,
-                           "LAST_SESSION_TIMESTAMP", &last_session_timestamp);
+                                     "STOPPING",               &stopping,
+                                     "REALTIME",               &realtime,
+                                     "MONOTONIC",              &monotonic,
+                                     "LAST_SESSION_TIMESTAMP", &last_session_timestamp);
         if (r == -ENOENT)
                 return 0;
         if (r < 0)
@@ -605,6 +611,7 @@ int user_finalize(User *u) {
         }
 
         (void) unlink(u->state_file);
+        manager_checkpoint_mark_dirty(u->manager, u->state_file);
         user_add_to_gc_queue(u);
 
         if (u->started) {
@@ -618,9 +625,13 @@ int user_finalize(User *u) {
 int user_get_idle_hint(User *u, dual_timestamp *t) {
         bool idle_hint = true;
         dual_timestamp ts = DUAL_TIMESTAMP_NULL;
+        int r;
 
         assert(u);
 
+        if (idle_hint_cache_get(&u->idle_hint_cache, u->manager, t, &r))
+                return r;
+
         LIST_FOREACH(sessions_by_user, s, u->sessions) {
                 dual_timestamp k;
                 int ih;
@@ -644,6 +655,8 @@ int user_get_idle_hint(User *u, dual_timestamp *t) {
                 }
         }
 
+        idle_hint_cache_put(&u->idle_hint_cache, u->manager, idle_hint, &ts);
+
         if (t)
                 *t = ts;
 
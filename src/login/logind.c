@@ -9,6 +9,7 @@
 #include "sd-device.h"
 
 #include "alloc-util.h"
+#include "battery-util.h"
 //#include "bus-error.h"
 // #include "bus-locator.h"
 #include "bus-log-control-api.h"
@@ -17,12 +18,15 @@
 #include "common-signal.h"
 #include "constants.h"
 #include "daemon-util.h"
+#include "device-enumerator-private.h"
 #include "device-util.h"
 #include "dirent-util.h"
 #include "escape.h"
 #include "fd-util.h"
 // #include "format-util.h"
+#include "fileio.h"
 #include "fs-util.h"
+#include "logind-checkpoint.h"
 #include "logind-dbus.h"
 //#include "logind-seat-dbus.h"
 //#include "logind-session-dbus.h"
@@ -37,7 +41,7 @@
 #include "signal-util.h"
 #include "strv.h"
 #include "terminal-util.h"
-//#include "udev-util.h"
+#include "udev-util.h"
 /// Additional includes needed by elogind
 #include "elogind.h"
 #include "musl_missing.h"
@@ -65,6 +69,7 @@ static int manager_new(Manager **ret) {
 
         *m = (Manager) {
                 .console_active_fd = -EBADF,
+                .timeline_fd = -EBADF,
 #if 0 /// elogind does not support autospawning of vts
                 .reserve_vt_fd = -EBADF,
 #endif // 0
@@ -141,7 +146,10 @@ static Manager* manager_free(Manager *m) {
         hashmap_free(m->users);
         hashmap_free(m->inhibitors);
         hashmap_free(m->buttons);
+        hashmap_free(m->power_supplies);
         hashmap_free(m->brightness_writers);
+        hashmap_free(m->checkpoint);
+        set_free(m->checkpoint_dirty);
 
         hashmap_free(m->user_units);
 #if 0 /// elogind does not support systemd session units.
@@ -158,9 +166,15 @@ static Manager* manager_free(Manager *m) {
         sd_event_source_unref(m->lid_switch_ignore_event_source);
 
         sd_event_source_unref(m->reboot_key_long_press_event_source);
+        sd_event_source_unref(m->checkpoint_event_source);
+
+        manager_timeline_flush(m);
 
 #if ENABLE_UTMP
         sd_event_source_unref(m->utmp_event_source);
+        sd_event_source_unref(m->utmp_read_event_source);
+        free(m->utmp_records);
+        free(m->utmp_records_pending);
 #endif
 
 #if 0 /// Do not fail with an assert if manager creation fails when elogind forks
@@ -175,6 +189,7 @@ static Manager* manager_free(Manager *m) {
         sd_device_monitor_unref(m->device_monitor);
         sd_device_monitor_unref(m->device_vcsa_monitor);
         sd_device_monitor_unref(m->device_button_monitor);
+        sd_device_monitor_unref(m->device_power_supply_monitor);
 
         if (m->unlink_nologin)
                 (void) unlink_or_warn("/run/nologin");
@@ -182,6 +197,8 @@ static Manager* manager_free(Manager *m) {
         bus_verify_polkit_async_registry_free(m->polkit_registry);
 
         sd_bus_flush_close_unref(m->bus);
+        FOREACH_ARRAY(t, m->bus_templates, _MANAGER_BUS_TEMPLATE_MAX)
+                sd_bus_message_template_unref(*t);
         sd_event_unref(m->event);
 
 #if 0 /// elogind does not support autospawning of vts
@@ -215,7 +232,9 @@ static int manager_enumerate_devices(Manager *m) {
         /* Loads devices from udev and creates seats for them as
          * necessary */
 
-        r = sd_device_enumerator_new(&e);
+        /* Only a few db entries (tags and ID_SEAT) are needed here, hence do not parse the whole db. The
+         * devices are dropped right after, hence also keep their properties in one arena each. */
+        r = device_enumerator_new_full(&e, DEVICE_ENUMERATOR_LAZY_DB|DEVICE_ENUMERATOR_COMPACT_PROPERTIES);
         if (r < 0)
                 return r;
 
@@ -245,7 +264,7 @@ static int manager_enumerate_buttons(Manager *m) {
         if (manager_all_buttons_ignored(m))
                 return 0;
 
-        r = sd_device_enumerator_new(&e);
+        r = device_enumerator_new_full(&e, DEVICE_ENUMERATOR_LAZY_DB|DEVICE_ENUMERATOR_COMPACT_PROPERTIES);
         if (r < 0)
                 return r;
 
@@ -268,6 +287,24 @@ static int manager_enumerate_buttons(Manager *m) {
         return r;
 }
 
+static int manager_enumerate_power_supplies(Manager *m) {
+        int r;
+
+        assert(m);
+
+        /* Keep track of the power supplies, instead of enumerating them whenever we need to know if we are
+         * on AC. Changes are picked up by device_power_supply_monitor. */
+
+        m->power_supplies = hashmap_free(m->power_supplies);
+
+        r = power_supplies_enumerate(&m->power_supplies, /* usb_role = */ true);
+        if (r < 0)
+                return r;
+
+        m->power_supplies_enumerated = true;
+        return 0;
+}
+
 static int manager_enumerate_seats(Manager *m) {
         _cleanup_closedir_ DIR *d = NULL;
         int r = 0;
@@ -496,7 +533,7 @@ static int manager_attach_fds(Manager *m) {
                 close_and_notify_warn(fd, fdnames[i]);
         }
 
-        return 0;
+        return n;
 }
 
 static int manager_enumerate_sessions(Manager *m) {
@@ -535,9 +572,12 @@ static int manager_enumerate_sessions(Manager *m) {
                         r = k;
         }
 
+        startup_trace_mark(&m->startup_trace, STARTUP_ENUMERATE_SESSIONS, hashmap_size(m->sessions));
+
         /* We might be restarted and PID1 could have sent us back the session device fds we previously
          * saved. */
-        (void) manager_attach_fds(m);
+        k = manager_attach_fds(m);
+        startup_trace_mark(&m->startup_trace, STARTUP_ATTACH_FDS, MAX(k, 0));
 
         return r;
 }
@@ -587,12 +627,17 @@ static int manager_dispatch_seat_udev(sd_device_monitor *monitor, sd_device *dev
         return 0;
 }
 
-static int manager_dispatch_device_udev(sd_device_monitor *monitor, sd_device *device, void *userdata) {
+static int manager_dispatch_device_udev(sd_device_monitor *monitor, sd_device **devices, size_t n_devices, void *userdata) {
         Manager *m = ASSERT_PTR(userdata);
 
-        assert(device);
+        assert(devices || n_devices == 0);
+
+        /* Hotplugging a docking station or resetting a USB hub generates bursts of uevents. Those are
+         * handled within a single event loop iteration, hence manager_run() garbage collects the seats
+         * they touch only once, after the whole burst has been processed. */
+        FOREACH_ARRAY(d, devices, n_devices)
+                manager_process_seat_device(m, *d);
 
-        manager_process_seat_device(m, device);
         return 0;
 }
 
@@ -624,6 +669,29 @@ static int manager_dispatch_button_udev(sd_device_monitor *monitor, sd_device *d
         return 0;
 }
 
+static int manager_dispatch_power_supply_udev(sd_device_monitor *monitor, sd_device *device, void *userdata) {
+        Manager *m = ASSERT_PTR(userdata);
+        const char *syspath, *subsystem;
+        int r;
+
+        assert(device);
+
+        /* The state of power supplies is read through the attribute cache, see read_virtual_attribute(),
+         * don't keep the attributes of removed ones open. */
+        if (device_for_action(device, SD_DEVICE_REMOVE) &&
+            sd_device_get_syspath(device, &syspath) >= 0)
+                virtual_attribute_cache_invalidate(syspath);
+
+        if (sd_device_get_subsystem(device, &subsystem) >= 0 && streq(subsystem, "typec"))
+                r = power_supplies_refresh_usb(m->power_supplies);
+        else
+                r = power_supplies_process_device(&m->power_supplies, device);
+        if (r < 0)
+                log_device_debug_errno(device, r, "Failed to update power supply state, ignoring: %m");
+
+        return 0;
+}
+
 static int manager_dispatch_console(sd_event_source *s, int fd, uint32_t revents, void *userdata) {
         Manager *m = ASSERT_PTR(userdata);
 
@@ -721,6 +789,18 @@ static int manager_connect_bus(Manager *m) {
         if (r < 0)
                 return log_error_errno(r, "Failed to attach bus to event loop: %m");
 
+        /* Sessions, users and seats often change several properties in one go, e.g. when a session is
+         * activated. Send out one PropertiesChanged signal per object and event loop iteration for that. */
+        r = sd_bus_set_defer_properties_changed(m->bus, true);
+        if (r < 0)
+                return log_error_errno(r, "Failed to enable coalescing of PropertiesChanged signals: %m");
+
+        /* Nearly every method call looks at the credentials of its sender, and clients tend to call more
+         * than one method. Don't ask the bus driver about the same peer again and again. */
+        r = sd_bus_set_cache_sender_creds(m->bus, true);
+        if (r < 0)
+                return log_error_errno(r, "Failed to enable caching of sender credentials: %m");
+
 #if 0 /// elogind has to setup its release agent
         return 0;
 #else // 0
@@ -850,6 +930,7 @@ static int manager_connect_udev(Manager *m) {
         assert(!m->device_monitor);
         assert(!m->device_vcsa_monitor);
         assert(!m->device_button_monitor);
+        assert(!m->device_power_supply_monitor);
 
         r = sd_device_monitor_new(&m->device_seat_monitor);
         if (r < 0)
@@ -889,7 +970,7 @@ static int manager_connect_udev(Manager *m) {
         if (r < 0)
                 return r;
 
-        r = sd_device_monitor_start(m->device_monitor, manager_dispatch_device_udev, m);
+        r = sd_device_monitor_start_batch(m->device_monitor, manager_dispatch_device_udev, m);
         if (r < 0)
                 return r;
 
@@ -920,6 +1001,28 @@ static int manager_connect_udev(Manager *m) {
                 (void) sd_device_monitor_set_description(m->device_button_monitor, "button");
         }
 
+        r = sd_device_monitor_new(&m->device_power_supply_monitor);
+        if (r < 0)
+                return r;
+
+        r = sd_device_monitor_filter_add_match_subsystem_devtype(m->device_power_supply_monitor, "power_supply", NULL);
+        if (r < 0)
+                return r;
+
+        r = sd_device_monitor_filter_add_match_subsystem_devtype(m->device_power_supply_monitor, "typec", NULL);
+        if (r < 0)
+                return r;
+
+        r = sd_device_monitor_attach_event(m->device_power_supply_monitor, m->event);
+        if (r < 0)
+                return r;
+
+        r = sd_device_monitor_start(m->device_power_supply_monitor, manager_dispatch_power_supply_udev, m);
+        if (r < 0)
+                return r;
+
+        (void) sd_device_monitor_set_description(m->device_power_supply_monitor, "power_supply,typec");
+
 #if 0 /// elogind does not support autospawning of vts
         /* Don't bother watching VCSA devices, if nobody cares */
         if (m->n_autovts > 0 && m->console_active_fd >= 0) {
@@ -1088,6 +1191,7 @@ static int manager_dispatch_reload_signal(sd_event_source *s, const struct signa
 }
 
 static int manager_startup(Manager *m) {
+        unsigned n;
         int r;
         Seat *seat;
         Session *session;
@@ -1107,6 +1211,8 @@ static int manager_startup(Manager *m) {
                 return log_error_errno(r, "Failed to register elogind signal handlers: %m");
         }
 #endif // 1
+        startup_trace_mark(&m->startup_trace, STARTUP_SIGNALS, 0);
+
         /* Connect to utmp */
         manager_connect_utmp(m);
 
@@ -1114,16 +1220,19 @@ static int manager_startup(Manager *m) {
         r = manager_connect_console(m);
         if (r < 0)
                 return r;
+        startup_trace_mark(&m->startup_trace, STARTUP_CONNECT_CONSOLE, 0);
 
         /* Connect to udev */
         r = manager_connect_udev(m);
         if (r < 0)
                 return log_error_errno(r, "Failed to create udev watchers: %m");
+        startup_trace_mark(&m->startup_trace, STARTUP_CONNECT_UDEV, 0);
 
         /* Connect to the bus */
         r = manager_connect_bus(m);
         if (r < 0)
                 return r;
+        startup_trace_mark(&m->startup_trace, STARTUP_CONNECT_BUS, 0);
 
         /* Instantiate magic seat 0 */
         r = manager_add_seat(m, "seat0", &m->seat0);
@@ -1134,18 +1243,24 @@ static int manager_startup(Manager *m) {
         if (r < 0)
                 log_warning_errno(r, "Failed to set up lid switch ignore event source: %m");
 
-        /* Deserialize state */
+        /* Deserialize state, use the checkpoint to avoid parsing every state file if possible */
+        (void) manager_load_checkpoint(m);
+        startup_trace_mark(&m->startup_trace, STARTUP_CHECKPOINT, 0);
+
         r = manager_enumerate_devices(m);
         if (r < 0)
                 log_warning_errno(r, "Device enumeration failed: %m");
+        startup_trace_mark(&m->startup_trace, STARTUP_ENUMERATE_DEVICES, hashmap_size(m->devices));
 
         r = manager_enumerate_seats(m);
         if (r < 0)
                 log_warning_errno(r, "Seat enumeration failed: %m");
+        startup_trace_mark(&m->startup_trace, STARTUP_ENUMERATE_SEATS, hashmap_size(m->seats));
 
         r = manager_enumerate_users(m);
         if (r < 0)
                 log_warning_errno(r, "User enumeration failed: %m");
+        startup_trace_mark(&m->startup_trace, STARTUP_ENUMERATE_USERS, hashmap_size(m->users));
 
         r = manager_enumerate_sessions(m);
         if (r < 0)
@@ -1154,15 +1269,31 @@ static int manager_startup(Manager *m) {
         r = manager_enumerate_inhibitors(m);
         if (r < 0)
                 log_warning_errno(r, "Inhibitor enumeration failed: %m");
+        startup_trace_mark(&m->startup_trace, STARTUP_ENUMERATE_INHIBITORS, hashmap_size(m->inhibitors));
 
         r = manager_enumerate_buttons(m);
         if (r < 0)
                 log_warning_errno(r, "Button enumeration failed: %m");
+        startup_trace_mark(&m->startup_trace, STARTUP_ENUMERATE_BUTTONS, hashmap_size(m->buttons));
+
+        r = manager_enumerate_power_supplies(m);
+        if (r < 0)
+                log_warning_errno(r, "Power supply enumeration failed: %m");
+        startup_trace_mark(&m->startup_trace, STARTUP_ENUMERATE_POWER_SUPPLIES, hashmap_size(m->power_supplies));
+
+        manager_prune_checkpoint(m);
+
+        r = manager_start_checkpoint_timer(m);
+        if (r < 0)
+                log_warning_errno(r, "Failed to set up checkpoint timer, ignoring: %m");
 
         manager_load_scheduled_shutdown(m);
 
         /* Remove stale objects before we start them */
+        n = hashmap_size(m->seats) + hashmap_size(m->users) + hashmap_size(m->sessions);
         manager_gc(m, false);
+        startup_trace_mark(&m->startup_trace, STARTUP_GC,
+                           n - (hashmap_size(m->seats) + hashmap_size(m->users) + hashmap_size(m->sessions)));
 
         /* Reserve the special reserved VT */
 #if 0 /// elogind does not support autospawning of vts
@@ -1171,6 +1302,9 @@ static int manager_startup(Manager *m) {
 
         /* Read in utmp if it exists */
         manager_read_utmp(m);
+#if ENABLE_UTMP
+        startup_trace_mark(&m->startup_trace, STARTUP_READ_UTMP, m->n_utmp_records);
+#endif
 
         /* And start everything */
         HASHMAP_FOREACH(seat, m->seats)
@@ -1197,6 +1331,9 @@ static int manager_startup(Manager *m) {
 
         manager_dispatch_idle_action(NULL, 0, m);
 
+        startup_trace_mark(&m->startup_trace, STARTUP_START,
+                           hashmap_size(m->seats) + hashmap_size(m->users) + hashmap_size(m->sessions) +
+                           hashmap_size(m->inhibitors));
         return 0;
 }
 
@@ -1234,8 +1371,12 @@ static int manager_run(Manager *m) {
 static int run(int argc, char *argv[]) {
         _cleanup_(manager_freep) Manager *m = NULL;
         _unused_ _cleanup_(notify_on_cleanup) const char *notify_message = NULL;
+        usec_t startup_begin, daemonized;
+        const char *e;
         int r;
 
+        startup_begin = now(CLOCK_MONOTONIC);
+
         elogind_set_program_name(argv[0]);
         log_set_facility(LOG_AUTH);
         log_setup();
@@ -1249,6 +1390,7 @@ static int run(int argc, char *argv[]) {
         }
         // If we forked, we are in the grandchild, the daemon, now.
 #endif // 1
+        daemonized = now(CLOCK_MONOTONIC);
 
 #if 0 /// This is elogind
         r = service_parse_argv("systemd-logind.service",
@@ -1318,15 +1460,36 @@ static int run(int argc, char *argv[]) {
         if (r < 0)
                 return log_error_errno(r, "Failed to allocate manager object: %m");
 
+        startup_trace_init(&m->startup_trace, startup_begin);
+        startup_trace_mark_at(&m->startup_trace, STARTUP_DAEMONIZE, 0, daemonized);
+        startup_trace_mark(&m->startup_trace, STARTUP_MANAGER, 0);
+
         (void) manager_parse_config_file(m);
+        startup_trace_mark(&m->startup_trace, STARTUP_CONFIG, 0);
 
         log_debug_elogind("%s", "Starting manager...");
         r = manager_startup(m);
         if (r < 0)
                 return log_error_errno(r, "Failed to fully start up daemon: %m");
 
+        startup_trace_ready(&m->startup_trace);
+
+        e = getenv(STARTUP_TRACE_ENV);
+        if (e) {
+                r = startup_trace_write(&m->startup_trace, e);
+                if (r < 0)
+                        log_warning_errno(r, "Failed to write start-up trace to %s, ignoring: %m", e);
+        }
+
         notify_message = notify_start(NOTIFY_READY, NOTIFY_STOPPING);
-        return manager_run(m);
+        r = manager_run(m);
+        if (r < 0)
+                return r;
+
+        /* Make the next start-up cheap */
+        (void) manager_write_checkpoint(m);
+
+        return 0;
 }
 
 DEFINE_MAIN_FUNCTION(run);
@@ -17,10 +17,24 @@
 
 typedef struct Manager Manager;
 
+/* The idle hints of sessions without an explicit idle hint are derived from the atime of their tty, which
+ * takes a couple of syscalls per session. Hence, idle hints of sessions, users, seats and the manager are
+ * cached for this long, unless something invalidates them earlier, see manager_invalidate_idle_hint(). */
+#define IDLE_HINT_CACHE_USEC (1 * USEC_PER_SEC)
+
+typedef struct IdleHintCache {
+        uint64_t generation;
+        usec_t until; /* CLOCK_MONOTONIC */
+        int idle_hint;
+        dual_timestamp timestamp;
+} IdleHintCache;
+
 #include "logind-action.h"
 #include "logind-button.h"
 #include "logind-device.h"
 #include "logind-inhibit.h"
+#include "logind-startup-trace.h"
+#include "logind-timeline.h"
 
 /// Additional includes needed by elogind
 #include "cgroup-util.h"
@@ -31,9 +45,22 @@ typedef struct Manager Manager;
 #define MANAGER_IS_TEST_RUN(m) (  (m)->test_run_flags != 0)
 #define MANAGER_IS_USER(m)     (!((m)->is_system))
 #endif // 1
+/* Signatures logind puts into method replies and PropertiesChanged over and over again, see
+ * manager_append_bus_template() */
+typedef enum ManagerBusTemplate {
+        MANAGER_BUS_TEMPLATE_SESSION,   /* (susso) */
+        MANAGER_BUS_TEMPLATE_USER,      /* (uso) */
+        MANAGER_BUS_TEMPLATE_INHIBITOR, /* (ssssuu) */
+        MANAGER_BUS_TEMPLATE_ID_PATH,   /* (so) */
+        MANAGER_BUS_TEMPLATE_UID_PATH,  /* (uo) */
+        _MANAGER_BUS_TEMPLATE_MAX,
+        _MANAGER_BUS_TEMPLATE_INVALID = -EINVAL,
+} ManagerBusTemplate;
+
 struct Manager {
         sd_event *event;
         sd_bus *bus;
+        sd_bus_message_template *bus_templates[_MANAGER_BUS_TEMPLATE_MAX];
 
         Hashmap *devices;
         Hashmap *seats;
@@ -44,16 +71,28 @@ struct Manager {
         Hashmap *buttons;
         Hashmap *brightness_writers;
 
+        /* The power supplies, kept up-to-date by device_power_supply_monitor. If the enumeration at
+         * start-up failed, they are enumerated whenever needed instead. */
+        Hashmap *power_supplies;
+        bool power_supplies_enumerated;
+
         LIST_HEAD(Seat, seat_gc_queue);
         LIST_HEAD(Session, session_gc_queue);
         LIST_HEAD(User, user_gc_queue);
 
         sd_device_monitor *device_seat_monitor, *device_monitor, *device_vcsa_monitor, *device_button_monitor;
+        sd_device_monitor *device_power_supply_monitor;
 
         sd_event_source *console_active_event_source;
 
 #if ENABLE_UTMP
         sd_event_source *utmp_event_source;
+        sd_event_source *utmp_read_event_source;
+
+        /* The utmp records as of the last pass, and which of them had no matching session yet */
+        struct utmpx *utmp_records;
+        bool *utmp_records_pending;
+        size_t n_utmp_records;
 #endif
 
         int console_active_fd;
@@ -106,6 +145,16 @@ struct Manager {
          * start after the delay is over */
         const HandleActionData *delayed_action;
 
+        /* The shutdown or sleep operation in progress, and the last ones that finished, see logind-timeline.c */
+        Timeline *timeline;
+        Timeline **timelines;
+        size_t n_timelines;
+        int timeline_fd; /* only set in the child executing the operation */
+        sd_event_source *timeline_event_source;
+
+        /* How long start-up took, see logind-startup-trace.c */
+        StartupTrace startup_trace;
+
 #if 0 /// elogind does all relevant actions on its own. No systemd jobs and units.
         /* If a shutdown/suspend is currently executed, then this is the job of it */
         char *action_job;
@@ -127,6 +176,12 @@ struct Manager {
         /* Allow elogind to put Nvidia cards to sleep */
         bool handle_nvidia_sleep;
 
+        /* Optionally run the system-sleep hook scripts in parallel, grouped by the
+           numbers their file names start with, and with limits */
+        bool sleep_hooks_parallel;
+        unsigned sleep_hooks_max_parallel;
+        usec_t sleep_hook_timeout_usec;
+
         /* To allow elogind to put nvidia cards to sleep on suspend/hibernate,
            we store the users uid to get the right VT information */
         uid_t scheduled_sleep_uid;
@@ -153,6 +208,8 @@ struct Manager {
 
         sd_event_source *idle_action_event_source;
         usec_t idle_action_usec;
+        uint64_t idle_hint_generation;
+        IdleHintCache idle_hint_cache;
         usec_t idle_action_not_before_usec;
         HandleAction idle_action;
         bool was_idle;
@@ -200,6 +257,12 @@ struct Manager {
 
         char *efi_loader_entry_one_shot;
         struct stat efi_loader_entry_one_shot_stat;
+
+        Hashmap *checkpoint; /* see logind-checkpoint.c */
+        Set *checkpoint_dirty; /* state files written or removed since the last checkpoint */
+        bool checkpoint_trusted; /* only set during start-up */
+        unsigned n_checkpoint_hits;
+        sd_event_source *checkpoint_event_source;
 };
 
 void manager_reset_config(Manager *m);
@@ -224,13 +287,16 @@ int manager_spawn_autovt(Manager *m, unsigned vtnr);
 bool manager_shall_kill(Manager *m, const char *user);
 
 int manager_get_idle_hint(Manager *m, dual_timestamp *t);
+void manager_invalidate_idle_hint(Manager *m);
+bool idle_hint_cache_get(const IdleHintCache *c, Manager *m, dual_timestamp *t, int *ret);
+void idle_hint_cache_put(IdleHintCache *c, Manager *m, int idle_hint, const dual_timestamp *t);
 
 int manager_get_user_by_pid(Manager *m, pid_t pid, User **user);
 int manager_get_session_by_pidref(Manager *m, const PidRef *pid, Session **ret);
 
 bool manager_is_lid_closed(Manager *m);
 bool manager_is_docked_or_external_displays(Manager *m);
-bool manager_is_on_external_power(void);
+bool manager_is_on_external_power(Manager *m);
 bool manager_all_buttons_ignored(Manager *m);
 
 int manager_read_utmp(Manager *m);
@@ -2,6 +2,8 @@
 
 #include "logind-action.h"
 #include "logind-session.h"
+#include "logind-startup-trace.h"
+#include "logind-timeline.h"
 #include "test-tables.h"
 #include "tests.h"
 
@@ -14,6 +16,8 @@ int main(int argc, char **argv) {
         test_table(session_class, SESSION_CLASS);
         test_table(session_state, SESSION_STATE);
         test_table(session_type, SESSION_TYPE);
+        test_table(startup_phase, STARTUP_PHASE);
+        test_table(timeline_phase, TIMELINE_PHASE);
         test_table(user_state, USER_STATE);
 
         return EXIT_SUCCESS;
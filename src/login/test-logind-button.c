@@ -0,0 +1,190 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "sd-event.h"
+
+#include "alloc-util.h"
+#include "fileio.h"
+#include "hashmap.h"
+#include "logind-button.h"
+#include "logind-test-util.h"
+#include "tests.h"
+#include "time-util.h"
+
+/* Replays evdev event streams into a Button, no input device needed. A recorded stream, i.e. what reading
+ * from /dev/input/eventX returned, may be passed as argument, to replay it and measure its handling. */
+
+#define EV(t, c, v) ((struct input_event) { .type = (t), .code = (c), .value = (v) })
+#define SYN EV(EV_SYN, SYN_REPORT, 0)
+
+static void replay(Button *b, const struct input_event *events, size_t n, size_t batch) {
+        assert(batch > 0);
+
+        for (size_t i = 0; i < n; i += batch)
+                assert_se(button_process_events(b, events + i, MIN(batch, n - i)) >= 0);
+}
+
+TEST(lid) {
+        _cleanup_(test_manager_freep) Manager *m = test_manager_new();
+        Button *b;
+
+        assert_se(b = button_new(m, "event0"));
+
+        replay(b, (const struct input_event[]) { EV(EV_SW, SW_LID, 1), SYN }, 2, 1);
+        assert_se(b->lid_closed);
+        assert_se(b->check_event_source);
+
+        replay(b, (const struct input_event[]) { EV(EV_SW, SW_LID, 0), SYN }, 2, 1);
+        assert_se(!b->lid_closed);
+        assert_se(!b->check_event_source);
+
+        /* Nothing happens before the frame is complete */
+        replay(b, (const struct input_event[]) { EV(EV_SW, SW_LID, 1) }, 1, 1);
+        assert_se(!b->lid_closed);
+        replay(b, (const struct input_event[]) { SYN }, 1, 1);
+        assert_se(b->lid_closed);
+
+        /* Only the final state of a batch counts */
+        replay(b, (const struct input_event[]) {
+                        EV(EV_SW, SW_LID, 0), SYN,
+                        EV(EV_SW, SW_LID, 1), SYN,
+                        EV(EV_SW, SW_LID, 0), SYN,
+                }, 6, 6);
+        assert_se(!b->lid_closed);
+        assert_se(!b->check_event_source);
+
+        replay(b, (const struct input_event[]) {
+                        EV(EV_SW, SW_LID, 1), SYN,
+                        EV(EV_SW, SW_LID, 0), SYN,
+                }, 4, 4);
+        assert_se(!b->lid_closed);
+        assert_se(!b->check_event_source);
+}
+
+TEST(dock) {
+        _cleanup_(test_manager_freep) Manager *m = test_manager_new();
+        Button *b;
+
+        assert_se(b = button_new(m, "event0"));
+
+        replay(b, (const struct input_event[]) {
+                        EV(EV_SW, SW_LID, 1),
+                        EV(EV_SW, SW_DOCK, 1),
+                        SYN,
+                }, 3, 3);
+        assert_se(b->lid_closed);
+        assert_se(b->docked);
+        assert_se(manager_is_docked_or_external_displays(m));
+
+        replay(b, (const struct input_event[]) { EV(EV_SW, SW_DOCK, 0), SYN }, 2, 2);
+        assert_se(b->lid_closed);
+        assert_se(!b->docked);
+}
+
+TEST(dropped) {
+        _cleanup_(test_manager_freep) Manager *m = test_manager_new();
+        Button *b;
+
+        assert_se(b = button_new(m, "event0"));
+
+        /* Everything up to the next SYN_REPORT is ignored, including what preceded the SYN_DROPPED in the
+         * same frame */
+        replay(b, (const struct input_event[]) {
+                        EV(EV_SW, SW_LID, 1),
+                        EV(EV_SYN, SYN_DROPPED, 0),
+                        EV(EV_SW, SW_DOCK, 1),
+                        SYN,
+                }, 4, 1);
+        assert_se(!b->lid_closed);
+        assert_se(!b->docked);
+
+        replay(b, (const struct input_event[]) { EV(EV_SW, SW_DOCK, 1), SYN }, 2, 2);
+        assert_se(b->docked);
+}
+
+TEST(power_key) {
+        _cleanup_(test_manager_freep) Manager *m = test_manager_new();
+        struct input_event frame[2 * BUTTON_FRAME_EVENTS_MAX + 1];
+        Button *b;
+
+        assert_se(b = button_new(m, "event0"));
+
+        /* With a long press action, the press arms a timer and the release disarms it again */
+        m->handle_power_key_long_press = HANDLE_POWEROFF;
+
+        replay(b, (const struct input_event[]) { EV(EV_KEY, KEY_POWER, 1), SYN }, 2, 2);
+        assert_se(m->power_key_long_press_event_source);
+
+        replay(b, (const struct input_event[]) { EV(EV_KEY, KEY_POWER, 2), SYN }, 2, 2);
+        assert_se(m->power_key_long_press_event_source);
+
+        replay(b, (const struct input_event[]) { EV(EV_KEY, KEY_POWER, 0), SYN }, 2, 2);
+        assert_se(!m->power_key_long_press_event_source);
+
+        /* Key events are not coalesced, press and release are both seen in a single batch */
+        replay(b, (const struct input_event[]) {
+                        EV(EV_KEY, KEY_POWER, 1), SYN,
+                        EV(EV_KEY, KEY_POWER, 0), SYN,
+                        EV(EV_KEY, KEY_POWER2, 1), SYN,
+                }, 6, 6);
+        assert_se(m->power_key_long_press_event_source);
+
+        /* Frames longer than what is held at once are split, but handled in order */
+        for (size_t i = 0; i < 2 * BUTTON_FRAME_EVENTS_MAX; i++)
+                frame[i] = EV(EV_KEY, KEY_POWER, i % 2 == 0 ? 0 : 1);
+        frame[ELEMENTSOF(frame) - 1] = SYN;
+
+        replay(b, frame, ELEMENTSOF(frame), ELEMENTSOF(frame));
+        assert_se(m->power_key_long_press_event_source);
+
+        replay(b, (const struct input_event[]) { EV(EV_KEY, KEY_POWER, 0), SYN }, 2, 1);
+        assert_se(!m->power_key_long_press_event_source);
+}
+
+static void replay_timed(Button *b, const struct input_event *events, size_t n, size_t batch) {
+        usec_t start;
+
+        start = now(CLOCK_MONOTONIC);
+        replay(b, events, n, batch);
+
+        log_info("Replayed %zu events in batches of %zu in %s.",
+                 n, batch, FORMAT_TIMESPAN(usec_sub_unsigned(now(CLOCK_MONOTONIC), start), 1));
+}
+
+TEST(replay) {
+        _cleanup_(test_manager_freep) Manager *m = test_manager_new();
+        _cleanup_free_ struct input_event *events = NULL;
+        size_t n;
+        Button *b;
+
+        if (saved_argc > 1) {
+                _cleanup_free_ char *data = NULL;
+                size_t size;
+
+                assert_se(read_full_file(saved_argv[1], &data, &size) >= 0);
+                assert_se(size % sizeof(struct input_event) == 0);
+
+                n = size / sizeof(struct input_event);
+                events = (struct input_event*) TAKE_PTR(data);
+        } else {
+                /* A lid switch that bounces a bit every time it's closed or opened */
+                n = 200 * 6;
+                assert_se(events = new(struct input_event, n));
+
+                for (size_t i = 0; i < n; i += 6) {
+                        events[i] = EV(EV_SW, SW_LID, 1);
+                        events[i + 1] = SYN;
+                        events[i + 2] = EV(EV_SW, SW_LID, 0);
+                        events[i + 3] = SYN;
+                        events[i + 4] = EV(EV_KEY, KEY_POWER, i % 12 == 0);
+                        events[i + 5] = SYN;
+                }
+        }
+
+        assert_se(b = button_new(m, "event0"));
+
+        /* One event at a time is what reading one event per wakeup did */
+        replay_timed(b, events, n, 1);
+        replay_timed(b, events, n, 64);
+}
+
+DEFINE_TEST_MAIN(LOG_INFO);
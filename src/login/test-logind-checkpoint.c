@@ -0,0 +1,178 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "alloc-util.h"
+#include "env-file.h"
+#include "fd-util.h"
+#include "fileio.h"
+#include "fs-util.h"
+#include "io-util.h"
+#include "logind-checkpoint.h"
+#include "path-util.h"
+#include "rm-rf.h"
+#include "set.h"
+#include "string-util.h"
+#include "tests.h"
+#include "time-util.h"
+#include "tmpfile-util.h"
+
+static int parse_state_file_sentinel(Hashmap *checkpoint, bool trusted, const char *fname, ...) {
+        va_list ap;
+        int r;
+
+        va_start(ap, fname);
+        r = logind_checkpoint_parse_state_filev(checkpoint, trusted, fname, ap);
+        va_end(ap);
+
+        return r;
+}
+
+#define parse_state_file(checkpoint, trusted, fname, ...) \
+        parse_state_file_sentinel(checkpoint, trusted, fname, __VA_ARGS__, NULL)
+
+static void set_mtime_back(const char *path) {
+        struct timespec ts[2];
+
+        /* Pretend the directory was last changed a while ago, so that a checkpoint written now is newer
+         * even with coarse timestamps */
+        timespec_store(&ts[0], now(CLOCK_REALTIME) - USEC_PER_HOUR);
+        ts[1] = ts[0];
+        assert_se(utimensat(AT_FDCWD, path, ts, 0) >= 0);
+}
+
+TEST(checkpoint) {
+        _cleanup_(rm_rf_physical_and_freep) char *t = NULL;
+        _cleanup_hashmap_free_ Hashmap *h = NULL, *loaded = NULL;
+        _cleanup_set_free_ Set *dirty = NULL;
+        _cleanup_free_ char *sessions = NULL, *users = NULL, *checkpoint = NULL, *s1 = NULL, *s2 = NULL, *u1 = NULL,
+                *uid = NULL, *remote_host = NULL, *seat = NULL, *state = NULL, *display = NULL;
+        const char *dirs[3];
+
+        assert_se(mkdtemp_malloc("/tmp/test-logind-checkpoint.XXXXXX", &t) >= 0);
+
+        assert_se(sessions = path_join(t, "sessions"));
+        assert_se(users = path_join(t, "users"));
+        assert_se(checkpoint = path_join(t, "checkpoint"));
+        assert_se(s1 = path_join(sessions, "1"));
+        assert_se(s2 = path_join(sessions, "c2"));
+        assert_se(u1 = path_join(users, "1000"));
+
+        assert_se(mkdir(sessions, 0755) >= 0);
+        assert_se(mkdir(users, 0755) >= 0);
+
+        assert_se(write_string_file(s1,
+                                    "# This is private data. Do not parse.\n"
+                                    "UID=1000\n"
+                                    "REMOTE_HOST=foo\\x20bar\n"
+                                    "SEAT=seat0\n"
+                                    "DISPLAY=\n",
+                                    WRITE_STRING_FILE_CREATE) >= 0);
+        assert_se(write_string_file(s2, "UID=1001\nSTATE=closing\n", WRITE_STRING_FILE_CREATE) >= 0);
+        assert_se(write_string_file(u1, "NAME=test\nSTATE=active\n", WRITE_STRING_FILE_CREATE) >= 0);
+
+        dirs[0] = sessions;
+        dirs[1] = users;
+        dirs[2] = NULL;
+
+        /* No entries give an empty, but valid checkpoint */
+        assert_se(logind_checkpoint_write(checkpoint, NULL, (const char*[]) { NULL }) >= 0);
+        assert_se(logind_checkpoint_load(checkpoint, (const char*[]) { NULL }, &loaded) >= 0);
+        assert_se(hashmap_isempty(loaded));
+
+        /* Only the files that are listed are read */
+        assert_se(set_put_strdup(&dirty, s1) >= 0);
+        assert_se(set_put_strdup(&dirty, s2) >= 0);
+        assert_se(logind_checkpoint_update(&h, dirty) >= 0);
+        assert_se(hashmap_size(h) == 2);
+
+        set_clear(dirty);
+        assert_se(set_put_strdup(&dirty, u1) >= 0);
+        assert_se(logind_checkpoint_update(&h, dirty) >= 0);
+        assert_se(hashmap_size(h) == 3);
+
+        set_mtime_back(sessions);
+        set_mtime_back(users);
+        assert_se(logind_checkpoint_write(checkpoint, h, dirs) >= 0);
+
+        /* The directories have not changed since, hence the entries can be used without checking */
+        assert_se(logind_checkpoint_load(checkpoint, dirs, &loaded) > 0);
+        assert_se(hashmap_size(loaded) == 3);
+
+        /* Served from the checkpoint, with the same values parse_env_file() would return */
+        assert_se(parse_state_file(loaded, true, s1,
+                                   "UID", &uid,
+                                   "REMOTE_HOST", &remote_host,
+                                   "SEAT", &seat,
+                                   "DISPLAY", &display,
+                                   "STATE", &state) > 0);
+        assert_se(streq(uid, "1000"));
+        assert_se(streq(seat, "seat0"));
+        assert_se(!state);
+
+        /* Keys with an empty value are unset, not empty strings */
+        assert_se(!display);
+
+        {
+                _cleanup_free_ char *remote_host2 = NULL, *display2 = NULL;
+
+                assert_se(parse_env_file(NULL, s1, "REMOTE_HOST", &remote_host2, "DISPLAY", &display2) >= 0);
+                assert_se(streq(remote_host, remote_host2));
+                assert_se(!display2);
+        }
+
+        /* Entries that were not looked up are dropped */
+        logind_checkpoint_prune(loaded);
+        assert_se(hashmap_size(loaded) == 1);
+        assert_se(hashmap_contains(loaded, s1));
+
+        /* A replaced file is parsed again, and the directories no longer match the checkpoint */
+        assert_se(write_string_file(s2, "UID=1001\nSTATE=active\n", WRITE_STRING_FILE_CREATE|WRITE_STRING_FILE_ATOMIC) >= 0);
+        assert_se(parse_state_file(h, false, s2, "UID", &uid, "STATE", &state) == 0);
+        assert_se(streq(uid, "1001"));
+        assert_se(streq(state, "active"));
+
+        loaded = hashmap_free(loaded);
+        assert_se(logind_checkpoint_load(checkpoint, dirs, &loaded) == 0);
+        assert_se(hashmap_size(loaded) == 3);
+
+        /* Files not known to the checkpoint are parsed, too */
+        assert_se(parse_state_file(NULL, false, u1, "STATE", &state) == 0);
+        assert_se(streq(state, "active"));
+        assert_se(unlink(u1) >= 0);
+        assert_se(parse_state_file(h, false, u1, "STATE", &state) == -ENOENT);
+
+        /* Updating picks up the replaced and the removed file */
+        set_clear(dirty);
+        assert_se(set_put_strdup(&dirty, s2) >= 0);
+        assert_se(set_put_strdup(&dirty, u1) >= 0);
+        assert_se(logind_checkpoint_update(&h, dirty) >= 0);
+        assert_se(hashmap_size(h) == 2);
+        assert_se(!hashmap_contains(h, u1));
+        assert_se(parse_state_file(h, false, s2, "STATE", &state) > 0);
+        assert_se(streq(state, "active"));
+
+        h = hashmap_free(h);
+        loaded = hashmap_free(loaded);
+
+        /* Garbled checkpoints are refused */
+        {
+                _cleanup_free_ char *buf = NULL;
+                _cleanup_close_ int fd = -EBADF;
+                size_t size;
+
+                assert_se(read_full_file(checkpoint, &buf, &size) >= 0);
+                assert_se(size > 0);
+
+                buf[size - 2] ^= 0x01;
+                assert_se((fd = open(checkpoint, O_WRONLY|O_CLOEXEC)) >= 0);
+                assert_se(loop_write(fd, buf, size) >= 0);
+                assert_se(logind_checkpoint_load(checkpoint, dirs, &h) == -EBADMSG);
+
+                assert_se(write_string_file(checkpoint, "ELCKPT02", WRITE_STRING_FILE_TRUNCATE) >= 0);
+                assert_se(logind_checkpoint_load(checkpoint, dirs, &h) == -EBADMSG);
+        }
+
+        assert_se(unlink(checkpoint) >= 0);
+        assert_se(logind_checkpoint_load(checkpoint, dirs, &h) == -ENOENT);
+}
+
+DEFINE_TEST_MAIN(LOG_DEBUG);
@@ -0,0 +1,80 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "fd-util.h"
+#include "json.h"
+#include "logind-startup-trace.h"
+#include "path-util.h"
+#include "rm-rf.h"
+#include "string-util.h"
+#include "tests.h"
+#include "tmpfile-util.h"
+
+TEST(mark) {
+        StartupTrace t;
+
+        startup_trace_init(&t, 1000);
+        assert_se(startup_trace_total(&t) == 0);
+
+        startup_trace_mark_at(&t, STARTUP_DAEMONIZE, 0, 1500);
+        startup_trace_mark_at(&t, STARTUP_ENUMERATE_SESSIONS, 3, 2000);
+        startup_trace_mark_at(&t, STARTUP_ATTACH_FDS, 0, 2100);
+
+        /* A phase that runs twice is accounted for in total */
+        startup_trace_mark_at(&t, STARTUP_ENUMERATE_SESSIONS, 2, 2600);
+
+        /* The clock never goes backwards for the phases */
+        startup_trace_mark_at(&t, STARTUP_GC, 1, 2500);
+
+        assert_se(t.phases[STARTUP_DAEMONIZE].recorded);
+        assert_se(t.phases[STARTUP_DAEMONIZE].usec == 500);
+        assert_se(t.phases[STARTUP_ENUMERATE_SESSIONS].usec == 1000);
+        assert_se(t.phases[STARTUP_ENUMERATE_SESSIONS].n_objects == 5);
+        assert_se(t.phases[STARTUP_ATTACH_FDS].usec == 100);
+        assert_se(t.phases[STARTUP_GC].recorded);
+        assert_se(t.phases[STARTUP_GC].usec == 0);
+        assert_se(!t.phases[STARTUP_CONNECT_BUS].recorded);
+
+        startup_trace_ready(&t);
+        assert_se(startup_trace_total(&t) == t.ready - 1000);
+
+        /* Once ready, nothing is recorded anymore */
+        startup_trace_mark_at(&t, STARTUP_READ_UTMP, 7, t.ready + 1);
+        assert_se(!t.phases[STARTUP_READ_UTMP].recorded);
+}
+
+TEST(write) {
+        _cleanup_(rm_rf_physical_and_freep) char *d = NULL;
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        _cleanup_fclose_ FILE *f = NULL;
+        _cleanup_free_ char *p = NULL;
+        JsonVariant *phases, *e;
+        StartupTrace t;
+
+        startup_trace_init(&t, now(CLOCK_MONOTONIC));
+        startup_trace_mark(&t, STARTUP_CONNECT_BUS, 0);
+        startup_trace_mark(&t, STARTUP_ENUMERATE_USERS, 42);
+        startup_trace_ready(&t);
+
+        assert_se(mkdtemp_malloc("/tmp/test-logind-startup-trace.XXXXXX", &d) >= 0);
+        assert_se(p = path_join(d, "sub/trace.json"));
+        assert_se(startup_trace_write(&t, p) >= 0);
+
+        assert_se(f = fopen(p, "re"));
+        assert_se(json_parse_file(f, p, 0, &v, NULL, NULL) >= 0);
+
+        assert_se(json_variant_unsigned(json_variant_by_key(v, "totalUSec")) == startup_trace_total(&t));
+
+        assert_se(phases = json_variant_by_key(v, "phases"));
+        assert_se(json_variant_elements(phases) == 2);
+
+        assert_se(e = json_variant_by_index(phases, 0));
+        assert_se(streq(json_variant_string(json_variant_by_key(e, "phase")), "connect-bus"));
+        assert_se(json_variant_unsigned(json_variant_by_key(e, "objects")) == 0);
+
+        assert_se(e = json_variant_by_index(phases, 1));
+        assert_se(streq(json_variant_string(json_variant_by_key(e, "phase")), "enumerate-users"));
+        assert_se(json_variant_unsigned(json_variant_by_key(e, "objects")) == 42);
+        assert_se(json_variant_unsigned(json_variant_by_key(e, "usec")) == t.phases[STARTUP_ENUMERATE_USERS].usec);
+}
+
+DEFINE_TEST_MAIN(LOG_DEBUG);
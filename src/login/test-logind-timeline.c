@@ -0,0 +1,126 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "sd-event.h"
+
+#include "alloc-util.h"
+#include "fd-util.h"
+#include "logind-test-util.h"
+#include "logind-timeline.h"
+#include "process-util.h"
+#include "tests.h"
+#include "time-util.h"
+
+static void assert_phases(const Timeline *t, const TimelinePhase *phases, size_t n) {
+        assert_se(t->n_marks == n);
+
+        for (size_t i = 0; i < n; i++) {
+                assert_se(t->marks[i].phase == phases[i]);
+
+                if (i > 0)
+                        assert_se(t->marks[i].timestamp.monotonic >= t->marks[i - 1].timestamp.monotonic);
+        }
+}
+
+TEST(history) {
+        _cleanup_(test_manager_freep) Manager *m = test_manager_new();
+
+        /* Marks without an operation in progress are dropped */
+        manager_timeline_mark(m, TIMELINE_EXECUTE);
+        manager_timeline_end(m, 0);
+        assert_se(!m->timeline);
+        assert_se(m->n_timelines == 0);
+
+        manager_timeline_begin(m, "suspend");
+        manager_timeline_mark(m, TIMELINE_INHIBITOR_DELAY);
+        manager_timeline_mark(m, TIMELINE_INHIBITOR_TIMEOUT);
+        manager_timeline_mark(m, TIMELINE_EXECUTE);
+        manager_timeline_end(m, -EIO);
+
+        assert_se(!m->timeline);
+        assert_se(m->n_timelines == 1);
+        assert_se(streq(m->timelines[0]->action, "suspend"));
+        assert_se(m->timelines[0]->result == -EIO);
+        assert_phases(m->timelines[0],
+                      (const TimelinePhase[]) {
+                              TIMELINE_REQUEST,
+                              TIMELINE_INHIBITOR_DELAY,
+                              TIMELINE_INHIBITOR_TIMEOUT,
+                              TIMELINE_EXECUTE,
+                              TIMELINE_FINISH,
+                      }, 5);
+
+        /* A new operation ends the one still in progress */
+        manager_timeline_begin(m, "hibernate");
+        manager_timeline_begin(m, "poweroff");
+        assert_se(m->n_timelines == 2);
+        assert_se(streq(m->timelines[1]->action, "hibernate"));
+        assert_se(m->timelines[1]->result == -ECANCELED);
+        manager_timeline_end(m, 0);
+
+        /* Only the most recent ones are kept */
+        for (unsigned i = 0; i < TIMELINES_MAX; i++) {
+                manager_timeline_begin(m, i % 2 == 0 ? "reboot" : "halt");
+                manager_timeline_end(m, 0);
+        }
+
+        assert_se(m->n_timelines == TIMELINES_MAX);
+        assert_se(streq(m->timelines[0]->action, "reboot"));
+        assert_se(streq(m->timelines[TIMELINES_MAX - 1]->action, "halt"));
+        assert_se(m->timelines[TIMELINES_MAX - 1]->result == 0);
+}
+
+static void run_until_finished(Manager *m) {
+        usec_t deadline = usec_add(now(CLOCK_MONOTONIC), 5 * USEC_PER_SEC);
+
+        while (m->timeline) {
+                assert_se(now(CLOCK_MONOTONIC) < deadline);
+                assert_se(sd_event_run(m->event, 100 * USEC_PER_MSEC) >= 0);
+        }
+}
+
+static void test_fork_one(bool finish) {
+        _cleanup_(test_manager_freep) Manager *m = test_manager_new();
+        int fd, r;
+
+        log_info("/* %s(finish=%s) */", __func__, yes_no(finish));
+
+        manager_timeline_begin(m, "suspend");
+        manager_timeline_mark(m, TIMELINE_FORK);
+
+        assert_se((fd = manager_timeline_prepare_fork(m)) >= 0);
+
+        r = safe_fork_full("(timeline)", NULL, &fd, 1, FORK_CLOSE_ALL_FDS|FORK_DEATHSIG_SIGTERM|FORK_LOG|FORK_WAIT, NULL);
+        assert_se(r >= 0);
+        if (r == 0) {
+                manager_timeline_mark(m, TIMELINE_SLEEP_CONFIG);
+                manager_timeline_mark(m, TIMELINE_PRE_HOOKS);
+                if (finish)
+                        manager_timeline_end(m, -ECANCELED);
+                _exit(EXIT_SUCCESS);
+        }
+
+        manager_timeline_forked(m);
+        assert_se(m->timeline_fd < 0);
+
+        run_until_finished(m);
+
+        assert_se(m->n_timelines == 1);
+        assert_se(m->timelines[0]->result == (finish ? -ECANCELED : -EPIPE));
+        assert_se(!m->timeline_event_source);
+
+        assert_phases(m->timelines[0],
+                      (const TimelinePhase[]) {
+                              TIMELINE_REQUEST,
+                              TIMELINE_FORK,
+                              TIMELINE_SLEEP_CONFIG,
+                              TIMELINE_PRE_HOOKS,
+                              TIMELINE_FINISH,
+                      }, 5);
+}
+
+TEST(fork) {
+        test_fork_one(true);
+        test_fork_one(false);
+}
+
+DEFINE_TEST_MAIN(LOG_DEBUG);
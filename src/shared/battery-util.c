@@ -2,13 +2,43 @@
 
 #include "sd-device.h"
 
+#include "alloc-util.h"
 #include "device-private.h"
 #include "device-util.h"
+#include "errno-util.h"
+#include "fileio.h"
+#include "parse-util.h"
+#include "path-util.h"
 #include "string-util.h"
+#include "udev-util.h"
 #include "battery-util.h"
 
 #define BATTERY_LOW_CAPACITY_LEVEL 5
 
+int power_supply_read_attribute(sd_device *d, const char *attr, char **ret) {
+        _cleanup_free_ char *p = NULL;
+        const char *syspath;
+        int r;
+
+        assert(d);
+        assert(attr);
+        assert(ret);
+
+        /* Unlike sd_device_get_sysattr_value() this keeps the attribute open, as the state of power
+         * supplies is queried over and over again, see read_virtual_attribute(). Use it for attributes that
+         * change, the static ones are better read through sd_device. */
+
+        r = sd_device_get_syspath(d, &syspath);
+        if (r < 0)
+                return r;
+
+        p = path_join(syspath, attr);
+        if (!p)
+                return -ENOMEM;
+
+        return read_virtual_attribute(p, ret);
+}
+
 static int device_is_power_sink(sd_device *device) {
         _cleanup_(sd_device_enumerator_unrefp) sd_device_enumerator *e = NULL;
         bool found_source = false, found_sink = false;
@@ -41,9 +71,9 @@ static int device_is_power_sink(sd_device *device) {
                 return r;
 
         FOREACH_DEVICE(e, d) {
-                const char *val;
+                _cleanup_free_ char *val = NULL;
 
-                r = sd_device_get_sysattr_value(d, "power_role", &val);
+                r = power_supply_read_attribute(d, "power_role", &val);
                 if (r < 0) {
                         if (r != -ENOENT)
                                 log_device_debug_errno(d, r, "Failed to read 'power_role' sysfs attribute, ignoring: %m");
@@ -69,48 +99,182 @@ static int device_is_power_sink(sd_device *device) {
         return found_sink || !found_source;
 }
 
-static bool battery_is_discharging(sd_device *d) {
+PowerSupply* power_supply_free(PowerSupply *s) {
+        if (!s)
+                return NULL;
+
+        free(s->syspath);
+        free(s->name);
+        free(s->type);
+        free(s->status);
+        return mfree(s);
+}
+
+DEFINE_PRIVATE_HASH_OPS_WITH_VALUE_DESTRUCTOR(power_supply_hash_ops, char, string_hash_func, string_compare_func,
+                                              PowerSupply, power_supply_free);
+
+static int power_supply_read_int(sd_device *d, const char *attr, int *ret) {
+        _cleanup_free_ char *val = NULL;
+        int r;
+
+        assert(d);
+        assert(attr);
+        assert(ret);
+
+        r = power_supply_read_attribute(d, attr, &val);
+        if (r < 0)
+                return r;
+
+        return safe_atoi(val, ret);
+}
+
+static int power_supply_update(PowerSupply *s, sd_device *d, bool usb_role) {
         const char *val;
         int r;
 
+        assert(s);
         assert(d);
 
-        r = sd_device_get_sysattr_value(d, "scope", &val);
-        if (r < 0) {
-                if (r != -ENOENT)
-                        log_device_debug_errno(d, r, "Failed to read 'scope' sysfs attribute, ignoring: %m");
-        } else if (streq(val, "Device")) {
-                log_device_debug(d, "The power supply is a device battery, ignoring device.");
-                return false;
+        /* See
+         * https://github.com/torvalds/linux/blob/4eef766b7d4d88f0b984781bc1bcb574a6eafdc7/include/linux/power_supply.h#L176
+         * for defined power source types. Also see:
+         * https://docs.kernel.org/admin-guide/abi-testing.html#abi-file-testing-sysfs-class-power */
+
+        /* The type, scope and name of a power supply never change, only read them once */
+        if (!s->type) {
+                r = sd_device_get_sysattr_value(d, "type", &val);
+                if (r < 0)
+                        return log_device_debug_errno(d, r, "Failed to read 'type' sysfs attribute: %m");
+
+                s->type = strdup(val);
+                if (!s->type)
+                        return -ENOMEM;
+
+                r = sd_device_get_sysattr_value(d, "scope", &val);
+                if (r < 0) {
+                        if (r != -ENOENT)
+                                log_device_debug_errno(d, r, "Failed to read 'scope' sysfs attribute, ignoring: %m");
+                } else
+                        s->device_scope = streq(val, "Device");
+
+                if (sd_device_get_property_value(d, "POWER_SUPPLY_NAME", &val) >= 0) {
+                        s->name = strdup(val);
+                        if (!s->name)
+                                return -ENOMEM;
+                }
         }
 
-        r = device_get_sysattr_bool(d, "present");
-        if (r < 0)
-                log_device_debug_errno(d, r, "Failed to read 'present' sysfs attribute, assuming the battery is present: %m");
-        else if (r == 0) {
-                log_device_debug(d, "The battery is not present, ignoring the power supply.");
-                return false;
+        /* Ignore USB-C power supply in source mode. See issue #21988. Finding out needs an enumeration of
+         * the type-C ports, hence it may be left for power_supplies_refresh_usb(). */
+        if (streq(s->type, "USB") && usb_role)
+                s->usb_sink = device_is_power_sink(d);
+
+        if (streq(s->type, "Battery")) {
+                _cleanup_free_ char *present = NULL;
+
+                r = power_supply_read_attribute(d, "present", &present);
+                s->present = r < 0 ? r : parse_boolean(present);
+
+                /* Possible values: "Unknown", "Charging", "Discharging", "Not charging", "Full" */
+                s->status = mfree(s->status);
+                r = power_supply_read_attribute(d, "status", &s->status);
+                if (r < 0)
+                        log_device_debug_errno(d, r, "Failed to read 'status' sysfs attribute: %m");
+
+                s->capacity = battery_read_capacity_percentage(d);
+        } else {
+                r = power_supply_read_int(d, "online", &s->online);
+                if (r < 0)
+                        s->online = r;
         }
 
-        /* Possible values: "Unknown", "Charging", "Discharging", "Not charging", "Full" */
-        r = sd_device_get_sysattr_value(d, "status", &val);
-        if (r < 0) {
-                log_device_debug_errno(d, r, "Failed to read 'status' sysfs attribute, assuming the battery is discharging: %m");
-                return true;
+        return 0;
+}
+
+static int power_supplies_add_device(Hashmap **supplies, sd_device *d, bool usb_role) {
+        _cleanup_(power_supply_freep) PowerSupply *n = NULL;
+        const char *syspath;
+        PowerSupply *s;
+        int r;
+
+        assert(supplies);
+        assert(d);
+
+        r = sd_device_get_syspath(d, &syspath);
+        if (r < 0)
+                return r;
+
+        if (device_for_action(d, SD_DEVICE_REMOVE)) {
+                power_supply_free(hashmap_remove(*supplies, syspath));
+                return 0;
         }
-        if (!streq(val, "Discharging")) {
-                log_device_debug(d, "The battery status is '%s', assuming the battery is not used as a power source of this machine.", val);
-                return false;
+
+        s = hashmap_get(*supplies, syspath);
+        if (s)
+                return power_supply_update(s, d, usb_role);
+
+        n = new(PowerSupply, 1);
+        if (!n)
+                return -ENOMEM;
+
+        *n = (PowerSupply) {
+                .syspath = strdup(syspath),
+                .usb_sink = -ENODATA,
+                .present = -ENODATA,
+                .online = -ENODATA,
+                .capacity = -ENODATA,
+        };
+        if (!n->syspath)
+                return -ENOMEM;
+
+        r = power_supply_update(n, d, usb_role);
+        if (r < 0)
+                return r;
+
+        r = hashmap_ensure_put(supplies, &power_supply_hash_ops, n->syspath, n);
+        if (r < 0)
+                return r;
+
+        TAKE_PTR(n);
+        return 0;
+}
+
+int power_supplies_process_device(Hashmap **supplies, sd_device *d) {
+        return power_supplies_add_device(supplies, d, /* usb_role = */ true);
+}
+
+int power_supplies_refresh_usb(Hashmap *supplies) {
+        PowerSupply *s;
+        int r = 0;
+
+        /* The power role of USB type-C ports changed, reevaluate the USB power supplies */
+
+        HASHMAP_FOREACH(s, supplies) {
+                _cleanup_(sd_device_unrefp) sd_device *d = NULL;
+                int k;
+
+                if (!streq_ptr(s->type, "USB"))
+                        continue;
+
+                k = sd_device_new_from_syspath(&d, s->syspath);
+                if (k < 0) {
+                        RET_GATHER(r, k);
+                        continue;
+                }
+
+                s->usb_sink = device_is_power_sink(d);
         }
 
-        return true;
+        return r;
 }
 
-int on_ac_power(void) {
+int power_supplies_enumerate(Hashmap **ret, bool usb_role) {
         _cleanup_(sd_device_enumerator_unrefp) sd_device_enumerator *e = NULL;
-        bool found_ac_online = false, found_discharging_battery = false;
+        _cleanup_hashmap_free_ Hashmap *supplies = NULL;
         int r;
 
+        assert(ret);
+
         r = sd_device_enumerator_new(&e);
         if (r < 0)
                 return r;
@@ -124,46 +288,84 @@ int on_ac_power(void) {
                 return r;
 
         FOREACH_DEVICE(e, d) {
-                /* See
-                 * https://github.com/torvalds/linux/blob/4eef766b7d4d88f0b984781bc1bcb574a6eafdc7/include/linux/power_supply.h#L176
-                 * for defined power source types. Also see:
-                 * https://docs.kernel.org/admin-guide/abi-testing.html#abi-file-testing-sysfs-class-power */
+                r = power_supplies_add_device(&supplies, d, usb_role);
+                if (r == -ENOMEM)
+                        return r;
+                if (r < 0)
+                        log_device_debug_errno(d, r, "Failed to read power supply, ignoring device: %m");
+        }
 
-                const char *val;
-                r = sd_device_get_sysattr_value(d, "type", &val);
-                if (r < 0) {
-                        log_device_debug_errno(d, r, "Failed to read 'type' sysfs attribute, ignoring device: %m");
+        *ret = TAKE_PTR(supplies);
+        return 0;
+}
+
+bool power_supply_is_battery(const PowerSupply *s) {
+        assert(s);
+
+        /* A battery powering this machine, i.e. not the one of a mouse or so */
+        return streq_ptr(s->type, "Battery") && s->present > 0 && !s->device_scope;
+}
+
+static bool power_supply_is_discharging(const PowerSupply *s) {
+        assert(s);
+
+        if (s->device_scope) {
+                log_debug("Power supply %s is a device battery, ignoring device.", s->syspath);
+                return false;
+        }
+
+        if (s->present < 0)
+                log_debug_errno(s->present, "Failed to read 'present' sysfs attribute of %s, assuming the battery is present: %m", s->syspath);
+        else if (s->present == 0) {
+                log_debug("Battery %s is not present, ignoring the power supply.", s->syspath);
+                return false;
+        }
+
+        if (!s->status) {
+                log_debug("Status of battery %s is unknown, assuming the battery is discharging.", s->syspath);
+                return true;
+        }
+        if (!streq(s->status, "Discharging")) {
+                log_debug("The status of battery %s is '%s', assuming the battery is not used as a power source of this machine.", s->syspath, s->status);
+                return false;
+        }
+
+        return true;
+}
+
+int power_supplies_on_ac_power(Hashmap *supplies) {
+        bool found_ac_online = false, found_discharging_battery = false;
+        PowerSupply *s;
+
+        HASHMAP_FOREACH(s, supplies) {
+                if (!s->type)
                         continue;
-                }
 
-                /* Ignore USB-C power supply in source mode. See issue #21988. */
-                if (streq(val, "USB")) {
-                        r = device_is_power_sink(d);
-                        if (r <= 0) {
-                                if (r < 0)
-                                        log_device_debug_errno(d, r, "Failed to determine the current power role, ignoring device: %m");
-                                else
-                                        log_device_debug(d, "USB power supply is in source mode, ignoring device.");
-                                continue;
-                        }
+                if (streq(s->type, "USB") && s->usb_sink <= 0) {
+                        if (s->usb_sink == -ENODATA)
+                                log_debug("Power role of USB power supply %s not determined yet, ignoring device.", s->syspath);
+                        else if (s->usb_sink < 0)
+                                log_debug_errno(s->usb_sink, "Failed to determine the current power role of %s, ignoring device: %m", s->syspath);
+                        else
+                                log_debug("USB power supply %s is in source mode, ignoring device.", s->syspath);
+                        continue;
                 }
 
-                if (streq(val, "Battery")) {
-                        if (battery_is_discharging(d)) {
+                if (streq(s->type, "Battery")) {
+                        if (power_supply_is_discharging(s)) {
                                 found_discharging_battery = true;
-                                log_device_debug(d, "The power supply is a battery and currently discharging.");
+                                log_debug("Power supply %s is a battery and currently discharging.", s->syspath);
                         }
                         continue;
                 }
 
-                r = device_get_sysattr_unsigned(d, "online", NULL);
-                if (r < 0) {
-                        log_device_debug_errno(d, r, "Failed to query 'online' sysfs attribute, ignoring device: %m");
+                if (s->online < 0) {
+                        log_debug_errno(s->online, "Failed to query 'online' sysfs attribute of %s, ignoring device: %m", s->syspath);
                         continue;
-                } else if (r > 0)  /* At least 1 and 2 are defined as different types of 'online' */
+                } else if (s->online > 0)  /* At least 1 and 2 are defined as different types of 'online' */
                         found_ac_online = true;
 
-                log_device_debug(d, "The power supply is currently %s.", r > 0 ? "online" : "offline");
+                log_debug("Power supply %s is currently %s.", s->syspath, s->online > 0 ? "online" : "offline");
         }
 
         if (found_ac_online) {
@@ -178,6 +380,61 @@ int on_ac_power(void) {
         }
 }
 
+static bool power_supplies_have_usb(Hashmap *supplies) {
+        PowerSupply *s;
+
+        HASHMAP_FOREACH(s, supplies)
+                if (streq_ptr(s->type, "USB"))
+                        return true;
+
+        return false;
+}
+
+static int power_supplies_enumerate_lazily(Hashmap **ret) {
+        int r;
+
+        assert(ret);
+
+        /* For a single answer the power roles of the USB power supplies are only looked at if the answer
+         * depends on them, see power_supplies_resolve_usb(), because that needs an enumeration of the
+         * type-C ports on top. Until then USB power supplies count as not online. */
+
+        r = power_supplies_enumerate(ret, /* usb_role = */ false);
+        if (r < 0)
+                return log_debug_errno(r, "Failed to enumerate power supplies: %m");
+
+        return 0;
+}
+
+static bool power_supplies_resolve_usb(Hashmap *supplies) {
+        int r;
+
+        if (!power_supplies_have_usb(supplies))
+                return false;
+
+        r = power_supplies_refresh_usb(supplies);
+        if (r < 0)
+                log_debug_errno(r, "Failed to determine the power role of some USB power supplies, ignoring: %m");
+
+        return true;
+}
+
+int on_ac_power(void) {
+        _cleanup_hashmap_free_ Hashmap *supplies = NULL;
+        int r;
+
+        r = power_supplies_enumerate_lazily(&supplies);
+        if (r < 0)
+                return r;
+
+        /* Another online power supply can only turn "battery" into "AC", not the other way round */
+        r = power_supplies_on_ac_power(supplies);
+        if (r != 0 || !power_supplies_resolve_usb(supplies))
+                return r;
+
+        return power_supplies_on_ac_power(supplies);
+}
+
 /* Get the list of batteries */
 int battery_enumerator_new(sd_device_enumerator **ret) {
         _cleanup_(sd_device_enumerator_unrefp) sd_device_enumerator *e = NULL;
@@ -215,11 +472,14 @@ int battery_enumerator_new(sd_device_enumerator **ret) {
 
 /* Battery percentage capacity fetched from capacity file and if in range 0-100 then returned */
 int battery_read_capacity_percentage(sd_device *dev) {
+        _cleanup_free_ char *capacity = NULL;
         int battery_capacity, r;
 
         assert(dev);
 
-        r = device_get_sysattr_int(dev, "capacity", &battery_capacity);
+        r = power_supply_read_attribute(dev, "capacity", &capacity);
+        if (r >= 0)
+                r = safe_atoi(capacity, &battery_capacity);
         if (r < 0)
                 return log_device_debug_errno(dev, r, "Failed to read/parse POWER_SUPPLY_CAPACITY: %m");
 
@@ -230,45 +490,36 @@ int battery_read_capacity_percentage(sd_device *dev) {
 }
 
 /* If a battery whose percentage capacity is <= 5% exists, and we're not on AC power, return success */
-int battery_is_discharging_and_low(void) {
-        _cleanup_(sd_device_enumerator_unrefp) sd_device_enumerator *e = NULL;
+int power_supplies_discharging_and_low(Hashmap *supplies) {
         bool unsure = false, found_low = false;
-        int r;
+        PowerSupply *s;
 
          /* We have not used battery capacity_level since value is set to full
          * or Normal in case ACPI is not working properly. In case of no battery
          * 0 will be returned and system will be suspended for 1st cycle then hibernated */
 
-        r = on_ac_power();
-        if (r < 0)
-                log_debug_errno(r, "Failed to check if the system is running on AC, assuming it is not: %m");
-        if (r > 0)
+        if (power_supplies_on_ac_power(supplies))
                 return false;
 
-        r = battery_enumerator_new(&e);
-        if (r < 0)
-                return log_debug_errno(r, "Failed to initialize battery enumerator: %m");
-
-        FOREACH_DEVICE(e, dev) {
-                int level;
+        HASHMAP_FOREACH(s, supplies) {
+                if (!power_supply_is_battery(s))
+                        continue;
 
-                level = battery_read_capacity_percentage(dev);
-                if (level < 0) {
+                if (s->capacity < 0) {
+                        log_debug_errno(s->capacity, "Failed to read/parse POWER_SUPPLY_CAPACITY of %s: %m", s->syspath);
                         unsure = true;
                         continue;
                 }
 
-                if (level > BATTERY_LOW_CAPACITY_LEVEL) { /* Found a charged battery */
-                        log_device_full(dev,
-                                        found_low ? LOG_INFO : LOG_DEBUG,
-                                        "Found battery with capacity above threshold (%d%% > %d%%).",
-                                        level, BATTERY_LOW_CAPACITY_LEVEL);
+                if (s->capacity > BATTERY_LOW_CAPACITY_LEVEL) { /* Found a charged battery */
+                        log_full(found_low ? LOG_INFO : LOG_DEBUG,
+                                 "Found battery %s with capacity above threshold (%d%% > %d%%).",
+                                 s->syspath, s->capacity, BATTERY_LOW_CAPACITY_LEVEL);
                         return false;
                 }
 
-                log_device_info(dev,
-                                "Found battery with capacity below threshold (%d%% <= %d%%).",
-                                level, BATTERY_LOW_CAPACITY_LEVEL);
+                log_info("Found battery %s with capacity below threshold (%d%% <= %d%%).",
+                         s->syspath, s->capacity, BATTERY_LOW_CAPACITY_LEVEL);
                 found_low = true;
         }
 
@@ -281,3 +532,21 @@ int battery_is_discharging_and_low(void) {
         /* If found neither charged nor low batteries, assume that we aren't in low battery state */
         return found_low;
 }
+
+int battery_is_discharging_and_low(void) {
+        _cleanup_hashmap_free_ Hashmap *supplies = NULL;
+        int r;
+
+        /* One pass over the power supplies answers both whether we are on AC and how full the batteries
+         * are */
+        r = power_supplies_enumerate_lazily(&supplies);
+        if (r < 0)
+                return r;
+
+        /* Another online power supply can only turn "low" into "on AC", not the other way round */
+        r = power_supplies_discharging_and_low(supplies);
+        if (r <= 0 || !power_supplies_resolve_usb(supplies))
+                return r;
+
+        return power_supplies_discharging_and_low(supplies);
+}
@@ -3,9 +3,38 @@
 
 #include "sd-device.h"
 
+#include "hashmap.h"
+
+/* What we know about a power supply, see power_supplies_enumerate() and power_supplies_process_device() */
+typedef struct PowerSupply {
+        char *syspath;
+        char *name;      /* POWER_SUPPLY_NAME, may be NULL */
+        char *type;      /* "Battery", "Mains", "USB", … */
+        bool device_scope; /* the battery of a peripheral, not of this machine */
+        int usb_sink;    /* for USB power supplies: whether they are in sink mode, or negative errno */
+        int present;     /* for batteries: boolean, or negative errno */
+        char *status;    /* for batteries: "Charging", "Discharging", …, NULL if unknown */
+        int capacity;    /* for batteries: 0…100 percent, or negative errno */
+        int online;      /* for anything else: > 0 if online, or negative errno */
+} PowerSupply;
+
+PowerSupply* power_supply_free(PowerSupply *s);
+DEFINE_TRIVIAL_CLEANUP_FUNC(PowerSupply*, power_supply_free);
+
+bool power_supply_is_battery(const PowerSupply *s);
+
+int power_supplies_enumerate(Hashmap **ret, bool usb_role);
+int power_supplies_process_device(Hashmap **supplies, sd_device *d);
+int power_supplies_refresh_usb(Hashmap *supplies);
+
+int power_supplies_on_ac_power(Hashmap *supplies);
+int power_supplies_discharging_and_low(Hashmap *supplies);
+
 int on_ac_power(void);
 
 int battery_is_discharging_and_low(void);
 
 int battery_enumerator_new(sd_device_enumerator **ret);
 int battery_read_capacity_percentage(sd_device *dev);
+
+int power_supply_read_attribute(sd_device *d, const char *attr, char **ret);
@@ -128,7 +128,6 @@ int bus_call_method(
         return r;
 }
 
-#if 0 /// UNNEEDED by elogind
 int bus_get_property(
                 sd_bus *bus,
                 const BusLocator *locator,
@@ -141,7 +140,6 @@ int bus_get_property(
 
         return sd_bus_get_property(bus, locator->destination, locator->path, locator->interface, member, error, reply, type);
 }
-#endif // 0
 
 int bus_get_property_trivial(
                 sd_bus *bus,
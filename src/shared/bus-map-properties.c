@@ -251,3 +251,141 @@ int bus_map_all_properties(
 
         return r;
 }
+
+typedef struct BusMapPropertiesCall {
+        const struct bus_properties_map *map;
+        unsigned flags;
+        size_t *n_inflight;
+        BusMapPropertiesRequest *request;
+        sd_bus_slot *slot;
+} BusMapPropertiesCall;
+
+void bus_map_properties_request_array_free(BusMapPropertiesRequest *requests, size_t n) {
+        assert(requests || n == 0);
+
+        FOREACH_ARRAY(i, requests, n) {
+                sd_bus_message_unref(i->reply);
+                sd_bus_error_free(&i->error);
+        }
+
+        free(requests);
+}
+
+static void bus_map_properties_call_array_free(BusMapPropertiesCall *calls, size_t n) {
+        assert(calls || n == 0);
+
+        FOREACH_ARRAY(i, calls, n)
+                sd_bus_slot_unref(i->slot);
+
+        free(calls);
+}
+
+static int map_all_properties_reply(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
+        BusMapPropertiesCall *c = ASSERT_PTR(userdata);
+        BusMapPropertiesRequest *req = ASSERT_PTR(c->request);
+        int r;
+
+        assert(m);
+
+        assert(*c->n_inflight > 0);
+        (*c->n_inflight)--;
+
+        r = sd_bus_message_get_errno(m);
+        if (r > 0) {
+                req->result = sd_bus_error_copy(&req->error, sd_bus_message_get_error(m));
+                return 0;
+        }
+
+        r = bus_message_map_all_properties(m, c->map, c->flags, &req->error, req->userdata);
+        if (r < 0) {
+                req->result = r;
+                return 0;
+        }
+
+        req->reply = sd_bus_message_ref(m);
+        req->result = 0;
+        return 0;
+}
+
+int bus_map_all_properties_many(
+                sd_bus *bus,
+                const char *destination,
+                const struct bus_properties_map *map,
+                unsigned flags,
+                size_t max_inflight,
+                BusMapPropertiesRequest *requests,
+                size_t n_requests) {
+
+        BusMapPropertiesCall *calls = NULL;
+        size_t n_inflight = 0, n_sent = 0;
+        int r;
+
+        assert(bus);
+        assert(destination);
+        assert(map);
+        assert(max_inflight > 0);
+        assert(requests || n_requests == 0);
+
+        /* Like bus_map_all_properties() for many objects at once. Instead of waiting for each GetAll()
+         * reply before sending the next call, keeps up to max_inflight calls on the wire. Replies are
+         * mapped as they come in. Failures to get the properties of a single object are reported in its
+         * request, the return value is only about failures of the bus connection itself. */
+
+        if (n_requests == 0)
+                return 0;
+
+        calls = new0(BusMapPropertiesCall, n_requests);
+        if (!calls)
+                return -ENOMEM;
+
+        CLEANUP_ARRAY(calls, n_requests, bus_map_properties_call_array_free);
+
+        for (;;) {
+                while (n_sent < n_requests && n_inflight < max_inflight) {
+                        BusMapPropertiesCall *c = calls + n_sent;
+                        BusMapPropertiesRequest *req = requests + n_sent;
+
+                        assert(req->path);
+
+                        *c = (BusMapPropertiesCall) {
+                                .map = map,
+                                .flags = flags,
+                                .n_inflight = &n_inflight,
+                                .request = req,
+                        };
+
+                        req->result = -EINPROGRESS;
+
+                        r = sd_bus_call_method_async(
+                                        bus,
+                                        &c->slot,
+                                        destination,
+                                        req->path,
+                                        "org.freedesktop.DBus.Properties",
+                                        "GetAll",
+                                        map_all_properties_reply,
+                                        c,
+                                        "s", "");
+                        if (r < 0)
+                                return r;
+
+                        n_sent++;
+                        n_inflight++;
+                }
+
+                if (n_inflight == 0)
+                        break;
+
+                r = sd_bus_process(bus, NULL);
+                if (r < 0)
+                        return r;
+                if (r > 0)
+                        continue;
+
+                r = sd_bus_wait(bus, UINT64_MAX);
+                if (r < 0)
+                        return r;
+        }
+
+        return 0;
+}
@@ -25,3 +25,22 @@ int bus_map_strv_sort(sd_bus *bus, const char *member, sd_bus_message *m, sd_bus
 int bus_message_map_all_properties(sd_bus_message *m, const struct bus_properties_map *map, unsigned flags, sd_bus_error *error, void *userdata);
 int bus_map_all_properties(sd_bus *bus, const char *destination, const char *path, const struct bus_properties_map *map,
                            unsigned flags, sd_bus_error *error, sd_bus_message **reply, void *userdata);
+
+/* Requests for bus_map_all_properties_many(). The path and userdata are filled in by the caller, the rest
+ * when the reply arrives. As with bus_map_all_properties(), strings may point into the reply. */
+typedef struct BusMapPropertiesRequest {
+        const char *path;
+        void *userdata;
+
+        sd_bus_message *reply;
+        sd_bus_error error;
+        int result;
+} BusMapPropertiesRequest;
+
+/* Stays well below the limit of pending replies dbus-daemon puts on each connection */
+#define BUS_MAP_PROPERTIES_MAX_INFLIGHT 64U
+
+void bus_map_properties_request_array_free(BusMapPropertiesRequest *requests, size_t n);
+
+int bus_map_all_properties_many(sd_bus *bus, const char *destination, const struct bus_properties_map *map, unsigned flags,
+                                size_t max_inflight, BusMapPropertiesRequest *requests, size_t n_requests);
@@ -0,0 +1,472 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "alloc-util.h"
+#include "bus-internal.h"
+#include "bus-message.h"
+#include "bus-message-json.h"
+#include "bus-util.h"
+#include "fileio.h"
+#include "memstream-util.h"
+#include "time-util.h"
+
+/* Writes out a message as JSON while walking it, rather than converting it into a JsonVariant tree first and
+ * formatting that. The output is the same json_variant_dump() generates for the tree, byte by byte: objects
+ * carry their fields in the order they are read, variants become {"type","data"} objects, dictionaries with
+ * string keys become objects, and everything else becomes an array. */
+
+typedef struct JsonWriter {
+        FILE *f;
+        JsonFormatFlags flags;
+        unsigned level;
+} JsonWriter;
+
+static void json_writer_indent(JsonWriter *w) {
+        for (unsigned i = 0; i < w->level; i++)
+                fputc('\t', w->f);
+}
+
+/* Starts the next array element or object field. The opening bracket is only written with the first
+ * element, as empty containers are formatted differently. */
+static void json_writer_next(JsonWriter *w, char open, size_t *n) {
+        bool pretty = FLAGS_SET(w->flags, JSON_FORMAT_PRETTY);
+
+        assert(w);
+        assert(n);
+
+        if (*n == 0) {
+                fputc(open, w->f);
+                if (pretty)
+                        fputc('\n', w->f);
+                w->level++;
+        } else
+                fputs(pretty ? ",\n" : ",", w->f);
+
+        if (pretty)
+                json_writer_indent(w);
+
+        (*n)++;
+}
+
+static void json_writer_close(JsonWriter *w, char open, char close, size_t n) {
+        assert(w);
+
+        if (n == 0) {
+                fputc(open, w->f);
+                fputc(close, w->f);
+                return;
+        }
+
+        assert(w->level > 0);
+        w->level--;
+
+        if (FLAGS_SET(w->flags, JSON_FORMAT_PRETTY)) {
+                fputc('\n', w->f);
+                json_writer_indent(w);
+        }
+
+        fputc(close, w->f);
+}
+
+static void json_writer_key(JsonWriter *w, size_t *n, const char *key) {
+        assert(w);
+        assert(key);
+
+        json_writer_next(w, '{', n);
+        json_format_string(w->f, key, w->flags);
+        fputs(FLAGS_SET(w->flags, JSON_FORMAT_PRETTY) ? " : " : ":", w->f);
+}
+
+static void json_writer_string(JsonWriter *w, const char *s) {
+        assert(w);
+
+        if (s)
+                json_format_string(w->f, s, w->flags);
+        else
+                json_format_null(w->f, w->flags);
+}
+
+static int json_stream_one(JsonWriter *w, sd_bus_message *m);
+
+static int json_stream_array_or_struct(JsonWriter *w, sd_bus_message *m) {
+        size_t n = 0;
+        int r;
+
+        assert(w);
+        assert(m);
+
+        for (;;) {
+                r = sd_bus_message_at_end(m, false);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+                if (r > 0)
+                        break;
+
+                json_writer_next(w, '[', &n);
+
+                r = json_stream_one(w, m);
+                if (r < 0)
+                        return r;
+        }
+
+        json_writer_close(w, '[', ']', n);
+        return 0;
+}
+
+static int json_stream_variant(JsonWriter *w, sd_bus_message *m, const char *contents) {
+        size_t n = 0;
+        int r;
+
+        assert(w);
+        assert(m);
+        assert(contents);
+
+        json_writer_key(w, &n, "type");
+        json_format_string(w->f, contents, w->flags);
+
+        json_writer_key(w, &n, "data");
+        r = json_stream_one(w, m);
+        if (r < 0)
+                return r;
+
+        json_writer_close(w, '{', '}', n);
+        return 0;
+}
+
+static int json_stream_dict_array(JsonWriter *w, sd_bus_message *m) {
+        size_t n = 0;
+        int r;
+
+        assert(w);
+        assert(m);
+
+        for (;;) {
+                const char *contents, *key;
+                char type;
+
+                r = sd_bus_message_at_end(m, false);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+                if (r > 0)
+                        break;
+
+                r = sd_bus_message_peek_type(m, &type, &contents);
+                if (r < 0)
+                        return r;
+
+                assert(type == 'e');
+
+                /* JSON object keys are strings, hence like json_variant_new_object() refuse anything else */
+                if (!IN_SET(contents[0], SD_BUS_TYPE_STRING, SD_BUS_TYPE_OBJECT_PATH, SD_BUS_TYPE_SIGNATURE))
+                        return -EINVAL;
+
+                r = sd_bus_message_enter_container(m, type, contents);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                r = sd_bus_message_read_basic(m, contents[0], &key);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                json_writer_key(w, &n, key);
+
+                r = json_stream_one(w, m);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_exit_container(m);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+        }
+
+        json_writer_close(w, '{', '}', n);
+        return 0;
+}
+
+static int json_stream_one(JsonWriter *w, sd_bus_message *m) {
+        const char *contents;
+        char type;
+        int r;
+
+        assert(w);
+        assert(m);
+
+        r = sd_bus_message_peek_type(m, &type, &contents);
+        if (r < 0)
+                return bus_log_parse_error(r);
+
+        switch (type) {
+
+        case SD_BUS_TYPE_BYTE: {
+                uint8_t b;
+
+                r = sd_bus_message_read_basic(m, type, &b);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                json_format_unsigned(w->f, b, w->flags);
+                break;
+        }
+
+        case SD_BUS_TYPE_BOOLEAN: {
+                int b;
+
+                r = sd_bus_message_read_basic(m, type, &b);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                json_format_boolean(w->f, b, w->flags);
+                break;
+        }
+
+        case SD_BUS_TYPE_INT16: {
+                int16_t b;
+
+                r = sd_bus_message_read_basic(m, type, &b);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                json_format_integer(w->f, b, w->flags);
+                break;
+        }
+
+        case SD_BUS_TYPE_UINT16: {
+                uint16_t b;
+
+                r = sd_bus_message_read_basic(m, type, &b);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                json_format_unsigned(w->f, b, w->flags);
+                break;
+        }
+
+        case SD_BUS_TYPE_INT32: {
+                int32_t b;
+
+                r = sd_bus_message_read_basic(m, type, &b);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                json_format_integer(w->f, b, w->flags);
+                break;
+        }
+
+        case SD_BUS_TYPE_UINT32: {
+                uint32_t b;
+
+                r = sd_bus_message_read_basic(m, type, &b);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                json_format_unsigned(w->f, b, w->flags);
+                break;
+        }
+
+        case SD_BUS_TYPE_INT64: {
+                int64_t b;
+
+                r = sd_bus_message_read_basic(m, type, &b);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                json_format_integer(w->f, b, w->flags);
+                break;
+        }
+
+        case SD_BUS_TYPE_UINT64: {
+                uint64_t b;
+
+                r = sd_bus_message_read_basic(m, type, &b);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                json_format_unsigned(w->f, b, w->flags);
+                break;
+        }
+
+        case SD_BUS_TYPE_DOUBLE: {
+                double d;
+
+                r = sd_bus_message_read_basic(m, type, &d);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                r = json_format_real(w->f, d, w->flags);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to format double: %m");
+                break;
+        }
+
+        case SD_BUS_TYPE_STRING:
+        case SD_BUS_TYPE_OBJECT_PATH:
+        case SD_BUS_TYPE_SIGNATURE: {
+                const char *s;
+
+                r = sd_bus_message_read_basic(m, type, &s);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                json_format_string(w->f, s, w->flags);
+                break;
+        }
+
+        case SD_BUS_TYPE_UNIX_FD:
+                r = sd_bus_message_read_basic(m, type, NULL);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                json_format_null(w->f, w->flags);
+                break;
+
+        case SD_BUS_TYPE_ARRAY:
+        case SD_BUS_TYPE_VARIANT:
+        case SD_BUS_TYPE_STRUCT:
+                r = sd_bus_message_enter_container(m, type, contents);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                if (type == SD_BUS_TYPE_VARIANT)
+                        r = json_stream_variant(w, m, contents);
+                else if (type == SD_BUS_TYPE_ARRAY && contents[0] == '{')
+                        r = json_stream_dict_array(w, m);
+                else
+                        r = json_stream_array_or_struct(w, m);
+                if (r < 0)
+                        return r;
+
+                r = sd_bus_message_exit_container(m);
+                if (r < 0)
+                        return bus_log_parse_error(r);
+
+                break;
+
+        default:
+                assert_not_reached();
+        }
+
+        return 0;
+}
+
+static int json_stream_payload(JsonWriter *w, sd_bus_message *m) {
+        size_t n = 0;
+        int r;
+
+        assert(w);
+        assert(m);
+
+        json_writer_key(w, &n, "type");
+        json_writer_string(w, sd_bus_message_get_signature(m, false));
+
+        json_writer_key(w, &n, "data");
+        r = json_stream_array_or_struct(w, m);
+        if (r < 0)
+                return r;
+
+        json_writer_close(w, '{', '}', n);
+        return 0;
+}
+
+int bus_message_dump_json(sd_bus_message *m, JsonFormatFlags flags, FILE *f) {
+        _cleanup_(memstream_done) MemStream ms = {};
+        _cleanup_free_ char *buf = NULL;
+        JsonWriter w;
+        size_t n = 0, sz;
+        usec_t ts;
+        char e[2];
+        int r;
+
+        assert(m);
+
+        if (!f)
+                f = stdout;
+
+        /* Generate everything in memory first, so that nothing is written for messages we fail to convert */
+        w = (JsonWriter) {
+                .f = memstream_init(&ms),
+        };
+        if (!w.f)
+                return log_oom();
+
+        w.flags = json_format_begin(w.f, flags & ~JSON_FORMAT_FLUSH);
+
+        e[0] = m->header->endian;
+        e[1] = 0;
+
+        ts = m->realtime;
+        if (ts == 0)
+                ts = now(CLOCK_REALTIME);
+
+        json_writer_key(&w, &n, "type");
+        json_writer_string(&w, bus_message_type_to_string(m->header->type));
+        json_writer_key(&w, &n, "endian");
+        json_writer_string(&w, e);
+        json_writer_key(&w, &n, "flags");
+        json_format_integer(w.f, m->header->flags, w.flags);
+        json_writer_key(&w, &n, "version");
+        json_format_integer(w.f, m->header->version, w.flags);
+        json_writer_key(&w, &n, "cookie");
+        json_format_integer(w.f, BUS_MESSAGE_COOKIE(m), w.flags);
+        if (m->reply_cookie != 0) {
+                json_writer_key(&w, &n, "reply_cookie");
+                json_format_integer(w.f, m->reply_cookie, w.flags);
+        }
+        json_writer_key(&w, &n, "timestamp-realtime");
+        json_format_unsigned(w.f, ts, w.flags);
+        if (m->sender) {
+                json_writer_key(&w, &n, "sender");
+                json_writer_string(&w, m->sender);
+        }
+        if (m->destination) {
+                json_writer_key(&w, &n, "destination");
+                json_writer_string(&w, m->destination);
+        }
+        if (m->path) {
+                json_writer_key(&w, &n, "path");
+                json_writer_string(&w, m->path);
+        }
+        if (m->interface) {
+                json_writer_key(&w, &n, "interface");
+                json_writer_string(&w, m->interface);
+        }
+        if (m->member) {
+                json_writer_key(&w, &n, "member");
+                json_writer_string(&w, m->member);
+        }
+        if (m->monotonic != 0) {
+                json_writer_key(&w, &n, "monotonic");
+                json_format_integer(w.f, m->monotonic, w.flags);
+        }
+        if (m->realtime != 0) {
+                json_writer_key(&w, &n, "realtime");
+                json_format_integer(w.f, m->realtime, w.flags);
+        }
+        if (m->seqnum != 0) {
+                json_writer_key(&w, &n, "seqnum");
+                json_format_integer(w.f, m->seqnum, w.flags);
+        }
+        if (m->error.name) {
+                json_writer_key(&w, &n, "error_name");
+                json_writer_string(&w, m->error.name);
+        }
+
+        json_writer_key(&w, &n, "payload");
+        r = json_stream_payload(&w, m);
+        if (r < 0)
+                return r;
+
+        json_writer_close(&w, '{', '}', n);
+
+        r = json_format_end(w.f, w.flags);
+        if (r < 0)
+                return log_error_errno(r, "Failed to format JSON: %m");
+
+        r = memstream_finalize(&ms, &buf, &sz);
+        if (r < 0)
+                return log_error_errno(r, "Failed to flush JSON: %m");
+
+        fwrite(buf, 1, sz, f);
+
+        if (FLAGS_SET(flags, JSON_FORMAT_FLUSH))
+                return fflush_and_check(f);
+        return 0;
+}
@@ -0,0 +1,10 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+#pragma once
+
+#include <stdio.h>
+
+#include "sd-bus.h"
+
+#include "json.h"
+
+int bus_message_dump_json(sd_bus_message *m, JsonFormatFlags flags, FILE *f);
@@ -46,6 +46,16 @@ int bus_add_implementation(sd_bus *bus, const BusObjectImplementation *impl, voi
                                                impl->path);
         }
 
+        if (impl->cached_node_enumerator) {
+                r = sd_bus_add_node_enumerator_cached(bus, NULL,
+                                                      impl->path,
+                                                      impl->cached_node_enumerator,
+                                                      userdata);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to add cached node enumerator for %s: %m",
+                                               impl->path);
+        }
+
         if (impl->manager) {
                 r = sd_bus_add_object_manager(bus, NULL, impl->path);
                 if (r < 0)
@@ -19,6 +19,7 @@ struct BusObjectImplementation {
         const sd_bus_vtable **vtables;
         const BusObjectVtablePair *fallback_vtables;
         sd_bus_node_enumerator_t node_enumerator;
+        sd_bus_node_enumerator_t cached_node_enumerator;
         bool manager;
         const BusObjectImplementation **children;
 };
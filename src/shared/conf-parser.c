@@ -867,8 +867,8 @@ DEFINE_PARSER(uint32, uint32_t, safe_atou32);
 DEFINE_PARSER(int32, int32_t, safe_atoi32);
 #endif // 0
 DEFINE_PARSER(uint64, uint64_t, safe_atou64);
-#if 0 /// UNNEEDED by elogind
 DEFINE_PARSER(unsigned, unsigned, safe_atou);
+#if 0 /// UNNEEDED by elogind
 DEFINE_PARSER(double, double, safe_atod);
 DEFINE_PARSER(nsec, nsec_t, parse_nsec);
 #endif // 0
@@ -23,7 +23,7 @@
 #include "process-util.h"
 #include "serialize.h"
 //#include "set.h"
-//#include "signal-util.h"
+#include "signal-util.h"
 #include "stat-util.h"
 //#include "string-table.h"
 #include "string-util.h"
@@ -79,10 +79,328 @@ static int do_spawn(const char *path, char *argv[], int stdout_fd, pid_t *pid, b
         return 1;
 }
 
+#if 1 /// elogind can run its hook scripts in parallel, with limits
+typedef struct ExecJob {
+        const char *path;
+        char *t;
+        pid_t pid;
+        int fd;
+        usec_t start;
+        bool killed;
+} ExecJob;
+
+static void exec_job_done(ExecJob *job) {
+        assert(job);
+
+        job->t = mfree(job->t);
+        job->fd = safe_close(job->fd);
+}
+
+static void exec_jobs_kill_and_free(ExecJob *jobs, size_t n) {
+        /* Scripts that are still running when we give up on the group are killed and reaped, so that none
+         * of them keeps running behind our back after we returned. */
+        FOREACH_ARRAY(job, jobs, n) {
+                if (job->pid > 0) {
+                        log_debug("Killing %s.", job->path);
+                        (void) kill(job->pid, SIGKILL);
+                        (void) wait_for_terminate(job->pid, NULL);
+                }
+
+                exec_job_done(job);
+        }
+
+        free(jobs);
+}
+
+static size_t exec_group_end(char* const* paths, size_t n, size_t i, ExecDirFlags flags) {
+        const char *fn;
+        size_t k;
+
+        assert(i < n);
+
+        if (!FLAGS_SET(flags, EXEC_DIR_GROUP_BY_PREFIX))
+                return n;
+
+        /* The paths are sorted by file name, hence scripts whose names start with the same number, like
+         * "50-foo" and "50-bar", are next to each other. They form a group, and all scripts of a group are
+         * done before any script of the next group is started. Scripts without such a prefix form one
+         * group of their own. */
+        fn = last_path_component(paths[i]);
+        k = strspn(fn, DIGITS);
+
+        for (i++; i < n; i++) {
+                const char *other = last_path_component(paths[i]);
+
+                if (strspn(other, DIGITS) != k || strncmp(fn, other, k) != 0)
+                        break;
+        }
+
+        return i;
+}
+
+static int exec_job_start(
+                ExecJob *job,
+                const char *path,
+                const char *root,
+                bool with_output,
+                char *argv[],
+                ExecDirFlags flags) {
+
+        _cleanup_free_ char *t = NULL;
+        _cleanup_close_ int fd = -EBADF;
+        pid_t pid = 0;
+        int r;
+
+        assert(job);
+        assert(path);
+
+        t = path_join(root, path);
+        if (!t)
+                return log_oom();
+
+        if (with_output) {
+                _cleanup_free_ char *bn = NULL;
+
+                r = path_extract_filename(path, &bn);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to extract filename from path '%s': %m", path);
+
+                fd = open_serialization_fd(bn);
+                if (fd < 0)
+                        return log_error_errno(fd, "Failed to open serialization file: %m");
+        }
+
+        log_debug("About to execute %s", t);
+
+        r = do_spawn(t, argv, fd, &pid, FLAGS_SET(flags, EXEC_DIR_SET_SYSTEMD_EXEC_PID));
+        if (r <= 0)
+                return r;
+
+        *job = (ExecJob) {
+                .path = path,
+                .t = TAKE_PTR(t),
+                .pid = pid,
+                .fd = TAKE_FD(fd),
+                .start = now(CLOCK_MONOTONIC),
+        };
+
+        return 1;
+}
+
+static int exec_job_finish(
+                ExecJob *job,
+                gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
+                void* const callback_args[_STDOUT_CONSUME_MAX],
+                ExecDirFlags flags,
+                bool *skip_remaining) {
+
+        int r;
+
+        assert(job);
+        assert(skip_remaining);
+
+        /* -EPROTO means the script was killed by a signal, possibly by us due to the timeout, which was
+         * logged already. That counts as a failure of the script. */
+        r = wait_for_terminate_and_check(job->t, job->pid, WAIT_LOG_ABNORMAL);
+        if (r < 0 && r != -EPROTO)
+                return r;
+
+        log_full(FLAGS_SET(flags, EXEC_DIR_LOG_DURATION) ? LOG_INFO : LOG_DEBUG,
+                 "%s finished after %s.",
+                 job->path, FORMAT_TIMESPAN(usec_sub_unsigned(now(CLOCK_MONOTONIC), job->start), USEC_PER_MSEC));
+
+        if (r > 0) {
+                if (FLAGS_SET(flags, EXEC_DIR_SKIP_REMAINING) && r == EXIT_SKIP_REMAINING) {
+                        log_info("%s succeeded with exit status %i, not executing remaining executables.", job->path, r);
+                        *skip_remaining = true;
+                } else if (!FLAGS_SET(flags, EXEC_DIR_IGNORE_ERRORS)) {
+                        log_error("%s failed with exit status %i.", job->path, r);
+                        return r;
+                } else
+                        log_warning("%s failed with exit status %i, ignoring.", job->path, r);
+        } else if (r < 0 && !FLAGS_SET(flags, EXEC_DIR_IGNORE_ERRORS))
+                return EXIT_FAILURE;
+
+        if (callbacks) {
+                if (lseek(job->fd, 0, SEEK_SET) < 0)
+                        return log_error_errno(errno, "Failed to seek on serialization fd: %m");
+
+                r = callbacks[STDOUT_GENERATE](TAKE_FD(job->fd), callback_args[STDOUT_GENERATE]);
+                if (r < 0)
+                        return log_error_errno(r, "Failed to process output from %s: %m", job->path);
+        }
+
+        return 0;
+}
+
+static int exec_jobs_wait(ExecJob *jobs, size_t *n_running, usec_t job_timeout,
+                          gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
+                          void* const callback_args[_STDOUT_CONSUME_MAX],
+                          ExecDirFlags flags,
+                          bool *skip_remaining) {
+
+        usec_t deadline = USEC_INFINITY, n;
+        bool finished = false;
+        sigset_t ss, saved;
+        int r;
+
+        assert(jobs);
+        assert(n_running);
+        assert(*n_running > 0);
+
+        /* SIGCHLD is blocked before looking for finished scripts, so that it is kept pending for
+         * sigtimedwait() below if a script finishes right after we looked. */
+        assert_se(sigemptyset(&ss) >= 0);
+        assert_se(sigaddset(&ss, SIGCHLD) >= 0);
+        if (sigprocmask(SIG_BLOCK, &ss, &saved) < 0)
+                return log_error_errno(errno, "Failed to block SIGCHLD: %m");
+
+        for (;;) {
+                for (size_t i = 0; i < *n_running;) {
+                        siginfo_t si = {};
+
+                        if (waitid(P_PID, jobs[i].pid, &si, WEXITED|WNOHANG|WNOWAIT) < 0) {
+                                r = log_error_errno(errno, "Failed to check on %s: %m", jobs[i].path);
+                                goto finish;
+                        }
+                        if (si.si_pid == 0) {
+                                i++;
+                                continue;
+                        }
+
+                        r = exec_job_finish(jobs + i, callbacks, callback_args, flags, skip_remaining);
+                        exec_job_done(jobs + i);
+                        jobs[i] = jobs[--*n_running];
+                        if (r != 0)
+                                goto finish;
+
+                        finished = true;
+                }
+
+                if (finished) {
+                        r = 0;
+                        goto finish;
+                }
+
+                n = now(CLOCK_MONOTONIC);
+
+                if (job_timeout != USEC_INFINITY)
+                        FOREACH_ARRAY(job, jobs, *n_running) {
+                                usec_t d = usec_add(job->start, job_timeout);
+
+                                if (job->killed)
+                                        continue;
+
+                                if (d <= n) {
+                                        log_warning("%s timed out after %s, killing.",
+                                                    job->path, FORMAT_TIMESPAN(job_timeout, USEC_PER_MSEC));
+                                        (void) kill(job->pid, SIGKILL);
+                                        job->killed = true;
+                                        continue;
+                                }
+
+                                deadline = MIN(deadline, d);
+                        }
+
+                if (sigtimedwait(&ss, NULL, deadline == USEC_INFINITY ? NULL : TIMESPEC_STORE(deadline - n)) < 0 &&
+                    !IN_SET(errno, EAGAIN, EINTR)) {
+                        r = log_error_errno(errno, "Failed to wait for SIGCHLD: %m");
+                        goto finish;
+                }
+
+                deadline = USEC_INFINITY;
+        }
+
+finish:
+        if (sigprocmask(SIG_SETMASK, &saved, NULL) < 0)
+                return log_error_errno(errno, "Failed to restore signal mask: %m");
+
+        return r;
+}
+
+static int do_execute_jobs(
+                char* const* paths,
+                const char *root,
+                const ExecDirLimits *limits,
+                gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
+                void* const callback_args[_STDOUT_CONSUME_MAX],
+                int output_fd,
+                char *argv[],
+                ExecDirFlags flags) {
+
+        ExecJob *jobs = NULL;
+        size_t n, n_running = 0, next = 0, group_end = 0;
+        bool skip_remaining = false;
+        usec_t begin;
+        int r;
+
+        assert(limits);
+
+        /* Runs up to limits->max_jobs scripts at the same time, each for no longer than limits->job_timeout.
+         * As scripts finish in any order, so are their outputs handed to the callbacks. With
+         * EXEC_DIR_SKIP_REMAINING, no further script is started once one exited with 77, but those that
+         * run already are still waited for. If anything fails, the scripts still running are killed. */
+
+        n = strv_length(paths);
+        if (n == 0)
+                return 0;
+
+        jobs = new0(ExecJob, limits->max_jobs > 0 ? MIN(n, (size_t) limits->max_jobs) : n);
+        if (!jobs)
+                return log_oom();
+
+        begin = now(CLOCK_MONOTONIC);
+
+        for (;;) {
+                if (next >= group_end && n_running == 0) {
+                        if (next >= n)
+                                break;
+
+                        group_end = exec_group_end(paths, n, next, flags);
+                }
+
+                while (next < group_end && (limits->max_jobs == 0 || n_running < limits->max_jobs)) {
+                        r = exec_job_start(jobs + n_running, paths[next++], root, !!callbacks, argv, flags);
+                        if (r < 0)
+                                goto finish;
+                        if (r > 0)
+                                n_running++;
+                }
+
+                if (n_running == 0)
+                        continue;
+
+                r = exec_jobs_wait(jobs, &n_running, limits->job_timeout, callbacks, callback_args, flags, &skip_remaining);
+                if (r != 0)
+                        goto finish;
+
+                if (skip_remaining)
+                        next = group_end = n;
+        }
+
+        log_full(FLAGS_SET(flags, EXEC_DIR_LOG_DURATION) ? LOG_INFO : LOG_DEBUG,
+                 "Executed %zu scripts in %s.", n, FORMAT_TIMESPAN(usec_sub_unsigned(now(CLOCK_MONOTONIC), begin), USEC_PER_MSEC));
+
+        r = 0;
+        if (callbacks) {
+                r = callbacks[STDOUT_COLLECT](output_fd, callback_args[STDOUT_COLLECT]);
+                if (r < 0)
+                        log_error_errno(r, "Callback two failed: %m");
+        }
+
+finish:
+        exec_jobs_kill_and_free(jobs, n_running);
+        return r;
+}
+#endif // 1
+
 static int do_execute(
                 char* const* paths,
                 const char *root,
                 usec_t timeout,
+#if 1 /// elogind can run its hook scripts in parallel, with limits
+                const ExecDirLimits *limits,
+#endif // 1
                 gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
                 void* const callback_args[_STDOUT_CONSUME_MAX],
                 int output_fd,
@@ -118,6 +436,11 @@ static int do_execute(
                 if (putenv(*e) != 0)
                         return log_error_errno(errno, "Failed to set environment variable: %m");
 
+#if 1 /// elogind can run its hook scripts in parallel, with limits
+        if (limits && FLAGS_SET(flags, EXEC_DIR_PARALLEL))
+                return do_execute_jobs(paths, root, limits, callbacks, callback_args, output_fd, argv, flags);
+#endif // 1
+
         STRV_FOREACH(path, paths) {
                 _cleanup_free_ char *t = NULL;
                 _cleanup_close_ int fd = -EBADF;
@@ -162,10 +485,18 @@ static int do_execute(
                         t = NULL;
                 } else {
                         bool skip_remaining = false;
+#if 1 /// elogind can log how long each of its hook scripts took
+                        usec_t start = now(CLOCK_MONOTONIC);
+#endif // 1
 
                         r = wait_for_terminate_and_check(t, pid, WAIT_LOG_ABNORMAL);
                         if (r < 0)
                                 return r;
+#if 1 /// elogind can log how long each of its hook scripts took
+                        log_full(FLAGS_SET(flags, EXEC_DIR_LOG_DURATION) ? LOG_INFO : LOG_DEBUG,
+                                 "%s finished after %s.",
+                                 *path, FORMAT_TIMESPAN(usec_sub_unsigned(now(CLOCK_MONOTONIC), start), USEC_PER_MSEC));
+#endif // 1
                         if (r > 0) {
                                 if (FLAGS_SET(flags, EXEC_DIR_SKIP_REMAINING) && r == EXIT_SKIP_REMAINING) {
                                         log_info("%s succeeded with exit status %i, not executing remaining executables.", *path, r);
@@ -218,11 +549,20 @@ static int do_execute(
         return 0;
 }
 
+#if 0 /// elogind can run its hook scripts in parallel, with limits
 int execute_strv(
                 const char *name,
                 char* const* paths,
                 const char *root,
                 usec_t timeout,
+#else // 0
+int execute_strv_full(
+                const char *name,
+                char* const* paths,
+                const char *root,
+                usec_t timeout,
+                const ExecDirLimits *limits,
+#endif // 0
                 gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
                 void* const callback_args[_STDOUT_CONSUME_MAX],
                 char *argv[],
@@ -233,7 +573,11 @@ int execute_strv(
         pid_t executor_pid;
         int r;
 
+#if 0 /// elogind honours EXEC_DIR_SKIP_REMAINING when running scripts in parallel with limits
         assert(!FLAGS_SET(flags, EXEC_DIR_PARALLEL | EXEC_DIR_SKIP_REMAINING));
+#else // 0
+        assert(limits || !FLAGS_SET(flags, EXEC_DIR_PARALLEL | EXEC_DIR_SKIP_REMAINING));
+#endif // 0
 
         if (strv_isempty(paths))
                 return 0;
@@ -258,7 +602,11 @@ int execute_strv(
         if (r < 0)
                 return r;
         if (r == 0) {
+#if 0 /// elogind can run its hook scripts in parallel, with limits
                 r = do_execute(paths, root, timeout, callbacks, callback_args, fd, argv, envp, flags);
+#else // 0
+                r = do_execute(paths, root, timeout, limits, callbacks, callback_args, fd, argv, envp, flags);
+#endif // 0
                 _exit(r < 0 ? EXIT_FAILURE : r);
         }
 
@@ -280,9 +628,16 @@ int execute_strv(
         return 0;
 }
 
+#if 0 /// elogind can run its hook scripts in parallel, with limits
 int execute_directories(
                 const char* const* directories,
                 usec_t timeout,
+#else // 0
+int execute_directories_full(
+                const char* const* directories,
+                usec_t timeout,
+                const ExecDirLimits *limits,
+#endif // 0
                 gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
                 void* const callback_args[_STDOUT_CONSUME_MAX],
                 char *argv[],
@@ -310,7 +665,11 @@ int execute_directories(
                         return log_error_errno(r, "Failed to extract file name from '%s': %m", directories[0]);
         }
 
+#if 0 /// elogind can run its hook scripts in parallel, with limits
         return execute_strv(name, paths, NULL, timeout, callbacks, callback_args, argv, envp, flags);
+#else // 0
+        return execute_strv_full(name, paths, NULL, timeout, limits, callbacks, callback_args, argv, envp, flags);
+#endif // 0
 }
 
 #if 0 /// UNNEEDED by elogind
@@ -20,8 +20,19 @@ typedef enum {
         EXEC_DIR_IGNORE_ERRORS        = 1 << 1, /* Ignore non-zero exit status of scripts */
         EXEC_DIR_SET_SYSTEMD_EXEC_PID = 1 << 2, /* Set $SYSTEMD_EXEC_PID environment variable */
         EXEC_DIR_SKIP_REMAINING       = 1 << 3, /* Ignore remaining executions when one exit with 77. */
+#if 1 /// elogind can run its hook scripts in ordered groups, see execute_strv_full()
+        EXEC_DIR_GROUP_BY_PREFIX      = 1 << 4, /* With limits: only run scripts with the same numeric prefix together */
+        EXEC_DIR_LOG_DURATION         = 1 << 5, /* Log how long each script took at info level */
+#endif // 1
 } ExecDirFlags;
 
+#if 1 /// elogind can run its hook scripts in parallel, with limits
+typedef struct ExecDirLimits {
+        unsigned max_jobs;  /* How many scripts may run at the same time, 0 for no limit */
+        usec_t job_timeout; /* After how long a single script is killed, USEC_INFINITY for never */
+} ExecDirLimits;
+#endif // 1
+
 typedef enum ExecCommandFlags {
         EXEC_COMMAND_IGNORE_FAILURE   = 1 << 0,
         EXEC_COMMAND_FULLY_PRIVILEGED = 1 << 1,
@@ -31,6 +42,7 @@ typedef enum ExecCommandFlags {
         _EXEC_COMMAND_FLAGS_INVALID   = -EINVAL,
 } ExecCommandFlags;
 
+#if 0 /// elogind can run its hook scripts in parallel, with limits
 int execute_strv(
                 const char *name,
                 char* const* paths,
@@ -50,6 +62,53 @@ int execute_directories(
                 char *argv[],
                 char *envp[],
                 ExecDirFlags flags);
+#else // 0
+int execute_strv_full(
+                const char *name,
+                char* const* paths,
+                const char *root,
+                usec_t timeout,
+                const ExecDirLimits *limits,
+                gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
+                void* const callback_args[_STDOUT_CONSUME_MAX],
+                char *argv[],
+                char *envp[],
+                ExecDirFlags flags);
+
+static inline int execute_strv(
+                const char *name,
+                char* const* paths,
+                const char *root,
+                usec_t timeout,
+                gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
+                void* const callback_args[_STDOUT_CONSUME_MAX],
+                char *argv[],
+                char *envp[],
+                ExecDirFlags flags) {
+        return execute_strv_full(name, paths, root, timeout, NULL, callbacks, callback_args, argv, envp, flags);
+}
+
+int execute_directories_full(
+                const char* const* directories,
+                usec_t timeout,
+                const ExecDirLimits *limits,
+                gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
+                void* const callback_args[_STDOUT_CONSUME_MAX],
+                char *argv[],
+                char *envp[],
+                ExecDirFlags flags);
+
+static inline int execute_directories(
+                const char* const* directories,
+                usec_t timeout,
+                gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
+                void* const callback_args[_STDOUT_CONSUME_MAX],
+                char *argv[],
+                char *envp[],
+                ExecDirFlags flags) {
+        return execute_directories_full(directories, timeout, NULL, callbacks, callback_args, argv, envp, flags);
+}
+#endif // 0
 
 #if 0 /// UNNEEDED in elogind
 int exec_command_flags_from_strv(char **ex_opts, ExecCommandFlags *flags);
@@ -64,6 +64,10 @@
  - To make things easy, when cells are added without any explicit configured formatting, then we'll copy the formatting
    from the same cell in the previous cell. This is particularly useful for the "weight" of the cell (see above), as
    this means setting the weight of the cells of the header row will nicely propagate to all cells in the other rows.
+
+ - Tables may be printed while they are filled, see table_set_stream(). In that case the column widths are determined
+   from the first rows only, and rows are released once written out, except for the header and the last row, which
+   the formatting of the next row is copied from.
 */
 
 typedef struct TableData {
@@ -158,6 +162,12 @@ struct Table {
         size_t n_json_fields;
 
         bool *reverse_map;
+
+        FILE *stream;         /* If set, rows are written out while they are added, see table_set_stream() */
+        size_t stream_sample; /* The number of rows to determine column widths from, before streaming starts */
+        size_t *stream_width; /* The fixed column widths, once streaming started */
+        bool stream_kept;     /* Whether the first row after the header was written out already */
+        size_t n_released;    /* The number of rows written out and released already */
 };
 
 Table *table_new_raw(size_t n_columns) {
@@ -258,6 +268,8 @@ static TableData *table_data_free(TableData *d) {
 DEFINE_PRIVATE_TRIVIAL_REF_UNREF_FUNC(TableData, table_data, table_data_free);
 DEFINE_TRIVIAL_CLEANUP_FUNC(TableData*, table_data_unref);
 
+static int table_stream_flush(Table *t, bool final);
+
 Table *table_unref(Table *t) {
         if (!t)
                 return NULL;
@@ -269,6 +281,7 @@ Table *table_unref(Table *t) {
         free(t->display_map);
         free(t->sort_map);
         free(t->reverse_map);
+        free(t->stream_width);
 
         for (size_t i = 0; i < t->n_json_fields; i++)
                 free(t->json_fields[i]);
@@ -477,6 +490,15 @@ int table_add_cell_full(
         assert(type >= 0);
         assert(type < _TABLE_DATA_TYPE_MAX);
 
+        /* If a new row starts, write out the ones completed so far */
+        if (t->stream && t->n_cells % t->n_columns == 0) {
+                int r;
+
+                r = table_stream_flush(t, /* final= */ false);
+                if (r < 0)
+                        return r;
+        }
+
         /* Special rule: patch NULL data fields to the empty field */
         if (!data)
                 type = TABLE_EMPTY;
@@ -1251,6 +1273,10 @@ int table_set_sort_internal(Table *t, size_t first_column, ...) {
 
         assert(t);
 
+        /* Rows that are written out as they come cannot be sorted anymore */
+        if (t->stream)
+                return -EBUSY;
+
         column = first_column;
 
         va_start(ap, first_column);
@@ -2178,44 +2204,25 @@ static const char* table_data_rgap_color(TableData *d) {
         return NULL;
 }
 
-int table_print(Table *t, FILE *f) {
-        size_t n_rows, *minimum_width, *maximum_width, display_columns, *requested_width,
+static size_t table_display_columns(Table *t) {
+        assert(t);
+
+        if (t->display_map)
+                return t->n_display_map;
+
+        return t->n_columns;
+}
+
+static int table_compute_widths(Table *t, size_t n_rows, size_t display_columns, bool streaming, size_t *ret_width) {
+        size_t *minimum_width, *maximum_width, *requested_width,
                 table_minimum_width, table_maximum_width, table_requested_width, table_effective_width,
                 *width = NULL;
-        _cleanup_free_ size_t *sorted = NULL;
         uint64_t *column_weight, weight_sum;
         int r;
 
         assert(t);
-
-        if (!f)
-                f = stdout;
-
-        /* Ensure we have no incomplete rows */
-        assert(t->n_cells % t->n_columns == 0);
-
-        n_rows = t->n_cells / t->n_columns;
-        assert(n_rows > 0); /* at least the header row must be complete */
-
-        if (t->sort_map) {
-                /* If sorting is requested, let's calculate an index table we use to lookup the actual index to display with. */
-
-                sorted = new(size_t, n_rows);
-                if (!sorted)
-                        return -ENOMEM;
-
-                for (size_t i = 0; i < n_rows; i++)
-                        sorted[i] = i * t->n_columns;
-
-                typesafe_qsort_r(sorted, n_rows, table_data_compare, t);
-        }
-
-        if (t->display_map)
-                display_columns = t->n_display_map;
-        else
-                display_columns = t->n_columns;
-
         assert(display_columns > 0);
+        assert(ret_width);
 
         minimum_width = newa(size_t, display_columns);
         maximum_width = newa(size_t, display_columns);
@@ -2298,6 +2305,13 @@ int table_print(Table *t, FILE *f) {
                         }
                 }
 
+                /* Rows that are not known yet when streaming may need more than the sample did. Columns with
+                 * an explicit maximum width get that right away, so that they don't need to be ellipsized. */
+                if (streaming)
+                        for (size_t j = 0; j < display_columns; j++)
+                                if (maximum_width[j] != SIZE_MAX)
+                                        requested_width[j] = MAX(requested_width[j], maximum_width[j]);
+
                 /* One space between each column */
                 table_requested_width = table_minimum_width = table_maximum_width = display_columns - 1;
 
@@ -2308,10 +2322,8 @@ int table_print(Table *t, FILE *f) {
 
                         table_minimum_width += minimum_width[j];
 
-                        if (maximum_width[j] == SIZE_MAX)
-                                table_maximum_width = SIZE_MAX;
-                        else
-                                table_maximum_width += maximum_width[j];
+                        /* Saturating, an unbounded column makes the whole table unbounded */
+                        table_maximum_width = size_add(table_maximum_width, maximum_width[j]);
 
                         table_requested_width += requested_width[j];
                 }
@@ -2332,7 +2344,7 @@ int table_print(Table *t, FILE *f) {
                         table_effective_width = table_minimum_width;
 
                 if (!width)
-                        width = newa(size_t, display_columns);
+                        width = ret_width;
 
                 if (table_effective_width >= table_requested_width) {
                         size_t extra;
@@ -2436,137 +2448,284 @@ int table_print(Table *t, FILE *f) {
                 }
         }
 
-        /* Second pass: show output */
-        for (size_t i = t->header ? 0 : 1; i < n_rows; i++) {
-                size_t n_subline = 0;
-                bool more_sublines;
-                TableData **row;
+        return 0;
+}
 
-                if (sorted)
-                        row = t->data + sorted[i];
-                else
-                        row = t->data + i * t->n_columns;
+static int table_print_row(Table *t, TableData **row, size_t display_columns, const size_t *width, FILE *f) {
+        size_t n_subline = 0;
+        bool more_sublines;
+        int r;
 
-                do {
-                        const char *gap_color = NULL;
-                        more_sublines = false;
+        assert(t);
+        assert(row);
+        assert(width);
+        assert(f);
 
-                        for (size_t j = 0; j < display_columns; j++) {
-                                _cleanup_free_ char *buffer = NULL, *extracted = NULL;
-                                bool lines_truncated = false;
-                                const char *field, *color = NULL;
-                                TableData *d;
-                                size_t l;
+        do {
+                const char *gap_color = NULL;
+                more_sublines = false;
 
-                                assert_se(d = row[t->display_map ? t->display_map[j] : j]);
+                for (size_t j = 0; j < display_columns; j++) {
+                        _cleanup_free_ char *buffer = NULL, *extracted = NULL;
+                        bool lines_truncated = false;
+                        const char *field, *color = NULL;
+                        TableData *d;
+                        size_t l;
+
+                        assert_se(d = row[t->display_map ? t->display_map[j] : j]);
+
+                        field = table_data_format(t, d, false, width[j], NULL);
+                        if (!field)
+                                return -ENOMEM;
+
+                        r = string_extract_line(field, n_subline, &extracted);
+                        if (r < 0)
+                                return r;
+                        if (r > 0) {
+                                /* There are more lines to come */
+                                if ((t->cell_height_max == SIZE_MAX || n_subline + 1 < t->cell_height_max))
+                                        more_sublines = true; /* There are more lines to come */
+                                else
+                                        lines_truncated = true;
+                        }
+                        if (extracted)
+                                field = extracted;
+
+                        l = utf8_console_width(field);
+                        if (l > width[j]) {
+                                /* Field is wider than allocated space. Let's ellipsize */
 
-                                field = table_data_format(t, d, false, width[j], NULL);
-                                if (!field)
+                                buffer = ellipsize(field, width[j], /* ellipsize at the end if we truncated coming lines, otherwise honour configuration */
+                                                   lines_truncated ? 100 : d->ellipsize_percent);
+                                if (!buffer)
                                         return -ENOMEM;
 
-                                r = string_extract_line(field, n_subline, &extracted);
-                                if (r < 0)
-                                        return r;
-                                if (r > 0) {
-                                        /* There are more lines to come */
-                                        if ((t->cell_height_max == SIZE_MAX || n_subline + 1 < t->cell_height_max))
-                                                more_sublines = true; /* There are more lines to come */
-                                        else
-                                                lines_truncated = true;
-                                }
-                                if (extracted)
-                                        field = extracted;
+                                field = buffer;
+                        } else {
+                                if (lines_truncated) {
+                                        _cleanup_free_ char *padded = NULL;
+
+                                        /* We truncated more lines of this cell, let's add an
+                                         * ellipsis. We first append it, but that might make our
+                                         * string grow above what we have space for, hence ellipsize
+                                         * right after. This will truncate the ellipsis and add a new
+                                         * one. */
 
-                                l = utf8_console_width(field);
-                                if (l > width[j]) {
-                                        /* Field is wider than allocated space. Let's ellipsize */
+                                        padded = strjoin(field, special_glyph(SPECIAL_GLYPH_ELLIPSIS));
+                                        if (!padded)
+                                                return -ENOMEM;
 
-                                        buffer = ellipsize(field, width[j], /* ellipsize at the end if we truncated coming lines, otherwise honour configuration */
-                                                           lines_truncated ? 100 : d->ellipsize_percent);
+                                        buffer = ellipsize(padded, width[j], 100);
                                         if (!buffer)
                                                 return -ENOMEM;
 
                                         field = buffer;
-                                } else {
-                                        if (lines_truncated) {
-                                                _cleanup_free_ char *padded = NULL;
-
-                                                /* We truncated more lines of this cell, let's add an
-                                                 * ellipsis. We first append it, but that might make our
-                                                 * string grow above what we have space for, hence ellipsize
-                                                 * right after. This will truncate the ellipsis and add a new
-                                                 * one. */
-
-                                                padded = strjoin(field, special_glyph(SPECIAL_GLYPH_ELLIPSIS));
-                                                if (!padded)
-                                                        return -ENOMEM;
-
-                                                buffer = ellipsize(padded, width[j], 100);
-                                                if (!buffer)
-                                                        return -ENOMEM;
-
-                                                field = buffer;
-                                                l = utf8_console_width(field);
-                                        }
-
-                                        if (l < width[j]) {
-                                                _cleanup_free_ char *aligned = NULL;
-                                                /* Field is shorter than allocated space. Let's align with spaces */
-
-                                                aligned = align_string_mem(field, d->url, width[j], d->align_percent);
-                                                if (!aligned)
-                                                        return -ENOMEM;
-
-                                                /* Drop trailing white spaces of last column when no cosmetics is set. */
-                                                if (j == display_columns - 1 &&
-                                                    (!colors_enabled() || !table_data_color(d)) &&
-                                                    (!urlify_enabled() || !d->url))
-                                                        delete_trailing_chars(aligned, NULL);
-
-                                                free_and_replace(buffer, aligned);
-                                                field = buffer;
-                                        }
+                                        l = utf8_console_width(field);
                                 }
 
-                                if (l >= width[j] && d->url) {
-                                        _cleanup_free_ char *clickable = NULL;
+                                if (l < width[j]) {
+                                        _cleanup_free_ char *aligned = NULL;
+                                        /* Field is shorter than allocated space. Let's align with spaces */
 
-                                        r = terminal_urlify(d->url, field, &clickable);
-                                        if (r < 0)
-                                                return r;
+                                        aligned = align_string_mem(field, d->url, width[j], d->align_percent);
+                                        if (!aligned)
+                                                return -ENOMEM;
 
-                                        free_and_replace(buffer, clickable);
+                                        /* Drop trailing white spaces of last column when no cosmetics is set. */
+                                        if (j == display_columns - 1 &&
+                                            (!colors_enabled() || !table_data_color(d)) &&
+                                            (!urlify_enabled() || !d->url))
+                                                delete_trailing_chars(aligned, NULL);
+
+                                        free_and_replace(buffer, aligned);
                                         field = buffer;
                                 }
+                        }
 
-                                if (colors_enabled() && gap_color)
-                                        fputs(gap_color, f);
+                        if (l >= width[j] && d->url) {
+                                _cleanup_free_ char *clickable = NULL;
 
-                                if (j > 0)
-                                        fputc(' ', f); /* column separator left of cell */
+                                r = terminal_urlify(d->url, field, &clickable);
+                                if (r < 0)
+                                        return r;
 
-                                if (colors_enabled()) {
-                                        color = table_data_color(d);
+                                free_and_replace(buffer, clickable);
+                                field = buffer;
+                        }
 
-                                        /* Undo gap color */
-                                        if (gap_color)
-                                                fputs(ANSI_NORMAL, f);
+                        if (colors_enabled() && gap_color)
+                                fputs(gap_color, f);
 
-                                        if (color)
-                                                fputs(color, f);
-                                }
+                        if (j > 0)
+                                fputc(' ', f); /* column separator left of cell */
 
-                                fputs(field, f);
+                        if (colors_enabled()) {
+                                color = table_data_color(d);
 
-                                if (colors_enabled() && color)
+                                /* Undo gap color */
+                                if (gap_color)
                                         fputs(ANSI_NORMAL, f);
 
-                                gap_color = table_data_rgap_color(d);
+                                if (color)
+                                        fputs(color, f);
                         }
 
-                        fputc('\n', f);
-                        n_subline ++;
-                } while (more_sublines);
+                        fputs(field, f);
+
+                        if (colors_enabled() && color)
+                                fputs(ANSI_NORMAL, f);
+
+                        gap_color = table_data_rgap_color(d);
+                }
+
+                fputc('\n', f);
+                n_subline ++;
+        } while (more_sublines);
+
+        return 0;
+}
+
+static int table_stream_flush(Table *t, bool final) {
+        _cleanup_free_ size_t *width = NULL;
+        size_t n_rows, display_columns, first;
+        int r;
+
+        assert(t);
+        assert(t->stream);
+        assert(t->n_cells % t->n_columns == 0);
+
+        n_rows = t->n_cells / t->n_columns;
+        assert(n_rows > 0);
+
+        display_columns = table_display_columns(t);
+
+        if (!t->stream_width) {
+                /* Collect rows until the sample is complete, and fix the column widths from it. If the table
+                 * ends before that, it is formatted from all rows, like any other table. */
+                if (!final && n_rows - 1 < t->stream_sample)
+                        return 0;
+
+                width = new(size_t, display_columns);
+                if (!width)
+                        return -ENOMEM;
+
+                r = table_compute_widths(t, n_rows, display_columns, /* streaming= */ !final, width);
+                if (r < 0)
+                        return r;
+
+                t->stream_width = TAKE_PTR(width);
+
+                if (t->header) {
+                        r = table_print_row(t, t->data, display_columns, t->stream_width, t->stream);
+                        if (r < 0)
+                                return r;
+                }
+
+                first = 1;
+        } else
+                first = t->stream_kept ? 2 : 1;
+
+        for (size_t i = first; i < n_rows; i++) {
+                r = table_print_row(t, t->data + i * t->n_columns, display_columns, t->stream_width, t->stream);
+                if (r < 0)
+                        return r;
+        }
+
+        /* Release what was written out, except for the header and the last row, as cells added later copy
+         * their formatting from the row above them */
+        if (n_rows > 2) {
+                size_t n = (n_rows - 2) * t->n_columns;
+
+                for (size_t i = t->n_columns; i < t->n_columns + n; i++)
+                        table_data_unref(t->data[i]);
+
+                memmove(t->data + t->n_columns, t->data + t->n_columns + n, t->n_columns * sizeof(TableData*));
+                t->n_cells -= n;
+                t->n_released += n_rows - 2;
+        }
+
+        t->stream_kept = n_rows > 1;
+
+        /* Leave flushing to stdio while rows are coming in, a write per row would be slow */
+        if (!final)
+                return 0;
+
+        return fflush_and_check(t->stream);
+}
+
+int table_set_stream(Table *t, FILE *f, size_t n_sample) {
+        assert(t);
+
+        /* Makes the table write out rows while they are added, rather than at the end. Column widths are
+         * fixed once the first n_sample rows after the header are known, from those rows and from the
+         * explicitly configured maximum widths. Each further row is written out as soon as it is complete,
+         * and released. table_print() writes out what's left then. Cell references to rows that are
+         * written out become invalid, and the rows cannot be sorted. */
+
+        if (t->sort_map || t->vertical)
+                return -EINVAL;
+
+        t->stream = f ?: stdout;
+        t->stream_sample = n_sample;
+
+        return 0;
+}
+
+int table_print(Table *t, FILE *f) {
+        size_t n_rows, display_columns, *width;
+        _cleanup_free_ size_t *sorted = NULL;
+        int r;
+
+        assert(t);
+
+        if (t->stream) {
+                assert(!f || f == t->stream);
+                return table_stream_flush(t, /* final= */ true);
+        }
+
+        if (!f)
+                f = stdout;
+
+        /* Ensure we have no incomplete rows */
+        assert(t->n_cells % t->n_columns == 0);
+
+        n_rows = t->n_cells / t->n_columns;
+        assert(n_rows > 0); /* at least the header row must be complete */
+
+        if (t->sort_map) {
+                /* If sorting is requested, let's calculate an index table we use to lookup the actual index to display with. */
+
+                sorted = new(size_t, n_rows);
+                if (!sorted)
+                        return -ENOMEM;
+
+                for (size_t i = 0; i < n_rows; i++)
+                        sorted[i] = i * t->n_columns;
+
+                typesafe_qsort_r(sorted, n_rows, table_data_compare, t);
+        }
+
+        display_columns = table_display_columns(t);
+        assert(display_columns > 0);
+
+        width = newa(size_t, display_columns);
+
+        r = table_compute_widths(t, n_rows, display_columns, /* streaming= */ false, width);
+        if (r < 0)
+                return r;
+
+        /* Second pass: show output */
+        for (size_t i = t->header ? 0 : 1; i < n_rows; i++) {
+                TableData **row;
+
+                if (sorted)
+                        row = t->data + sorted[i];
+                else
+                        row = t->data + i * t->n_columns;
+
+                r = table_print_row(t, row, display_columns, width, f);
+                if (r < 0)
+                        return r;
         }
 
         return fflush_and_check(f);
@@ -2596,7 +2755,7 @@ size_t table_get_rows(Table *t) {
                 return 0;
 
         assert(t->n_columns > 0);
-        return t->n_cells / t->n_columns;
+        return t->n_released + t->n_cells / t->n_columns;
 }
 
 size_t table_get_columns(Table *t) {
@@ -3015,6 +3174,10 @@ static int table_to_json_vertical(Table *t, JsonVariant **ret) {
 int table_to_json(Table *t, JsonVariant **ret) {
         assert(t);
 
+        /* Rows that were written out already are gone */
+        if (t->n_released > 0)
+                return -EBUSY;
+
         if (t->vertical)
                 return table_to_json_vertical(t, ret);
 
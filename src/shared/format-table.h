@@ -147,6 +147,12 @@ int table_hide_column_from_display_internal(Table *t, ...);
 #define table_hide_column_from_display(t, ...) table_hide_column_from_display_internal(t, __VA_ARGS__, (size_t) -1)
 #endif // 0
 
+int table_set_stream(Table *t, FILE *f, size_t n_sample);
+
+/* The number of rows to fix column widths from before streaming starts, tables shorter than that are
+ * formatted exactly like without streaming */
+#define TABLE_STREAM_SAMPLE_DEFAULT 1000U
+
 int table_print(Table *t, FILE *f);
 int table_format(Table *t, char **ret);
 
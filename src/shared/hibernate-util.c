@@ -129,7 +129,7 @@ static int read_resume_config(dev_t *ret_devno, uint64_t *ret_offset) {
         assert(ret_devno);
         assert(ret_offset);
 
-        r = read_one_line_file("/sys/power/resume", &devno_str);
+        r = read_virtual_attribute("/sys/power/resume", &devno_str);
         if (r < 0)
                 return log_debug_errno(r, "Failed to read /sys/power/resume: %m");
 
@@ -137,7 +137,7 @@ static int read_resume_config(dev_t *ret_devno, uint64_t *ret_offset) {
         if (r < 0)
                 return log_debug_errno(r, "Failed to parse /sys/power/resume devno '%s': %m", devno_str);
 
-        r = read_one_line_file("/sys/power/resume_offset", &offset_str);
+        r = read_virtual_attribute("/sys/power/resume_offset", &offset_str);
         if (r == -ENOENT) {
                 log_debug_errno(r, "Kernel does not expose resume_offset, skipping.");
                 offset = UINT64_MAX;
@@ -404,13 +404,17 @@ int find_suitable_hibernation_device_full(HibernationDevice *ret_device, uint64_
 }
 
 static int get_proc_meminfo_active(unsigned long long *ret) {
-        _cleanup_free_ char *active_str = NULL;
+        _cleanup_free_ char *meminfo = NULL, *active_str = NULL;
         unsigned long long active;
         int r;
 
         assert(ret);
 
-        r = get_proc_field("/proc/meminfo", "Active(anon)", WHITESPACE, &active_str);
+        r = read_virtual_attribute("/proc/meminfo", &meminfo);
+        if (r < 0)
+                return log_debug_errno(r, "Failed to read /proc/meminfo: %m");
+
+        r = get_proc_field_from_string(meminfo, "Active(anon)", WHITESPACE, &active_str);
         if (r < 0)
                 return log_debug_errno(r, "Failed to retrieve Active(anon) from /proc/meminfo: %m");
 
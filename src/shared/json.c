@@ -1526,7 +1526,7 @@ static int print_source(FILE *f, JsonVariant *v, JsonFormatFlags flags, bool whi
         return 0;
 }
 
-static void json_format_string(FILE *f, const char *q, JsonFormatFlags flags) {
+void json_format_string(FILE *f, const char *q, JsonFormatFlags flags) {
         assert(q);
 
         fputc('"', f);
@@ -1534,7 +1534,19 @@ static void json_format_string(FILE *f, const char *q, JsonFormatFlags flags) {
         if (flags & JSON_FORMAT_COLOR)
                 fputs(ansi_green(), f);
 
-        for (; *q; q++)
+        for (; *q; q++) {
+                size_t n;
+
+                /* Write out runs of characters that need no escaping in one go */
+                for (n = 0; q[n] && !IN_SET(q[n], '"', '\\') && ((signed char) q[n] < 0 || q[n] >= ' '); n++)
+                        ;
+                if (n > 0) {
+                        fwrite(q, 1, n, f);
+                        q += n;
+                        if (!*q)
+                                break;
+                }
+
                 switch (*q) {
                 case '"':
                         fputs("\\\"", f);
@@ -1571,6 +1583,7 @@ static void json_format_string(FILE *f, const char *q, JsonFormatFlags flags) {
                                 fputc(*q, f);
                         break;
                 }
+        }
 
         if (flags & JSON_FORMAT_COLOR)
                 fputs(ANSI_NORMAL, f);
@@ -1578,78 +1591,117 @@ static void json_format_string(FILE *f, const char *q, JsonFormatFlags flags) {
         fputc('"', f);
 }
 
-static int json_format(FILE *f, JsonVariant *v, JsonFormatFlags flags, const char *prefix) {
-        int r;
+int json_format_real(FILE *f, double d, JsonFormatFlags flags) {
+        locale_t loc, old_loc;
 
         assert(f);
-        assert(v);
 
-        switch (json_variant_type(v)) {
+        /* Formats the value the same way as json_variant_new_real() followed by json_variant_dump() would */
+        switch (fpclassify(d)) {
+        case FP_NAN:
+        case FP_INFINITE:
+                json_format_null(f, flags);
+                return 0;
 
-        case JSON_VARIANT_REAL: {
-                locale_t loc, old_loc;
+        case FP_ZERO:
+                d = 0.0;
+                break;
+        }
 
-                loc = newlocale(LC_NUMERIC_MASK, "C", (locale_t) 0);
-                if (loc == (locale_t) 0)
-                        return -errno;
+        loc = newlocale(LC_NUMERIC_MASK, "C", (locale_t) 0);
+        if (loc == (locale_t) 0)
+                return -errno;
 
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ansi_highlight_blue(), f);
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ansi_highlight_blue(), f);
 
-                old_loc = uselocale(loc);
-                fprintf(f, "%.*e", DECIMAL_DIG, json_variant_real(v));
-                uselocale(old_loc);
+        old_loc = uselocale(loc);
+        fprintf(f, "%.*e", DECIMAL_DIG, d);
+        uselocale(old_loc);
 
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_NORMAL, f);
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ANSI_NORMAL, f);
 
-                freelocale(loc);
-                break;
-        }
+        freelocale(loc);
+        return 0;
+}
 
-        case JSON_VARIANT_INTEGER:
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ansi_highlight_blue(), f);
+void json_format_integer(FILE *f, int64_t i, JsonFormatFlags flags) {
+        assert(f);
 
-                fprintf(f, "%" PRIdMAX, json_variant_integer(v));
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ansi_highlight_blue(), f);
 
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_NORMAL, f);
-                break;
+        fprintf(f, "%" PRIdMAX, (intmax_t) i);
 
-        case JSON_VARIANT_UNSIGNED:
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ansi_highlight_blue(), f);
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ANSI_NORMAL, f);
+}
 
-                fprintf(f, "%" PRIuMAX, json_variant_unsigned(v));
+void json_format_unsigned(FILE *f, uint64_t u, JsonFormatFlags flags) {
+        assert(f);
 
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_NORMAL, f);
-                break;
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ansi_highlight_blue(), f);
 
-        case JSON_VARIANT_BOOLEAN:
+        fprintf(f, "%" PRIuMAX, (uintmax_t) u);
 
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_HIGHLIGHT, f);
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ANSI_NORMAL, f);
+}
 
-                if (json_variant_boolean(v))
-                        fputs("true", f);
-                else
-                        fputs("false", f);
+void json_format_boolean(FILE *f, bool b, JsonFormatFlags flags) {
+        assert(f);
+
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ANSI_HIGHLIGHT, f);
 
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_NORMAL, f);
+        fputs(b ? "true" : "false", f);
 
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ANSI_NORMAL, f);
+}
+
+void json_format_null(FILE *f, JsonFormatFlags flags) {
+        assert(f);
+
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ANSI_HIGHLIGHT, f);
+
+        fputs("null", f);
+
+        if (flags & JSON_FORMAT_COLOR)
+                fputs(ANSI_NORMAL, f);
+}
+
+static int json_format(FILE *f, JsonVariant *v, JsonFormatFlags flags, const char *prefix) {
+        int r;
+
+        assert(f);
+        assert(v);
+
+        switch (json_variant_type(v)) {
+
+        case JSON_VARIANT_REAL:
+                r = json_format_real(f, json_variant_real(v), flags);
+                if (r < 0)
+                        return r;
                 break;
 
-        case JSON_VARIANT_NULL:
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_HIGHLIGHT, f);
+        case JSON_VARIANT_INTEGER:
+                json_format_integer(f, json_variant_integer(v), flags);
+                break;
 
-                fputs("null", f);
+        case JSON_VARIANT_UNSIGNED:
+                json_format_unsigned(f, json_variant_unsigned(v), flags);
+                break;
 
-                if (flags & JSON_FORMAT_COLOR)
-                        fputs(ANSI_NORMAL, f);
+        case JSON_VARIANT_BOOLEAN:
+                json_format_boolean(f, json_variant_boolean(v), flags);
+                break;
+
+        case JSON_VARIANT_NULL:
+                json_format_null(f, flags);
                 break;
 
         case JSON_VARIANT_STRING:
@@ -1818,6 +1870,19 @@ int json_variant_dump(JsonVariant *v, JsonFormatFlags flags, FILE *f, const char
 
         print_source(f, v, flags, false);
 
+        flags = json_format_begin(f, flags);
+
+        json_format(f, v, flags, prefix);
+
+        return json_format_end(f, flags);
+}
+
+JsonFormatFlags json_format_begin(FILE *f, JsonFormatFlags flags) {
+        assert(f);
+
+        /* Resolves the automatic flags and writes out what precedes a JSON value. Returns the resolved flags,
+         * which shall be used for the value itself and for json_format_end(). */
+
         if (((flags & (JSON_FORMAT_COLOR_AUTO|JSON_FORMAT_COLOR)) == JSON_FORMAT_COLOR_AUTO) && colors_enabled())
                 flags |= JSON_FORMAT_COLOR;
 
@@ -1829,7 +1894,11 @@ int json_variant_dump(JsonVariant *v, JsonFormatFlags flags, FILE *f, const char
         if (flags & JSON_FORMAT_SEQ)
                 fputc('\x1e', f); /* ASCII Record Separator */
 
-        json_format(f, v, flags, prefix);
+        return flags;
+}
+
+int json_format_end(FILE *f, JsonFormatFlags flags) {
+        assert(f);
 
         if (flags & (JSON_FORMAT_PRETTY|JSON_FORMAT_SEQ|JSON_FORMAT_SSE|JSON_FORMAT_NEWLINE))
                 fputc('\n', f);
@@ -205,6 +205,16 @@ typedef enum JsonFormatFlags {
 int json_variant_format(JsonVariant *v, JsonFormatFlags flags, char **ret);
 int json_variant_dump(JsonVariant *v, JsonFormatFlags flags, FILE *f, const char *prefix);
 
+/* Building blocks for writing JSON directly, formatted exactly like json_variant_dump() would */
+JsonFormatFlags json_format_begin(FILE *f, JsonFormatFlags flags);
+int json_format_end(FILE *f, JsonFormatFlags flags);
+void json_format_string(FILE *f, const char *q, JsonFormatFlags flags);
+int json_format_real(FILE *f, double d, JsonFormatFlags flags);
+void json_format_integer(FILE *f, int64_t i, JsonFormatFlags flags);
+void json_format_unsigned(FILE *f, uint64_t u, JsonFormatFlags flags);
+void json_format_boolean(FILE *f, bool b, JsonFormatFlags flags);
+void json_format_null(FILE *f, JsonFormatFlags flags);
+
 int json_variant_filter(JsonVariant **v, char **to_remove);
 
 int json_variant_set_field(JsonVariant **v, const char *field, JsonVariant *value);
@@ -318,13 +328,9 @@ typedef int (*JsonBuildCallback)(JsonVariant **ret, const char *name, void *user
 #endif // 0
 #define JSON_BUILD_BOOLEAN(b) _JSON_BUILD_BOOLEAN, (bool) { b }
 #define JSON_BUILD_ARRAY(...) _JSON_BUILD_ARRAY_BEGIN, __VA_ARGS__, _JSON_BUILD_ARRAY_END
-#if 0 /// UNNEEDED by elogind
 #define JSON_BUILD_EMPTY_ARRAY _JSON_BUILD_ARRAY_BEGIN, _JSON_BUILD_ARRAY_END
-#endif // 0
 #define JSON_BUILD_OBJECT(...) _JSON_BUILD_OBJECT_BEGIN, __VA_ARGS__, _JSON_BUILD_OBJECT_END
-#if 0 /// UNNEEDED by elogind
 #define JSON_BUILD_EMPTY_OBJECT _JSON_BUILD_OBJECT_BEGIN, _JSON_BUILD_OBJECT_END
-#endif // 0
 #define JSON_BUILD_PAIR(n, ...) _JSON_BUILD_PAIR, (const char*) { n }, __VA_ARGS__
 #define JSON_BUILD_PAIR_CONDITION(c, n, ...) _JSON_BUILD_PAIR_CONDITION, (bool) { c }, (const char*) { n }, __VA_ARGS__
 #define JSON_BUILD_NULL _JSON_BUILD_NULL
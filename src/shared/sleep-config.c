@@ -165,6 +165,9 @@ int parse_sleep_config(SleepConfig **ret) {
                 { "Sleep", "HandleNvidiaSleep",           config_parse_bool, 0, &sc->handle_nvidia_sleep },
                 { "Sleep", "SuspendByUsing",              config_parse_strv, 0, &sc->suspend_by_using },
                 { "Sleep", "HibernateByUsing",            config_parse_strv, 0, &sc->hibernate_by_using },
+                { "Sleep", "SleepHooksParallel",          config_parse_bool, 0, &sc->sleep_hooks_parallel },
+                { "Sleep", "SleepHooksMaxParallel",       config_parse_unsigned, 0, &sc->sleep_hooks_max_parallel },
+                { "Sleep", "SleepHookTimeoutSec",         config_parse_sec,  0, &sc->sleep_hook_timeout_usec },
 #endif // 1
                 { "Sleep", "AllowSuspend",              config_parse_tristate,    0,               &allow_suspend               },
                 { "Sleep", "AllowHibernation",          config_parse_tristate,    0,               &allow_hibernate             },
@@ -261,7 +264,7 @@ int sleep_state_supported(char **states) {
         if (access("/sys/power/state", W_OK) < 0)
                 return log_debug_errno(errno, "/sys/power/state is not writable: %m");
 
-        r = read_one_line_file("/sys/power/state", &supported_sysfs);
+        r = read_virtual_attribute("/sys/power/state", &supported_sysfs);
         if (r < 0)
                 return log_debug_errno(r, "Failed to read /sys/power/state: %m");
 
@@ -293,7 +296,7 @@ int sleep_mode_supported(char **modes) {
         if (access("/sys/power/disk", W_OK) < 0)
                 return log_debug_errno(errno, "/sys/power/disk is not writable: %m");
 
-        r = read_one_line_file("/sys/power/disk", &supported_sysfs);
+        r = read_virtual_attribute("/sys/power/disk", &supported_sysfs);
         if (r < 0)
                 return log_debug_errno(r, "Failed to read /sys/power/disk: %m");
 
@@ -346,7 +349,7 @@ static int suspend_mode_supported(char **modes) {
         if (access("/sys/power/mem_sleep", W_OK) < 0)
                 return log_debug_errno(errno, "/sys/power/mem_sleep is not writable: %m");
 
-        r = read_one_line_file("/sys/power/mem_sleep", &supported_sysfs);
+        r = read_virtual_attribute("/sys/power/mem_sleep", &supported_sysfs);
         if (r < 0)
                 return log_debug_errno(r, "Failed to read /sys/power/mem_sleep: %m");
 
@@ -362,12 +362,12 @@ int battery_trip_point_alarm_exists(void) {
                 return log_debug_errno(r, "Failed to initialize battery enumerator: %m");
 
         FOREACH_DEVICE(e, dev) {
-                const char *alarm_attr;
+                _cleanup_free_ char *alarm_attr = NULL;
                 int has_alarm;
 
                 has_battery = true;
 
-                r = sd_device_get_sysattr_value(dev, "alarm", &alarm_attr);
+                r = power_supply_read_attribute(dev, "alarm", &alarm_attr);
                 if (r < 0)
                         return log_device_debug_errno(dev, r, "Failed to read battery alarm attribute: %m");
 
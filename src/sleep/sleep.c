@@ -190,6 +190,39 @@ static int execute_external(Manager *m, SleepOperation operation) {
 }
 #endif // 1
 
+#if 1 /// elogind can run the sleep hook scripts in parallel, and with a timeout for each of them
+static int execute_sleep_hooks(
+                const Manager *m,
+                const char* const* dirs,
+                char **arguments,
+                gather_stdout_callback_t const callbacks[_STDOUT_CONSUME_MAX],
+                void* const callback_args[_STDOUT_CONSUME_MAX],
+                ExecDirFlags flags) {
+
+        ExecDirLimits limits = {
+                .max_jobs = 1,
+                .job_timeout = USEC_INFINITY,
+        };
+
+        assert(m);
+
+        if (m->sleep_hooks_parallel)
+                limits.max_jobs = m->sleep_hooks_max_parallel;
+        if (timestamp_is_set(m->sleep_hook_timeout_usec))
+                limits.job_timeout = m->sleep_hook_timeout_usec;
+
+        /* Slow hooks delay the sleep operation for everybody, hence always tell how long they took */
+        flags |= EXEC_DIR_LOG_DURATION;
+
+        if (!m->sleep_hooks_parallel && limits.job_timeout == USEC_INFINITY)
+                return execute_directories(dirs, DEFAULT_TIMEOUT_USEC, callbacks, callback_args, arguments, NULL, flags);
+
+        /* Hooks whose file names start with the same number run side by side, the groups in order */
+        return execute_directories_full(dirs, DEFAULT_TIMEOUT_USEC, &limits, callbacks, callback_args, arguments, NULL,
+                                        flags | EXEC_DIR_PARALLEL | EXEC_DIR_GROUP_BY_PREFIX);
+}
+#endif // 1
+
 static int write_efi_hibernate_location(const HibernationDevice *hibernation_device, bool required) {
         int log_level = required ? LOG_ERR : LOG_DEBUG;
 
@@ -454,6 +487,9 @@ static int execute(
 #endif // 0
                 bool resume_set;
 
+#if 1 /// elogind records how long each step of the operation takes
+                manager_timeline_mark(m, TIMELINE_HIBERNATION_DEVICE);
+#endif // 1
                 r = find_suitable_hibernation_device(&hibernation_device);
                 if (r < 0)
                         return log_error_errno(r, "Failed to find location to hibernate to: %m");
@@ -503,7 +539,8 @@ static int execute(
         log_debug_elogind("Executing suspend hook scripts... (Must succeed: %s)",
                           m->callback_must_succeed ? "YES" : "no");
 
-        r = execute_directories(dirs, DEFAULT_TIMEOUT_USEC, gather_output, gather_args, (char **) arguments, NULL, EXEC_DIR_NONE);
+        manager_timeline_mark(m, TIMELINE_PRE_HOOKS);
+        r = execute_sleep_hooks(m, dirs, (char **) arguments, gather_output, gather_args, EXEC_DIR_NONE);
 
         log_debug_elogind("Result is %d (callback_failed: %s)", r, m->callback_failed ? "true" : "false");
 
@@ -540,16 +577,20 @@ static int execute(
                    "SLEEP=%s", sleep_operation_to_string(arg_operation));
 
 #if 1 /// elogind may try to send a suspend signal to an nvidia card
-        if ( m->handle_nvidia_sleep )
+        if ( m->handle_nvidia_sleep ) {
+                manager_timeline_mark(m, TIMELINE_NVIDIA_SUSPEND);
                 have_nvidia = nvidia_sleep(m, driver_fd, operation, &vtnr);
+        }
 #endif // 1
 
 #if 0 /// Instead of only writing to /sys/power/state, elogind offers the possibility to call an extra program instead
         r = write_state(state_fd, sleep_config->states[operation]);
 #else // 0
+        manager_timeline_mark(m, TIMELINE_SLEEP);
         r = execute_external(m, operation);
         if (r < 0)
                 r = write_state(state_fd, sleep_config->states[operation]);
+        manager_timeline_mark(m, TIMELINE_RESUME);
 #endif // 0
         if (r < 0)
                 log_struct_errno(LOG_ERR, r,
@@ -563,15 +604,18 @@ static int execute(
                            "SLEEP=%s", sleep_operation_to_string(arg_operation));
 
 #if 1 /// if put to sleep, elogind also has to wakeup an nvidia card
-        if (have_nvidia)
+        if (have_nvidia) {
+                manager_timeline_mark(m, TIMELINE_NVIDIA_RESUME);
                 nvidia_sleep(m, driver_fd, _SLEEP_OPERATION_MAX, &vtnr);
+        }
 #endif // 1
 
         arguments[1] = "post";
 #if 0 /// elogind does not execute wakeup hook scripts in parallel, they might be order relevant
         (void) execute_directories(dirs, DEFAULT_TIMEOUT_USEC, NULL, NULL, (char **) arguments, NULL, EXEC_DIR_PARALLEL | EXEC_DIR_IGNORE_ERRORS);
 #else // 0
-        (void) execute_directories(dirs, DEFAULT_TIMEOUT_USEC, NULL, NULL, (char **) arguments, NULL, EXEC_DIR_IGNORE_ERRORS);
+        manager_timeline_mark(m, TIMELINE_POST_HOOKS);
+        (void) execute_sleep_hooks(m, dirs, (char **) arguments, NULL, NULL, EXEC_DIR_IGNORE_ERRORS);
 #endif // 0
 
         if (r >= 0)
@@ -905,6 +949,7 @@ int do_sleep(Manager *sleep_config, SleepOperation operation) {
         arg_operation = operation;
 
         log_debug_elogind("Called for '%s'", sleep_operation_to_string(operation));
+        manager_timeline_mark(sleep_config, TIMELINE_SLEEP_CONFIG);
 #endif // 0
 
         r = parse_sleep_config(&sleep_config);
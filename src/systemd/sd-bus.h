@@ -41,6 +41,7 @@ typedef struct sd_bus_message sd_bus_message;
 typedef struct sd_bus_slot sd_bus_slot;
 typedef struct sd_bus_creds sd_bus_creds;
 typedef struct sd_bus_track sd_bus_track;
+typedef struct sd_bus_message_template sd_bus_message_template;
 
 typedef struct {
         const char *name;
@@ -171,6 +172,11 @@ int sd_bus_set_exit_on_disconnect(sd_bus *bus, int b);
 int sd_bus_get_exit_on_disconnect(sd_bus *bus);
 int sd_bus_set_close_on_exit(sd_bus *bus, int b);
 int sd_bus_get_close_on_exit(sd_bus *bus);
+int sd_bus_set_defer_properties_changed(sd_bus *bus, int b);
+int sd_bus_get_defer_properties_changed(sd_bus *bus);
+int sd_bus_set_cache_sender_creds(sd_bus *bus, int b);
+int sd_bus_get_cache_sender_creds(sd_bus *bus);
+int sd_bus_get_sender_creds_cache_stats(sd_bus *bus, uint64_t *ret_driver_calls_avoided, uint64_t *ret_driver_calls);
 int sd_bus_set_watch_bind(sd_bus *bus, int b);
 int sd_bus_get_watch_bind(sd_bus *bus);
 int sd_bus_set_connected_signal(sd_bus *bus, int b);
@@ -235,6 +241,8 @@ int sd_bus_add_fallback(sd_bus *bus, sd_bus_slot **slot, const char *prefix, sd_
 int sd_bus_add_object_vtable(sd_bus *bus, sd_bus_slot **slot, const char *path, const char *interface, const sd_bus_vtable *vtable, void *userdata);
 int sd_bus_add_fallback_vtable(sd_bus *bus, sd_bus_slot **slot, const char *prefix, const char *interface, const sd_bus_vtable *vtable, sd_bus_object_find_t find, void *userdata);
 int sd_bus_add_node_enumerator(sd_bus *bus, sd_bus_slot **slot, const char *path, sd_bus_node_enumerator_t callback, void *userdata);
+int sd_bus_add_node_enumerator_cached(sd_bus *bus, sd_bus_slot **slot, const char *path, sd_bus_node_enumerator_t callback, void *userdata);
+int sd_bus_invalidate_node_enumerators(sd_bus *bus, const char *path);
 int sd_bus_add_object_manager(sd_bus *bus, sd_bus_slot **slot, const char *path);
 
 /* Slot object */
@@ -527,6 +535,100 @@ const char* sd_bus_track_next(sd_bus_track *track);
 int sd_bus_track_set_destroy_callback(sd_bus_track *s, sd_bus_destroy_t callback);
 int sd_bus_track_get_destroy_callback(sd_bus_track *s, sd_bus_destroy_t *ret);
 
+/* Message templates */
+
+int sd_bus_message_template_new(sd_bus_message_template **ret, const char *types);
+sd_bus_message_template* sd_bus_message_template_ref(sd_bus_message_template *t);
+sd_bus_message_template* sd_bus_message_template_unref(sd_bus_message_template *t);
+
+const char* sd_bus_message_template_get_signature(sd_bus_message_template *t);
+
+int sd_bus_message_append_template(sd_bus_message *m, sd_bus_message_template *t, ...);
+int sd_bus_message_append_templatev(sd_bus_message *m, sd_bus_message_template *t, va_list ap);
+
+#if defined(__cplusplus) && __cplusplus >= 201402L
+/* Compile-time signature validation, for SD_BUS_MESSAGE_TEMPLATE_NEW() below. Returns the length of
+ * the single complete type at s, or -1 if it is not valid. */
+constexpr int _sd_bus_signature_element_length(const char *s, unsigned n_array, unsigned n_struct) {
+        switch (*s) {
+
+        case 'y': case 'b': case 'n': case 'q': case 'i': case 'u': case 'x': case 't':
+        case 'd': case 's': case 'o': case 'g': case 'h': case 'v':
+                return 1;
+
+        case 'a': {
+                if (n_array >= 32)
+                        return -1;
+
+                if (s[1] == '{') {
+                        int l = 0;
+
+                        if (n_struct >= 32)
+                                return -1;
+
+                        switch (s[2]) {
+                        case 'y': case 'b': case 'n': case 'q': case 'i': case 'u': case 'x': case 't':
+                        case 'd': case 's': case 'o': case 'g': case 'h':
+                                break;
+                        default:
+                                return -1;
+                        }
+
+                        l = _sd_bus_signature_element_length(s + 3, n_array + 1, n_struct + 1);
+                        if (l < 0 || s[3 + l] != '}')
+                                return -1;
+
+                        return 3 + l + 1;
+                }
+
+                int l = _sd_bus_signature_element_length(s + 1, n_array + 1, n_struct);
+                return l < 0 ? -1 : l + 1;
+        }
+
+        case '(': {
+                int p = 1;
+
+                if (n_struct >= 32 || s[1] == ')')
+                        return -1;
+
+                while (s[p] != ')') {
+                        int l = _sd_bus_signature_element_length(s + p, n_array, n_struct + 1);
+                        if (l < 0)
+                                return -1;
+                        p += l;
+                }
+
+                return p + 1;
+        }
+
+        default:
+                return -1;
+        }
+}
+
+constexpr bool _sd_bus_signature_is_valid(const char *s) {
+        int p = 0;
+
+        while (s[p] != 0) {
+                int l = _sd_bus_signature_element_length(s + p, 0, 0);
+                if (l < 0)
+                        return false;
+                p += l;
+        }
+
+        return p <= 255;
+}
+
+/* In C++ the signature is validated at compile time */
+#  define SD_BUS_MESSAGE_TEMPLATE_NEW(ret, types)                                       \
+        ((void) [] { static_assert(_sd_bus_signature_is_valid(types), "Invalid D-Bus signature " types); }, \
+         sd_bus_message_template_new((ret), (types)))
+#else
+/* In C only the use of a string literal is enforced, the signature is validated at runtime */
+#  define SD_BUS_MESSAGE_TEMPLATE_NEW(ret, types)                                       \
+        sd_bus_message_template_new((ret), "" types "")
+#endif
+
 /* Define helpers so that __attribute__((cleanup(sd_bus_unrefp))) and similar may be used. */
 _SD_DEFINE_POINTER_CLEANUP_FUNC(sd_bus, sd_bus_unref);
 _SD_DEFINE_POINTER_CLEANUP_FUNC(sd_bus, sd_bus_close_unref);
@@ -535,6 +637,7 @@ _SD_DEFINE_POINTER_CLEANUP_FUNC(sd_bus_slot, sd_bus_slot_unref);
 _SD_DEFINE_POINTER_CLEANUP_FUNC(sd_bus_message, sd_bus_message_unref);
 _SD_DEFINE_POINTER_CLEANUP_FUNC(sd_bus_creds, sd_bus_creds_unref);
 _SD_DEFINE_POINTER_CLEANUP_FUNC(sd_bus_track, sd_bus_track_unref);
+_SD_DEFINE_POINTER_CLEANUP_FUNC(sd_bus_message_template, sd_bus_message_template_unref);
 
 _SD_END_DECLARATIONS;
 
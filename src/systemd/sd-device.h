@@ -51,6 +51,7 @@ __extension__ typedef enum sd_device_action_t {
 /* callback */
 
 typedef int (*sd_device_monitor_handler_t)(sd_device_monitor *m, sd_device *device, void *userdata);
+typedef int (*sd_device_monitor_batch_handler_t)(sd_device_monitor *m, sd_device **devices, size_t n_devices, void *userdata);
 
 /* device */
 
@@ -151,6 +152,9 @@ int sd_device_monitor_set_description(sd_device_monitor *m, const char *descript
 int sd_device_monitor_get_description(sd_device_monitor *m, const char **ret);
 int sd_device_monitor_start(sd_device_monitor *m, sd_device_monitor_handler_t callback, void *userdata);
 int sd_device_monitor_stop(sd_device_monitor *m);
+int sd_device_monitor_set_batch_size(sd_device_monitor *m, size_t size);
+int sd_device_monitor_get_batch_size(sd_device_monitor *m, size_t *ret);
+int sd_device_monitor_start_batch(sd_device_monitor *m, sd_device_monitor_batch_handler_t callback, void *userdata);
 
 int sd_device_monitor_filter_add_match_subsystem_devtype(sd_device_monitor *m, const char *subsystem, const char *devtype);
 int sd_device_monitor_filter_add_match_tag(sd_device_monitor *m, const char *tag);
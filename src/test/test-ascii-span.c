@@ -0,0 +1,123 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "ascii-span.h"
+#include "random-util.h"
+#include "string-util.h"
+#include "tests.h"
+#include "utf8.h"
+
+/* Compares the vectorized helpers with the scalar ones on random input, at all offsets and lengths up to a
+ * few vectors, so that every alignment, every position of the first bad byte and every tail is covered. */
+
+#define BUFFER_SIZE 160U
+
+static const char object_path_chars[] = "/_" LETTERS DIGITS;
+
+static void fill_random(char *buf, size_t n, unsigned bad_permille) {
+        /* Mostly characters that are valid everywhere, with a sprinkling of bytes of any value */
+        for (size_t i = 0; i < n; i++)
+                if (random_u64_range(1000) < bad_permille)
+                        buf[i] = (char) random_u64_range(256);
+                else
+                        buf[i] = object_path_chars[random_u64_range(strlen(object_path_chars))];
+}
+
+static char* utf8_is_valid_n_scalar(const char *str, size_t len_bytes) {
+        for (const char *p = str; (size_t) (p - str) < len_bytes; ) {
+                int len;
+
+                if (*p == '\0')
+                        return NULL;
+
+                len = utf8_encoded_valid_unichar(p, len_bytes - (p - str));
+                if (len < 0)
+                        return NULL;
+
+                p += len;
+        }
+
+        return (char*) str;
+}
+
+static void test_one(const char *buf) {
+        for (size_t offset = 0; offset < 32; offset++)
+                for (size_t n = 0; offset + n <= BUFFER_SIZE; n++) {
+                        const char *s = buf + offset;
+
+                        assert_se(ascii_span(s, n) == ascii_span_scalar(s, n));
+                        assert_se(ascii_span_object_path(s, n) == ascii_span_object_path_scalar(s, n));
+                        assert_se(!utf8_is_valid_n(s, n) == !utf8_is_valid_n_scalar(s, n));
+                }
+}
+
+TEST(ascii_span) {
+        assert_se(ascii_span("", 0) == 0);
+        assert_se(ascii_span("foo", 3) == 3);
+        assert_se(ascii_span("foo", 4) == 3);
+        assert_se(ascii_span("abcdefghijklmnopqrstuvwxyz\0abcdefghijklmnopqrstuvwxyz", 53) == 26);
+        assert_se(ascii_span("abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyząę", 56) == 52);
+        assert_se(ascii_span("abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwxyz\x7f", 53) == 53);
+
+        assert_se(ascii_span_object_path("/org/freedesktop/login1/session/_31", 35) == 35);
+        assert_se(ascii_span_object_path("/org/freedesktop/login1/session/c1-", 35) == 34);
+        assert_se(ascii_span_object_path("/org/freedesktop/login1/session/c1@", 35) == 34);
+        assert_se(ascii_span_object_path("/org/freedesktop/login1/session/c1[", 35) == 34);
+        assert_se(ascii_span_object_path("/org/freedesktop/login1/session/c1`", 35) == 34);
+        assert_se(ascii_span_object_path("/org/freedesktop/login1/session/c1{", 35) == 34);
+        assert_se(ascii_span_object_path("/org/freedesktop/login1/session/c1:", 35) == 34);
+
+        /* Consecutive slashes, within and across vector boundaries */
+        assert_se(ascii_span_object_path("/org/freedesktop//login1/session", 32) == 17);
+        assert_se(ascii_span_object_path("/org/freedeskto//login1/session/c1/_31", 38) == 16);
+        assert_se(ascii_span_object_path("/org/freedesktop/login1/session//c1/_31", 39) == 32);
+        assert_se(ascii_span_object_path("/org/freedesktop/login1/sessio//c1/_31", 38) == 31);
+}
+
+TEST(ascii_span_differential) {
+        static const unsigned bad_permille[] = { 0, 2, 10, 50, 500, 1000 };
+        char buf[BUFFER_SIZE];
+
+        /* Valid throughout, and with bad bytes at various densities */
+        FOREACH_ARRAY(b, bad_permille, ELEMENTSOF(bad_permille))
+                for (unsigned i = 0; i < 20; i++) {
+                        fill_random(buf, sizeof(buf), *b);
+                        test_one(buf);
+                }
+
+        /* All single byte values at all positions in otherwise valid input */
+        fill_random(buf, sizeof(buf), 0);
+        for (size_t i = 0; i < 64; i++)
+                for (unsigned c = 0; c < 256; c++) {
+                        char saved = buf[i];
+
+                        buf[i] = (char) c;
+                        for (size_t n = i; n <= 96; n++) {
+                                assert_se(ascii_span(buf, n) == ascii_span_scalar(buf, n));
+                                assert_se(ascii_span_object_path(buf, n) == ascii_span_object_path_scalar(buf, n));
+                        }
+                        buf[i] = saved;
+                }
+}
+
+TEST(utf8_is_valid_n_differential) {
+        static const char *const chars[] = { "a", "/", "ą", "™", "😀", "\341\204", "\377", "\200" };
+        char buf[BUFFER_SIZE];
+
+        /* Multibyte characters, valid and broken ones, at random positions in ASCII */
+        for (unsigned i = 0; i < 200; i++) {
+                size_t n = random_u64_range(8);
+
+                fill_random(buf, sizeof(buf), 0);
+
+                for (size_t j = 0; j < n; j++) {
+                        const char *c = chars[random_u64_range(ELEMENTSOF(chars))];
+                        size_t k = random_u64_range(sizeof(buf) - strlen(c));
+
+                        memcpy(buf + k, c, strlen(c));
+                }
+
+                test_one(buf);
+        }
+}
+
+DEFINE_TEST_MAIN(LOG_INFO);
@@ -0,0 +1,177 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include "alloc-util.h"
+#include "battery-util.h"
+#include "device-internal.h"
+#include "device-private.h"
+#include "fileio.h"
+#include "mount-util.h"
+#include "namespace-util.h"
+#include "path-util.h"
+#include "rm-rf.h"
+#include "string-util.h"
+#include "tests.h"
+#include "tmpfile-util.h"
+
+/* The power supplies live in a directory of our own below /sys, on a tmpfs in a mount namespace of our own,
+ * as sd_device refuses syspaths elsewhere. The attributes are plain files. */
+
+static void write_attribute(const char *syspath, const char *attr, const char *value) {
+        _cleanup_free_ char *p = NULL;
+
+        assert_se(p = path_join(syspath, attr));
+        assert_se(write_string_file(p, value, WRITE_STRING_FILE_CREATE|WRITE_STRING_FILE_MKDIR_0755) >= 0);
+}
+
+static void process_device(Hashmap **supplies, const char *syspath, sd_device_action_t action) {
+        _cleanup_(sd_device_unrefp) sd_device *d = NULL;
+
+        assert_se(device_new_aux(&d) >= 0);
+        assert_se(device_set_syspath(d, syspath, /* verify = */ false) >= 0);
+        assert_se(device_add_property(d, "POWER_SUPPLY_NAME", last_path_component(syspath)) >= 0);
+        assert_se(device_set_action(d, action) >= 0);
+
+        /* Like the devices the monitor hands out, which carry everything udev knows about them */
+        d->sealed = true;
+
+        assert_se(power_supplies_process_device(supplies, d) >= 0);
+}
+
+TEST(on_ac_power) {
+        _cleanup_(rm_rf_physical_and_freep) char *tmpdir = NULL;
+        _cleanup_hashmap_free_ Hashmap *supplies = NULL;
+        const char *bat, *ac, *usb;
+        PowerSupply *s;
+
+        assert_se(mkdtemp_malloc("/sys/test-battery-util.XXXXXX", &tmpdir) >= 0);
+        bat = strjoina(tmpdir, "/BAT0");
+        ac = strjoina(tmpdir, "/AC");
+        usb = strjoina(tmpdir, "/ucsi-source-psy-USBC000:001");
+
+        /* Nothing at all, e.g. a desktop machine */
+        assert_se(power_supplies_on_ac_power(supplies) > 0);
+
+        write_attribute(bat, "type", "Battery");
+        write_attribute(bat, "present", "1");
+        write_attribute(bat, "status", "Discharging");
+        write_attribute(bat, "capacity", "50");
+        process_device(&supplies, bat, SD_DEVICE_ADD);
+        assert_se(power_supplies_on_ac_power(supplies) == 0);
+
+        assert_se(s = hashmap_get(supplies, bat));
+        assert_se(streq(s->type, "Battery"));
+        assert_se(streq(s->name, "BAT0"));
+        assert_se(!s->device_scope);
+        assert_se(s->present > 0);
+        assert_se(streq(s->status, "Discharging"));
+        assert_se(s->capacity == 50);
+
+        write_attribute(ac, "type", "Mains");
+        write_attribute(ac, "online", "0");
+        process_device(&supplies, ac, SD_DEVICE_ADD);
+        assert_se(hashmap_size(supplies) == 2);
+        assert_se(power_supplies_on_ac_power(supplies) == 0);
+        assert_se(power_supplies_discharging_and_low(supplies) == 0);
+
+        /* A "change" event rereads the state of the very same record */
+        write_attribute(ac, "online", "1");
+        process_device(&supplies, ac, SD_DEVICE_CHANGE);
+        assert_se(hashmap_size(supplies) == 2);
+        assert_se(power_supplies_on_ac_power(supplies) > 0);
+
+        /* A "remove" event drops it */
+        process_device(&supplies, ac, SD_DEVICE_REMOVE);
+        assert_se(hashmap_size(supplies) == 1);
+        assert_se(!hashmap_get(supplies, ac));
+        assert_se(power_supplies_on_ac_power(supplies) == 0);
+
+        /* Removing a power supply we don't know about is fine */
+        process_device(&supplies, ac, SD_DEVICE_REMOVE);
+        assert_se(hashmap_size(supplies) == 1);
+
+        /* A USB power supply whose power role was not looked at yet does not count, one in sink mode does.
+         * The lazy checks rely on that only turning "battery" into "AC". */
+        write_attribute(usb, "type", "USB");
+        write_attribute(usb, "online", "1");
+        process_device(&supplies, usb, SD_DEVICE_ADD);
+        assert_se(s = hashmap_get(supplies, usb));
+        s->usb_sink = -ENODATA;
+        assert_se(power_supplies_on_ac_power(supplies) == 0);
+        s->usb_sink = 0;
+        assert_se(power_supplies_on_ac_power(supplies) == 0);
+        s->usb_sink = 1;
+        assert_se(power_supplies_on_ac_power(supplies) > 0);
+}
+
+TEST(discharging_and_low) {
+        _cleanup_(rm_rf_physical_and_freep) char *tmpdir = NULL;
+        _cleanup_hashmap_free_ Hashmap *supplies = NULL;
+        const char *bat0, *bat1, *mouse;
+        PowerSupply *s;
+
+        assert_se(mkdtemp_malloc("/sys/test-battery-util.XXXXXX", &tmpdir) >= 0);
+        bat0 = strjoina(tmpdir, "/BAT0");
+        bat1 = strjoina(tmpdir, "/BAT1");
+        mouse = strjoina(tmpdir, "/hidpp_battery_0");
+
+        write_attribute(bat0, "type", "Battery");
+        write_attribute(bat0, "present", "1");
+        write_attribute(bat0, "status", "Discharging");
+        write_attribute(bat0, "capacity", "3");
+        process_device(&supplies, bat0, SD_DEVICE_ADD);
+        assert_se(power_supplies_discharging_and_low(supplies) > 0);
+
+        /* The battery of a mouse is not one of ours */
+        write_attribute(mouse, "type", "Battery");
+        write_attribute(mouse, "scope", "Device");
+        write_attribute(mouse, "present", "1");
+        write_attribute(mouse, "status", "Discharging");
+        write_attribute(mouse, "capacity", "80");
+        process_device(&supplies, mouse, SD_DEVICE_ADD);
+        assert_se(s = hashmap_get(supplies, mouse));
+        assert_se(s->device_scope);
+        assert_se(!power_supply_is_battery(s));
+        assert_se(power_supplies_discharging_and_low(supplies) > 0);
+
+        /* Neither is one that is not there */
+        write_attribute(bat1, "type", "Battery");
+        write_attribute(bat1, "present", "0");
+        write_attribute(bat1, "capacity", "90");
+        process_device(&supplies, bat1, SD_DEVICE_ADD);
+        assert_se(s = hashmap_get(supplies, bat1));
+        assert_se(!s->status);
+        assert_se(power_supplies_discharging_and_low(supplies) > 0);
+
+        /* If in doubt, we are not low */
+        write_attribute(bat1, "present", "1");
+        write_attribute(bat1, "status", "Discharging");
+        write_attribute(bat1, "capacity", "101");
+        process_device(&supplies, bat1, SD_DEVICE_CHANGE);
+        assert_se(s->capacity == -ERANGE);
+        assert_se(power_supplies_discharging_and_low(supplies) == 0);
+
+        write_attribute(bat1, "capacity", "20");
+        process_device(&supplies, bat1, SD_DEVICE_CHANGE);
+        assert_se(s->capacity == 20);
+        assert_se(power_supplies_discharging_and_low(supplies) == 0);
+
+        /* Once the charged battery is gone, we are low again */
+        process_device(&supplies, bat1, SD_DEVICE_REMOVE);
+        assert_se(power_supplies_discharging_and_low(supplies) > 0);
+}
+
+static int intro(void) {
+        int r;
+
+        r = detach_mount_namespace();
+        if (r < 0)
+                return log_tests_skipped_errno(r, "Failed to detach mount namespace");
+
+        r = mount_nofollow_verbose(LOG_DEBUG, "tmpfs", "/sys", "tmpfs", 0, "mode=0755");
+        if (r < 0)
+                return log_tests_skipped_errno(r, "Failed to mount tmpfs on /sys");
+
+        return EXIT_SUCCESS;
+}
+
+DEFINE_TEST_MAIN_WITH_INTRO(LOG_DEBUG, intro);
@@ -0,0 +1,145 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <stdio.h>
+#include <sys/socket.h>
+
+#include "sd-bus.h"
+
+#include "bus-message-json.h"
+#include "fd-util.h"
+#include "json.h"
+#include "parse-util.h"
+#include "tests.h"
+#include "time-util.h"
+
+/* Compares writing out messages as JSON directly while reading them with building a JsonVariant tree from
+ * them first and dumping that, the way busctl monitor used to do it. Takes the number of iterations as
+ * argument. */
+
+static unsigned arg_iterations = 10000;
+
+#define N_SESSIONS 100
+
+static sd_bus_message* new_properties_changed(sd_bus *bus) {
+        sd_bus_message *m;
+
+        assert_se(sd_bus_message_new_signal(bus, &m, "/org/freedesktop/login1/session/c1",
+                                            "org.freedesktop.DBus.Properties", "PropertiesChanged") >= 0);
+        assert_se(sd_bus_message_append(m, "sa{sv}as", "org.freedesktop.login1.Session",
+                                        2, "Active", "b", 1, "State", "s", "active",
+                                        1, "IdleHint") >= 0);
+        assert_se(sd_bus_message_seal(m, 1, 0) >= 0);
+        return m;
+}
+
+static JsonVariant* build_properties_changed(sd_bus_message *m) {
+        const char *interface, *active_name, *state_name, *state, *invalidated;
+        JsonVariant *v = NULL;
+        int active;
+
+        assert_se(sd_bus_message_read(m, "sa{sv}as", &interface,
+                                      2, &active_name, "b", &active, &state_name, "s", &state,
+                                      1, &invalidated) >= 0);
+
+        assert_se(json_build(&v, JSON_BUILD_ARRAY(
+                JSON_BUILD_STRING(interface),
+                JSON_BUILD_OBJECT(
+                        JSON_BUILD_PAIR(active_name, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("type", JSON_BUILD_STRING("b")),
+                                                                       JSON_BUILD_PAIR("data", JSON_BUILD_BOOLEAN(active)))),
+                        JSON_BUILD_PAIR(state_name, JSON_BUILD_OBJECT(JSON_BUILD_PAIR("type", JSON_BUILD_STRING("s")),
+                                                                      JSON_BUILD_PAIR("data", JSON_BUILD_STRING(state))))),
+                JSON_BUILD_ARRAY(JSON_BUILD_STRING(invalidated)))) >= 0);
+        return v;
+}
+
+static sd_bus_message* new_list_sessions(sd_bus *bus) {
+        sd_bus_message *m;
+
+        assert_se(sd_bus_message_new_signal(bus, &m, "/org/freedesktop/login1", "org.freedesktop.elogind.Test", "Test") >= 0);
+        assert_se(sd_bus_message_open_container(m, 'a', "(susso)") >= 0);
+        for (unsigned i = 0; i < N_SESSIONS; i++)
+                assert_se(sd_bus_message_append(m, "(susso)", "c1", (uint32_t) 1000, "foo", "seat0",
+                                                "/org/freedesktop/login1/session/c1") >= 0);
+        assert_se(sd_bus_message_close_container(m) >= 0);
+        assert_se(sd_bus_message_seal(m, 1, 0) >= 0);
+        return m;
+}
+
+static JsonVariant* build_list_sessions(sd_bus_message *m) {
+        JsonVariant *sessions = NULL, *v = NULL;
+        const char *id, *user, *seat, *path;
+        uint32_t uid;
+
+        assert_se(sd_bus_message_enter_container(m, 'a', "(susso)") >= 0);
+
+        while (sd_bus_message_read(m, "(susso)", &id, &uid, &user, &seat, &path) > 0) {
+                _cleanup_(json_variant_unrefp) JsonVariant *s = NULL;
+
+                assert_se(json_build(&s, JSON_BUILD_ARRAY(
+                        JSON_BUILD_STRING(id), JSON_BUILD_UNSIGNED(uid), JSON_BUILD_STRING(user),
+                        JSON_BUILD_STRING(seat), JSON_BUILD_STRING(path))) >= 0);
+                assert_se(json_variant_append_array(&sessions, s) >= 0);
+        }
+
+        assert_se(sd_bus_message_exit_container(m) >= 0);
+
+        assert_se(json_build(&v, JSON_BUILD_ARRAY(JSON_BUILD_VARIANT(sessions))) >= 0);
+        json_variant_unref(sessions);
+        return v;
+}
+
+static nsec_t run_tree(sd_bus_message *m, JsonVariant* (*build)(sd_bus_message *m), FILE *f) {
+        usec_t ts = now(CLOCK_MONOTONIC);
+
+        for (unsigned i = 0; i < arg_iterations; i++) {
+                _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+
+                assert_se(sd_bus_message_rewind(m, true) >= 0);
+                v = build(m);
+
+                assert_se(json_variant_dump(v, JSON_FORMAT_NEWLINE, f, NULL) >= 0);
+        }
+
+        return (now(CLOCK_MONOTONIC) - ts) * NSEC_PER_USEC / arg_iterations;
+}
+
+static nsec_t run_stream(sd_bus_message *m, FILE *f) {
+        usec_t ts = now(CLOCK_MONOTONIC);
+
+        for (unsigned i = 0; i < arg_iterations; i++) {
+                assert_se(sd_bus_message_rewind(m, true) >= 0);
+                assert_se(bus_message_dump_json(m, JSON_FORMAT_NEWLINE, f) >= 0);
+        }
+
+        return (now(CLOCK_MONOTONIC) - ts) * NSEC_PER_USEC / arg_iterations;
+}
+
+int main(int argc, char *argv[]) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *changed = NULL, *sessions = NULL;
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        _cleanup_close_pair_ int pair[2] = EBADF_PAIR;
+        _cleanup_fclose_ FILE *f = NULL;
+
+        test_setup_logging(LOG_INFO);
+
+        if (argc > 1)
+                assert_se(safe_atou(argv[1], &arg_iterations) >= 0 && arg_iterations > 0);
+
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, pair) >= 0);
+        assert_se(sd_bus_new(&bus) >= 0);
+        assert_se(sd_bus_set_fd(bus, pair[0], pair[0]) >= 0);
+        TAKE_FD(pair[0]);
+        assert_se(sd_bus_start(bus) >= 0);
+
+        assert_se(f = fopen("/dev/null", "we"));
+
+        changed = new_properties_changed(bus);
+        sessions = new_list_sessions(bus);
+
+        /* The tree column only covers the payload, the stream column the whole message including its header */
+        printf("SIGNATURE\tTREE NSEC\tSTREAM NSEC\n");
+        printf("sa{sv}as\t%" PRIu64 "\t%" PRIu64 "\n", run_tree(changed, build_properties_changed, f), run_stream(changed, f));
+        printf("a(susso)\t%" PRIu64 "\t%" PRIu64 "\n", run_tree(sessions, build_list_sessions, f), run_stream(sessions, f));
+
+        return 0;
+}
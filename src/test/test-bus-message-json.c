@@ -0,0 +1,205 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+
+#include <math.h>
+#include <sys/socket.h>
+
+#include "sd-bus.h"
+
+#include "alloc-util.h"
+#include "bus-internal.h"
+#include "bus-message.h"
+#include "bus-message-json.h"
+#include "fd-util.h"
+#include "json.h"
+#include "memstream-util.h"
+#include "tests.h"
+
+static sd_bus *bus = NULL;
+
+static void test_message(sd_bus_message *m, JsonVariant *payload) {
+        static const JsonFormatFlags flags[] = {
+                0,
+                JSON_FORMAT_NEWLINE,
+                JSON_FORMAT_PRETTY,
+                JSON_FORMAT_PRETTY|JSON_FORMAT_COLOR,
+                JSON_FORMAT_SEQ,
+                JSON_FORMAT_SSE|JSON_FORMAT_FLUSH,
+        };
+        _cleanup_(json_variant_unrefp) JsonVariant *v = NULL;
+        char e[2] = { m->header->endian, 0 };
+
+        /* The reference is built the way busctl monitor used to do it, as a JsonVariant tree */
+        assert_se(json_build(&v, JSON_BUILD_OBJECT(
+                JSON_BUILD_PAIR("type", JSON_BUILD_STRING(bus_message_type_to_string(m->header->type))),
+                JSON_BUILD_PAIR("endian", JSON_BUILD_STRING(e)),
+                JSON_BUILD_PAIR("flags", JSON_BUILD_INTEGER(m->header->flags)),
+                JSON_BUILD_PAIR("version", JSON_BUILD_INTEGER(m->header->version)),
+                JSON_BUILD_PAIR("cookie", JSON_BUILD_INTEGER(BUS_MESSAGE_COOKIE(m))),
+                JSON_BUILD_PAIR_CONDITION(m->reply_cookie != 0, "reply_cookie", JSON_BUILD_INTEGER(m->reply_cookie)),
+                JSON_BUILD_PAIR("timestamp-realtime", JSON_BUILD_UNSIGNED(m->realtime)),
+                JSON_BUILD_PAIR_CONDITION(m->sender, "sender", JSON_BUILD_STRING(m->sender)),
+                JSON_BUILD_PAIR_CONDITION(m->destination, "destination", JSON_BUILD_STRING(m->destination)),
+                JSON_BUILD_PAIR_CONDITION(m->path, "path", JSON_BUILD_STRING(m->path)),
+                JSON_BUILD_PAIR_CONDITION(m->interface, "interface", JSON_BUILD_STRING(m->interface)),
+                JSON_BUILD_PAIR_CONDITION(m->member, "member", JSON_BUILD_STRING(m->member)),
+                JSON_BUILD_PAIR_CONDITION(m->monotonic != 0, "monotonic", JSON_BUILD_INTEGER(m->monotonic)),
+                JSON_BUILD_PAIR_CONDITION(m->realtime != 0, "realtime", JSON_BUILD_INTEGER(m->realtime)),
+                JSON_BUILD_PAIR_CONDITION(m->seqnum != 0, "seqnum", JSON_BUILD_INTEGER(m->seqnum)),
+                JSON_BUILD_PAIR_CONDITION(m->error.name, "error_name", JSON_BUILD_STRING(m->error.name)),
+                JSON_BUILD_PAIR("payload", JSON_BUILD_OBJECT(
+                        JSON_BUILD_PAIR("type", JSON_BUILD_STRING(sd_bus_message_get_signature(m, false))),
+                        JSON_BUILD_PAIR("data", JSON_BUILD_VARIANT(payload)))))) >= 0);
+
+        FOREACH_ARRAY(i, flags, ELEMENTSOF(flags)) {
+                _cleanup_(memstream_done) MemStream a = {}, b = {};
+                _cleanup_free_ char *x = NULL, *y = NULL;
+                FILE *f;
+
+                assert_se(f = memstream_init(&a));
+                assert_se(json_variant_dump(v, *i, f, NULL) >= 0);
+                assert_se(memstream_finalize(&a, &x, NULL) >= 0);
+
+                assert_se(sd_bus_message_rewind(m, true) >= 0);
+                assert_se(f = memstream_init(&b));
+                assert_se(bus_message_dump_json(m, *i, f) >= 0);
+                assert_se(memstream_finalize(&b, &y, NULL) >= 0);
+
+                if (*i == 0)
+                        log_info("%s", y);
+
+                assert_se(streq(x, y));
+        }
+}
+
+static sd_bus_message* new_message(void) {
+        sd_bus_message *m;
+
+        assert_se(sd_bus_message_new_signal(bus, &m, "/foo", "org.freedesktop.elogind.Test", "Test") >= 0);
+        return m;
+}
+
+static void seal_message(sd_bus_message *m) {
+        assert_se(sd_bus_message_seal(m, 4711, 0) >= 0);
+
+        m->realtime = 1700000000 * USEC_PER_SEC;
+        m->monotonic = 4242;
+        m->seqnum = 7;
+}
+
+TEST(basic) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = new_message();
+        _cleanup_(json_variant_unrefp) JsonVariant *payload = NULL, *pi = NULL, *zero = NULL, *nan = NULL, *tiny = NULL;
+
+        assert_se(sd_bus_message_append(m, "ybnqiuxtd",
+                                        (uint8_t) 255, 1, (int16_t) -16, (uint16_t) 16, (int32_t) INT32_MIN,
+                                        (uint32_t) UINT32_MAX, (int64_t) INT64_MIN, (uint64_t) UINT64_MAX, 3.14) >= 0);
+        assert_se(sd_bus_message_append(m, "ddd", -0.0, NAN, 1e-300) >= 0);
+        assert_se(sd_bus_message_append(m, "sog", "\"quoted\\\"\n\t\x01 \xc3\xa4", "/org/freedesktop/elogind", "a{sv}") >= 0);
+        assert_se(sd_bus_message_append(m, "s", "") >= 0);
+        seal_message(m);
+
+        assert_se(json_variant_new_real(&pi, 3.14) >= 0);
+        assert_se(json_variant_new_real(&zero, -0.0) >= 0);
+        assert_se(json_variant_new_real(&nan, NAN) >= 0);
+        assert_se(json_variant_new_real(&tiny, 1e-300) >= 0);
+
+        assert_se(json_build(&payload, JSON_BUILD_ARRAY(
+                JSON_BUILD_UNSIGNED(255), JSON_BUILD_BOOLEAN(true), JSON_BUILD_INTEGER(-16), JSON_BUILD_UNSIGNED(16),
+                JSON_BUILD_INTEGER(INT32_MIN), JSON_BUILD_UNSIGNED(UINT32_MAX), JSON_BUILD_INTEGER(INT64_MIN),
+                JSON_BUILD_UNSIGNED(UINT64_MAX), JSON_BUILD_VARIANT(pi),
+                JSON_BUILD_VARIANT(zero), JSON_BUILD_VARIANT(nan), JSON_BUILD_VARIANT(tiny),
+                JSON_BUILD_STRING("\"quoted\\\"\n\t\x01 \xc3\xa4"), JSON_BUILD_STRING("/org/freedesktop/elogind"),
+                JSON_BUILD_STRING("a{sv}"), JSON_BUILD_STRING(""))) >= 0);
+
+        test_message(m, payload);
+}
+
+TEST(containers) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = new_message();
+        _cleanup_(json_variant_unrefp) JsonVariant *payload = NULL;
+
+        assert_se(sd_bus_message_append(m, "sa{sv}as",
+                                        "org.freedesktop.login1.Session",
+                                        3,
+                                        "Active", "b", 1,
+                                        "User", "(uo)", 1000, "/org/freedesktop/login1/user/_1000",
+                                        "Nested", "v", "ai", 2, 1, 2,
+                                        1, "IdleHint") >= 0);
+        assert_se(sd_bus_message_append(m, "aia{ss}a(ii)(sa{uai})", 0, 0, 0, "x", 0, 0) >= 0);
+        assert_se(sd_bus_message_append(m, "aay", 2, 0, 3, 'f', 'o', 'o') >= 0);
+        seal_message(m);
+
+        assert_se(json_build(&payload, JSON_BUILD_ARRAY(
+                JSON_BUILD_STRING("org.freedesktop.login1.Session"),
+                JSON_BUILD_OBJECT(
+                        JSON_BUILD_PAIR("Active", JSON_BUILD_OBJECT(JSON_BUILD_PAIR("type", JSON_BUILD_STRING("b")),
+                                                                    JSON_BUILD_PAIR("data", JSON_BUILD_BOOLEAN(true)))),
+                        JSON_BUILD_PAIR("User", JSON_BUILD_OBJECT(JSON_BUILD_PAIR("type", JSON_BUILD_STRING("(uo)")),
+                                                                  JSON_BUILD_PAIR("data", JSON_BUILD_ARRAY(
+                                                                        JSON_BUILD_UNSIGNED(1000),
+                                                                        JSON_BUILD_STRING("/org/freedesktop/login1/user/_1000"))))),
+                        JSON_BUILD_PAIR("Nested", JSON_BUILD_OBJECT(JSON_BUILD_PAIR("type", JSON_BUILD_STRING("v")),
+                                                                    JSON_BUILD_PAIR("data", JSON_BUILD_OBJECT(
+                                                                        JSON_BUILD_PAIR("type", JSON_BUILD_STRING("ai")),
+                                                                        JSON_BUILD_PAIR("data", JSON_BUILD_ARRAY(
+                                                                                JSON_BUILD_INTEGER(1),
+                                                                                JSON_BUILD_INTEGER(2)))))))),
+                JSON_BUILD_ARRAY(JSON_BUILD_STRING("IdleHint")),
+                JSON_BUILD_EMPTY_ARRAY,
+                JSON_BUILD_EMPTY_OBJECT,
+                JSON_BUILD_EMPTY_ARRAY,
+                JSON_BUILD_ARRAY(JSON_BUILD_STRING("x"), JSON_BUILD_EMPTY_OBJECT),
+                JSON_BUILD_ARRAY(JSON_BUILD_EMPTY_ARRAY,
+                                 JSON_BUILD_ARRAY(JSON_BUILD_UNSIGNED('f'), JSON_BUILD_UNSIGNED('o'), JSON_BUILD_UNSIGNED('o'))))) >= 0);
+
+        test_message(m, payload);
+}
+
+TEST(empty) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = new_message();
+        _cleanup_(json_variant_unrefp) JsonVariant *payload = NULL;
+
+        seal_message(m);
+        m->monotonic = m->seqnum = 0;
+
+        assert_se(json_build(&payload, JSON_BUILD_EMPTY_ARRAY) >= 0);
+
+        test_message(m, payload);
+}
+
+TEST(non_string_keys) {
+        _cleanup_(sd_bus_message_unrefp) sd_bus_message *m = new_message();
+        _cleanup_(memstream_done) MemStream ms = {};
+        _cleanup_free_ char *buf = NULL;
+        size_t sz;
+        FILE *f;
+
+        assert_se(sd_bus_message_append(m, "a{is}", 1, 4, "four") >= 0);
+        seal_message(m);
+        assert_se(sd_bus_message_rewind(m, true) >= 0);
+
+        /* Refused like json_variant_new_object() does, without writing anything */
+        assert_se(f = memstream_init(&ms));
+        assert_se(bus_message_dump_json(m, JSON_FORMAT_NEWLINE, f) == -EINVAL);
+        assert_se(memstream_finalize(&ms, &buf, &sz) >= 0);
+        assert_se(sz == 0);
+}
+
+static int intro(void) {
+        _cleanup_close_pair_ int pair[2] = EBADF_PAIR;
+
+        assert_se(socketpair(AF_UNIX, SOCK_STREAM|SOCK_CLOEXEC|SOCK_NONBLOCK, 0, pair) >= 0);
+        assert_se(sd_bus_new(&bus) >= 0);
+        assert_se(sd_bus_set_fd(bus, pair[0], pair[0]) >= 0);
+        TAKE_FD(pair[0]);
+        assert_se(sd_bus_start(bus) >= 0);
+
+        return EXIT_SUCCESS;
+}
+
+static int outro(void) {
+        bus = sd_bus_flush_close_unref(bus);
+        return EXIT_SUCCESS;
+}
+
+DEFINE_TEST_MAIN_FULL(LOG_INFO, intro, outro);
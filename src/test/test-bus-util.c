@@ -1,7 +1,12 @@
 /* SPDX-License-Identifier: LGPL-2.1-or-later */
 
+#include "bus-map-properties.h"
 #include "bus-util.h"
 #include "log.h"
+#include "parse-util.h"
+#include "path-util.h"
+#include "string-util.h"
+#include "strv.h"
 #include "tests.h"
 
 static int callback(sd_bus_message *m, void *userdata, sd_bus_error *ret_error) {
@@ -44,4 +49,100 @@ TEST(destroy_callback) {
         assert_se(n_called == 1);
 }
 
+typedef struct TestObject {
+        uint32_t index;
+        char *name;
+} TestObject;
+
+static int test_object_find(sd_bus *bus, const char *path, const char *interface, void *userdata, void **found, sd_bus_error *error) {
+        const char *e;
+        unsigned u;
+
+        e = path_startswith(path, "/test");
+        if (!e || safe_atou(e, &u) < 0 || u >= 1000)
+                return 0;
+
+        /* The object itself is its index */
+        *found = UINT_TO_PTR(u + 1);
+        return 1;
+}
+
+static int test_object_get_index(sd_bus *bus, const char *path, const char *interface, const char *property,
+                                 sd_bus_message *reply, void *userdata, sd_bus_error *error) {
+        return sd_bus_message_append(reply, "u", (uint32_t) (PTR_TO_UINT(userdata) - 1));
+}
+
+static int test_object_get_name(sd_bus *bus, const char *path, const char *interface, const char *property,
+                                sd_bus_message *reply, void *userdata, sd_bus_error *error) {
+        char name[DECIMAL_STR_MAX(unsigned) + STRLEN("object")];
+
+        xsprintf(name, "object%u", PTR_TO_UINT(userdata) - 1);
+        return sd_bus_message_append(reply, "s", name);
+}
+
+static const sd_bus_vtable test_object_vtable[] = {
+        SD_BUS_VTABLE_START(0),
+        SD_BUS_PROPERTY("Index", "u", test_object_get_index, 0, SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_PROPERTY("Name", "s", test_object_get_name, 0, SD_BUS_VTABLE_PROPERTY_CONST),
+        SD_BUS_VTABLE_END
+};
+
+TEST(map_all_properties_many) {
+        static const struct bus_properties_map map[] = {
+                { "Index", "u", NULL, offsetof(TestObject, index) },
+                { "Name",  "s", NULL, offsetof(TestObject, name)  },
+                {}
+        };
+        _cleanup_(sd_bus_flush_close_unrefp) sd_bus *bus = NULL;
+        _cleanup_strv_free_ char **paths = NULL;
+        _cleanup_free_ TestObject *objects = NULL;
+        BusMapPropertiesRequest *requests = NULL;
+        size_t n = 0;
+        const char *unique;
+        int r;
+
+        CLEANUP_ARRAY(requests, n, bus_map_properties_request_array_free);
+
+        r = sd_bus_open_user(&bus);
+        if (r < 0)
+                r = sd_bus_open_system(&bus);
+        if (r < 0)
+                return (void) log_tests_skipped_errno(r, "Failed to connect to bus");
+
+        /* The calls go out to ourselves, and are served while we wait for the replies */
+        assert_se(sd_bus_add_fallback_vtable(bus, NULL, "/test", "org.freedesktop.elogind.Test", test_object_vtable,
+                                             test_object_find, NULL) >= 0);
+        assert_se(sd_bus_get_unique_name(bus, &unique) >= 0);
+
+        /* Every tenth object does not exist */
+        for (unsigned i = 0; i < 200; i++)
+                assert_se(strv_extendf(&paths, "/test/%u", i % 10 == 9 ? i + 1000 : i) >= 0);
+
+        n = strv_length(paths);
+        assert_se(requests = new0(BusMapPropertiesRequest, n));
+        assert_se(objects = new0(TestObject, n));
+
+        for (size_t i = 0; i < n; i++)
+                requests[i] = (BusMapPropertiesRequest) {
+                        .path = paths[i],
+                        .userdata = objects + i,
+                };
+
+        assert_se(bus_map_all_properties_many(bus, unique, map, 0, 16, requests, n) >= 0);
+
+        for (size_t i = 0; i < n; i++) {
+                if (i % 10 == 9) {
+                        assert_se(requests[i].result < 0);
+                        assert_se(sd_bus_error_is_set(&requests[i].error));
+                        assert_se(!requests[i].reply);
+                        continue;
+                }
+
+                assert_se(requests[i].result == 0);
+                assert_se(requests[i].reply);
+                assert_se(objects[i].index == i);
+                assert_se(streq_ptr(objects[i].name, strjoina("object", paths[i] + STRLEN("/test/"))));
+        }
+}
+
 DEFINE_TEST_MAIN(LOG_DEBUG);
@@ -15,11 +15,13 @@
 #include "fs-util.h"
 #include "log.h"
 #include "macro.h"
+#include "parse-util.h"
 #include "path-util.h"
 #include "rm-rf.h"
 #include "string-util.h"
 #include "strv.h"
 #include "tests.h"
+#include "time-util.h"
 #include "tmpfile-util.h"
 
 static int here = 0, here2 = 0, here3 = 0;
@@ -282,6 +284,202 @@ TEST(stdout_gathering) {
         assert_se(streq(output, "a\nb\nc\nd\n"));
 }
 
+#if 1 /// elogind can run its hook scripts in parallel, with limits
+/* The scripts are run from a child process, which passes on how many outputs it processed */
+static int count_stdout_generate(int fd, void *arg) {
+        unsigned *n = ASSERT_PTR(arg);
+
+        assert_se(fd >= 0);
+        safe_close(fd);
+
+        (*n)++;
+        return 0;
+}
+static int count_stdout_collect(int fd, void *arg) {
+        unsigned *n = ASSERT_PTR(arg);
+
+        assert_se(write(fd, n, sizeof *n) == sizeof *n);
+        safe_close(fd);
+
+        return 0;
+}
+static int count_stdout_consume(int fd, void *arg) {
+        unsigned *n = ASSERT_PTR(arg);
+
+        assert_se(read(fd, n, sizeof *n) == sizeof *n);
+        safe_close(fd);
+
+        return 0;
+}
+
+static const gather_stdout_callback_t count_stdout[] = {
+        count_stdout_generate,
+        count_stdout_collect,
+        count_stdout_consume,
+};
+
+static int execute_directory_limits_one(bool ignore_errors, unsigned *ret_n_outputs) {
+        _cleanup_(rm_rf_physical_and_freep) char *tmpdir = NULL;
+        const char *name_a, *name_b, *name_c, *name_slow, *name_last;
+        ExecDirLimits limits = {
+                .max_jobs = 2,
+                .job_timeout = USEC_PER_SEC,
+        };
+        unsigned n_outputs = 0;
+        void *args[] = { &n_outputs, &n_outputs, &n_outputs };
+        usec_t begin;
+        int r;
+
+        assert_se(mkdtemp_malloc("/tmp/test-exec-util-limits.XXXXXXX", &tmpdir) >= 0);
+
+        const char *dirs[] = { tmpdir, NULL };
+
+        /* The two scripts of the first group wait for each other, hence only finish if run side by side */
+        name_a = strjoina(tmpdir, "/10-a");
+        name_b = strjoina(tmpdir, "/10-b");
+        name_c = strjoina(tmpdir, "/20-c");
+        name_slow = strjoina(tmpdir, "/30-slow");
+        name_last = strjoina(tmpdir, "/40-last");
+
+        assert_se(write_string_file(name_a,
+                                    "#!/bin/sh\ncd $(dirname $0)\ntouch a-started\n"
+                                    "while [ ! -e b-started ]; do sleep 0.05; done\ntouch a-done",
+                                    WRITE_STRING_FILE_CREATE) == 0);
+        assert_se(write_string_file(name_b,
+                                    "#!/bin/sh\ncd $(dirname $0)\ntouch b-started\n"
+                                    "while [ ! -e a-started ]; do sleep 0.05; done\ntouch b-done",
+                                    WRITE_STRING_FILE_CREATE) == 0);
+        assert_se(write_string_file(name_c,
+                                    "#!/bin/sh\ncd $(dirname $0)\n[ -e a-done ] && [ -e b-done ] && touch c-done",
+                                    WRITE_STRING_FILE_CREATE) == 0);
+        assert_se(write_string_file(name_slow,
+                                    "#!/bin/sh\nexec sleep 60",
+                                    WRITE_STRING_FILE_CREATE) == 0);
+        assert_se(write_string_file(name_last,
+                                    "#!/bin/sh\ntouch $(dirname $0)/last-done",
+                                    WRITE_STRING_FILE_CREATE) == 0);
+
+        FOREACH_STRING(name, name_a, name_b, name_c, name_slow, name_last)
+                assert_se(chmod(name, 0755) == 0);
+
+        if (access(name_a, X_OK) < 0 && ERRNO_IS_PRIVILEGE(errno))
+                return -EPERM;
+
+        begin = now(CLOCK_MONOTONIC);
+        r = execute_directories_full(dirs, 60 * USEC_PER_SEC, &limits, count_stdout, args, NULL, NULL,
+                                     EXEC_DIR_PARALLEL | EXEC_DIR_GROUP_BY_PREFIX | EXEC_DIR_LOG_DURATION |
+                                     (ignore_errors ? EXEC_DIR_IGNORE_ERRORS : 0));
+        log_info("Executed scripts in %s.", FORMAT_TIMESPAN(usec_sub_unsigned(now(CLOCK_MONOTONIC), begin), USEC_PER_MSEC));
+
+        /* The slow script was killed after its timeout, way before it would have finished */
+        assert_se(usec_sub_unsigned(now(CLOCK_MONOTONIC), begin) < 30 * USEC_PER_SEC);
+
+        assert_se(access(strjoina(tmpdir, "/a-done"), F_OK) >= 0);
+        assert_se(access(strjoina(tmpdir, "/b-done"), F_OK) >= 0);
+        assert_se(access(strjoina(tmpdir, "/c-done"), F_OK) >= 0);
+        assert_se((access(strjoina(tmpdir, "/last-done"), F_OK) >= 0) == ignore_errors);
+
+        *ret_n_outputs = n_outputs;
+        return r;
+}
+
+TEST(execute_directory_limits) {
+        unsigned n_outputs;
+        int r;
+
+        r = execute_directory_limits_one(/* ignore_errors = */ true, &n_outputs);
+        if (r == -EPERM)
+                return (void) log_tests_skipped("Cannot execute scripts");
+        assert_se(r == 0);
+        assert_se(n_outputs == 5);
+
+        /* Without ignoring errors, nothing is run after the script that timed out */
+        assert_se(execute_directory_limits_one(/* ignore_errors = */ false, &n_outputs) > 0);
+}
+
+TEST(execute_directory_limits_failure) {
+        _cleanup_(rm_rf_physical_and_freep) char *tmpdir = NULL;
+        _cleanup_free_ char *pid_string = NULL;
+        const char *name_fail, *name_sleeper;
+        ExecDirLimits limits = {
+                .max_jobs = 2,
+                .job_timeout = USEC_INFINITY,
+        };
+        pid_t pid;
+
+        assert_se(mkdtemp_malloc("/tmp/test-exec-util-limits-failure.XXXXXXX", &tmpdir) >= 0);
+
+        const char *dirs[] = { tmpdir, NULL };
+
+        /* The first script fails while the second one still runs, which must not survive the failure */
+        name_fail = strjoina(tmpdir, "/10-fail");
+        name_sleeper = strjoina(tmpdir, "/10-sleeper");
+
+        assert_se(write_string_file(name_fail,
+                                    "#!/bin/sh\ncd $(dirname $0)\n"
+                                    "while [ ! -s sleeper-pid ]; do sleep 0.05; done\nexit 1",
+                                    WRITE_STRING_FILE_CREATE) == 0);
+        assert_se(write_string_file(name_sleeper,
+                                    "#!/bin/sh\necho $$ >$(dirname $0)/sleeper-pid.tmp\n"
+                                    "mv $(dirname $0)/sleeper-pid.tmp $(dirname $0)/sleeper-pid\nexec sleep 60",
+                                    WRITE_STRING_FILE_CREATE) == 0);
+
+        FOREACH_STRING(name, name_fail, name_sleeper)
+                assert_se(chmod(name, 0755) == 0);
+
+        if (access(name_fail, X_OK) < 0 && ERRNO_IS_PRIVILEGE(errno))
+                return (void) log_tests_skipped("Cannot execute scripts");
+
+        assert_se(execute_directories_full(dirs, 60 * USEC_PER_SEC, &limits, NULL, NULL, NULL, NULL,
+                                           EXEC_DIR_PARALLEL | EXEC_DIR_GROUP_BY_PREFIX) > 0);
+
+        /* The sleeper was killed and reaped before the executor returned */
+        assert_se(read_one_line_file(strjoina(tmpdir, "/sleeper-pid"), &pid_string) >= 0);
+        assert_se(parse_pid(pid_string, &pid) >= 0);
+        assert_se(kill(pid, 0) < 0 && errno == ESRCH);
+}
+
+TEST(execute_directory_limits_skip_remaining) {
+        _cleanup_(rm_rf_physical_and_freep) char *tmpdir = NULL;
+        const char *name_skip, *name_sibling, *name_next;
+        ExecDirLimits limits = {
+                .max_jobs = 2,
+                .job_timeout = USEC_INFINITY,
+        };
+
+        assert_se(mkdtemp_malloc("/tmp/test-exec-util-limits-skip.XXXXXXX", &tmpdir) >= 0);
+
+        const char *dirs[] = { tmpdir, NULL };
+
+        /* The script running next to the one that exits with 77 still finishes, the next group is skipped */
+        name_skip = strjoina(tmpdir, "/10-skip");
+        name_sibling = strjoina(tmpdir, "/10-sibling");
+        name_next = strjoina(tmpdir, "/20-next");
+
+        assert_se(write_string_file(name_skip,
+                                    "#!/bin/sh\nexit 77",
+                                    WRITE_STRING_FILE_CREATE) == 0);
+        assert_se(write_string_file(name_sibling,
+                                    "#!/bin/sh\nsleep 0.2\ntouch $(dirname $0)/sibling-done",
+                                    WRITE_STRING_FILE_CREATE) == 0);
+        assert_se(write_string_file(name_next,
+                                    "#!/bin/sh\ntouch $(dirname $0)/next-done",
+                                    WRITE_STRING_FILE_CREATE) == 0);
+
+        FOREACH_STRING(name, name_skip, name_sibling, name_next)
+                assert_se(chmod(name, 0755) == 0);
+
+        if (access(name_skip, X_OK) < 0 && ERRNO_IS_PRIVILEGE(errno))
+                return (void) log_tests_skipped("Cannot execute scripts");
+
+        assert_se(execute_directories_full(dirs, 60 * USEC_PER_SEC, &limits, NULL, NULL, NULL, NULL,
+                                           EXEC_DIR_PARALLEL | EXEC_DIR_GROUP_BY_PREFIX | EXEC_DIR_SKIP_REMAINING) == 0);
+
+        assert_se(access(strjoina(tmpdir, "/sibling-done"), F_OK) >= 0);
+        assert_se(access(strjoina(tmpdir, "/next-done"), F_OK) < 0 && errno == ENOENT);
+}
+#endif // 1
+
 #if 0 /// UNNEEDED by elogind
 TEST(environment_gathering) {
         _cleanup_(rm_rf_physical_and_freep) char *tmpdir = NULL;
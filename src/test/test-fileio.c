@@ -1116,6 +1116,50 @@ TEST(read_virtual_file) {
         test_read_virtual_file_one(SIZE_MAX);
 }
 
+TEST(read_virtual_attribute) {
+        _cleanup_(unlink_tempfilep) char fn[] = "/tmp/test-read_virtual_attribute-XXXXXX";
+        _cleanup_free_ char *buf = NULL, *buf2 = NULL, *field = NULL;
+        _cleanup_close_ int fd = -EBADF;
+
+        fd = mkostemp_safe(fn);
+        assert_se(fd >= 0);
+
+        assert_se(write_string_file(fn, "foo bar\n", WRITE_STRING_FILE_TRUNCATE) >= 0);
+        assert_se(read_virtual_attribute(fn, &buf) >= 0);
+        assert_se(streq(buf, "foo bar"));
+        buf = mfree(buf);
+
+        /* Changes in place are seen through the cached fd */
+        assert_se(write_string_file(fn, "waldo\n\n", WRITE_STRING_FILE_TRUNCATE) >= 0);
+        assert_se(read_virtual_attribute(fn, &buf) >= 0);
+        assert_se(streq(buf, "waldo"));
+        buf = mfree(buf);
+
+        /* A replaced file is not, until the cache is invalidated */
+        assert_se(write_string_file(fn, "quux", WRITE_STRING_FILE_ATOMIC) >= 0);
+        assert_se(read_virtual_attribute(fn, &buf) >= 0);
+        assert_se(streq(buf, "waldo"));
+        buf = mfree(buf);
+
+        virtual_attribute_cache_invalidate("/tmp");
+        assert_se(read_virtual_attribute(fn, &buf) >= 0);
+        assert_se(streq(buf, "quux"));
+        buf = mfree(buf);
+
+        assert_se(unlink(fn) >= 0);
+        virtual_attribute_cache_invalidate(fn);
+        assert_se(read_virtual_attribute(fn, &buf) == -ENOENT);
+
+        /* procfs files are fine too */
+        if (read_virtual_attribute("/proc/self/status", &buf2) < 0)
+                return;
+
+        assert_se(get_proc_field_from_string(buf2, "Name", WHITESPACE, &field) >= 0);
+        assert_se(streq(field, program_invocation_short_name));
+
+        virtual_attribute_cache_invalidate(NULL);
+}
+
 TEST(fdopen_independent) {
 #define TEST_TEXT "this is some random test text we are going to write to a memfd"
         _cleanup_close_ int fd = -EBADF;
@@ -4,6 +4,7 @@
 
 #include "alloc-util.h"
 #include "format-table.h"
+#include "memstream-util.h"
 #include "string-util.h"
 #include "strv.h"
 #include "tests.h"
@@ -648,6 +649,77 @@ TEST(dup_cell) {
                         "aaa     0     65535   4294967295   100%   ../    hello    hello    hello\n"));
 }
 
+TEST(stream) {
+        _cleanup_(memstream_done) MemStream m = {};
+        _cleanup_(table_unrefp) Table *t = NULL, *reference = NULL;
+        _cleanup_free_ char *formatted = NULL, *expected = NULL;
+        FILE *f;
+
+        /* Fewer rows than the sample, formatted like any other table */
+        assert_se(t = table_new("foo", "bar"));
+        assert_se(reference = table_new("foo", "bar"));
+        table_set_width(t, 0);
+        table_set_width(reference, 0);
+
+        assert_se(f = memstream_init(&m));
+        assert_se(table_set_stream(t, f, 10) >= 0);
+        assert_se(table_set_sort(t, (size_t) 0) == -EBUSY);
+
+        for (unsigned i = 0; i < 5; i++) {
+                assert_se(table_add_cell_stringf(t, NULL, "%u", i * 1000) >= 0);
+                assert_se(table_add_cell(t, NULL, TABLE_STRING, "x") >= 0);
+                assert_se(table_add_cell_stringf(reference, NULL, "%u", i * 1000) >= 0);
+                assert_se(table_add_cell(reference, NULL, TABLE_STRING, "x") >= 0);
+        }
+
+        assert_se(table_print(t, f) >= 0);
+        assert_se(memstream_finalize(&m, &formatted, NULL) >= 0);
+        assert_se(table_format(reference, &expected) >= 0);
+        assert_se(streq(formatted, expected));
+
+        formatted = mfree(formatted);
+        t = table_unref(t);
+
+        /* Widths fixed from the first two rows, the second column from its explicit maximum */
+        assert_se(t = table_new("foo", "bar"));
+        table_set_width(t, 0);
+        assert_se(table_set_maximum_width(t, TABLE_HEADER_CELL(1), 5) >= 0);
+
+        assert_se(f = memstream_init(&m));
+        assert_se(table_set_stream(t, f, 2) >= 0);
+
+        assert_se(table_add_many(t,
+                                 TABLE_STRING, "a",
+                                 TABLE_STRING, "1",
+                                 TABLE_STRING, "bb",
+                                 TABLE_STRING, "22") >= 0);
+        assert_se(ftell(f) == 0);
+
+        assert_se(table_add_many(t,
+                                 TABLE_STRING, "cccc",
+                                 TABLE_STRING, "333333",
+                                 TABLE_STRING, "d",
+                                 TABLE_STRING, "4",
+                                 TABLE_STRING, "e",
+                                 TABLE_STRING, "5") >= 0);
+        assert_se(ftell(f) > 0);
+        assert_se(table_get_rows(t) == 6);
+
+        assert_se(table_print(t, f) >= 0);
+        assert_se(table_get_rows(t) == 6);
+        assert_se(table_to_json(t, NULL) == -EBUSY);
+
+        assert_se(memstream_finalize(&m, &formatted, NULL) >= 0);
+        printf("%s\n", formatted);
+        assert_se(streq(formatted,
+                        "FOO BAR\n"
+                        "a   1\n"
+                        "bb  22\n"
+                        "cc… 3333…\n"
+                        "d   4\n"
+                        "e   5\n"));
+}
+
 static int intro(void) {
         assert_se(setenv("SYSTEMD_COLORS", "0", 1) >= 0);
         assert_se(setenv("COLUMNS", "40", 1) >= 0);